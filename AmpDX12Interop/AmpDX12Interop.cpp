@@ -10,6 +10,8 @@
 //*********************************************************
 
 #include "AmpDX12Interop.h"
+#include "PixelKernels.h"
+#include "stb_image.h"
 #include "stb_image_write.h"
 
 using namespace std;
@@ -20,11 +22,65 @@ const auto backBufferFormat = Format::R8G8B8A8_UNORM;
 
 AmpDX12Interop::AmpDX12Interop(uint32_t width, uint32_t height, wstring name) :
 	DXFramework(width, height, name),
+	m_recordedResult(nullptr),
 	m_frameIndex(0),
+	m_fenceEvent(nullptr),
+	m_framesInFlight(3),
+	m_backBufferCount(3),
+	m_frameLatencyWaitable(nullptr),
+	m_callbackEvent(nullptr),
 	m_deviceType(DEVICE_DISCRETE),
 	m_showFPS(true),
+	m_isPaused(false),
+	m_isBatchMode(false),
+	m_isDirty(true),
+	m_windowWidth(0),
+	m_windowHeight(0),
+	m_processedRect(),
+	m_frameSource(0),
+	m_numProcessedPixels(0),
+	m_numVisiblePixels(0),
+	m_numImagePixels(0),
+	m_numNewFrames(0),
+	m_totalChangedTexels(0),
+	m_totalFrameTexels(0),
+	m_totalFramePixels(0),
+	m_totalFrameVisiblePixels(0),
+	m_useAnnotations(false),
+	m_isAnnotating(false),
 	m_fileName("Assets/Sashimi.png"),
 	m_useNativeDX11(false),
+	m_useImageCache(true),
+	m_imageCacheSize(1024),
+	m_tileSize(0),
+	m_useTiling(false),
+	m_useCPUTiling(false),
+	m_useMultiAdapter(false),
+	m_numCPUWorkers(0),
+	m_useAtlas(true),
+	m_useStack(true),
+	m_rerecordEveryFrame(false),
+	m_isEventDriven(false),
+	m_useRenderThread(false),
+	m_maxFrameLatency(0),
+	m_rawWidth(0),
+	m_rawHeight(0),
+	m_useFixedPointLuma(false),
+	m_verifyLuma(false),
+	m_benchIterations(0),
+	m_startupTime(chrono::steady_clock::now()),
+	m_phaseTime(m_startupTime),
+	m_submitTime(0.0),
+	m_numSubmits(0),
+	m_numPausedSubmits(0),
+	m_frameEndFenceValues(),
+	m_latency(0.0),
+	m_numLatencyFrames(0),
+	m_totalLatency(0.0),
+	m_totalLatencyFrames(0),
+	m_cpuUsage(0.0),
+	m_cpuTime(0),
+	m_cpuUsageTime(m_startupTime),
 	m_screenShot(0)
 {
 #if defined (_DEBUG)
@@ -46,14 +102,25 @@ AmpDX12Interop::~AmpDX12Interop()
 
 void AmpDX12Interop::OnInit()
 {
-	vector<Resource::uptr> uploaders(0);
-	Texture::uptr srcForNative11;
-	LoadPipeline(uploaders, srcForNative11);
+	// The CPU tiled processing needs no device, and runs as a batch job
+	if (m_useTiling && m_useCPUTiling)
+	{
+		ProcessTiled(nullptr);
+		m_isBatchMode = true;
+		PostQuitMessage(0);
+
+		return;
+	}
+
+	Texture::sptr srcForNative11;
+	LoadPipeline(srcForNative11);
+	if (m_isBatchMode) return;
 	LoadAssets();
+	MarkStartupPhase("Initial upload");
 }
 
 // Load the rendering pipeline dependencies.
-void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::uptr& srcForNative11)
+void AmpDX12Interop::LoadPipeline(Texture::sptr& srcForNative11)
 {
 	auto dxgiFactoryFlags = 0u;
 
@@ -73,6 +140,8 @@ void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::up
 	}
 #endif
 
+	MarkStartupPhase("Window creation");
+
 	com_ptr<IDXGIFactory5> factory;
 	ThrowIfFailed(CreateDXGIFactory2(dxgiFactoryFlags, IID_PPV_ARGS(&factory)));
 
@@ -82,7 +151,21 @@ void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::up
 	const auto useWARP = m_deviceType == DEVICE_WARP;
 	auto checkUMA = true, checkWARP = true;
 	auto hr = DXGI_ERROR_NOT_FOUND;
-	for (uint8_t n = 0; n < 3; ++n)
+
+	// Take the fastest adapter measured by the probe, or fall back to the search below
+	if (m_deviceType == DEVICE_FASTEST)
+	{
+		AdapterProbe adapterProbe;
+		if (adapterProbe.Init("Cache") && adapterProbe.SelectFastest(factory.get(), dxgiAdapter))
+		{
+			dxgiAdapter->GetDesc1(&dxgiAdapterDesc);
+			m_device = Device::MakeUnique();
+			hr = m_device->Create(dxgiAdapter.get(), D3D_FEATURE_LEVEL_11_0);
+			PrintAdapterProbe(adapterProbe);
+		}
+	}
+
+	for (uint8_t n = 0; n < 3 && FAILED(hr); ++n)
 	{
 		if (FAILED(hr)) hr = DXGI_ERROR_UNSUPPORTED;
 		for (auto i = 0u; hr == DXGI_ERROR_UNSUPPORTED; ++i)
@@ -118,6 +201,7 @@ void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::up
 	else if (dxgiAdapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) m_title += L" (Software)";
 	//else m_title += wstring(L" - ") + dxgiAdapterDesc.Description;
 	ThrowIfFailed(hr);
+	MarkStartupPhase("Adapter and device creation");
 
 	// Create the command queue.
 	m_commandQueue = CommandQueue::MakeUnique();
@@ -128,7 +212,8 @@ void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::up
 	ThrowIfFailed(factory->MakeWindowAssociation(Win32Application::GetHwnd(), DXGI_MWA_NO_ALT_ENTER));
 
 	// Create a command allocator for each frame.
-	for (uint8_t n = 0u; n < FrameCount; ++n)
+	m_backBufferCount = (max)(m_framesInFlight, static_cast<uint8_t>(2));
+	for (uint8_t n = 0u; n < m_backBufferCount; ++n)
 	{
 		m_commandAllocators[n] = CommandAllocator::MakeUnique();
 		XUSG_N_RETURN(m_commandAllocators[n]->Create(m_device.get(), CommandListType::DIRECT,
@@ -141,6 +226,8 @@ void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::up
 	XUSG_N_RETURN(pCommandList->Create(m_device.get(), 0, CommandListType::DIRECT,
 		m_commandAllocators[m_frameIndex].get(), nullptr), ThrowIfFailed(E_FAIL));
 
+	MarkStartupPhase("Command queue, allocators and list");
+
 	// Create DX11on12 device
 	const auto pCommandQueue = reinterpret_cast<IUnknown*>(m_commandQueue->GetHandle());
 	const uint32_t d3d11DeviceFlags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
@@ -156,12 +243,81 @@ void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::up
 
 	m_amp12 = make_unique<Amp12>(ampAcceleratorView);
 	if (!m_amp12) ThrowIfFailed(E_FAIL);
+	m_amp12->SetFixedPointLuma(m_useFixedPointLuma);
+	MarkStartupPhase("DX11 device and AMP accelerator view");
 
-	if (!m_amp12->Init(pCommandList, uploaders, backBufferFormat,
-		m_fileName.c_str(), m_useNativeDX11 ? &srcForNative11 : nullptr))
-		ThrowIfFailed(E_FAIL);
+	if (!m_sequencePath.empty())
+	{
+		// Image sequences are streamed into alternating sources on a copy queue
+		uint32_t width, height;
+		if (!m_sequence.GetNumFrames()) ThrowIfFailed(E_FAIL);
+		m_sequence.GetFrameSize(width, height);
+		if (!m_amp12->InitSequence(m_device.get(), width, height, backBufferFormat,
+			m_frameSources, SequenceStreamer::MaxSourceCount))
+			ThrowIfFailed(E_FAIL);
+		if (!m_sequenceStreamer.Init(m_device.get(), &m_sequence, m_frameSources, SequenceStreamer::MaxSourceCount))
+			ThrowIfFailed(E_FAIL);
+		MarkStartupPhase("Sequence streaming initialization");
+	}
+	else if (!m_batchFileNames.empty())
+	{
+		// Batches are processed headless, saving the results next to their inputs, or benchmarked
+		if (m_benchIterations > 0) RunBenchmarks();
+		else ProcessBatch();
+		m_isBatchMode = true;
+		PostQuitMessage(0);
+
+		return;
+	}
+	else if (m_useTiling)
+	{
+		// Images beyond the max texture dimension are processed tile by tile as a batch job,
+		// streamed from their files instead of decoded
+		ProcessTiled(&ampAcceleratorView);
+		m_isBatchMode = true;
+		PostQuitMessage(0);
+
+		return;
+	}
+	else
+	{
+		// Join the image decoding, which has been overlapped with the device creation above
+		if (!m_imageLoader.Wait()) ThrowIfFailed(E_FAIL);
+		MarkStartupPhase("Waiting for image decode");
+
+		// The fixed-point luma of the GPU is checked against the CPU kernels as a batch job,
+		// exiting with 1 on any difference
+		if (m_verifyLuma)
+		{
+			const auto isExact = VerifyLuma();
+			m_isBatchMode = true;
+			PostQuitMessage(isExact ? 0 : 1);
+
+			return;
+		}
+
+		// Images are split among all the adapters and the CPU as a batch job, if requested
+		if (m_useMultiAdapter)
+		{
+			ProcessMultiAdapter();
+			m_isBatchMode = true;
+			PostQuitMessage(0);
+
+			return;
+		}
+
+		if (!m_uploadRing.Init(m_device.get(), UploadRingSize)) ThrowIfFailed(E_FAIL);
+		if (!m_amp12->Init(pCommandList, m_uploadRing, backBufferFormat, m_imageLoader,
+			m_useNativeDX11 ? &srcForNative11 : nullptr))
+			ThrowIfFailed(E_FAIL);
+		m_imageLoader.Release();
+		MarkStartupPhase("Amp12 initialization");
+	}
 	
 	m_amp12->GetImageSize(m_width, m_height);
+	if (!m_amp12->InitView(m_device.get(), m_width, m_height, backBufferFormat)) ThrowIfFailed(E_FAIL);
+	m_sourceDirty.SetBounds(m_width, m_height);
+	m_viewDirty.SetBounds(m_width, m_height);
 
 	// Resize window
 	{
@@ -177,18 +333,30 @@ void AmpDX12Interop::LoadPipeline(vector<Resource::uptr>& uploaders, Texture::up
 
 	// Describe and create the swap chain.
 	m_swapChain = SwapChain::MakeUnique();
+	const auto isWaitable = m_isEventDriven || m_maxFrameLatency > 0;
 	XUSG_N_RETURN(m_swapChain->Create(factory.get(), Win32Application::GetHwnd(), pCommandQueue,
-		FrameCount, m_width, m_height, backBufferFormat, SwapChainFlag::ALLOW_TEARING), ThrowIfFailed(E_FAIL));
+		m_backBufferCount, m_width, m_height, backBufferFormat, GetSwapChainFlags()), ThrowIfFailed(E_FAIL));
+
+	// The event-driven render loop sleeps until the swap chain can take the next frame, and the
+	// low-latency mode waits for it before sampling the input of a frame
+	if (isWaitable)
+	{
+		com_ptr<IDXGISwapChain2> swapChain2;
+		ThrowIfFailed(static_cast<IUnknown*>(m_swapChain->GetHandle())->QueryInterface(IID_PPV_ARGS(&swapChain2)));
+		if (m_maxFrameLatency > 0) ThrowIfFailed(swapChain2->SetMaximumFrameLatency(m_maxFrameLatency));
+		m_frameLatencyWaitable = swapChain2->GetFrameLatencyWaitableObject();
+	}
 
 	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 
 	// Create frame resources.
 	// Create a RTV for each frame.
-	for (uint8_t n = 0; n < FrameCount; ++n)
+	for (uint8_t n = 0; n < m_backBufferCount; ++n)
 	{
 		m_renderTargets[n] = RenderTarget::MakeUnique();
 		XUSG_N_RETURN(m_renderTargets[n]->CreateFromSwapChain(m_device.get(), m_swapChain.get(), n), ThrowIfFailed(E_FAIL));
 	}
+	MarkStartupPhase("Swap chain");
 }
 
 // Load the sample assets.
@@ -210,9 +378,15 @@ void AmpDX12Interop::LoadAssets()
 		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 		if (!m_fenceEvent) ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
 
+		// Create an event handle for the event-driven render loop to wait for the fence callbacks,
+		// apart from the frame synchronization
+		m_callbackEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (!m_callbackEvent) ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
 		// Wait for the command list to execute; we are reusing the same command 
 		// list in our main loop but for now, we just want to wait for setup to 
 		// complete before continuing.
+		m_uploadRing.Submit(m_fenceValues[m_frameIndex]);
 		WaitForGpu();
 	}
 }
@@ -220,6 +394,14 @@ void AmpDX12Interop::LoadAssets()
 // Update frame-based values.
 void AmpDX12Interop::OnUpdate()
 {
+	if (m_isBatchMode) return;
+
+	// In the low-latency mode, wait until the swap chain can take the frame before sampling the input
+	// of it; the event-driven render loop has already waited
+	if (m_maxFrameLatency > 0 && !IsEventDriven())
+		WaitForSingleObjectEx(m_frameLatencyWaitable, 1000, TRUE);
+	m_frameStartTimes[m_frameIndex] = chrono::steady_clock::now();
+
 	// Timer
 	static auto time = 0.0, pauseTime = 0.0;
 
@@ -234,26 +416,210 @@ void AmpDX12Interop::OnUpdate()
 // Render the scene.
 void AmpDX12Interop::OnRender()
 {
+	if (m_isBatchMode) return;
+
+	// Match the swap chain and the view to the client area
+	if (m_windowWidth > 0 && m_windowHeight > 0 && (m_windowWidth != m_width || m_windowHeight != m_height))
+		ResizeSwapChain();
+
 	// Record all the commands we need to render the scene into the command list.
-	PopulateCommandList();
+	auto startTime = chrono::steady_clock::now();
+	CommandList* pCommandList;
+	XUSG_N_RETURN(PopulateCommandList(pCommandList), ThrowIfFailed(E_FAIL));
+	auto submitTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	// Gather the out-of-date regions of the view: the changes of the source, and the parts of the
+	// window that have become visible. While paused, nothing else changes, so a frame, such as on
+	// an expose, only presents the result again. Of a new sequence frame, only the tiles whose
+	// hashes differ from the previous frame have changed, and the results of the others are kept.
+	if (!m_annotations.empty()) ApplyAnnotations();
+	auto isNewFrame = false;
+	if (!m_sequencePath.empty() && !m_isPaused)
+	{
+		// The sources alternate, so a new frame is always in another source
+		const auto frameSource = m_sequenceStreamer.Update(m_fence.get(), m_fenceValues[m_frameIndex]);
+		isNewFrame = frameSource != m_frameSource;
+		m_frameSource = frameSource;
+		for (const auto& rect : m_sequenceStreamer.GetChangedRects())
+		{
+			m_sourceDirty.Add(rect);
+			m_totalChangedTexels += static_cast<uint64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+		}
+	}
+	for (const auto& rect : m_sourceDirty.GetRects()) m_viewDirty.Add(m_amp12->GetViewRect(rect));
+	m_sourceDirty.Clear();
+
+	const auto visibleRect = GetVisibleRect();
+	RECT unionRect;
+	UnionRect(&unionRect, &visibleRect, &m_processedRect);
+	if (!EqualRect(&unionRect, &m_processedRect)) m_viewDirty.Add(visibleRect);
+	m_processedRect = visibleRect;
+
+	// Execute the command list. Only the dirty tiles of the visible part of the view are processed;
+	// the ones off the desktop are processed once they become visible.
+	m_dirtyRects.clear();
+	auto numProcessedPixels = 0ull;
+	for (const auto& rect : m_viewDirty.GetRects())
+	{
+		RECT dirtyRect;
+		if (!IntersectRect(&dirtyRect, &rect, &visibleRect)) continue;
+		m_dirtyRects.emplace_back(dirtyRect);
+		numProcessedPixels += static_cast<uint64_t>(dirtyRect.right - dirtyRect.left) * (dirtyRect.bottom - dirtyRect.top);
+	}
+	m_viewDirty.Clear();
 
-	// Execute the command list.
-	m_amp12->Process();
-	m_commandQueue->ExecuteCommandList(m_commandList.get());
+	if (m_isPaused) ++m_numPausedSubmits;
+	if (!m_dirtyRects.empty())
+	{
+		const auto numRects = static_cast<uint32_t>(m_dirtyRects.size());
+		if (m_sequencePath.empty()) m_amp12->Process(m_dirtyRects.data(), numRects);
+		else m_amp12->ProcessFrame(m_frameSource, m_dirtyRects.data(), numRects);
+	}
+
+	{
+		uint32_t width, height;
+		m_amp12->GetImageSize(width, height);
+		m_numProcessedPixels += numProcessedPixels;
+		m_numVisiblePixels += static_cast<uint64_t>(visibleRect.right - visibleRect.left) * (visibleRect.bottom - visibleRect.top);
+		m_numImagePixels += static_cast<uint64_t>(width) * height;
+
+		if (isNewFrame)
+		{
+			++m_numNewFrames;
+			m_totalFrameTexels += static_cast<uint64_t>(width) * height;
+			m_totalFramePixels += numProcessedPixels;
+			m_totalFrameVisiblePixels += static_cast<uint64_t>(visibleRect.right - visibleRect.left) * (visibleRect.bottom - visibleRect.top);
+		}
+	}
 
-	// Present the frame.
-	XUSG_N_RETURN(m_swapChain->Present(0, PresentFlag::ALLOW_TEARING), ThrowIfFailed(E_FAIL));
+	startTime = chrono::steady_clock::now();
+	m_commandQueue->ExecuteCommandList(pCommandList);
+	submitTime += chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+	m_submitTime += submitTime;
+	++m_numSubmits;
+
+	// Present the frame, telling the compositor which parts have changed; with none, the frame
+	// repeats the result, such as on an expose, and is presented in full.
+	m_presentRects.clear();
+	for (const auto& rect : m_dirtyRects) m_presentRects.emplace_back(rect.left, rect.top, rect.right, rect.bottom);
+	XUSG_N_RETURN(m_swapChain->PresentEx(0, PresentFlag::ALLOW_TEARING, static_cast<uint32_t>(m_presentRects.size()),
+		m_presentRects.data()), ThrowIfFailed(E_FAIL));
+	m_isDirty = false;
 
 	MoveToNextFrame();
+
+	// Report the startup-phase breakdown once the first frame has been presented
+	if (!m_startupPhases.empty())
+	{
+		MarkStartupPhase("First frame");
+		cout << "Startup phases:" << endl;
+		for (const auto& phase : m_startupPhases)
+			cout << "    " << phase.first << ": " << phase.second << " ms" << endl;
+		if (m_sequencePath.empty())
+		{
+			uint32_t width, height;
+			m_amp12->GetImageSize(width, height);
+			const auto megaPixels = width * static_cast<double>(height) / 1000000.0;
+			const auto loadTime = m_imageLoader.GetLoadTime();
+			const auto writeTime = m_imageLoader.GetWriteTime();
+			cout << "    Image decode (worker thread): " << loadTime << " ms, "
+				<< (m_useImageCache ? (m_imageLoader.IsCacheHit() ? "warm cache" : "cold cache") : "cache off") << ", "
+				<< megaPixels * 1000.0 / loadTime << " MPix/s" << endl;
+			cout << "    Upload write (" << m_imageLoader.GetWritePrecisionName() << "): " << writeTime << " ms, "
+				<< megaPixels * 1000.0 / writeTime << " MPix/s" << endl;
+			PrintUploadStats("Upload ring", m_uploadRing.GetStats());
+		}
+		cout << "Time to first frame: " << chrono::duration<double, milli>(
+			chrono::steady_clock::now() - m_startupTime).count() << " ms" << endl;
+		m_startupPhases.clear();
+	}
 }
 
 void AmpDX12Interop::OnDestroy()
 {
+	// The batch jobs have waited for all of their GPU work already
+	if (m_isBatchMode)
+	{
+		if (m_fenceEvent) CloseHandle(m_fenceEvent);
+
+		return;
+	}
+
 	// Ensure that the GPU is no longer referencing resources that are about to be
 	// cleaned up by the destructor.
 	WaitForGpu();
 
+	// Report the latency and throughput of the frame-queue setting, for tuning
+	if (m_totalLatencyFrames > 0)
+	{
+		const auto time = chrono::duration<double>(chrono::steady_clock::now() - m_latencyStartTime).count();
+		cout << "Frames in flight: " << static_cast<uint32_t>(m_framesInFlight) << ", max frame latency: ";
+		if (m_maxFrameLatency > 0) cout << m_maxFrameLatency;
+		else cout << "default";
+		cout << endl << "    Average latency: " << m_totalLatency / m_totalLatencyFrames << " ms, throughput: "
+			<< m_totalLatencyFrames / time << " fps" << endl;
+	}
+
+	// Report how much of the sequence the tile hashes have skipped. This is a work ratio, not a
+	// wall-clock speedup; compare the throughput above against a run with -hashtile 0 for that
+	if (m_numNewFrames > 0)
+	{
+		const auto tileSize = m_sequence.GetHashTileSize();
+		cout << "Sequence frames: " << m_numNewFrames << ", hash tile size: ";
+		if (tileSize > 0) cout << tileSize;
+		else cout << "off";
+		cout << endl << "    Unchanged texels: " << 100.0 * (1.0 - static_cast<double>(m_totalChangedTexels) / m_totalFrameTexels)
+			<< "%, processed pixels: " << (m_totalFrameVisiblePixels > 0 ? 100.0 * m_totalFramePixels / m_totalFrameVisiblePixels : 0.0)
+			<< "% of the visible" << endl << "    Visible to processed pixel ratio: "
+			<< (m_totalFramePixels > 0 ? static_cast<double>(m_totalFrameVisiblePixels) / m_totalFramePixels : 0.0)
+			<< "x (work skipped, not wall-clock speedup)" << endl;
+	}
+
 	CloseHandle(m_fenceEvent);
+	CloseHandle(m_callbackEvent);
+	if (m_frameLatencyWaitable) CloseHandle(m_frameLatencyWaitable);
+}
+
+void AmpDX12Interop::OnWindowMoved()
+{
+	// A frame is only needed if more of the window has become visible
+	const auto visibleRect = GetVisibleRect();
+	RECT unionRect;
+	UnionRect(&unionRect, &visibleRect, &m_processedRect);
+	if (!EqualRect(&unionRect, &m_processedRect)) m_isDirty = true;
+}
+
+void AmpDX12Interop::OnWindowSizeChanged(int width, int height)
+{
+	// The swap chain is resized on the next frame, on the render thread
+	m_windowWidth = width;
+	m_windowHeight = height;
+	if (width > 0 && height > 0) m_isDirty = true;
+}
+
+void AmpDX12Interop::OnLButtonDown(float posX, float posY)
+{
+	// Annotations are drawn into the source, so still images only. The source is updated on the
+	// DX12 queue, which is not fenced against the reads of the native D3D11 device
+	if (!m_useAnnotations || m_isBatchMode || !m_sequencePath.empty() || m_useNativeDX11) return;
+
+	m_isAnnotating = true;
+	Annotate(posX, posY);
+}
+
+void AmpDX12Interop::OnLButtonUp(float, float)
+{
+	m_isAnnotating = false;
+}
+
+void AmpDX12Interop::OnMouseMove(float posX, float posY)
+{
+	if (m_isAnnotating) Annotate(posX, posY);
+}
+
+void AmpDX12Interop::OnMouseLeave()
+{
+	m_isAnnotating = false;
 }
 
 // User hot-key interactions.
@@ -262,13 +628,16 @@ void AmpDX12Interop::OnKeyUp(uint8_t key)
 	switch (key)
 	{
 	case VK_SPACE:
+		// No frame is needed to pause, since the displayed result stays valid
 		m_isPaused = !m_isPaused;
+		m_isDirty = !m_isPaused;
+		m_numPausedSubmits = 0;
 		break;
 	case VK_F1:
 		m_showFPS = !m_showFPS;
 		break;
 	case VK_F11:
-		m_screenShot = 1;
+		if (!m_screenShot) m_screenShot = 1;
 		break;
 	case VK_ESCAPE:
 		PostQuitMessage(0);
@@ -276,6 +645,74 @@ void AmpDX12Interop::OnKeyUp(uint8_t key)
 	}
 }
 
+bool AmpDX12Interop::IsEventDriven() const
+{
+	// While paused, the render loop sleeps as well, so that no GPU work is submitted until a frame is needed
+	return (m_isEventDriven || m_isPaused) && !m_isBatchMode;
+}
+
+uint32_t AmpDX12Interop::GetWaitHandles(HANDLE* pHandles, uint32_t maxHandles)
+{
+	auto numHandles = 0u;
+
+	// The swap chain can take the next frame
+	if (IsFramePending() && m_frameLatencyWaitable && numHandles < maxHandles)
+		pHandles[numHandles++] = m_frameLatencyWaitable;
+
+	// The GPU has completed a transfer with a pending callback, such as a screen shot
+	if (!m_fenceCallbacks.IsEmpty() && numHandles < maxHandles)
+	{
+		XUSG_N_RETURN(m_fence->SetEventOnCompletion(m_fenceCallbacks.GetNextFenceValue(), m_callbackEvent), numHandles);
+		pHandles[numHandles++] = m_callbackEvent;
+	}
+
+	return numHandles;
+}
+
+uint32_t AmpDX12Interop::GetWaitTimeout() const
+{
+	// Without a frame-latency waitable object, a pending frame is rendered right away
+	if (IsFramePending() && !m_frameLatencyWaitable) return 0;
+
+	// Wake up once per second while idle, to refresh the CPU utilization
+	return 1000;
+}
+
+void AmpDX12Interop::OnWaitSignaled(uint32_t)
+{
+	m_fenceCallbacks.Poll(m_fence->GetCompletedValue());
+
+	if (IsFramePending())
+	{
+		OnUpdate();
+		OnRender();
+	}
+}
+
+void AmpDX12Interop::OnWaitTimeout()
+{
+	if (IsFramePending())
+	{
+		OnUpdate();
+		OnRender();
+
+		return;
+	}
+
+	UpdateCPUUsage();
+
+	wstringstream windowText;
+	windowText << (m_isPaused ? L"    paused" : L"    idle") << L", CPU: " << setprecision(1) << fixed << m_cpuUsage << L"%";
+	if (m_isPaused) windowText << L", GPU submissions: " << m_numPausedSubmits << L"    [SPACE] resume";
+	windowText << L"    [F11] screen shot";
+	SetCustomWindowText(windowText.str().c_str());
+}
+
+bool AmpDX12Interop::UsesRenderThread() const
+{
+	return m_useRenderThread && !m_isBatchMode;
+}
+
 void AmpDX12Interop::ParseCommandLineArgs(wchar_t* argv[], int argc)
 {
 	const auto str_tolower = [](wstring s)
@@ -307,6 +744,7 @@ void AmpDX12Interop::ParseCommandLineArgs(wchar_t* argv[], int argc)
 	{
 		if (isArgMatched(i, L"warp")) m_deviceType = DEVICE_WARP;
 		else if (isArgMatched(i, L"uma")) m_deviceType = DEVICE_UMA;
+		else if (isArgMatched(i, L"fastest")) m_deviceType = DEVICE_FASTEST;
 		else if (isArgMatched(i, L"i") || isArgMatched(i, L"image"))
 		{
 			if (hasNextArgValue(i))
@@ -317,43 +755,399 @@ void AmpDX12Interop::ParseCommandLineArgs(wchar_t* argv[], int argc)
 			}
 		}
 		else if (isArgMatched(i, L"n") || isArgMatched(i, L"native")) m_useNativeDX11 = true;
+		else if (isArgMatched(i, L"nocache")) m_useImageCache = false;
+		else if (isArgMatched(i, L"annotate")) m_useAnnotations = true;
+		else if (isArgMatched(i, L"fp32")) m_imageLoader.SetHalfFloat(false);
+		else if (isArgMatched(i, L"tile"))
+		{
+			if (hasNextArgValue(i)) m_tileSize = _wtoi(argv[++i]);
+			else m_tileSize = TiledProcessor::DefaultTileSize;
+		}
+		else if (isArgMatched(i, L"tilecpu"))
+		{
+			m_useCPUTiling = true;
+			if (hasNextArgValue(i)) m_numCPUWorkers = _wtoi(argv[++i]);
+			else m_numCPUWorkers = thread::hardware_concurrency();
+		}
+		else if (isArgMatched(i, L"multiadapter"))
+		{
+			// The CPU workers read HDR images as 32-bit floats
+			m_useMultiAdapter = true;
+			m_imageLoader.SetHalfFloat(false);
+			if (hasNextArgValue(i)) m_numCPUWorkers = _wtoi(argv[++i]);
+			else m_numCPUWorkers = thread::hardware_concurrency();
+		}
+		else if (isArgMatched(i, L"cachesize"))
+		{
+			if (hasNextArgValue(i)) m_imageCacheSize = _wtoi(argv[++i]);
+		}
+		else if (isArgMatched(i, L"s") || isArgMatched(i, L"sequence"))
+		{
+			if (hasNextArgValue(i))
+			{
+				m_sequencePath.resize(wcslen(argv[++i]));
+				for (size_t j = 0; j < m_sequencePath.size(); ++j)
+					m_sequencePath[j] = static_cast<char>(argv[i][j]);
+			}
+		}
+		else if (isArgMatched(i, L"bench"))
+		{
+			m_benchIterations = Benchmark::DefaultNumIterations;
+			if (hasNextArgValue(i)) m_benchIterations = static_cast<uint32_t>((max)(_wtoi(argv[++i]), 1));
+		}
+		else if (isArgMatched(i, L"b") || isArgMatched(i, L"batch"))
+		{
+			if (hasNextArgValue(i))
+			{
+				m_batchPath.resize(wcslen(argv[++i]));
+				for (size_t j = 0; j < m_batchPath.size(); ++j)
+					m_batchPath[j] = static_cast<char>(argv[i][j]);
+			}
+		}
+		else if (isArgMatched(i, L"noatlas")) m_useAtlas = false;
+		else if (isArgMatched(i, L"nostack")) m_useStack = false;
+		else if (isArgMatched(i, L"rerecord")) m_rerecordEveryFrame = true;
+		else if (isArgMatched(i, L"eventdriven")) m_isEventDriven = true;
+		else if (isArgMatched(i, L"renderthread")) m_useRenderThread = true;
+		else if (isArgMatched(i, L"frames"))
+		{
+			if (hasNextArgValue(i))
+				m_framesInFlight = static_cast<uint8_t>((min)((max)(_wtoi(argv[++i]), 1), static_cast<int>(MaxFrameCount)));
+		}
+		else if (isArgMatched(i, L"lowlatency"))
+		{
+			m_maxFrameLatency = 1;
+			if (hasNextArgValue(i)) m_maxFrameLatency = (min)((max)(_wtoi(argv[++i]), 1), 16);
+		}
+		else if (isArgMatched(i, L"fixedluma")) m_useFixedPointLuma = true;
+		else if (isArgMatched(i, L"verify")) m_verifyLuma = m_useFixedPointLuma = true;
+		else if (isArgMatched(i, L"hashtile"))
+		{
+			// 0 turns the hashes off; otherwise tiles of 4 to 1024 texels
+			if (hasNextArgValue(i))
+			{
+				const auto tileSize = _wtoi(argv[++i]);
+				m_sequence.SetHashTileSize(tileSize > 0 ? (min)((max)(tileSize, 4), 1024) : 0);
+			}
+		}
+		else if (isArgMatched(i, L"rawsize"))
+		{
+			if (hasNextArgValue(i)) m_rawWidth = _wtoi(argv[++i]);
+			if (hasNextArgValue(i)) m_rawHeight = _wtoi(argv[++i]);
+		}
+	}
+
+	// An image path with a glob or a .y4m video is taken as a sequence
+	if (m_sequencePath.empty() && m_batchPath.empty() && ImageSequence::IsSequencePath(m_fileName.c_str()))
+		m_sequencePath = m_fileName;
+
+	// Start prefetching the image sequence, if any, so that its decoding overlaps with the device creation.
+	// The frame sources are uploaded on a copy queue and wrapped by 11on12, so native DX11 is not used.
+	if (!m_sequencePath.empty())
+	{
+		m_useNativeDX11 = false;
+		m_sequence.Open(m_sequencePath.c_str(), m_rawWidth, m_rawHeight);
+		MarkStartupPhase("Command-line parsing");
+
+		return;
+	}
+
+	// Start decoding the input image, or the first image of a batch, as soon as its file name
+	// is known, so that it overlaps with the window and device creation.
+	if (!m_batchPath.empty() && ImageSequence::FindFiles(m_batchPath.c_str(), m_batchFileNames))
+		m_fileName = m_batchFileNames[0];
+
+	// The benchmarks run over the batch, or the single image, and time their own decoding from a
+	// cold start, so nothing is prefetched
+	if (m_benchIterations > 0)
+	{
+		if (m_batchFileNames.empty()) m_batchFileNames.push_back(m_fileName);
+		MarkStartupPhase("Command-line parsing");
+
+		return;
+	}
+
+	m_useImageCache = m_useImageCache &&
+		m_imageCache.Init("Cache", static_cast<uint64_t>(m_imageCacheSize) << 20);
+
+	// A single image to tile is never decoded as a whole; whether it needs tiling is known from its header
+	if (m_batchFileNames.empty() && !m_verifyLuma && !m_useMultiAdapter && m_bandReader.Open(m_fileName.c_str()))
+	{
+		uint32_t width, height;
+		m_bandReader.GetImageSize(width, height);
+		m_useTiling = m_tileSize > 0 || m_useCPUTiling || TiledProcessor::IsTilingRequired(width, height);
+		if (m_useTiling)
+		{
+			MarkStartupPhase("Command-line parsing");
+
+			return;
+		}
+		m_bandReader.Close();
 	}
+
+	m_imageLoader.LoadAsync(m_fileName.c_str(), m_useImageCache ? &m_imageCache : nullptr);
+	MarkStartupPhase("Command-line parsing");
 }
 
-void AmpDX12Interop::PopulateCommandList()
+bool AmpDX12Interop::PopulateCommandList(CommandList*& pCommandList)
 {
+	// The commands of a frame only depend on the back buffer, so they are recorded once per
+	// back buffer, and again only if the result texture changes. The frames with a screen
+	// shot are recorded anew.
+	if (m_screenShot != 1 && !m_rerecordEveryFrame)
+	{
+		if (m_recordedResult != m_amp12->GetViewResult()) RecordPresentCommandLists();
+		pCommandList = m_presentCommandLists[m_frameIndex].get();
+
+		return true;
+	}
+
 	// Command list allocators can only be reset when the associated 
 	// command lists have finished execution on the GPU; apps should use 
 	// fences to determine GPU execution progress.
 	const auto pCommandAllocator = m_commandAllocators[m_frameIndex].get();
-	XUSG_N_RETURN(pCommandAllocator->Reset(), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(pCommandAllocator->Reset(), false);
 
 	// However, when ExecuteCommandList() is called on a particular command 
 	// list, that command list can then be reset at any time and must be before 
 	// re-recording.
-	const auto pCommandList = m_commandList.get();
-	XUSG_N_RETURN(pCommandList->Reset(pCommandAllocator, nullptr), ThrowIfFailed(E_FAIL));
+	pCommandList = m_commandList.get();
+	XUSG_N_RETURN(pCommandList->Reset(pCommandAllocator, nullptr), false);
 
 	// Record commands.
-	ResourceBarrier barrier;
 	const auto pRenderTarget = m_renderTargets[m_frameIndex].get();
+	RecordPresent(pCommandList, pRenderTarget);
+
+	// Screen-shot helper
+	if (m_screenShot == 1)
+	{
+		if (!m_readBuffer) m_readBuffer = Buffer::MakeUnique();
+		pRenderTarget->ReadBack(pCommandList, m_readBuffer.get(), &m_rowPitch);
+		m_screenShot = 2;
+
+		// The read-back is complete once the fence value of this frame is signaled.
+		const auto width = m_width;
+		const auto height = m_height;
+		m_fenceCallbacks.Register(m_fenceValues[m_frameIndex], [this, width, height]()
+			{
+				char timeStr[15];
+				tm dateTime;
+				const auto now = time(nullptr);
+				if (!localtime_s(&dateTime, &now) && strftime(timeStr, sizeof(timeStr), "%Y%m%d%H%M%S", &dateTime))
+					SaveImage((string("AmpDX12Interop_") + timeStr + ".png").c_str(), m_readBuffer.get(), width, height, m_rowPitch);
+				m_screenShot = 0;
+			});
+	}
+
+	XUSG_N_RETURN(pCommandList->Close(), false);
+
+	return true;
+}
+
+void AmpDX12Interop::RecordPresentCommandLists()
+{
+	// The lists of the previous result may still be in flight
+	if (m_recordedResult) WaitForGpu();
+
+	for (uint8_t n = 0; n < m_backBufferCount; ++n)
+	{
+		auto& commandList = m_presentCommandLists[n];
+		auto& commandAllocator = m_presentAllocators[n];
+		if (!commandList)
+		{
+			commandAllocator = CommandAllocator::MakeUnique();
+			XUSG_N_RETURN(commandAllocator->Create(m_device.get(), CommandListType::DIRECT,
+				(L"PresentAllocator" + to_wstring(n)).c_str()), ThrowIfFailed(E_FAIL));
+			commandList = CommandList::MakeUnique();
+			XUSG_N_RETURN(commandList->Create(m_device.get(), 0, CommandListType::DIRECT,
+				commandAllocator.get(), nullptr), ThrowIfFailed(E_FAIL));
+		}
+		else
+		{
+			XUSG_N_RETURN(commandAllocator->Reset(), ThrowIfFailed(E_FAIL));
+			XUSG_N_RETURN(commandList->Reset(commandAllocator.get(), nullptr), ThrowIfFailed(E_FAIL));
+		}
+
+		RecordPresent(commandList.get(), m_renderTargets[n].get());
+		XUSG_N_RETURN(commandList->Close(), ThrowIfFailed(E_FAIL));
+	}
+
+	m_recordedResult = m_amp12->GetViewResult();
+}
+
+void AmpDX12Interop::RecordPresent(CommandList* pCommandList, RenderTarget* pRenderTarget)
+{
+	ResourceBarrier barrier;
 	auto numBarriers = pRenderTarget->SetBarrier(&barrier, ResourceState::COPY_DEST);
 	pCommandList->Barrier(numBarriers, &barrier);
 
-	pCommandList->CopyResource(pRenderTarget, m_amp12->GetResult());
+	pCommandList->CopyResource(pRenderTarget, m_amp12->GetViewResult());
 
 	numBarriers = pRenderTarget->SetBarrier(&barrier, ResourceState::PRESENT);
 	pCommandList->Barrier(numBarriers, &barrier);
+}
 
-	// Screen-shot helper
-	if (m_screenShot == 1)
+void AmpDX12Interop::ResizeSwapChain()
+{
+	// All the references to the back buffers must be released before they are resized
+	WaitForGpu();
+	for (uint8_t n = 0; n < m_backBufferCount; ++n) m_renderTargets[n].reset();
+	m_recordedResult = nullptr;
+	m_readBuffer.reset();
+
+	m_width = m_windowWidth;
+	m_height = m_windowHeight;
+	ThrowIfFailed(m_swapChain->ResizeBuffers(m_backBufferCount, m_width, m_height, backBufferFormat, GetSwapChainFlags()));
+
+	for (uint8_t n = 0; n < m_backBufferCount; ++n)
 	{
-		if (!m_readBuffer) m_readBuffer = Buffer::MakeUnique();
-		pRenderTarget->ReadBack(pCommandList, m_readBuffer.get(), &m_rowPitch);
-		m_screenShot = 2;
+		m_renderTargets[n] = RenderTarget::MakeUnique();
+		XUSG_N_RETURN(m_renderTargets[n]->CreateFromSwapChain(m_device.get(), m_swapChain.get(), n), ThrowIfFailed(E_FAIL));
 	}
 
-	XUSG_N_RETURN(pCommandList->Close(), ThrowIfFailed(E_FAIL));
+	// The GPU is idle, so every back buffer is ready
+	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+	for (uint8_t n = 0; n < m_backBufferCount; ++n) m_fenceValues[n] = m_fenceValues[m_frameIndex];
+
+	// The view matches the back buffers, so that it is presented by a copy
+	if (!m_amp12->InitView(m_device.get(), m_width, m_height, backBufferFormat)) ThrowIfFailed(E_FAIL);
+	m_viewDirty.SetBounds(m_width, m_height);
+	m_processedRect = {};
+}
+
+RECT AmpDX12Interop::GetVisibleRect() const
+{
+	// The parts of the client area that are off the desktop are never displayed
+	const auto hWnd = Win32Application::GetHwnd();
+	RECT clientRect = { 0, 0, static_cast<LONG>(m_width), static_cast<LONG>(m_height) };
+	MapWindowPoints(hWnd, nullptr, reinterpret_cast<POINT*>(&clientRect), 2);
+
+	RECT desktopRect;
+	desktopRect.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+	desktopRect.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+	desktopRect.right = desktopRect.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+	desktopRect.bottom = desktopRect.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+
+	RECT visibleRect;
+	if (!IntersectRect(&visibleRect, &clientRect, &desktopRect)) return {};
+	MapWindowPoints(nullptr, hWnd, reinterpret_cast<POINT*>(&visibleRect), 2);
+
+	return visibleRect;
+}
+
+void AmpDX12Interop::Annotate(float x, float y)
+{
+	uint32_t imageX, imageY;
+	if (!m_amp12->GetImagePosition(x, y, imageX, imageY)) return;
+
+	m_annotations.push_back({ static_cast<LONG>(imageX), static_cast<LONG>(imageY) });
+	m_isDirty = true;
+}
+
+void AmpDX12Interop::ApplyAnnotations()
+{
+	// The brush is white, which is all ones in the unorm formats only
+	const auto format = m_amp12->GetSourceFormat();
+	const auto texelSize = format == Format::R8G8B8A8_UNORM ? 4u : (format == Format::R16G16B16A16_UNORM ? 8u : 0u);
+	if (texelSize == 0)
+	{
+		m_annotations.clear();
+
+		return;
+	}
+
+	if (!m_uploadCommandList)
+	{
+		for (uint8_t n = 0; n < MaxFrameCount; ++n)
+		{
+			m_uploadAllocators[n] = CommandAllocator::MakeUnique();
+			XUSG_N_RETURN(m_uploadAllocators[n]->Create(m_device.get(), CommandListType::DIRECT,
+				(L"UploadAllocator" + to_wstring(n)).c_str()), ThrowIfFailed(E_FAIL));
+		}
+		m_uploadCommandList = CommandList::MakeUnique();
+		XUSG_N_RETURN(m_uploadCommandList->Create(m_device.get(), 0, CommandListType::DIRECT,
+			m_uploadAllocators[m_frameIndex].get(), nullptr), ThrowIfFailed(E_FAIL));
+	}
+	else
+	{
+		XUSG_N_RETURN(m_uploadAllocators[m_frameIndex]->Reset(), ThrowIfFailed(E_FAIL));
+		XUSG_N_RETURN(m_uploadCommandList->Reset(m_uploadAllocators[m_frameIndex].get(), nullptr), ThrowIfFailed(E_FAIL));
+	}
+
+	// Stamp the brush, at the same size on the display, at each pending position
+	uint32_t width, height;
+	m_amp12->GetImageSize(width, height);
+	const RECT imageRect = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+	const auto brushSize = (max)(static_cast<uint32_t>(BrushSize * m_amp12->GetViewScale()), 1u);
+	const vector<uint8_t> brush(static_cast<size_t>(texelSize) * brushSize * brushSize, 0xff);
+	for (const auto& annotation : m_annotations)
+	{
+		const RECT brushRect = { annotation.x - static_cast<LONG>(brushSize / 2), annotation.y - static_cast<LONG>(brushSize / 2),
+			annotation.x - static_cast<LONG>(brushSize / 2) + static_cast<LONG>(brushSize),
+			annotation.y - static_cast<LONG>(brushSize / 2) + static_cast<LONG>(brushSize) };
+		RECT rect;
+		if (!IntersectRect(&rect, &brushRect, &imageRect)) continue;
+		if (!m_amp12->UpdateSource(m_uploadCommandList.get(), m_uploadRing, brush.data(), texelSize * brushSize, rect)) break;
+		m_sourceDirty.Add(rect);
+	}
+	m_annotations.clear();
+
+	// The copies precede the processing, which the 11on12 device submits to the same queue later
+	XUSG_N_RETURN(m_uploadCommandList->Close(), ThrowIfFailed(E_FAIL));
+	m_commandQueue->ExecuteCommandList(m_uploadCommandList.get());
+	m_uploadRing.Submit(m_fenceValues[m_frameIndex]);
+}
+
+SwapChainFlag AmpDX12Interop::GetSwapChainFlags() const
+{
+	const auto isWaitable = m_isEventDriven || m_maxFrameLatency > 0;
+
+	return SwapChainFlag::ALLOW_TEARING |
+		(isWaitable ? SwapChainFlag::FRAME_LATENCY_WAITABLE_OBJECT : SwapChainFlag::NONE);
+}
+
+bool AmpDX12Interop::IsFramePending() const
+{
+	// Sequences always have a next frame unless paused; still images only when out of date, or for a screen shot
+	return (!m_sequencePath.empty() && !m_isPaused) || m_isDirty || m_screenShot == 1;
+}
+
+void AmpDX12Interop::UpdateLatency()
+{
+	// The completion is observed on the frame boundaries only, so the latency is rounded up to them
+	const auto completedValue = m_fence->GetCompletedValue();
+	const auto now = chrono::steady_clock::now();
+	for (uint8_t n = 0; n < m_backBufferCount; ++n)
+	{
+		if (m_frameEndFenceValues[n] == 0 || m_frameEndFenceValues[n] > completedValue) continue;
+
+		const auto latency = chrono::duration<double, milli>(now - m_frameStartTimes[n]).count();
+		if (m_totalLatencyFrames == 0) m_latencyStartTime = m_frameStartTimes[n];
+		m_latency += latency;
+		++m_numLatencyFrames;
+		m_totalLatency += latency;
+		++m_totalLatencyFrames;
+		m_frameEndFenceValues[n] = 0;
+	}
+}
+
+void AmpDX12Interop::UpdateCPUUsage()
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) return;
+
+	const auto toUInt64 = [](const FILETIME& fileTime)
+	{
+		return (static_cast<uint64_t>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+	};
+
+	// CPU time of all threads over the wall time since the last update
+	const auto cpuTime = toUInt64(kernelTime) + toUInt64(userTime);
+	const auto now = chrono::steady_clock::now();
+	const auto wallTime = chrono::duration<double>(now - m_cpuUsageTime).count();
+	if (wallTime > 0.0) m_cpuUsage = (cpuTime - m_cpuTime) / (wallTime * 100000.0);
+	m_cpuTime = cpuTime;
+	m_cpuUsageTime = now;
 }
 
 // Wait for pending GPU work to complete.
@@ -368,6 +1162,10 @@ void AmpDX12Interop::WaitForGpu()
 
 	// Increment the fence value for the current frame.
 	m_fenceValues[m_frameIndex]++;
+
+	// Complete the pending GPU->CPU transfers, and recycle the upload memory
+	m_fenceCallbacks.Poll(m_fence->GetCompletedValue());
+	m_uploadRing.Reclaim(m_fence->GetCompletedValue());
 }
 
 // Prepare to render the next frame.
@@ -376,40 +1174,69 @@ void AmpDX12Interop::MoveToNextFrame()
 	// Schedule a Signal command in the queue.
 	const auto currentFenceValue = m_fenceValues[m_frameIndex];
 	XUSG_N_RETURN(m_commandQueue->Signal(m_fence.get(), currentFenceValue), ThrowIfFailed(E_FAIL));
+	m_frameEndFenceValues[m_frameIndex] = currentFenceValue;
 
 	// Update the frame index.
 	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 
-	// If the next frame is not ready to be rendered yet, wait until it is ready.
-	if (m_fence->GetCompletedValue() < m_fenceValues[m_frameIndex])
+	// If the next frame is not ready to be rendered yet, wait until it is ready. With a single
+	// frame in flight, the current frame must have completed as well.
+	const auto waitValue = m_framesInFlight > 1 ? m_fenceValues[m_frameIndex] : currentFenceValue;
+	if (m_fence->GetCompletedValue() < waitValue)
 	{
-		XUSG_N_RETURN(m_fence->SetEventOnCompletion(m_fenceValues[m_frameIndex], m_fenceEvent), ThrowIfFailed(E_FAIL));
+		XUSG_N_RETURN(m_fence->SetEventOnCompletion(waitValue, m_fenceEvent), ThrowIfFailed(E_FAIL));
 		WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
 	}
+	UpdateLatency();
 
 	// Set the fence value for the next frame.
 	m_fenceValues[m_frameIndex] = currentFenceValue + 1;
 
-	// Screen-shot helper
-	if (m_screenShot)
+	// Complete the GPU->CPU transfers, such as screen shots, whose fence values have passed,
+	// and recycle the upload memory
+	m_fenceCallbacks.Poll(m_fence->GetCompletedValue());
+	m_uploadRing.Reclaim(m_fence->GetCompletedValue());
+}
+
+// Create the synchronization objects and the upload ring of the headless batch jobs, which run
+// in place of the render loop; they are shared by all the jobs of the run.
+void AmpDX12Interop::InitHeadless()
+{
+	if (m_fenceEvent) return;
+
+	if (!m_fence)
 	{
-		if (m_screenShot > FrameCount)
-		{
-			char timeStr[15];
-			tm dateTime;
-			const auto now = time(nullptr);
-			if (!localtime_s(&dateTime, &now) && strftime(timeStr, sizeof(timeStr), "%Y%m%d%H%M%S", &dateTime))
-				SaveImage((string("AmpDX12Interop_") + timeStr + ".png").c_str(), m_readBuffer.get(), m_width, m_height, m_rowPitch);
-			m_screenShot = 0;
-		}
-		else ++m_screenShot;
+		m_fence = Fence::MakeUnique();
+		XUSG_N_RETURN(m_fence->Create(m_device.get(), m_fenceValues[m_frameIndex]++, FenceFlag::NONE, L"Fence"), ThrowIfFailed(E_FAIL));
 	}
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (!m_fenceEvent) ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+	if (!m_uploadRing.Init(m_device.get(), UploadRingSize)) ThrowIfFailed(E_FAIL);
+}
+
+// Execute the commands recorded so far, wait for them, and reset the command list for the next ones.
+void AmpDX12Interop::ExecuteAndWait()
+{
+	const auto pCommandAllocator = m_commandAllocators[m_frameIndex].get();
+	const auto pCommandList = m_commandList.get();
+	XUSG_N_RETURN(pCommandList->Close(), ThrowIfFailed(E_FAIL));
+	m_commandQueue->ExecuteCommandList(pCommandList);
+	m_uploadRing.Submit(m_fenceValues[m_frameIndex]);
+	WaitForGpu();
+	XUSG_N_RETURN(pCommandAllocator->Reset(), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(pCommandList->Reset(pCommandAllocator, nullptr), ThrowIfFailed(E_FAIL));
 }
 
 void AmpDX12Interop::SaveImage(char const* fileName, Buffer* pImageBuffer, uint32_t w, uint32_t h, uint32_t rowPitch, uint8_t comp)
+{
+	SaveImage(fileName, static_cast<const uint8_t*>(pImageBuffer->Map(nullptr)), w, h, rowPitch, comp);
+	pImageBuffer->Unmap();
+}
+
+void AmpDX12Interop::SaveImage(char const* fileName, const uint8_t* pData, uint32_t w, uint32_t h, uint32_t rowPitch, uint8_t comp)
 {
 	assert(comp == 3 || comp == 4);
-	const auto pData = static_cast<const uint8_t*>(pImageBuffer->Map(nullptr));
 
 	//stbi_write_png_compression_level = 1024;
 	vector<uint8_t> imageData(comp * w * h);
@@ -424,8 +1251,689 @@ void AmpDX12Interop::SaveImage(char const* fileName, Buffer* pImageBuffer, uint3
 		}
 
 	stbi_write_png(fileName, w, h, comp, imageData.data(), 0);
+}
 
-	pImageBuffer->Unmap();
+void AmpDX12Interop::ProcessTiled(const Concurrency::accelerator_view* pAcceleratorView)
+{
+	uint32_t width, height;
+	m_bandReader.GetImageSize(width, height);
+
+	// Save next to the input image, band by band
+	const auto outFileName = GetOutputFileName(m_fileName);
+	BandWriter bandWriter;
+	if (!bandWriter.Open(outFileName.c_str(), width, height))
+	{
+		cerr << "Failed to create " << outFileName << endl;
+		ThrowIfFailed(E_FAIL);
+	}
+
+	uint32_t numTiles;
+	double processTime;
+	size_t bufferSize;
+	if (pAcceleratorView)
+	{
+		TiledProcessor tiledProcessor(*pAcceleratorView);
+		if (!tiledProcessor.Process(m_bandReader, bandWriter, m_tileSize > 0 ? m_tileSize : TiledProcessor::DefaultTileSize))
+			ThrowIfFailed(E_FAIL);
+		numTiles = tiledProcessor.GetNumTiles();
+		processTime = tiledProcessor.GetProcessTime();
+		bufferSize = tiledProcessor.GetBufferSize();
+	}
+	else
+	{
+		CPUTiledProcessor tiledProcessor(m_numCPUWorkers);
+		if (!tiledProcessor.Process(m_bandReader, bandWriter, m_tileSize > 0 ? m_tileSize : CPUTiledProcessor::DefaultTileSize))
+			ThrowIfFailed(E_FAIL);
+		numTiles = tiledProcessor.GetNumTiles();
+		processTime = tiledProcessor.GetProcessTime();
+		bufferSize = tiledProcessor.GetBufferSize();
+	}
+	const auto isStreamed = m_bandReader.IsStreamed();
+	m_bandReader.Close();
+	if (!bandWriter.Close())
+	{
+		cerr << "Failed to save " << outFileName << endl;
+		ThrowIfFailed(E_FAIL);
+	}
+
+	cout << "Tiled processing" << (pAcceleratorView ? "" : " on the CPU") << ": " << width << "x" << height
+		<< " in " << numTiles << " tiles, " << processTime << " ms, " << width * static_cast<double>(height) /
+		(1000.0 * processTime) << " MPix/s" << endl;
+	cout << "Band buffers: " << bufferSize / 1048576.0 << " MB";
+	if (!isStreamed) cout << " (the input format is decoded as a whole)";
+	cout << endl;
+	cout << "Output: " << outFileName << endl;
+}
+
+void AmpDX12Interop::ProcessMultiAdapter()
+{
+	uint32_t width, height;
+	m_imageLoader.GetImageSize(width, height);
+
+	vector<uint8_t> result;
+	MultiAdapterProcessor multiAdapterProcessor;
+	if (!multiAdapterProcessor.Init(m_numCPUWorkers)) ThrowIfFailed(E_FAIL);
+	if (!multiAdapterProcessor.Process(m_imageLoader, result)) ThrowIfFailed(E_FAIL);
+	m_imageLoader.Release();
+
+	// Save next to the input image
+	const auto outFileName = GetOutputFileName(m_fileName);
+	if (!stbi_write_png(outFileName.c_str(), width, height, 4, result.data(), static_cast<int>(sizeof(uint32_t) * width)))
+		cerr << "Failed to save " << outFileName << endl;
+
+	cout << "Multi-adapter processing: " << width << "x" << height << " on " << multiAdapterProcessor.GetNumDevices()
+		<< " devices, " << multiAdapterProcessor.GetProcessTime() << " ms, " << width * static_cast<double>(height) /
+		(1000.0 * multiAdapterProcessor.GetProcessTime()) << " MPix/s" << endl;
+	const auto& scheduler = multiAdapterProcessor.GetScheduler();
+	for (auto i = 0u; i < multiAdapterProcessor.GetNumDevices(); ++i)
+	{
+		cout << "    " << ToUTF8(multiAdapterProcessor.GetDeviceName(i)) << ": " << scheduler.GetThroughput(i) / 1000.0
+			<< " MPix/s, " << scheduler.GetShare(i) * 100.0 << "% of the last round, "
+			<< multiAdapterProcessor.GetNumPixels(i) * 100.0 / (static_cast<double>(width) * height)
+			<< "% of the image" << endl;
+	}
+	cout << "Output: " << outFileName << endl;
+}
+
+void AmpDX12Interop::ProcessBatch()
+{
+	InitHeadless();
+	const auto pCommandList = m_commandList.get();
+
+	const auto readBuffer = Buffer::MakeUnique();
+	const auto startTime = chrono::steady_clock::now();
+	auto numProcessed = 0u;
+
+	// With -multiadapter, the images are split among all the adapters and the CPU workers instead
+	MultiAdapterProcessor multiAdapterProcessor;
+	vector<uint8_t> result;
+	if (m_useMultiAdapter && !multiAdapterProcessor.Init(m_numCPUWorkers)) ThrowIfFailed(E_FAIL);
+
+	// Small images are packed into an atlas, which is processed as one image once it is full.
+	// The atlas of the multi-adapter processing is packed in CPU memory, which the CPU workers
+	// read in place, so that they are woken once per atlas rather than per image.
+	ImageAtlas atlas;
+	vector<pair<size_t, ImageAtlas::Region>> atlasImages;
+	auto numAtlases = 0u;
+	auto atlasOccupancy = 0.0;
+	if (m_useAtlas && !(m_useMultiAdapter ? atlas.Init() : atlas.Init(m_device.get()))) ThrowIfFailed(E_FAIL);
+	const auto processAtlas = [&]()
+	{
+		if (atlasImages.empty()) return;
+
+		const uint8_t* pData;
+		uint32_t rowPitch;
+		if (m_useMultiAdapter)
+		{
+			// Process the packed rows on all the devices at once
+			const auto width = atlas.GetWidth();
+			XUSG_N_RETURN(multiAdapterProcessor.Process(atlas.GetPixels(), width, atlas.GetPackedHeight(), result),
+				ThrowIfFailed(E_FAIL));
+			pData = result.data();
+			rowPitch = sizeof(uint32_t) * width;
+		}
+		else
+		{
+			// Upload
+			XUSG_N_RETURN(m_amp12->InitAtlas(m_device.get(), atlas.GetWidth(), atlas.GetUsedHeight(),
+				backBufferFormat, m_useNativeDX11), ThrowIfFailed(E_FAIL));
+			atlas.Upload(pCommandList, m_amp12->GetSource());
+			ExecuteAndWait();
+
+			// Process, and read back the results of all the packed images at once
+			m_amp12->Process();
+			XUSG_N_RETURN(m_amp12->ReadBackResult(pCommandList, readBuffer.get(), &rowPitch), ThrowIfFailed(E_FAIL));
+			ExecuteAndWait();
+			pData = static_cast<const uint8_t*>(readBuffer->Map(nullptr));
+		}
+
+		for (const auto& image : atlasImages)
+		{
+			const auto& region = image.second;
+			SaveImage(GetOutputFileName(m_batchFileNames[image.first]).c_str(),
+				&pData[rowPitch * region.Y + sizeof(uint32_t) * region.X], region.Width, region.Height, rowPitch);
+		}
+		if (!m_useMultiAdapter) readBuffer->Unmap();
+
+		numProcessed += atlas.GetNumImages();
+		atlasOccupancy += atlas.GetOccupancy();
+		++numAtlases;
+		atlasImages.clear();
+		atlas.Reset();
+	};
+
+	// Consecutive images of the same size are stacked into the slices of a volume texture,
+	// which is processed in one dispatch; volume textures are only wrapped by 11on12
+	ImageStack stack;
+	vector<size_t> stackImages;
+	auto numStacks = 0u;
+	auto numStackedImages = 0u;
+	const auto useStack = m_useStack && !m_useNativeDX11 && !m_useMultiAdapter;
+	const auto processStack = [&]()
+	{
+		if (stack.IsEmpty()) return;
+
+		// Upload
+		uint32_t width, height;
+		const auto numSlices = stack.GetNumImages();
+		stack.GetImageSize(width, height);
+		XUSG_N_RETURN(m_amp12->InitStack(m_device.get(), width, height, stack.GetMaxDepth(),
+			stack.GetFormat(), backBufferFormat), ThrowIfFailed(E_FAIL));
+		stack.Upload(pCommandList, m_amp12->GetStackSource());
+		ExecuteAndWait();
+
+		// Process, and read back the results of all the slices at once
+		m_amp12->ProcessStack(numSlices);
+		m_amp12->ReadBackStack(pCommandList, numSlices);
+		ExecuteAndWait();
+
+		uint32_t rowPitch;
+		uint64_t slicePitch;
+		const auto pData = m_amp12->MapStackResult(rowPitch, slicePitch);
+		XUSG_N_RETURN(pData, ThrowIfFailed(E_FAIL));
+		for (uint16_t j = 0; j < numSlices; ++j)
+			SaveImage(GetOutputFileName(m_batchFileNames[stackImages[j]]).c_str(),
+				&pData[slicePitch * j], width, height, rowPitch);
+		m_amp12->UnmapStackResult();
+
+		numProcessed += numSlices;
+		numStackedImages += numSlices;
+		++numStacks;
+		stackImages.clear();
+		stack.Reset();
+	};
+
+	for (size_t i = 0; i < m_batchFileNames.size(); ++i)
+	{
+		const auto& fileName = m_batchFileNames[i];
+		const auto loadNext = [&]()
+		{
+			// Decode the next image while this one is processed
+			m_imageLoader.Release();
+			if (i + 1 < m_batchFileNames.size())
+				m_imageLoader.LoadAsync(m_batchFileNames[i + 1].c_str(), m_useImageCache ? &m_imageCache : nullptr);
+		};
+
+		if (!m_imageLoader.Wait())
+		{
+			cerr << "Failed to load " << fileName << endl;
+			loadNext();
+			continue;
+		}
+
+		if (m_useAtlas && ImageAtlas::IsPackable(m_imageLoader))
+		{
+			// Process the full atlas first, if the image does not fit into it
+			ImageAtlas::Region region;
+			if (!atlas.Insert(m_imageLoader, region))
+			{
+				processAtlas();
+				atlas.Insert(m_imageLoader, region);
+			}
+			atlasImages.emplace_back(i, region);
+			loadNext();
+			continue;
+		}
+
+		if (useStack && ImageStack::IsStackable(m_imageLoader))
+		{
+			// Process the current stack first, if the image does not match it, or once it is full
+			if (!stack.IsEmpty() && !stack.IsCompatible(m_imageLoader)) processStack();
+			if (stack.IsEmpty()) XUSG_N_RETURN(stack.Begin(m_device.get(), m_imageLoader), ThrowIfFailed(E_FAIL));
+			stack.Insert(m_imageLoader);
+			stackImages.push_back(i);
+			if (stack.IsFull()) processStack();
+			loadNext();
+			continue;
+		}
+
+		if (m_useMultiAdapter)
+		{
+			uint32_t width, height;
+			m_imageLoader.GetImageSize(width, height);
+			const auto isProcessed = multiAdapterProcessor.Process(m_imageLoader, result);
+			if (!isProcessed) cerr << "Failed to process " << fileName << endl;
+			loadNext();
+			if (!isProcessed) continue;
+
+			SaveImage(GetOutputFileName(fileName).c_str(), result.data(), width, height, sizeof(uint32_t) * width);
+			++numProcessed;
+			continue;
+		}
+
+		// The pooled textures of the previous image are reused for the images of the same size
+		Texture::sptr srcForNative11;
+		const auto isLoaded = m_amp12->Init(pCommandList, m_uploadRing, backBufferFormat,
+			m_imageLoader, m_useNativeDX11 ? &srcForNative11 : nullptr);
+		if (!isLoaded) cerr << "Failed to load " << fileName << endl;
+		loadNext();
+
+		// Upload
+		ExecuteAndWait();
+		if (!isLoaded) continue;
+
+		// Process, and read back the result
+		uint32_t width, height, rowPitch;
+		m_amp12->GetImageSize(width, height);
+		m_amp12->Process();
+		XUSG_N_RETURN(m_amp12->ReadBackResult(pCommandList, readBuffer.get(), &rowPitch), ThrowIfFailed(E_FAIL));
+		ExecuteAndWait();
+
+		SaveImage(GetOutputFileName(fileName).c_str(), readBuffer.get(), width, height, rowPitch);
+		++numProcessed;
+	}
+	processAtlas();
+	processStack();
+
+	const auto batchTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	const auto& texturePool = m_amp12->GetTexturePool();
+	cout << "Batch processing: " << numProcessed << " of " << m_batchFileNames.size() << " images in "
+		<< batchTime * 1000.0 << " ms, " << numProcessed / batchTime << " images/s" << endl;
+	if (numAtlases > 0)
+		cout << "    Atlases: " << numAtlases << ", " << atlasOccupancy * 100.0 / numAtlases
+			<< "% average occupancy" << endl;
+	if (numStacks > 0)
+		cout << "    Stacks: " << numStacks << ", " << static_cast<double>(numStackedImages) / numStacks
+			<< " images per stack on average" << endl;
+	if (m_useMultiAdapter)
+	{
+		uint64_t numPixels = 0;
+		for (auto i = 0u; i < multiAdapterProcessor.GetNumDevices(); ++i)
+			numPixels += multiAdapterProcessor.GetNumPixels(i);
+		for (auto i = 0u; i < multiAdapterProcessor.GetNumDevices(); ++i)
+			cout << "    " << ToUTF8(multiAdapterProcessor.GetDeviceName(i)) << ": " << (numPixels > 0 ?
+				multiAdapterProcessor.GetNumPixels(i) * 100.0 / numPixels : 0.0) << "% of the pixels" << endl;
+	}
+	cout << "    Texture pool: " << texturePool.GetHitRate() * 100.0 << "% hits ("
+		<< texturePool.GetNumHits() << " of " << texturePool.GetNumAcquires() << ")" << endl;
+	PrintUploadStats("Upload ring", m_uploadRing.GetStats());
+}
+
+void AmpDX12Interop::RunBenchmarks()
+{
+	// Only the images stb_image decodes are measured; DDS files are uploaded as they are
+	struct Image
+	{
+		string FileName;
+		double MegaPixels;
+		uint8_t Channels;
+		bool IsHDR;
+		bool Is16Bit;
+	};
+	vector<Image> images;
+	auto megaPixels = 0.0;
+	for (const auto& fileName : m_batchFileNames)
+	{
+		int width, height, channels;
+		if (!stbi_info(fileName.c_str(), &width, &height, &channels)) continue;
+		const Image image = { fileName, width * static_cast<double>(height) / 1000000.0, static_cast<uint8_t>(channels),
+			stbi_is_hdr(fileName.c_str()) != 0, stbi_is_16_bit(fileName.c_str()) != 0 };
+		images.emplace_back(image);
+		megaPixels += image.MegaPixels;
+	}
+	XUSG_M_RETURN(images.empty(), cerr, "No image to benchmark.", ThrowIfFailed(E_FAIL));
+
+	Benchmark benchmark(m_benchIterations);
+	ImageLoader imageLoader;
+
+	// Decoding through stdio, as the loader did before the input was mapped: stbi_info() and each
+	// query open and parse the file again, before the decode reads it once more
+	const auto decodeStdio = [](const Image& image)
+	{
+		const auto fileName = image.FileName.c_str();
+		int width, height, channels;
+		XUSG_N_RETURN(stbi_info(fileName, &width, &height, &channels), false);
+
+		void* pPixels;
+		if (stbi_is_hdr(fileName)) pPixels = stbi_loadf(fileName, &width, &height, &channels, 0);
+		else if (stbi_is_16_bit(fileName)) pPixels = stbi_load_16(fileName, &width, &height, &channels, 0);
+		else pPixels = stbi_load(fileName, &width, &height, &channels, 0);
+		stbi_image_free(pPixels);
+
+		return pPixels != nullptr;
+	};
+
+	// Decoding from one mapping of the file, by the image loader
+	const auto decodeMapped = [&imageLoader](const Image& image)
+	{
+		const auto isLoaded = imageLoader.Load(image.FileName.c_str());
+		imageLoader.Release();
+
+		return isLoaded;
+	};
+
+	// The first decode of a file in the process is the cold run of its first measurement; the OS
+	// file cache is warm for the following measurements, so the mapped input is measured first.
+	const auto& firstImage = images[0];
+	const auto decodeBatch = [&images](const function<bool(const Image&)>& decode)
+	{
+		for (const auto& image : images) XUSG_N_RETURN(decode(image), false);
+
+		return true;
+	};
+	XUSG_N_RETURN(benchmark.Run("Startup decode, mapped", [&]() { return decodeMapped(firstImage); },
+		firstImage.MegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Startup decode, stdio", [&]() { return decodeStdio(firstImage); },
+		firstImage.MegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Batch decode, mapped", [&]() { return decodeBatch(decodeMapped); },
+		static_cast<double>(images.size()), "images"), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Batch decode, stdio", [&]() { return decodeBatch(decodeStdio); },
+		static_cast<double>(images.size()), "images"), ThrowIfFailed(E_FAIL));
+	cout << "Benchmark: " << images.size() << " images, " << megaPixels << " MPix in total" << endl;
+	benchmark.Print(cout, "Image input");
+
+	// RGB to RGBA8 expansion by every backend, across image sizes; the scalar kernel stands for the
+	// per-pixel loop of stb_image's conversion
+	benchmark.Clear();
+	for (const auto size : { 256u, 1024u, 4096u })
+	{
+		const auto numPixels = static_cast<size_t>(size) * size;
+		vector<uint8_t> rgb(3 * numPixels), rgba(4 * numPixels);
+		for (size_t i = 0; i < rgb.size(); ++i) rgb[i] = static_cast<uint8_t>(i * 7);
+
+		for (uint8_t i = 0; i < PixelKernels::BACKEND_AUTO; ++i)
+		{
+			const auto backend = static_cast<PixelKernels::Backend>(i);
+			if (!PixelKernels::IsBackendSupported(backend)) continue;
+
+			const auto name = to_string(size) + "x" + to_string(size) + ", " + PixelKernels::GetBackendName(backend);
+			benchmark.Run(name, [&]()
+			{
+				PixelKernels::ExpandRGBToRGBA(rgba.data(), rgb.data(), numPixels, backend);
+
+				return true;
+			}, numPixels / 1000000.0, "MPix");
+		}
+	}
+
+	// Decoding the 8-bit RGB images of the batch into RGBA8 upload pixels, either expanded by stb_image
+	// while decoding, or decoded to RGB and expanded by the kernels while writing
+	vector<const Image*> rgbImages;
+	auto rgbMegaPixels = 0.0;
+	for (const auto& image : images)
+	{
+		if (image.Channels != 3 || image.IsHDR || image.Is16Bit) continue;
+		rgbImages.push_back(&image);
+		rgbMegaPixels += image.MegaPixels;
+	}
+
+	vector<uint8_t> staging;
+	const auto decodeRGBA = [&](uint8_t reqChannels)
+	{
+		imageLoader.SetRequestedChannels(reqChannels);
+		for (const auto pImage : rgbImages)
+		{
+			XUSG_N_RETURN(imageLoader.Load(pImage->FileName.c_str()), false);
+			uint32_t width, height;
+			imageLoader.GetImageSize(width, height);
+			staging.resize(sizeof(uint32_t) * width * height);
+			imageLoader.WriteRegion(staging.data(), sizeof(uint32_t) * width, 0, 0, width, height);
+			imageLoader.Release();
+		}
+
+		return true;
+	};
+	if (!rgbImages.empty())
+	{
+		XUSG_N_RETURN(benchmark.Run("Batch RGB decode, RGBA by stb_image", [&]() { return decodeRGBA(4); },
+			rgbMegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+		XUSG_N_RETURN(benchmark.Run("Batch RGB decode, RGB expanded by the kernels", [&]() { return decodeRGBA(0); },
+			rgbMegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+		imageLoader.SetRequestedChannels(0);
+	}
+	benchmark.Print(cout, "RGB to RGBA expansion");
+
+	// Decoding with the image cache off, cold (emptied before every run, so that each run decodes and
+	// stores the entries), and warm (filled by the cold run, so that the warm runs map the entries).
+	// A cache of its own is used, so that the entries of the regular runs are kept.
+	benchmark.Clear();
+	ImageCache imageCache;
+	XUSG_N_RETURN(imageCache.Init("BenchCache", static_cast<uint64_t>(m_imageCacheSize) << 20), ThrowIfFailed(E_FAIL));
+	auto numWarmLoads = 0u, numWarmHits = 0u;
+	const auto decodeCached = [&](const Image& image, ImageCache* pCache, bool isWarm)
+	{
+		XUSG_N_RETURN(imageLoader.Load(image.FileName.c_str(), pCache), false);
+		if (isWarm)
+		{
+			++numWarmLoads;
+			if (imageLoader.IsCacheHit()) ++numWarmHits;
+		}
+		imageLoader.Release();
+
+		return true;
+	};
+	const auto emptyCache = [&imageCache](bool) { imageCache.Clear(); };
+	auto isWarm = false;
+	const auto warmCache = [&imageCache, &isWarm](bool isCold)
+	{
+		if (isCold) imageCache.Clear();
+		isWarm = !isCold;
+	};
+
+	XUSG_N_RETURN(benchmark.Run("Startup decode, cache off", [&]() { return decodeCached(firstImage, nullptr, false); },
+		firstImage.MegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Startup decode, cold cache", [&]() { return decodeCached(firstImage, &imageCache, false); },
+		firstImage.MegaPixels, "MPix", emptyCache), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Startup decode, warm cache", [&]() { return decodeCached(firstImage, &imageCache, isWarm); },
+		firstImage.MegaPixels, "MPix", warmCache), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Batch decode, cache off", [&]()
+		{ return decodeBatch([&](const Image& image) { return decodeCached(image, nullptr, false); }); },
+		static_cast<double>(images.size()), "images"), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Batch decode, cold cache", [&]()
+		{ return decodeBatch([&](const Image& image) { return decodeCached(image, &imageCache, false); }); },
+		static_cast<double>(images.size()), "images", emptyCache), ThrowIfFailed(E_FAIL));
+	XUSG_N_RETURN(benchmark.Run("Batch decode, warm cache", [&]()
+		{ return decodeBatch([&](const Image& image) { return decodeCached(image, &imageCache, isWarm); }); },
+		static_cast<double>(images.size()), "images", warmCache), ThrowIfFailed(E_FAIL));
+	imageCache.Clear();
+
+	benchmark.Print(cout, "Image cache");
+	cout << "    Warm cache hits: " << numWarmHits << " of " << numWarmLoads;
+	if (numWarmHits < numWarmLoads) cout << " (raise -cachesize for the batch to fit)";
+	cout << endl;
+
+	// Throughput of every stage of the pipeline per precision, over the images of each precision:
+	// decoding, writing into the upload resource (with the half-float conversion of HDR images),
+	// and processing on the GPU with the read-back; HDR images are measured as half and 32-bit floats
+	benchmark.Clear();
+	InitHeadless();
+	const auto pCommandList = m_commandList.get();
+
+	const auto readBuffer = Buffer::MakeUnique();
+	const auto upload = [&](const Image& image)
+	{
+		Texture::sptr srcForNative11;
+		XUSG_N_RETURN(imageLoader.Load(image.FileName.c_str()), false);
+		XUSG_N_RETURN(m_amp12->Init(pCommandList, m_uploadRing, backBufferFormat, imageLoader,
+			m_useNativeDX11 ? &srcForNative11 : nullptr), false);
+		ExecuteAndWait();
+		imageLoader.Release();
+
+		return true;
+	};
+
+	struct Precision
+	{
+		const char* Name;
+		bool IsHDR;
+		bool Is16Bit;
+		bool UseHalfFloat;
+	};
+	static const Precision precisions[] =
+	{
+		{ "8-bit unorm", false, false, false },
+		{ "16-bit unorm", false, true, false },
+		{ "16-bit float", true, false, true },
+		{ "32-bit float", true, false, false }
+	};
+	for (const auto& precision : precisions)
+	{
+		vector<const Image*> precisionImages;
+		auto precisionMegaPixels = 0.0;
+		for (const auto& image : images)
+		{
+			if (image.IsHDR != precision.IsHDR || (!image.IsHDR && image.Is16Bit != precision.Is16Bit)) continue;
+			precisionImages.push_back(&image);
+			precisionMegaPixels += image.MegaPixels;
+		}
+		if (precisionImages.empty()) continue;
+
+		imageLoader.SetHalfFloat(precision.UseHalfFloat);
+		const auto name = string(precision.Name) + ", ";
+		XUSG_N_RETURN(benchmark.Run(name + "decode", [&]()
+			{
+				for (const auto pImage : precisionImages) XUSG_N_RETURN(decodeMapped(*pImage), false);
+
+				return true;
+			}, precisionMegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+
+		XUSG_N_RETURN(benchmark.RunMeasured(name + "upload write", [&](double& time)
+			{
+				time = 0.0;
+				for (const auto pImage : precisionImages)
+				{
+					XUSG_N_RETURN(upload(*pImage), false);
+					time += imageLoader.GetWriteTime();
+				}
+
+				return true;
+			}, precisionMegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+
+		XUSG_N_RETURN(benchmark.RunMeasured(name + "GPU luma and read-back", [&](double& time)
+			{
+				time = 0.0;
+				for (const auto pImage : precisionImages)
+				{
+					XUSG_N_RETURN(upload(*pImage), false);
+
+					const auto startTime = chrono::steady_clock::now();
+					uint32_t rowPitch;
+					m_amp12->Process();
+					XUSG_N_RETURN(m_amp12->ReadBackResult(pCommandList, readBuffer.get(), &rowPitch), false);
+					ExecuteAndWait();
+					time += chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+				}
+
+				return true;
+			}, precisionMegaPixels, "MPix"), ThrowIfFailed(E_FAIL));
+	}
+	benchmark.Print(cout, "Throughput per precision");
+}
+
+bool AmpDX12Interop::VerifyLuma()
+{
+	// The fixed-point luma is defined on 8-bit channels, which the CPU kernels take as RGBA8
+	uint32_t width, height;
+	m_imageLoader.GetImageSize(width, height);
+	XUSG_M_RETURN(m_imageLoader.IsDDS() || m_imageLoader.GetFormat() != Format::R8G8B8A8_UNORM, cerr,
+		"Luma verification requires an 8-bit RGB or RGBA image.", false);
+
+	const auto rowSize = sizeof(uint32_t) * width;
+	vector<uint8_t> source(rowSize * height);
+	m_imageLoader.WriteRegion(source.data(), rowSize, 0, 0, width, height);
+
+	InitHeadless();
+	const auto pCommandList = m_commandList.get();
+
+	// Upload, process the whole image, and read back the result
+	Texture::sptr srcForNative11;
+	XUSG_N_RETURN(m_amp12->Init(pCommandList, m_uploadRing, backBufferFormat, m_imageLoader,
+		m_useNativeDX11 ? &srcForNative11 : nullptr), false);
+	m_imageLoader.Release();
+	ExecuteAndWait();
+
+	uint32_t rowPitch;
+	const auto readBuffer = Buffer::MakeUnique();
+	m_amp12->Process();
+	XUSG_N_RETURN(m_amp12->ReadBackResult(pCommandList, readBuffer.get(), &rowPitch), false);
+	ExecuteAndWait();
+
+	// Compare the result of every CPU backend with the GPU, bit for bit
+	cout << "Fixed-point luma verification: " << width << "x" << height << endl;
+	const auto pData = static_cast<const uint8_t*>(readBuffer->Map(nullptr));
+	vector<uint8_t> cpuRow(rowSize);
+	auto isExact = true;
+	for (uint8_t i = 0; i < PixelKernels::BACKEND_AUTO; ++i)
+	{
+		const auto backend = static_cast<PixelKernels::Backend>(i);
+		if (!PixelKernels::IsBackendSupported(backend)) continue;
+
+		auto numMismatches = 0ull;
+		uint32_t firstX = 0, firstY = 0;
+		for (auto y = 0u; y < height; ++y)
+		{
+			const auto pGPURow = &pData[static_cast<size_t>(rowPitch) * y];
+			PixelKernels::ConvertRGBAToLuma(cpuRow.data(), &source[rowSize * y], width, backend);
+			if (memcmp(cpuRow.data(), pGPURow, rowSize) == 0) continue;
+
+			for (auto x = 0u; x < width; ++x)
+			{
+				if (memcmp(&cpuRow[sizeof(uint32_t) * x], &pGPURow[sizeof(uint32_t) * x], sizeof(uint32_t)) == 0) continue;
+				if (numMismatches++ == 0)
+				{
+					firstX = x;
+					firstY = y;
+				}
+			}
+		}
+
+		cout << "    " << PixelKernels::GetBackendName(backend) << ": ";
+		if (numMismatches > 0) cout << numMismatches << " pixels differ, the first at (" << firstX << ", " << firstY << ")" << endl;
+		else cout << "bit-exact" << endl;
+		isExact = isExact && numMismatches == 0;
+	}
+	readBuffer->Unmap();
+
+	return isExact;
+}
+
+string AmpDX12Interop::GetOutputFileName(const string& fileName)
+{
+	// Next to the input image, as <name>_grey.png
+	const auto dirPos = fileName.find_last_of("/\\");
+	const auto extPos = fileName.find_last_of('.');
+	const auto hasExt = extPos != string::npos && (dirPos == string::npos || extPos > dirPos);
+
+	return fileName.substr(0, hasExt ? extPos : string::npos) + "_grey.png";
+}
+
+string AmpDX12Interop::ToUTF8(const wstring& str)
+{
+	if (str.empty()) return string();
+
+	const auto length = static_cast<int>(str.size());
+	const auto size = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), length, nullptr, 0, nullptr, nullptr);
+	if (size <= 0) return string();
+
+	string result(static_cast<size_t>(size), '\0');
+	WideCharToMultiByte(CP_UTF8, 0, str.c_str(), length, &result[0], size, nullptr, nullptr);
+
+	return result;
+}
+
+void AmpDX12Interop::MarkStartupPhase(const char* phaseName)
+{
+	const auto now = chrono::steady_clock::now();
+	m_startupPhases.emplace_back(phaseName, chrono::duration<double, milli>(now - m_phaseTime).count());
+	m_phaseTime = now;
+}
+
+void AmpDX12Interop::PrintAdapterProbe(const AdapterProbe& adapterProbe)
+{
+	cout << "Adapter probe: " << adapterProbe.GetProbeTime() << " ms" << endl;
+	for (const auto& result : adapterProbe.GetResults())
+	{
+		cout << "    " << ToUTF8(result.Description) << ": " << result.Throughput
+			<< " MPix/s" << (result.IsCached ? " (cached)" : "") << endl;
+	}
+}
+
+void AmpDX12Interop::PrintUploadStats(const char* name, const UploadRing::Stats& stats)
+{
+	cout << "    " << name << ": " << stats.HighWaterMark / 1048576.0 << " of "
+		<< stats.Capacity / 1048576.0 << " MB peak, " << stats.NumAllocations << " allocations, "
+		<< stats.NumDedicated << " dedicated, " << stats.NumWraps << " wraps, "
+		<< stats.NumFailures << " failures" << endl;
 }
 
 double AmpDX12Interop::CalculateFrameStats(float* pTimeStep)
@@ -450,6 +1958,44 @@ double AmpDX12Interop::CalculateFrameStats(float* pTimeStep)
 		if (m_showFPS) windowText << setprecision(2) << fixed << fps;
 		else windowText << L"[F1]";
 
+		if (!m_sequencePath.empty())
+		{
+			const auto stats = m_sequenceStreamer.GetStats();
+			windowText << L"    sequence: " << setprecision(2) << fixed << stats.FramesPerSecond
+				<< L" fps, decode " << stats.DecodeTime << L" ms, upload " << stats.UploadTime
+				<< L" ms, hash " << stats.HashTime << L" ms, overlap " << setprecision(0) << stats.Overlap * 100.0
+			<< L"%, tiles skipped " << stats.SkipRate * 100.0 << L"%";
+
+			const auto& uploadStats = m_sequenceStreamer.GetUploadStats();
+			windowText << L", upload ring " << setprecision(1) << uploadStats.HighWaterMark / 1048576.0
+				<< L"/" << uploadStats.Capacity / 1048576.0 << L" MB peak, "
+				<< uploadStats.NumAllocations << L" allocations";
+		}
+
+		windowText << L"    submit: " << setprecision(1) << fixed << (m_numSubmits > 0 ?
+			m_submitTime * 1000.0 / m_numSubmits : 0.0) << L" us" << (m_rerecordEveryFrame ?
+			L" (recorded per frame)" : L" (pre-recorded)");
+		m_submitTime = 0.0;
+		m_numSubmits = 0;
+
+		windowText << L"    latency: " << setprecision(1) << fixed << (m_numLatencyFrames > 0 ?
+			m_latency / m_numLatencyFrames : 0.0) << L" ms (" << static_cast<uint32_t>(m_framesInFlight) << L" in flight";
+		if (m_maxFrameLatency > 0) windowText << L", max latency " << m_maxFrameLatency;
+		windowText << L")";
+		m_latency = 0.0;
+		m_numLatencyFrames = 0;
+
+		windowText << L"    view: " << setprecision(2) << fixed << m_amp12->GetViewScale() << L" texels/pixel, processed "
+			<< setprecision(1) << (m_numVisiblePixels > 0 ? 100.0 * m_numProcessedPixels / m_numVisiblePixels : 0.0)
+			<< L"% of the visible, " << (m_numImagePixels > 0 ? 100.0 * m_numProcessedPixels / m_numImagePixels : 0.0)
+			<< L"% of the image pixels";
+		m_numProcessedPixels = 0;
+		m_numVisiblePixels = 0;
+		m_numImagePixels = 0;
+
+		UpdateCPUUsage();
+		windowText << L"    CPU: " << setprecision(1) << fixed << m_cpuUsage << L"%";
+
 		windowText << L"    [F11] screen shot";
 
 		SetCustomWindowText(windowText.str().c_str());
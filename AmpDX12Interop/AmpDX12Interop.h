@@ -14,6 +14,16 @@
 #include "DXFramework.h"
 #include "StepTimer.h"
 #include "Amp12.h"
+#include "TiledProcessor.h"
+#include "CPUTiledProcessor.h"
+#include "Benchmark.h"
+#include "MultiAdapterProcessor.h"
+#include "AdapterProbe.h"
+#include "SequenceStreamer.h"
+#include "ImageAtlas.h"
+#include "ImageStack.h"
+#include "DirtyRegion.h"
+#include "FenceCallbackRegistry.h"
 
 using namespace DirectX;
 
@@ -34,7 +44,20 @@ public:
 	virtual void OnRender();
 	virtual void OnDestroy();
 
+	virtual void OnWindowMoved();
+	virtual void OnWindowSizeChanged(int width, int height);
 	virtual void OnKeyUp(uint8_t /*key*/);
+	virtual void OnLButtonDown(float posX, float posY);
+	virtual void OnLButtonUp(float posX, float posY);
+	virtual void OnMouseMove(float posX, float posY);
+	virtual void OnMouseLeave();
+
+	virtual bool IsEventDriven() const;
+	virtual uint32_t GetWaitHandles(HANDLE* pHandles, uint32_t maxHandles);
+	virtual uint32_t GetWaitTimeout() const;
+	virtual void OnWaitSignaled(uint32_t handleIndex);
+	virtual void OnWaitTimeout();
+	virtual bool UsesRenderThread() const;
 
 	virtual void ParseCommandLineArgs(wchar_t* argv[], int argc);
 
@@ -43,19 +66,25 @@ private:
 	{
 		DEVICE_DISCRETE,
 		DEVICE_UMA,
-		DEVICE_WARP
+		DEVICE_WARP,
+		DEVICE_FASTEST	// Measured by the adapter probe
 	};
 
-	static const uint8_t FrameCount = 3;
+	static const uint8_t MaxFrameCount = 4;
 
 	XUSG::SwapChain::uptr			m_swapChain;
-	XUSG::CommandAllocator::uptr	m_commandAllocators[FrameCount];
+	XUSG::CommandAllocator::uptr	m_commandAllocators[MaxFrameCount];
 	XUSG::CommandQueue::uptr		m_commandQueue;
 
 	XUSG::Device::uptr			m_device;
-	XUSG::RenderTarget::uptr	m_renderTargets[FrameCount];
+	XUSG::RenderTarget::uptr	m_renderTargets[MaxFrameCount];
 	XUSG::CommandList::uptr		m_commandList;
 
+	// Copies of the result to the back buffers, recorded once per back buffer
+	XUSG::CommandAllocator::uptr	m_presentAllocators[MaxFrameCount];
+	XUSG::CommandList::uptr			m_presentCommandLists[MaxFrameCount];
+	const XUSG::Texture2D*			m_recordedResult;
+
 	// App resources.
 	std::unique_ptr<Amp12> m_amp12;
 
@@ -63,29 +92,158 @@ private:
 	uint32_t	m_frameIndex;
 	HANDLE		m_fenceEvent;
 	XUSG::Fence::uptr m_fence;
-	uint64_t	m_fenceValues[FrameCount];
+	uint64_t	m_fenceValues[MaxFrameCount];
+	uint8_t		m_framesInFlight;		// 1 to MaxFrameCount
+	uint8_t		m_backBufferCount;		// The flip model takes 2 at least, even with 1 frame in flight
+	HANDLE		m_frameLatencyWaitable;	// Of the event-driven render loop
+	HANDLE		m_callbackEvent;		// Signaled at the fence value of the next callback
+
+	// Completions of async GPU->CPU transfers
+	FenceCallbackRegistry m_fenceCallbacks;
 
 	// Application state
 	DeviceType	m_deviceType;
 	StepTimer	m_timer;
 	bool		m_showFPS;
 	bool		m_isPaused;
+	bool		m_isBatchMode;
+	bool		m_isDirty;		// A frame is needed, since the displayed result is out of date
+
+	// Only the out-of-date tiles of the visible part of the window are processed, at the display
+	// resolution, and presented as dirty rects
+	uint32_t	m_windowWidth;	// Of the client area, applied to the swap chain on the next frame
+	uint32_t	m_windowHeight;
+	RECT		m_processedRect;	// Of the view, up to date outside of the dirty region
+	uint8_t		m_frameSource;		// Last processed source of the sequence
+	DirtyRegion	m_sourceDirty;		// In image texels
+	DirtyRegion	m_viewDirty;		// In view pixels
+	std::vector<RECT> m_dirtyRects;
+	std::vector<XUSG::RectRange> m_presentRects;
+	uint64_t	m_numProcessedPixels;	// Since the last report, over the visible and the image pixels
+	uint64_t	m_numVisiblePixels;
+	uint64_t	m_numImagePixels;
+
+	// Totals over the frames that switch to a new sequence frame, of which only the tiles
+	// changed from the previous frame are processed
+	uint32_t	m_numNewFrames;
+	uint64_t	m_totalChangedTexels;	// Over the image texels
+	uint64_t	m_totalFrameTexels;
+	uint64_t	m_totalFramePixels;		// Processed, over the visible pixels
+	uint64_t	m_totalFrameVisiblePixels;
+
+	// Annotations drawn with the left button into the source of a still image, as a demo of the
+	// partial source updates, which is only on with -annotate
+	static const uint32_t BrushSize = 8;	// In view pixels
+	bool		m_useAnnotations;
+	bool		m_isAnnotating;
+	std::vector<POINT> m_annotations;	// Pending brush stamps, in image texels
+	XUSG::CommandAllocator::uptr	m_uploadAllocators[MaxFrameCount];
+	XUSG::CommandList::uptr			m_uploadCommandList;
 
 	// User external settings
 	std::string m_fileName;
 	bool m_useNativeDX11;
+	bool m_useImageCache;
+	uint32_t m_imageCacheSize;	// In MB
+	uint32_t m_tileSize;		// Forces tiled processing if non-zero
+	bool m_useTiling;			// Streams the image band by band from the file, decided on its header
+	bool m_useCPUTiling;		// Tiles on the CPU workers instead of the accelerator
+	bool m_useMultiAdapter;		// Splits the image among all the adapters and the CPU
+	uint32_t m_numCPUWorkers;	// Of the multi-adapter or CPU tiled processing
+	std::string m_sequencePath;	// Directory glob, Y4M or raw stream
+	std::string m_batchPath;	// Glob of images processed one by one, headless
+	bool m_useAtlas;			// Packs the small images of a batch into atlases
+	bool m_useStack;			// Stacks the same-size images of a batch into volume textures
+	bool m_rerecordEveryFrame;	// Records the present commands every frame, for comparison
+	bool m_isEventDriven;		// Renders only when a frame is needed, instead of continuously
+	bool m_useRenderThread;		// Renders on a thread of its own, apart from the message pump
+	uint32_t m_maxFrameLatency;	// Of the waitable-object low-latency mode; 0 if off
+	uint32_t m_rawWidth;
+	uint32_t m_rawHeight;
+	bool m_useFixedPointLuma;	// Rounds the luma in integers, identically on every device and the CPU
+	bool m_verifyLuma;			// Checks the fixed-point luma of the GPU against the CPU kernels, headless
+	uint32_t m_benchIterations;	// Warm iterations of the benchmarks, run headless over the batch; 0 if off
+
+	// Decoded-image cache across launches
+	ImageCache m_imageCache;
+
+	// Input image, decoded on a worker thread during device creation
+	ImageLoader m_imageLoader;
+
+	// Input image of the tiled processing, read band by band instead
+	BandReader m_bandReader;
+
+	// Upload memory recycled on the direct-queue fence
+	static const uint64_t UploadRingSize = 32 << 20;
+	UploadRing m_uploadRing;
+
+	// Input images of the batch mode
+	std::vector<std::string> m_batchFileNames;
+
+	// Input image sequence, streamed into alternating sources
+	ImageSequence		m_sequence;
+	SequenceStreamer	m_sequenceStreamer;
+	XUSG::Texture::sptr	m_frameSources[SequenceStreamer::MaxSourceCount];
+
+	// Startup-phase timing
+	std::chrono::steady_clock::time_point m_startupTime;
+	std::chrono::steady_clock::time_point m_phaseTime;
+	std::vector<std::pair<const char*, double>> m_startupPhases;
+
+	// CPU time of recording and submitting the frame commands, in ms
+	double		m_submitTime;
+	uint32_t	m_numSubmits;
+	uint32_t	m_numPausedSubmits;	// Since the pause, on exposes and resizes only
+
+	// Latency from the input sampling of a frame to the observed GPU completion of it, in ms
+	std::chrono::steady_clock::time_point m_frameStartTimes[MaxFrameCount];
+	uint64_t	m_frameEndFenceValues[MaxFrameCount];	// 0 if not in flight
+	double		m_latency;
+	uint32_t	m_numLatencyFrames;
+	double		m_totalLatency;
+	uint64_t	m_totalLatencyFrames;
+	std::chrono::steady_clock::time_point m_latencyStartTime;
+
+	// Process CPU utilization, in percent of a core
+	double		m_cpuUsage;
+	uint64_t	m_cpuTime;	// In 100 ns
+	std::chrono::steady_clock::time_point m_cpuUsageTime;
 
 	// Screen-shot helpers and state
 	XUSG::Buffer::uptr	m_readBuffer;
 	uint32_t			m_rowPitch;
 	uint8_t				m_screenShot;
 
-	void LoadPipeline(std::vector<XUSG::Resource::uptr>& uploaders, XUSG::Texture::uptr& srcForNative11);
+	void LoadPipeline(XUSG::Texture::sptr& srcForNative11);
 	void LoadAssets();
-	void PopulateCommandList();
+	bool PopulateCommandList(XUSG::CommandList*& pCommandList);
+	void RecordPresentCommandLists();
+	void RecordPresent(XUSG::CommandList* pCommandList, XUSG::RenderTarget* pRenderTarget);
+	void ResizeSwapChain();
+	RECT GetVisibleRect() const;
+	void Annotate(float x, float y);
+	void ApplyAnnotations();
+	XUSG::SwapChainFlag GetSwapChainFlags() const;
+	bool IsFramePending() const;
+	void UpdateCPUUsage();
+	void UpdateLatency();
 	void WaitForGpu();
 	void MoveToNextFrame();
+	void InitHeadless();
+	void ExecuteAndWait();
 	void SaveImage(char const* fileName, XUSG::Buffer* pImageBuffer,
 		uint32_t w, uint32_t h, uint32_t rowPitch, uint8_t comp = 3);
+	void SaveImage(char const* fileName, const uint8_t* pData,
+		uint32_t w, uint32_t h, uint32_t rowPitch, uint8_t comp = 3);
+	void ProcessTiled(const Concurrency::accelerator_view* pAcceleratorView);
+	void ProcessMultiAdapter();
+	void ProcessBatch();
+	void RunBenchmarks();
+	bool VerifyLuma();
+	static std::string GetOutputFileName(const std::string& fileName);
+	static std::string ToUTF8(const std::wstring& str);
+	void MarkStartupPhase(const char* phaseName);
+	void PrintAdapterProbe(const AdapterProbe& adapterProbe);
+	void PrintUploadStats(const char* name, const UploadRing::Stats& stats);
 	double CalculateFrameStats(float* fTimeStep = nullptr);
 };
@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "AlignedBuffer.h"
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+AlignedBuffer::AlignedBuffer() :
+	m_pData(nullptr),
+	m_capacity(0)
+{
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer&& other) :
+	m_pData(other.m_pData),
+	m_capacity(other.m_capacity)
+{
+	other.m_pData = nullptr;
+	other.m_capacity = 0;
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+	Release();
+}
+
+AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other)
+{
+	if (this != &other)
+	{
+		Release();
+		m_pData = other.m_pData;
+		m_capacity = other.m_capacity;
+		other.m_pData = nullptr;
+		other.m_capacity = 0;
+	}
+
+	return *this;
+}
+
+uint8_t* AlignedBuffer::Reserve(size_t size)
+{
+	if (size <= m_capacity) return m_pData;
+
+	Release();
+
+	// Round up to whole cache lines
+	const auto capacity = (size + Alignment - 1) / Alignment * Alignment;
+#ifdef _WIN32
+	m_pData = static_cast<uint8_t*>(_aligned_malloc(capacity, Alignment));
+#else
+	void* pData = nullptr;
+	if (posix_memalign(&pData, Alignment, capacity) != 0) pData = nullptr;
+	m_pData = static_cast<uint8_t*>(pData);
+#endif
+	m_capacity = m_pData ? capacity : 0;
+
+	return m_pData;
+}
+
+void AlignedBuffer::Release()
+{
+#ifdef _WIN32
+	_aligned_free(m_pData);
+#else
+	free(m_pData);
+#endif
+	m_pData = nullptr;
+	m_capacity = 0;
+}
@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Growable working buffer aligned to a cache line, for the CPU kernels. It only grows, so
+// that a buffer reused across bands, tiles or images stops allocating once it is warm.
+class AlignedBuffer
+{
+public:
+	AlignedBuffer();
+	AlignedBuffer(AlignedBuffer&& other);
+	virtual ~AlignedBuffer();
+
+	AlignedBuffer& operator=(AlignedBuffer&& other);
+
+	// Returns the data of at least the given size; the contents are not kept when it grows.
+	uint8_t* Reserve(size_t size);
+	void Release();
+
+	uint8_t* GetData() const { return m_pData; }
+	size_t GetCapacity() const { return m_capacity; }
+
+	static const size_t Alignment = 64;
+
+protected:
+	AlignedBuffer(const AlignedBuffer&) = delete;
+	AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+	uint8_t* m_pData;
+	size_t m_capacity;
+};
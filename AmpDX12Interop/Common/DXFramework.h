@@ -42,6 +42,18 @@ public:
 	virtual void OnMouseWheel(float deltaZ, float posX, float posY) {}
 	virtual void OnMouseLeave() {}
 
+	// Event-driven scheduling: between the messages, the main loop sleeps on the wait handles
+	// of the framework instead of spinning, and WM_PAINT only repaints the invalidated window.
+	virtual bool IsEventDriven() const { return false; }
+	virtual uint32_t GetWaitHandles(HANDLE* /*pHandles*/, uint32_t /*maxHandles*/) { return 0; }
+	virtual uint32_t GetWaitTimeout() const { return INFINITE; }	// In ms
+	virtual void OnWaitSignaled(uint32_t /*handleIndex*/) {}
+	virtual void OnWaitTimeout() {}
+
+	// Renders on a thread of its own, so that the message pump never stalls the rendering;
+	// the window events then reach the framework through a queue, on the render thread.
+	virtual bool UsesRenderThread() const { return false; }
+
 	// Accessors.
 	uint32_t GetWidth() const		{ return m_width; }
 	uint32_t GetHeight() const		{ return m_height; }
@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Read-only memory mapping of a whole file (file mapping on Windows, mmap elsewhere),
+// so that a file can be inspected and decoded several times without any extra I/O.
+class MappedFile
+{
+public:
+	MappedFile();
+	virtual ~MappedFile();
+
+	bool Open(const char* fileName);
+	void Close();
+
+	const uint8_t* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+	using uptr = std::unique_ptr<MappedFile>;
+
+protected:
+	const uint8_t* m_pData;
+	size_t m_size;
+
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#else
+	int m_fd;
+#endif
+};
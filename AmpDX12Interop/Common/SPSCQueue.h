@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. Push()
+// fails when the queue is full, and Pop() when it is empty; neither ever blocks. The head
+// and the tail are kept on separate cache lines, so the two threads do not false-share.
+template<typename T, uint32_t Capacity>
+class SPSCQueue
+{
+public:
+	SPSCQueue() : m_head(0), m_tail(0) {}
+
+	// Producer thread only
+	bool Push(const T& item)
+	{
+		const auto tail = m_tail.load(std::memory_order_relaxed);
+		const auto next = (tail + 1) % Capacity;
+		if (next == m_head.load(std::memory_order_acquire)) return false;
+
+		m_items[tail] = item;
+		m_tail.store(next, std::memory_order_release);
+
+		return true;
+	}
+
+	// Consumer thread only
+	bool Pop(T& item)
+	{
+		const auto head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) return false;
+
+		item = m_items[head];
+		m_head.store((head + 1) % Capacity, std::memory_order_release);
+
+		return true;
+	}
+
+protected:
+	T m_items[Capacity];	// One slot is kept empty to tell full from empty
+
+	alignas(64) std::atomic<uint32_t> m_head;
+	alignas(64) std::atomic<uint32_t> m_tail;
+};
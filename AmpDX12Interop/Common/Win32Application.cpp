@@ -13,6 +13,13 @@
 #include "Win32Application.h"
 
 HWND Win32Application::m_hwnd = nullptr;
+std::thread Win32Application::m_renderThread;
+std::atomic<bool> Win32Application::m_isRenderThreadStopping(false);
+HANDLE Win32Application::m_inputEvent = nullptr;
+SPSCQueue<Win32Application::InputEvent, 256> Win32Application::m_inputQueue;
+std::mutex Win32Application::m_pendingMoveMutex;
+Win32Application::InputEvent Win32Application::m_pendingMove = {};
+bool Win32Application::m_hasPendingMove = false;
 
 int Win32Application::Run(DXFramework *pFramework, HINSTANCE hInstance, int nCmdShow, HICON hIcon)
 {
@@ -58,20 +65,49 @@ int Win32Application::Run(DXFramework *pFramework, HINSTANCE hInstance, int nCmd
 	// Initialize the sample. OnInit is defined in each child-implementation of DXSample.
 	pFramework->OnInit();
 
+	// Start rendering on a thread of its own, if the framework asks for it
+	if (pFramework->UsesRenderThread())
+	{
+		m_inputEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		m_renderThread = std::thread(RenderThread, pFramework);
+	}
+
 	ShowWindow(m_hwnd, nCmdShow);
 
 	// Main sample loop.
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
 	{
+		// The message pump has nothing else to do, if the rendering is on its own thread
+		if (m_renderThread.joinable())
+		{
+			if (GetMessage(&msg, nullptr, 0, 0) > 0)
+			{
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+			else msg.message = WM_QUIT;
+		}
 		// Process any messages in the queue.
-		if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+		else if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
 		{
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
+		else if (pFramework->IsEventDriven())
+		{
+			// Sleep until a message arrives, or until one of the framework's handles is signaled
+			HANDLE handles[MAXIMUM_WAIT_OBJECTS - 1];
+			const auto numHandles = pFramework->GetWaitHandles(handles, MAXIMUM_WAIT_OBJECTS - 1);
+			const auto ret = MsgWaitForMultipleObjectsEx(numHandles, handles, pFramework->GetWaitTimeout(),
+				QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+			if (ret < WAIT_OBJECT_0 + numHandles) pFramework->OnWaitSignaled(ret - WAIT_OBJECT_0);
+			else if (ret == WAIT_TIMEOUT) pFramework->OnWaitTimeout();
+		}
 	}
 
+	StopRenderThread();
+	if (m_inputEvent) CloseHandle(m_inputEvent);
 	pFramework->OnDestroy();
 
 	// Return this part of the WM_QUIT message to Windows.
@@ -103,8 +139,7 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 		return 0;
 
 	case WM_MOVE:
-		if (pFramework)
-			pFramework->OnWindowMoved();
+		if (pFramework) PostInput(pFramework, { InputEvent::WINDOW_MOVED });
 		return 0;
 
 	case WM_SIZE:
@@ -114,7 +149,7 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 			{
 				s_minimized = true;
 				if (!s_in_suspend && pFramework)
-					pFramework->OnSuspending();
+					PostInput(pFramework, { InputEvent::SUSPENDING });
 				s_in_suspend = true;
 			}
 		}
@@ -122,14 +157,14 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 		{
 			s_minimized = false;
 			if (s_in_suspend && pFramework)
-				pFramework->OnResuming();
+				PostInput(pFramework, { InputEvent::RESUMING });
 			s_in_suspend = false;
 		}
 		else if (!s_in_sizemove && pFramework)
 		{
 			s_width = LOWORD(lParam);
 			s_height = HIWORD(lParam);
-			pFramework->OnWindowSizeChanged(s_width, s_height);
+			PostInput(pFramework, { InputEvent::WINDOW_SIZE_CHANGED, 0, static_cast<int>(s_width), static_cast<int>(s_height) });
 		}
 		return 0;
 
@@ -149,7 +184,7 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 
 			if (s_width != w || s_height != h)
 			{
-				pFramework->OnWindowSizeChanged(w, h);
+				PostInput(pFramework, { InputEvent::WINDOW_SIZE_CHANGED, 0, static_cast<int>(w), static_cast<int>(h) });
 				s_width = w;
 				s_height = h;
 			}
@@ -157,36 +192,41 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 		return 0;
 
 	case WM_KEYDOWN:
-		if (pFramework) pFramework->OnKeyDown(static_cast<uint8_t>(wParam));
+		if (pFramework) PostInput(pFramework, { InputEvent::KEY_DOWN, static_cast<uint8_t>(wParam) });
 		return 0;
 
 	case WM_KEYUP:
-		if (pFramework) pFramework->OnKeyUp(static_cast<uint8_t>(wParam));
+		if (pFramework) PostInput(pFramework, { InputEvent::KEY_UP, static_cast<uint8_t>(wParam) });
 		return 0;
 
 	case WM_LBUTTONDOWN:
 		if (pFramework)
-			pFramework->OnLButtonDown(static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)));
+			PostInput(pFramework, { InputEvent::L_BUTTON_DOWN, 0, 0, 0,
+				static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)) });
 		return 0;
 
 	case WM_LBUTTONUP:
 		if (pFramework)
-			pFramework->OnLButtonUp(static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)));
+			PostInput(pFramework, { InputEvent::L_BUTTON_UP, 0, 0, 0,
+				static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)) });
 		return 0;
 
 	case WM_RBUTTONDOWN:
 		if (pFramework)
-			pFramework->OnRButtonDown(static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)));
+			PostInput(pFramework, { InputEvent::R_BUTTON_DOWN, 0, 0, 0,
+				static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)) });
 		return 0;
 
 	case WM_RBUTTONUP:
 		if (pFramework)
-			pFramework->OnRButtonUp(static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)));
+			PostInput(pFramework, { InputEvent::R_BUTTON_UP, 0, 0, 0,
+				static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)) });
 		return 0;
 
 	case WM_MOUSEMOVE:
 		if (pFramework)
-			pFramework->OnMouseMove(static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)));
+			PostInput(pFramework, { InputEvent::MOUSE_MOVE, 0, 0, 0,
+				static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)) });
 		{
 			TRACKMOUSEEVENT csTME = { sizeof(TRACKMOUSEEVENT), TME_LEAVE, hWnd };
 			TrackMouseEvent(&csTME);
@@ -194,22 +234,30 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 		return 0;
 
 	case WM_MOUSELEAVE:
-		if (pFramework) pFramework->OnMouseLeave();
+		if (pFramework) PostInput(pFramework, { InputEvent::MOUSE_LEAVE });
 		return 0;
 
 	case WM_MOUSEWHEEL:
-		if (pFramework) pFramework->OnMouseWheel(static_cast<float>(GET_WHEEL_DELTA_WPARAM(wParam)) / WHEEL_DELTA,
-			static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)));
+		if (pFramework) PostInput(pFramework, { InputEvent::MOUSE_WHEEL, 0, 0, 0,
+			static_cast<float>(GET_X_LPARAM(lParam)), static_cast<float>(GET_Y_LPARAM(lParam)),
+			static_cast<float>(GET_WHEEL_DELTA_WPARAM(wParam)) / WHEEL_DELTA });
 		return 0;
 
 	case WM_PAINT:
 		if (pFramework)
 		{
-			pFramework->OnUpdate();
-			pFramework->OnRender();
+			PostInput(pFramework, { InputEvent::PAINT });
+
+			// Otherwise, WM_PAINT keeps coming, and the main loop never sleeps
+			if (pFramework->IsEventDriven() || m_renderThread.joinable()) ValidateRect(hWnd, nullptr);
 		}
 		return 0;
 
+	case WM_CLOSE:
+		// The render thread must be done with the window before it is destroyed
+		StopRenderThread();
+		break;
+
 	case WM_DESTROY:
 		PostQuitMessage(0);
 		return 0;
@@ -218,3 +266,167 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 	// Handle any messages the switch statement didn't.
 	return DefWindowProc(hWnd, message, wParam, lParam);
 }
+
+void Win32Application::PostInput(DXFramework* pFramework, const InputEvent& inputEvent)
+{
+	if (!m_renderThread.joinable()) return DispatchInput(pFramework, inputEvent);
+
+	// Only the latest position matters, so once the render thread has fallen a whole queue
+	// behind, the mouse moves overwrite each other until it catches up
+	if (inputEvent.Type == InputEvent::MOUSE_MOVE)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_pendingMoveMutex);
+			if (m_hasPendingMove || !m_inputQueue.Push(inputEvent))
+			{
+				m_pendingMove = inputEvent;
+				m_hasPendingMove = true;
+			}
+		}
+		SetEvent(m_inputEvent);
+
+		return;
+	}
+
+	// Keys, buttons and window events are never dropped; a pending move goes ahead of them
+	InputEvent pendingMove;
+	if (TakePendingMove(pendingMove)) PushInput(pendingMove);
+	PushInput(inputEvent);
+}
+
+void Win32Application::PushInput(const InputEvent& inputEvent)
+{
+	// Wait for the render thread to make room, handling the messages it sends meanwhile, such
+	// as its window-title updates, so that neither thread waits on the other
+	HANDLE hRenderThread = m_renderThread.native_handle();
+	while (!m_inputQueue.Push(inputEvent))
+	{
+		SetEvent(m_inputEvent);
+		const auto ret = MsgWaitForMultipleObjects(1, &hRenderThread, FALSE, 1, QS_SENDMESSAGE);
+		if (ret == WAIT_OBJECT_0) return;	// The render thread has exited
+		if (ret == WAIT_OBJECT_0 + 1)
+		{
+			MSG msg;
+			PeekMessage(&msg, nullptr, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+		}
+	}
+
+	SetEvent(m_inputEvent);
+}
+
+bool Win32Application::TakePendingMove(InputEvent& inputEvent)
+{
+	std::lock_guard<std::mutex> lock(m_pendingMoveMutex);
+	if (!m_hasPendingMove) return false;
+
+	inputEvent = m_pendingMove;
+	m_hasPendingMove = false;
+
+	return true;
+}
+
+void Win32Application::DispatchInput(DXFramework* pFramework, const InputEvent& inputEvent)
+{
+	switch (inputEvent.Type)
+	{
+	case InputEvent::KEY_DOWN:
+		pFramework->OnKeyDown(inputEvent.Key);
+		break;
+	case InputEvent::KEY_UP:
+		pFramework->OnKeyUp(inputEvent.Key);
+		break;
+	case InputEvent::L_BUTTON_DOWN:
+		pFramework->OnLButtonDown(inputEvent.X, inputEvent.Y);
+		break;
+	case InputEvent::L_BUTTON_UP:
+		pFramework->OnLButtonUp(inputEvent.X, inputEvent.Y);
+		break;
+	case InputEvent::R_BUTTON_DOWN:
+		pFramework->OnRButtonDown(inputEvent.X, inputEvent.Y);
+		break;
+	case InputEvent::R_BUTTON_UP:
+		pFramework->OnRButtonUp(inputEvent.X, inputEvent.Y);
+		break;
+	case InputEvent::MOUSE_MOVE:
+		pFramework->OnMouseMove(inputEvent.X, inputEvent.Y);
+		break;
+	case InputEvent::MOUSE_WHEEL:
+		pFramework->OnMouseWheel(inputEvent.Delta, inputEvent.X, inputEvent.Y);
+		break;
+	case InputEvent::MOUSE_LEAVE:
+		pFramework->OnMouseLeave();
+		break;
+	case InputEvent::WINDOW_MOVED:
+		pFramework->OnWindowMoved();
+		break;
+	case InputEvent::WINDOW_SIZE_CHANGED:
+		pFramework->OnWindowSizeChanged(inputEvent.Width, inputEvent.Height);
+		break;
+	case InputEvent::SUSPENDING:
+		pFramework->OnSuspending();
+		break;
+	case InputEvent::RESUMING:
+		pFramework->OnResuming();
+		break;
+	case InputEvent::PAINT:
+		pFramework->OnUpdate();
+		pFramework->OnRender();
+		break;
+	}
+}
+
+void Win32Application::RenderThread(DXFramework* pFramework)
+{
+	MSG msg = {};
+	while (!m_isRenderThreadStopping)
+	{
+		// Handle the window events queued by the message pump; a coalesced mouse move is newer
+		// than all of them
+		InputEvent inputEvent;
+		while (m_inputQueue.Pop(inputEvent)) DispatchInput(pFramework, inputEvent);
+		if (TakePendingMove(inputEvent)) DispatchInput(pFramework, inputEvent);
+
+		if (pFramework->IsEventDriven())
+		{
+			// Sleep until an input event arrives, or until one of the framework's handles is signaled
+			HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+			const auto numHandles = pFramework->GetWaitHandles(handles, MAXIMUM_WAIT_OBJECTS - 1);
+			handles[numHandles] = m_inputEvent;
+			const auto ret = WaitForMultipleObjects(numHandles + 1, handles, FALSE, pFramework->GetWaitTimeout());
+			if (ret < WAIT_OBJECT_0 + numHandles) pFramework->OnWaitSignaled(ret - WAIT_OBJECT_0);
+			else if (ret == WAIT_TIMEOUT) pFramework->OnWaitTimeout();
+		}
+		else
+		{
+			pFramework->OnUpdate();
+			pFramework->OnRender();
+		}
+
+		// PostQuitMessage() on this thread only reaches the queue of this thread, so forward it
+		// to the window, which is closed on the message-pump thread
+		if (PeekMessage(&msg, nullptr, WM_QUIT, WM_QUIT, PM_REMOVE))
+		{
+			PostMessage(m_hwnd, WM_CLOSE, 0, 0);
+			break;
+		}
+	}
+}
+
+void Win32Application::StopRenderThread()
+{
+	if (!m_renderThread.joinable()) return;
+
+	m_isRenderThreadStopping = true;
+	SetEvent(m_inputEvent);
+
+	// Keep handling the messages sent by the render thread, such as its window-title updates,
+	// until it exits
+	HANDLE hRenderThread = m_renderThread.native_handle();
+	while (MsgWaitForMultipleObjects(1, &hRenderThread, FALSE, INFINITE, QS_SENDMESSAGE) == WAIT_OBJECT_0 + 1)
+	{
+		MSG msg;
+		PeekMessage(&msg, nullptr, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+	}
+
+	m_renderThread.join();
+}
@@ -12,6 +12,7 @@
 #pragma once
 
 #include "DXFramework.h"
+#include "SPSCQueue.h"
 
 class DXFramework;
 
@@ -22,8 +23,55 @@ public:
 	static HWND GetHwnd() { return m_hwnd; }
 
 protected:
+	// Window events for the framework; with a render thread, they are queued to it
+	struct InputEvent
+	{
+		enum EventType : uint8_t
+		{
+			KEY_DOWN,
+			KEY_UP,
+			L_BUTTON_DOWN,
+			L_BUTTON_UP,
+			R_BUTTON_DOWN,
+			R_BUTTON_UP,
+			MOUSE_MOVE,
+			MOUSE_WHEEL,
+			MOUSE_LEAVE,
+			WINDOW_MOVED,
+			WINDOW_SIZE_CHANGED,
+			SUSPENDING,
+			RESUMING,
+			PAINT
+		};
+
+		EventType Type;
+		uint8_t Key;
+		int Width;
+		int Height;
+		float X;
+		float Y;
+		float Delta;
+	};
+
 	static LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
+	static void PostInput(DXFramework* pFramework, const InputEvent& inputEvent);
+	static void PushInput(const InputEvent& inputEvent);
+	static bool TakePendingMove(InputEvent& inputEvent);
+	static void DispatchInput(DXFramework* pFramework, const InputEvent& inputEvent);
+	static void RenderThread(DXFramework* pFramework);
+	static void StopRenderThread();
+
 private:
 	static HWND m_hwnd;
+
+	static std::thread m_renderThread;
+	static std::atomic<bool> m_isRenderThreadStopping;
+	static HANDLE m_inputEvent;
+	static SPSCQueue<InputEvent, 256> m_inputQueue;
+
+	// The latest mouse move that did not fit in the queue; moves are coalesced into it
+	static std::mutex m_pendingMoveMutex;
+	static InputEvent m_pendingMove;
+	static bool m_hasPendingMove;
 };
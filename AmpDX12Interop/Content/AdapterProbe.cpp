@@ -0,0 +1,217 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "AdapterProbe.h"
+#include "LumaKernel.h"
+
+using namespace std;
+using namespace Concurrency;
+using namespace Concurrency::direct3d;
+using namespace Concurrency::graphics;
+using namespace XUSG;
+
+static const uint32_t g_probeCacheMagic = 0x31504141; // "AAP1"
+static const uint32_t g_probeCacheVersion = 1;
+
+AdapterProbe::AdapterProbe() :
+	m_probeTime(0.0)
+{
+}
+
+AdapterProbe::~AdapterProbe()
+{
+}
+
+bool AdapterProbe::Init(const char* cacheDir)
+{
+	string dir = cacheDir;
+	if (!dir.empty() && dir.back() != '/' && dir.back() != '\\') dir += '/';
+	if (!CreateDirectoryA(dir.c_str(), nullptr))
+		XUSG_M_RETURN(GetLastError() != ERROR_ALREADY_EXISTS, cerr, "Failed to create the adapter probe cache directory.", false);
+	m_cacheFileName = dir + "AdapterProbe.bin";
+
+	// A missing or stale cache only costs a probe
+	LoadCache();
+
+	return true;
+}
+
+bool AdapterProbe::SelectFastest(IDXGIFactory1* pFactory, com_ptr<IDXGIAdapter1>& adapter)
+{
+	m_results.clear();
+	m_probeTime = 0.0;
+
+	auto isCacheDirty = false;
+	auto fastest = -1.0;
+	com_ptr<IDXGIAdapter1> candidate;
+	for (auto i = 0u; pFactory->EnumAdapters1(i, &candidate) != DXGI_ERROR_NOT_FOUND; ++i)
+	{
+		DXGI_ADAPTER_DESC1 desc;
+		candidate->GetDesc1(&desc);
+
+		Result result = {};
+		result.AdapterLuid = desc.AdapterLuid;
+		wcsncpy_s(result.Description, desc.Description, _TRUNCATE);
+		LARGE_INTEGER driverVersion = {};
+		candidate->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+		result.DriverVersion = driverVersion.QuadPart;
+
+		const auto pCached = FindCached(result);
+		if (pCached)
+		{
+			result.Throughput = pCached->Throughput;
+			result.IsCached = true;
+		}
+		else
+		{
+			const auto startTime = chrono::steady_clock::now();
+			result.Throughput = Measure(candidate.get());
+			m_probeTime += chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+			isCacheDirty = true;
+		}
+		m_results.emplace_back(result);
+
+		if (result.Throughput > fastest)
+		{
+			fastest = result.Throughput;
+			adapter = candidate;
+		}
+		candidate = nullptr;
+	}
+
+	// Only the current adapters are kept in the cache
+	if (isCacheDirty || m_results.size() != m_cachedResults.size()) SaveCache();
+
+	return fastest > 0.0;
+}
+
+const vector<AdapterProbe::Result>& AdapterProbe::GetResults() const
+{
+	return m_results;
+}
+
+double AdapterProbe::GetProbeTime() const
+{
+	return m_probeTime;
+}
+
+double AdapterProbe::Measure(IDXGIAdapter1* pAdapter) const
+{
+	// Only the adapters that can host the DX12 pipeline are candidates
+	if (FAILED(D3D12CreateDevice(pAdapter, D3D_FEATURE_LEVEL_11_0, __uuidof(ID3D12Device), nullptr))) return 0.0;
+
+	com_ptr<ID3D11Device> device11;
+	if (FAILED(D3D11CreateDevice(pAdapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, 0, nullptr, 0,
+		D3D11_SDK_VERSION, &device11, nullptr, nullptr)))
+		return 0.0;
+
+	try
+	{
+		const auto acceleratorView = create_accelerator_view(device11.get());
+
+		// A gradient, so that the kernel reads varying texels
+		vector<uint32_t> pixels(ProbeSize * ProbeSize);
+		for (auto i = 0u; i < ProbeSize; ++i)
+			for (auto j = 0u; j < ProbeSize; ++j)
+				pixels[ProbeSize * i + j] = (j & 0xff) | ((i & 0xff) << 8) | (((i + j) & 0xff) << 16) | 0xff000000;
+
+		const texture<unorm4, 2> sourceTexture(ProbeSize, ProbeSize, pixels.data(),
+			static_cast<uint32_t>(sizeof(uint32_t) * pixels.size()), 8u, acceleratorView);
+		texture<unorm4, 2> resultTexture(ProbeSize, ProbeSize, 8u, acceleratorView);
+		const auto source = texture_view<const unorm4, 2>(sourceTexture);
+		const auto result = texture_view<unorm4, 2>(resultTexture);
+
+		const auto dispatch = [&]()
+		{
+			parallel_for_each(acceleratorView, result.extent, [=](const index<2>& idx) restrict(amp)
+			{
+				const uint2 xy(idx[1], idx[0]);
+				const uint2 imageSize(result.extent[1], result.extent[0]);
+				const auto uv = (float2(xy) + 0.5f) / float2(imageSize);
+
+				result.set(idx, ToGrey(source.sample(uv, 0.0f)));
+			});
+		};
+
+		// Warm up, so that the kernel compilation is not measured
+		dispatch();
+		acceleratorView.wait();
+
+		// Calibrate: double the dispatches until a run takes long enough to be timed reliably
+		auto numDispatches = 0u;
+		auto time = 0.0;
+		for (auto n = 1u; time < MinProbeTime && n <= 4096; n *= 2)
+		{
+			const auto startTime = chrono::steady_clock::now();
+			for (auto i = 0u; i < n; ++i) dispatch();
+			acceleratorView.wait();
+			time = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+			numDispatches = n;
+		}
+
+		return static_cast<double>(ProbeSize) * ProbeSize * numDispatches / (1000.0 * time);
+	}
+	catch (const runtime_exception& e)
+	{
+		cerr << "Failed to probe an adapter: " << e.what() << endl;
+
+		return 0.0;
+	}
+}
+
+const AdapterProbe::Result* AdapterProbe::FindCached(const Result& key) const
+{
+	for (const auto& result : m_cachedResults)
+		if (result.AdapterLuid.LowPart == key.AdapterLuid.LowPart &&
+			result.AdapterLuid.HighPart == key.AdapterLuid.HighPart &&
+			result.DriverVersion == key.DriverVersion &&
+			wcscmp(result.Description, key.Description) == 0)
+			return &result;
+
+	return nullptr;
+}
+
+bool AdapterProbe::LoadCache()
+{
+	m_cachedResults.clear();
+
+	ifstream file(m_cacheFileName, ios::binary | ios::ate);
+	XUSG_N_RETURN(file, false);
+	const auto fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	uint32_t header[3];
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	XUSG_N_RETURN(file && header[0] == g_probeCacheMagic && header[1] == g_probeCacheVersion, false);
+
+	// The count is only trusted if the results fill the rest of the file exactly, so that a
+	// truncated or corrupt cache is a miss rather than a huge allocation
+	XUSG_N_RETURN(fileSize == sizeof(header) + sizeof(Result) * static_cast<uint64_t>(header[2]), false);
+
+	m_cachedResults.resize(header[2]);
+	file.read(reinterpret_cast<char*>(m_cachedResults.data()), sizeof(Result) * m_cachedResults.size());
+	if (!file)
+	{
+		m_cachedResults.clear();
+
+		return false;
+	}
+
+	// Nor may a corrupt description be compared past its end
+	for (auto& result : m_cachedResults) result.Description[_countof(result.Description) - 1] = L'\0';
+
+	return true;
+}
+
+bool AdapterProbe::SaveCache() const
+{
+	ofstream file(m_cacheFileName, ios::binary | ios::trunc);
+	XUSG_M_RETURN(!file, cerr, "Failed to save the adapter probe cache.", false);
+
+	const uint32_t header[] = { g_probeCacheMagic, g_probeCacheVersion, static_cast<uint32_t>(m_results.size()) };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_results.data()), sizeof(Result) * m_results.size());
+
+	return true;
+}
@@ -0,0 +1,47 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Picks the adapter that runs the luma kernel the fastest, by timing a short, calibrated
+// AMP dispatch loop on each candidate through a DX11 device of its own. WARP is probed as
+// the CPU candidate. Results are cached on disk, keyed by the adapter LUID, description
+// and driver version, so later launches skip the probe until the adapters change.
+class AdapterProbe
+{
+public:
+	struct Result
+	{
+		LUID		AdapterLuid;
+		int64_t		DriverVersion;
+		double		Throughput;	// In MPix/s
+		wchar_t		Description[128];
+		bool		IsCached;
+	};
+
+	AdapterProbe();
+	virtual ~AdapterProbe();
+
+	bool Init(const char* cacheDir);
+
+	// Probes the adapters that are not in the cache, and returns the fastest one.
+	bool SelectFastest(IDXGIFactory1* pFactory, XUSG::com_ptr<IDXGIAdapter1>& adapter);
+
+	const std::vector<Result>& GetResults() const;
+	double GetProbeTime() const;	// In ms, excluding the cached adapters
+
+	static const uint32_t ProbeSize = 1024;
+	static const uint32_t MinProbeTime = 50;	// In ms
+
+protected:
+	double Measure(IDXGIAdapter1* pAdapter) const;
+	const Result* FindCached(const Result& key) const;
+	bool LoadCache();
+	bool SaveCache() const;
+
+	std::string				m_cacheFileName;
+	std::vector<Result>		m_cachedResults;
+	std::vector<Result>		m_results;
+	double					m_probeTime;
+};
@@ -4,10 +4,9 @@
 
 #include "DXFrameworkHelper.h"
 #include "Amp12.h"
-#include "AmpVecMath.h"
-
-#define _ENABLE_STB_IMAGE_LOADER_ONLY_
-#include "Advanced/XUSGTextureLoader.h"
+#include "LumaKernel.h"
+#include "Shaders/CSLuma.h"
+#include "Shaders/CSLumaToneMap.h"
 
 using namespace std;
 using namespace Concurrency;
@@ -17,9 +16,37 @@ using namespace Concurrency::graphics::direct3d;
 using namespace DirectX;
 using namespace XUSG;
 
+static bool IsFloatFormat(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+		return true;
+	default:
+		return false;
+	}
+}
+
 Amp12::Amp12(const accelerator_view& acceleratorView) :
 	m_acceleratorView(acceleratorView),
-	m_imageSize(1, 1)
+	m_stackFootprint(),
+	m_imageSize(1, 1),
+	m_viewScale(1.0f),
+	m_viewOffset(0.0f, 0.0f),
+	m_readSourceInShader(false),
+	m_toneMapInShader(false),
+	m_useFixedPointLuma(false)
 {
 	const auto pDevice = get_device(acceleratorView);
 	pDevice->QueryInterface<ID3D11Device1>(&m_device11);
@@ -31,48 +58,224 @@ Amp12::~Amp12()
 	amp_uninitialize();
 }
 
-bool Amp12::Init(CommandList* pCommandList,  vector<Resource::uptr>& uploaders,
-	Format rtFormat, const char* fileName, Texture::uptr* pSrcForNative11)
+bool Amp12::Init(CommandList* pCommandList, UploadRing& uploadRing,
+	Format rtFormat, ImageLoader& imageLoader, Texture::sptr* pSrcForNative11)
 {
 	const auto pDevice = pCommandList->GetDevice();
 	m_useNativeDX11 = pSrcForNative11 ? true : false;
-	auto& source = pSrcForNative11 ? *pSrcForNative11 : m_source;
+	m_readSourceInShader = false;
 
-	// Load input image
-	source = Texture::MakeUnique();
-	uploaders.emplace_back(Resource::MakeUnique());
-	XUSG_N_RETURN(CreateTextureFromFile(pCommandList, fileName, source.get(),
-		uploaders.back().get(), ResourceState::COMMON, MemoryFlag::SHARED, L"Source"), false);
+	// Return the textures of the previous image, if any, to the pool
+	m_texturePool.Release(m_source);
+	m_texturePool.Release(m_result);
+
+	// Take a pooled source of the image size and format; DDS sources come with their
+	// own mips from the DDS loader, so they are not pooled
+	XUSG_N_RETURN(imageLoader.Wait(), false);
+	if (imageLoader.IsDDS()) m_source = make_unique<TexturePool::Entry>();
+	else
+	{
+		TexturePool::Key key = { 0, 0, imageLoader.GetFormat(), ResourceFlag::NONE };
+		imageLoader.GetImageSize(key.Width, key.Height);
+		m_source = m_texturePool.Acquire(key);
+	}
+
+	// Upload the input image into the pooled source. In the native DX11 path, the image is
+	// uploaded to an intermediate texture instead, and then copied to the shared source.
+	auto& source = pSrcForNative11 ? *pSrcForNative11 : m_source->Texture12;
+	XUSG_N_RETURN(imageLoader.CreateTexture(pCommandList, source, uploadRing, m_useNativeDX11 ?
+		ResourceState::COMMON : ResourceState::NON_PIXEL_SHADER_RESOURCE, MemoryFlag::SHARED, L"Source"), false);
 
 	// Create resources
 	m_imageSize.x = static_cast<uint32_t>(source->GetWidth());
 	m_imageSize.y = source->GetHeight();
+	XUSG_N_RETURN(CreateResources(pDevice, source->GetFormat(), source->GetNumMips(), rtFormat), false);
+
+	if (m_useNativeDX11)
+	{
+		ResourceBarrier barrier;
+		const auto pSource = m_source->Texture12.get();
+		auto numBarriers = pSource->SetBarrier(&barrier, ResourceState::COPY_DEST);
+		pCommandList->Barrier(numBarriers, &barrier);
+		pCommandList->CopyResource(pSource, source.get());
+		numBarriers = pSource->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+		pCommandList->Barrier(numBarriers, &barrier);
+	}
+
+	return true;
+}
+
+bool Amp12::InitAtlas(const Device* pDevice, uint32_t width, uint32_t height, Format rtFormat, bool useNativeDX11)
+{
+	m_useNativeDX11 = useNativeDX11;
+	m_readSourceInShader = false;
+	m_imageSize.x = width;
+	m_imageSize.y = height;
+
+	// Return the textures of the previous image, if any, to the pool
+	m_texturePool.Release(m_source);
+	m_texturePool.Release(m_result);
+
+	// The atlas is uploaded by the caller straight into the source, in either path
+	m_source = m_texturePool.Acquire({ width, height, Format::R8G8B8A8_UNORM, ResourceFlag::NONE });
+	if (!m_useNativeDX11 && !m_source->Texture12)
+	{
+		m_source->Texture12 = Texture::MakeShared();
+		XUSG_N_RETURN(m_source->Texture12->Create(pDevice, width, height, Format::R8G8B8A8_UNORM, 1,
+			ResourceFlag::NONE, 1, 1, false, MemoryFlag::SHARED, L"Atlas"), false);
+	}
+
+	return CreateResources(pDevice, Format::R8G8B8A8_UNORM, 1, rtFormat);
+}
+
+bool Amp12::InitSequence(const Device* pDevice, uint32_t width, uint32_t height, Format rtFormat,
+	Texture::sptr* pFrameSources, uint8_t numFrameSources)
+{
+	assert(numFrameSources > 0 && numFrameSources <= MaxFrameSourceCount);
+	m_useNativeDX11 = false;
+	m_readSourceInShader = false;
+	m_imageSize.x = width;
+	m_imageSize.y = height;
+
+	// Create resources
+	m_texturePool.Release(m_result);
+	m_result = m_texturePool.Acquire({ m_imageSize.x, m_imageSize.y, rtFormat,
+		ResourceFlag::ALLOW_UNORDERED_ACCESS | ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS });
+	if (!m_result->Texture12)
+	{
+		m_result->Texture12 = Texture::MakeShared();
+		XUSG_N_RETURN(m_result->Texture12->Create(pDevice, m_imageSize.x, m_imageSize.y, rtFormat, 1,
+			ResourceFlag::ALLOW_UNORDERED_ACCESS | ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS,
+			1, 1, false, MemoryFlag::SHARED, L"Result"), false);
+	}
 
+	// Wrap DX11 and AMP resources; the frame sources are uploaded on a copy queue,
+	// so they stay in the common state outside of the processing
+	com_ptr<ID3D11On12Device> device11On12;
+	m_device11->QueryInterface<ID3D11On12Device>(&device11On12);
+	D3D11_RESOURCE_FLAGS dx11ResourceFlags = { D3D11_BIND_SHADER_RESOURCE };
+	dx11ResourceFlags.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+	for (uint8_t i = 0; i < numFrameSources; ++i)
+	{
+		auto& frameSource = m_frameSources[i];
+		frameSource = make_unique<TexturePool::Entry>();
+		frameSource->Texture12 = Texture::MakeShared();
+		XUSG_N_RETURN(frameSource->Texture12->Create(pDevice, m_imageSize.x, m_imageSize.y, Format::R8G8B8A8_UNORM, 1,
+			ResourceFlag::NONE, 1, 1, false, MemoryFlag::SHARED, (L"FrameSource" + to_wstring(i)).c_str()), false);
+		pFrameSources[i] = frameSource->Texture12;
+
+		if (FAILED(device11On12->CreateWrappedResource(reinterpret_cast<IUnknown*>(frameSource->Texture12->GetHandle()),
+			&dx11ResourceFlags, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COMMON,
+			IID_PPV_ARGS(&frameSource->Texture11))))
+			return false;
+
+		frameSource->AMP = make_unique<texture<unorm4, 2>>(make_texture<unorm4, 2>(m_acceleratorView, frameSource->Texture11.get()));
+	}
+
+	dx11ResourceFlags.BindFlags |= D3D11_BIND_UNORDERED_ACCESS;
+	if (!m_result->Texture11 && FAILED(device11On12->CreateWrappedResource(
+		reinterpret_cast<IUnknown*>(m_result->Texture12->GetHandle()),
+		&dx11ResourceFlags, D3D12_RESOURCE_STATE_COPY_SOURCE,
+		D3D12_RESOURCE_STATE_COPY_SOURCE, IID_PPV_ARGS(&m_result->Texture11))))
+		return false;
+	if (!m_result->AMP) m_result->AMP = make_unique<texture<unorm4, 2>>(
+		make_texture<unorm4, 2>(m_acceleratorView, m_result->Texture11.get()));
+
+	ResourceBarrier barrier;
+	m_result->Texture12->SetBarrier(&barrier, ResourceState::COPY_SOURCE);
+
+	return true;
+}
+
+bool Amp12::InitStack(const Device* pDevice, uint32_t width, uint32_t height, uint16_t depth,
+	Format format, Format rtFormat)
+{
+	m_useNativeDX11 = false;
+	m_imageSize.x = width;
+	m_imageSize.y = height;
+
+	// Keep the stack textures, if the shape is unchanged
+	if (m_stackSource && m_stackSource->GetWidth() == width && m_stackSource->GetHeight() == height &&
+		m_stackSource->GetDepth() == depth && m_stackSource->GetFormat() == format &&
+		m_stackResult->GetFormat() == rtFormat)
+		return true;
+
+	m_stackSourceAMP.reset();
+	m_stackResultAMP.reset();
+	m_stackSource11 = nullptr;
+	m_stackResult11 = nullptr;
+
+	// Create resources
+	m_stackSource = Texture3D::MakeUnique();
+	XUSG_N_RETURN(m_stackSource->Create(pDevice, width, height, depth, format, ResourceFlag::NONE,
+		1, MemoryFlag::SHARED, L"StackSource"), false);
+
+	m_stackResult = Texture3D::MakeUnique();
+	XUSG_N_RETURN(m_stackResult->Create(pDevice, width, height, depth, rtFormat,
+		ResourceFlag::ALLOW_UNORDERED_ACCESS | ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS,
+		1, MemoryFlag::SHARED, L"StackResult"), false);
+
+	// The read-back buffer holds the whole result in its placed footprint
+	const auto pDevice12 = static_cast<ID3D12Device*>(pDevice->GetHandle());
+	const auto desc = static_cast<ID3D12Resource*>(m_stackResult->GetHandle())->GetDesc();
+	uint64_t readBufferSize;
+	pDevice12->GetCopyableFootprints(&desc, 0, 1, 0, &m_stackFootprint, nullptr, nullptr, &readBufferSize);
+	m_stackReadBuffer = Buffer::MakeUnique();
+	XUSG_N_RETURN(m_stackReadBuffer->Create(pDevice, static_cast<size_t>(readBufferSize), ResourceFlag::NONE,
+		MemoryType::READBACK, 0, nullptr, 0, nullptr, MemoryFlag::NONE, L"StackReadBuffer"), false);
+
+	// Wrap DX11 and AMP resources
+	com_ptr<ID3D11On12Device> device11On12;
+	m_device11->QueryInterface<ID3D11On12Device>(&device11On12);
+	D3D11_RESOURCE_FLAGS dx11ResourceFlags = { D3D11_BIND_SHADER_RESOURCE };
+	dx11ResourceFlags.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+	if (FAILED(device11On12->CreateWrappedResource(reinterpret_cast<IUnknown*>(m_stackSource->GetHandle()),
+		&dx11ResourceFlags, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, IID_PPV_ARGS(&m_stackSource11))))
+		return false;
+
+	dx11ResourceFlags.BindFlags |= D3D11_BIND_UNORDERED_ACCESS;
+	if (FAILED(device11On12->CreateWrappedResource(reinterpret_cast<IUnknown*>(m_stackResult->GetHandle()),
+		&dx11ResourceFlags, D3D12_RESOURCE_STATE_COPY_SOURCE,
+		D3D12_RESOURCE_STATE_COPY_SOURCE, IID_PPV_ARGS(&m_stackResult11))))
+		return false;
+
+	m_stackSourceAMP = make_unique<texture<unorm4, 3>>(make_texture<unorm4, 3>(m_acceleratorView, m_stackSource11.get()));
+	m_stackResultAMP = make_unique<texture<unorm4, 3>>(make_texture<unorm4, 3>(m_acceleratorView, m_stackResult11.get()));
+
+	ResourceBarrier barrier;
+	m_stackResult->SetBarrier(&barrier, ResourceState::COPY_SOURCE);
+
+	return true;
+}
+
+bool Amp12::CreateResources(const Device* pDevice, Format sourceFormat, uint8_t numSourceMips, Format rtFormat)
+{
 	auto resourceFlags = ResourceFlag::ALLOW_UNORDERED_ACCESS | ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS;
 	resourceFlags |= m_useNativeDX11 ? ResourceFlag::ALLOW_RENDER_TARGET : ResourceFlag::NONE;
-	m_result = Texture2D::MakeUnique();
-	XUSG_N_RETURN(m_result->Create(pDevice, m_imageSize.x, m_imageSize.y, rtFormat, 1,
-		resourceFlags, 1, 1, false, MemoryFlag::SHARED, L"Result"), false);
+	m_result = m_texturePool.Acquire({ m_imageSize.x, m_imageSize.y, rtFormat, resourceFlags });
+	XUSG_N_RETURN(CreateResult(pDevice, *m_result, rtFormat, L"Result"), false);
 
-	// Wrap DX11 resources
+	// Wrap DX11 resources; the pooled ones are already wrapped
 	if (m_useNativeDX11)
 	{
 		const auto pDevice12 = static_cast<ID3D12Device*>(pDevice->GetHandle());
 
 		// DX12 resource shared to native DX11 only supports resources with ALLOW_RENDER_TARGET
 		// So, we create a DX11 resource shared to DX12, and then copy the source data to it
-		CD3D11_TEXTURE2D_DESC texDesc(static_cast<DXGI_FORMAT>(source->GetFormat()), m_imageSize.x, m_imageSize.y,
-			1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT, 0, 1);
-		texDesc.MiscFlags = D3D11_RESOURCE_MISC_SHARED | D3D11_RESOURCE_MISC_SHARED_NTHANDLE;
-		XUSG_M_RETURN(FAILED(m_device11->CreateTexture2D(&texDesc, nullptr, &m_source11)),
-			cerr, "Failed to create DX11 resource.", false);
-
-		// Share the DX11 resource to DX12
+		if (!m_source->Texture11)
 		{
+			CD3D11_TEXTURE2D_DESC texDesc(static_cast<DXGI_FORMAT>(sourceFormat), m_imageSize.x, m_imageSize.y,
+				1, numSourceMips, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT, 0, 1);
+			texDesc.MiscFlags = D3D11_RESOURCE_MISC_SHARED | D3D11_RESOURCE_MISC_SHARED_NTHANDLE;
+			XUSG_M_RETURN(FAILED(m_device11->CreateTexture2D(&texDesc, nullptr, &m_source->Texture11)),
+				cerr, "Failed to create DX11 resource.", false);
+
+			// Share the DX11 resource to DX12
 			// Create a DX11 shared resource handle
 			HANDLE hResource;
 			com_ptr<IDXGIResource1> resourceDXGI;
-			XUSG_M_RETURN(FAILED(m_source11.As(&resourceDXGI)), cerr, "Failed to query DXGI resource.", false);
+			XUSG_M_RETURN(FAILED(m_source->Texture11.As(&resourceDXGI)), cerr, "Failed to query DXGI resource.", false);
 			XUSG_M_RETURN(FAILED(resourceDXGI->CreateSharedHandle(nullptr, DXGI_SHARED_RESOURCE_READ |
 				DXGI_SHARED_RESOURCE_WRITE, nullptr, &hResource)), cerr, "Failed to share Source.", false);
 
@@ -80,20 +283,8 @@ bool Amp12::Init(CommandList* pCommandList,  vector<Resource::uptr>& uploaders,
 			com_ptr<ID3D12Resource> resource12;
 			XUSG_M_RETURN(FAILED(pDevice12->OpenSharedHandle(hResource, IID_PPV_ARGS(&resource12))),
 				cerr, "Failed to open shared Source on DX12.", false);
-			m_source = Texture::MakeUnique();
-			m_source->Create(pDevice12, resource12.get());
-		}
-
-		// Share the DX12 resource to DX11
-		{
-			// Create a DX12 shared resource handle
-			HANDLE hResource;
-			XUSG_M_RETURN(FAILED(pDevice12->CreateSharedHandle(static_cast<ID3D12Resource*>(m_result->GetHandle()),
-				nullptr, GENERIC_ALL, nullptr, &hResource)), cerr, "Failed to share Result.", false);
-
-			// Open the resource handle on DX11
-			XUSG_M_RETURN(FAILED(m_device11->OpenSharedResource1(hResource, IID_PPV_ARGS(&m_result11))),
-				cerr, "Failed to open shared Result on DX11.", false);
+			m_source->Texture12 = Texture::MakeShared();
+			m_source->Texture12->Create(pDevice12, resource12.get());
 		}
 	}
 	else
@@ -103,48 +294,376 @@ bool Amp12::Init(CommandList* pCommandList,  vector<Resource::uptr>& uploaders,
 		m_device11->QueryInterface<ID3D11On12Device>(&device11On12);
 		D3D11_RESOURCE_FLAGS dx11ResourceFlags = { D3D11_BIND_SHADER_RESOURCE };
 		dx11ResourceFlags.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
-		if (FAILED(device11On12->CreateWrappedResource(reinterpret_cast<IUnknown*>(m_source->GetHandle()),
+		if (!m_source->Texture11 && FAILED(device11On12->CreateWrappedResource(
+			reinterpret_cast<IUnknown*>(m_source->Texture12->GetHandle()),
 			&dx11ResourceFlags, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, IID_PPV_ARGS(&m_source11))))
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, IID_PPV_ARGS(&m_source->Texture11))))
 			return false;
+	}
 
-		dx11ResourceFlags.BindFlags |= D3D11_BIND_UNORDERED_ACCESS;
-		if (FAILED(device11On12->CreateWrappedResource(reinterpret_cast<IUnknown*>(m_result->GetHandle()),
-			&dx11ResourceFlags, D3D12_RESOURCE_STATE_COPY_SOURCE,
-			D3D12_RESOURCE_STATE_COPY_SOURCE, IID_PPV_ARGS(&m_result11))))
-			return false;
+	// Wrap AMP resources; the source formats that AMP cannot wrap, such as the block-compressed
+	// ones, are read by a DX11 compute shader instead
+	const auto sourceFormat11 = static_cast<DXGI_FORMAT>(sourceFormat);
+	switch (sourceFormat11)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+		if (!m_source->AMP) m_source->AMP = make_unique<texture<unorm4, 2>>(
+			make_texture<unorm4, 2>(m_acceleratorView, m_source->Texture11.get()));
+		break;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		if (!m_source->AMPF) m_source->AMPF = make_unique<texture<float4, 2>>(
+			make_texture<float4, 2>(m_acceleratorView, m_source->Texture11.get()));
+		break;
+	default:
+		m_readSourceInShader = true;
+		XUSG_N_RETURN(CreateShaderReadPath(IsFloatFormat(sourceFormat11)), false);
 	}
 
-	// Wrap AMP resources
-	m_sourceAMP = make_unique<texture<unorm4, 2>>(make_texture<unorm4, 2>(m_acceleratorView, m_source11.get()));
-	m_resultAMP = make_unique<texture<unorm4, 2>>(make_texture<unorm4, 2>(m_acceleratorView, m_result11.get()));
+	return true;
+}
 
-	ResourceBarrier barrier;
-	m_result->SetBarrier(&barrier, ResourceState::COPY_SOURCE);
-	if (m_useNativeDX11)
+bool Amp12::CreateResult(const Device* pDevice, TexturePool::Entry& result, Format rtFormat, const wchar_t* name)
+{
+	if (!result.Texture12)
 	{
-		auto numBarriers = m_source->SetBarrier(&barrier, ResourceState::COPY_DEST);
-		pCommandList->Barrier(numBarriers, &barrier);
-		pCommandList->CopyResource(m_source.get(), source.get());
-		numBarriers = m_source->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);
-		pCommandList->Barrier(numBarriers, &barrier);
+		result.Texture12 = Texture::MakeShared();
+		XUSG_N_RETURN(result.Texture12->Create(pDevice, result.Id.Width, result.Id.Height, rtFormat, 1,
+			result.Id.Flags, 1, 1, false, MemoryFlag::SHARED, name), false);
+	}
+
+	// Wrap DX11 resources; the pooled ones are already wrapped
+	if (!result.Texture11)
+	{
+		if (m_useNativeDX11)
+		{
+			// Share the DX12 resource to DX11
+			// Create a DX12 shared resource handle
+			const auto pDevice12 = static_cast<ID3D12Device*>(pDevice->GetHandle());
+			HANDLE hResource;
+			XUSG_M_RETURN(FAILED(pDevice12->CreateSharedHandle(static_cast<ID3D12Resource*>(result.Texture12->GetHandle()),
+				nullptr, GENERIC_ALL, nullptr, &hResource)), cerr, "Failed to share Result.", false);
+
+			// Open the resource handle on DX11
+			XUSG_M_RETURN(FAILED(m_device11->OpenSharedResource1(hResource, IID_PPV_ARGS(&result.Texture11))),
+				cerr, "Failed to open shared Result on DX11.", false);
+		}
+		else
+		{
+			com_ptr<ID3D11On12Device> device11On12;
+			m_device11->QueryInterface<ID3D11On12Device>(&device11On12);
+			D3D11_RESOURCE_FLAGS dx11ResourceFlags = { D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS };
+			dx11ResourceFlags.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+			if (FAILED(device11On12->CreateWrappedResource(reinterpret_cast<IUnknown*>(result.Texture12->GetHandle()),
+				&dx11ResourceFlags, D3D12_RESOURCE_STATE_COPY_SOURCE,
+				D3D12_RESOURCE_STATE_COPY_SOURCE, IID_PPV_ARGS(&result.Texture11))))
+				return false;
+		}
 	}
 
+	if (!result.AMP) result.AMP = make_unique<texture<unorm4, 2>>(
+		make_texture<unorm4, 2>(m_acceleratorView, result.Texture11.get()));
+
+	ResourceBarrier barrier;
+	result.Texture12->SetBarrier(&barrier, ResourceState::COPY_SOURCE);
+
 	return true;
 }
 
+bool Amp12::InitView(const Device* pDevice, uint32_t width, uint32_t height, Format rtFormat)
+{
+	auto resourceFlags = ResourceFlag::ALLOW_UNORDERED_ACCESS | ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS;
+	resourceFlags |= m_useNativeDX11 ? ResourceFlag::ALLOW_RENDER_TARGET : ResourceFlag::NONE;
+	m_texturePool.Release(m_view);
+	m_view = m_texturePool.Acquire({ width, height, rtFormat, resourceFlags });
+	XUSG_N_RETURN(CreateResult(pDevice, *m_view, rtFormat, L"ViewResult"), false);
+
+	// Fit the image into the view, keeping its aspect ratio
+	m_viewScale = (max)(m_imageSize.x / static_cast<float>(width), m_imageSize.y / static_cast<float>(height));
+	m_viewOffset.x = (width - m_imageSize.x / m_viewScale) / 2.0f;
+	m_viewOffset.y = (height - m_imageSize.y / m_viewScale) / 2.0f;
+
+	return true;
+}
+
+void Amp12::SetFixedPointLuma(bool useFixedPointLuma)
+{
+	m_useFixedPointLuma = useFixedPointLuma;
+}
+
 void Amp12::Process()
+{
+	ProcessSource(*m_source);
+}
+
+void Amp12::Process(const RECT* pRects, uint32_t numRects)
+{
+	ProcessSource(*m_source, pRects, numRects);
+}
+
+void Amp12::ProcessFrame(uint8_t frameSource)
+{
+	ProcessSource(*m_frameSources[frameSource]);
+}
+
+void Amp12::ProcessFrame(uint8_t frameSource, const RECT* pRects, uint32_t numRects)
+{
+	ProcessSource(*m_frameSources[frameSource], pRects, numRects);
+}
+
+void Amp12::ProcessStack(uint16_t numSlices)
 {
 	com_ptr<ID3D11On12Device> device11On12;
-	ID3D11Resource* const pResources11[] = { m_source11.get(), m_result11.get() };
+	m_device11->QueryInterface<ID3D11On12Device>(&device11On12);
+	ID3D11Resource* const pResources11[] = { m_stackSource11.get(), m_stackResult11.get() };
+	device11On12->AcquireWrappedResources(pResources11, static_cast<uint32_t>(size(pResources11)));
+
+	const auto source = texture_view<const unorm4, 3>(*m_stackSourceAMP);
+	const auto result = texture_view<unorm4, 3>(*m_stackResultAMP);
+
+	// Only the filled slices are processed; each slice is sampled at its texel centers,
+	// so that the neighboring images never blend in
+	const extent<3> stackExtent(numSlices, result.extent[1], result.extent[2]);
+	if (m_useFixedPointLuma)
+	{
+		parallel_for_each(stackExtent, [=](const index<3>& idx) restrict(amp)
+			{
+				result.set(idx, ToGreyFixed(source[idx]));
+			}
+		);
+	}
+	else
+	{
+		parallel_for_each(stackExtent, [=](const index<3>& idx) restrict(amp)
+			{
+				const uint3 xyz(idx[2], idx[1], idx[0]);
+				const uint3 stackSize(result.extent[2], result.extent[1], result.extent[0]);
+				const auto uvw = (float3(xyz) + 0.5f) / float3(stackSize);
+
+				result.set(idx, ToGrey(source.sample(uvw, 0.0f)));
+			}
+		);
+	}
+
+	// Submit the work to the DX12 queue, which only happens on a flush under 11on12
+	device11On12->ReleaseWrappedResources(pResources11, static_cast<uint32_t>(size(pResources11)));
+	com_ptr<ID3D11DeviceContext> context;
+	m_device11->GetImmediateContext(&context);
+	context->Flush();
+}
+
+void Amp12::ProcessSource(const TexturePool::Entry& source, const RECT* pViewRects, uint32_t numViewRects)
+{
+	// Clip the regions to the view
+	vector<RECT> viewRects;
+	if (pViewRects)
+	{
+		const RECT viewBounds = { 0, 0, static_cast<LONG>(m_view->Id.Width), static_cast<LONG>(m_view->Id.Height) };
+		for (auto i = 0u; i < numViewRects; ++i)
+		{
+			RECT viewRect;
+			if (IntersectRect(&viewRect, &pViewRects[i], &viewBounds)) viewRects.emplace_back(viewRect);
+		}
+		if (viewRects.empty()) return;
+	}
+
+	com_ptr<ID3D11On12Device> device11On12;
+	ID3D11Resource* const pResources11[] = { source.Texture11.get(), m_result->Texture11.get(),
+		pViewRects ? m_view->Texture11.get() : nullptr };
+	const auto numResources = pViewRects ? 3u : 2u;
 	if (!m_useNativeDX11)
 	{
 		m_device11->QueryInterface<ID3D11On12Device>(&device11On12);
-		device11On12->AcquireWrappedResources(pResources11, static_cast<uint32_t>(size(pResources11)));
+		device11On12->AcquireWrappedResources(pResources11, numResources);
+	}
+
+	if (pViewRects)
+	{
+		// The formats that AMP cannot wrap are processed in full by the shader first, and only
+		// resampled into the view; the luma of a grey texel is the grey itself
+		if (m_readSourceInShader) ProcessInShader(source);
+		for (const auto& viewRect : viewRects)
+		{
+			if (m_readSourceInShader) ProcessView(*m_result->AMP, viewRect);
+			else if (source.AMPF) ProcessView(*source.AMPF, viewRect);
+			else if (m_useFixedPointLuma) ProcessViewFixed(*source.AMP, viewRect);
+			else ProcessView(*source.AMP, viewRect);
+		}
 	}
+	else if (m_readSourceInShader) ProcessInShader(source);
+	else if (source.AMPF) ProcessAMP(*source.AMPF);
+	else if (m_useFixedPointLuma) ProcessAMPFixed(*source.AMP);
+	else ProcessAMP(*source.AMP);
+
+	// Submit the work to the DX12 queue, which only happens on a flush under 11on12
+	if (!m_useNativeDX11)
+	{
+		device11On12->ReleaseWrappedResources(pResources11, numResources);
+		com_ptr<ID3D11DeviceContext> context;
+		m_device11->GetImmediateContext(&context);
+		context->Flush();
+	}
+}
+
+bool Amp12::UpdateSource(CommandList* pCommandList, UploadRing& uploadRing, const void* pData,
+	uint32_t rowPitch, const RECT& rect)
+{
+	const auto pSource = m_source->Texture12.get();
+	const auto pSource12 = static_cast<ID3D12Resource*>(pSource->GetHandle());
+
+	// Lay out the region like a texture of its own
+	auto desc = pSource12->GetDesc();
+	desc.Width = rect.right - rect.left;
+	desc.Height = rect.bottom - rect.top;
+	desc.MipLevels = 1;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	uint32_t numRows;
+	uint64_t rowSize, uploadSize;
+	const auto pDevice12 = static_cast<ID3D12Device*>(pCommandList->GetDevice()->GetHandle());
+	pDevice12->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, &numRows, &rowSize, &uploadSize);
+
+	UploadRing::Allocation allocation;
+	XUSG_M_RETURN(!uploadRing.Allocate(uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation),
+		cerr, "Failed to allocate upload memory.", false);
+	const auto pSrc = static_cast<const uint8_t*>(pData);
+	for (auto i = 0u; i < numRows; ++i)
+		memcpy(&allocation.pData[footprint.Footprint.RowPitch * i], &pSrc[static_cast<size_t>(rowPitch) * i],
+			static_cast<size_t>(rowSize));
+
+	ResourceBarrier barrier;
+	auto numBarriers = pSource->SetBarrier(&barrier, ResourceState::COPY_DEST);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	D3D12_TEXTURE_COPY_LOCATION dst = {};
+	dst.pResource = pSource12;
+	dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	dst.SubresourceIndex = 0;
+
+	D3D12_TEXTURE_COPY_LOCATION src = {};
+	src.pResource = static_cast<ID3D12Resource*>(allocation.pResource->GetHandle());
+	src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	src.PlacedFootprint = footprint;
+	src.PlacedFootprint.Offset += allocation.Offset;
+
+	const auto pCommandList12 = static_cast<ID3D12GraphicsCommandList*>(pCommandList->GetHandle());
+	pCommandList12->CopyTextureRegion(&dst, rect.left, rect.top, 0, &src, nullptr);
+
+	// Back to the state that the 11on12 wrapper expects
+	numBarriers = pSource->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	return true;
+}
+
+RECT Amp12::GetViewRect(const RECT& imageRect) const
+{
+	// The taps of a view pixel reach up to a texel beyond its footprint
+	RECT viewRect;
+	viewRect.left = static_cast<LONG>(floor((imageRect.left - 1) / m_viewScale + m_viewOffset.x));
+	viewRect.top = static_cast<LONG>(floor((imageRect.top - 1) / m_viewScale + m_viewOffset.y));
+	viewRect.right = static_cast<LONG>(ceil((imageRect.right + 1) / m_viewScale + m_viewOffset.x));
+	viewRect.bottom = static_cast<LONG>(ceil((imageRect.bottom + 1) / m_viewScale + m_viewOffset.y));
+
+	return viewRect;
+}
+
+bool Amp12::GetImagePosition(float x, float y, uint32_t& imageX, uint32_t& imageY) const
+{
+	const auto u = (x + 0.5f - m_viewOffset.x) * m_viewScale;
+	const auto v = (y + 0.5f - m_viewOffset.y) * m_viewScale;
+	if (u < 0.0f || v < 0.0f || u >= m_imageSize.x || v >= m_imageSize.y) return false;
+
+	imageX = static_cast<uint32_t>(u);
+	imageY = static_cast<uint32_t>(v);
+
+	return true;
+}
+
+void Amp12::GetImageSize(uint32_t& width, uint32_t& height) const
+{
+	width = m_imageSize.x;
+	height = m_imageSize.y;
+}
+
+Format Amp12::GetSourceFormat() const
+{
+	return m_source->Texture12->GetFormat();
+}
+
+const Texture2D* Amp12::GetResult() const
+{
+	return m_result->Texture12.get();
+}
+
+const Texture2D* Amp12::GetViewResult() const
+{
+	return m_view ? m_view->Texture12.get() : nullptr;
+}
+
+float Amp12::GetViewScale() const
+{
+	return m_viewScale;
+}
+
+bool Amp12::ReadBackResult(CommandList* pCommandList, Buffer* pReadBuffer, uint32_t* pRowPitch)
+{
+	// Keep the result in the state that its 11on12 wrapper expects
+	return m_result->Texture12->ReadBack(pCommandList, pReadBuffer, pRowPitch, 1, 0, 0, ResourceState::COPY_SOURCE);
+}
+
+Texture* Amp12::GetSource() const
+{
+	return m_source->Texture12.get();
+}
+
+const TexturePool& Amp12::GetTexturePool() const
+{
+	return m_texturePool;
+}
 
-	const auto source = texture_view<const unorm4, 2>(*m_sourceAMP);
-	const auto result = texture_view<unorm4, 2>(*m_resultAMP);
+Texture3D* Amp12::GetStackSource() const
+{
+	return m_stackSource.get();
+}
+
+void Amp12::ReadBackStack(CommandList* pCommandList, uint16_t numSlices)
+{
+	// The result stays in the state that its 11on12 wrapper expects
+	D3D12_TEXTURE_COPY_LOCATION dst = {};
+	dst.pResource = static_cast<ID3D12Resource*>(m_stackReadBuffer->GetHandle());
+	dst.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	dst.PlacedFootprint = m_stackFootprint;
+
+	D3D12_TEXTURE_COPY_LOCATION src = {};
+	src.pResource = static_cast<ID3D12Resource*>(m_stackResult->GetHandle());
+	src.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	src.SubresourceIndex = 0;
+
+	const D3D12_BOX srcBox = { 0, 0, 0, m_imageSize.x, m_imageSize.y, numSlices };
+	const auto pCommandList12 = static_cast<ID3D12GraphicsCommandList*>(pCommandList->GetHandle());
+	pCommandList12->CopyTextureRegion(&dst, 0, 0, 0, &src, &srcBox);
+}
+
+const uint8_t* Amp12::MapStackResult(uint32_t& rowPitch, uint64_t& slicePitch)
+{
+	rowPitch = m_stackFootprint.Footprint.RowPitch;
+	slicePitch = static_cast<uint64_t>(rowPitch) * m_stackFootprint.Footprint.Height;
+	const auto pData = static_cast<const uint8_t*>(m_stackReadBuffer->Map());
+
+	return pData ? &pData[m_stackFootprint.Offset] : nullptr;
+}
+
+void Amp12::UnmapStackResult()
+{
+	m_stackReadBuffer->Unmap();
+}
+
+template<typename T>
+void Amp12::ProcessAMP(const texture<T, 2>& sourceTexture)
+{
+	const auto source = texture_view<const T, 2>(sourceTexture);
+	const auto result = texture_view<unorm4, 2>(*m_result->AMP);
 
 	parallel_for_each(
 		// Define the compute domain, which is the set of threads that are created.
@@ -156,24 +675,175 @@ void Amp12::Process()
 			const uint2 imageSize(result.extent[1], result.extent[0]);
 			const auto uv = (float2(xy) + 0.5f) / float2(imageSize);
 
-			const auto src = source.sample(uv, 0.0f);
-			const auto dst = dot(src.xyz, unorm3(0.299f, 0.587f, 0.114f));
+			result.set(idx, ToGrey(source.sample(uv, 0.0f)));
+		}
+	);
+}
+
+template<typename T>
+void Amp12::ProcessView(const texture<T, 2>& sourceTexture, const RECT& rect)
+{
+	const auto source = texture_view<const T, 2>(sourceTexture);
+	const auto result = texture_view<unorm4, 2>(*m_view->AMP);
+
+	// One tap per 2 texels of the footprint on each axis, since each bilinear tap averages 2 x 2
+	const auto scale = m_viewScale;
+	const float2 offset(m_viewOffset.x, m_viewOffset.y);
+	const float2 imageSize(static_cast<float>(m_imageSize.x), static_cast<float>(m_imageSize.y));
+	const auto numTaps = (min)((max)(static_cast<int32_t>(ceil(scale / 2.0f)), 1), MaxViewTaps);
+
+	const index<2> origin(rect.top, rect.left);
+	parallel_for_each(
+		// Only the threads of the region are created
+		extent<2>(rect.bottom - rect.top, rect.right - rect.left),
+		[=](const index<2>& regionIdx) restrict(amp)
+		{
+			const auto idx = regionIdx + origin;
+			const float2 xy(static_cast<float>(idx[1]), static_cast<float>(idx[0]));
+
+			// Letterbox outside of the image
+			const auto center = (xy + 0.5f - offset) * scale;
+			if (center.x < 0.0f || center.y < 0.0f || center.x >= imageSize.x || center.y >= imageSize.y)
+			{
+				result.set(idx, unorm4(0.0f, 0.0f, 0.0f, 1.0f));
+				return;
+			}
+
+			// Average the taps over the footprint of the view pixel
+			auto luma = 0.0f, alpha = 0.0f;
+			for (auto i = 0; i < numTaps; ++i)
+			{
+				for (auto j = 0; j < numTaps; ++j)
+				{
+					const auto tap = (xy - offset + (float2(static_cast<float>(j), static_cast<float>(i)) + 0.5f) /
+						static_cast<float>(numTaps)) * scale;
+					const auto grey = ToGrey(source.sample(tap / imageSize, 0.0f));
+					luma += grey.x;
+					alpha += grey.w;
+				}
+			}
+			const auto weight = 1.0f / static_cast<float>(numTaps * numTaps);
+
+			result.set(idx, unorm4(luma * weight, luma * weight, luma * weight, alpha * weight));
+		}
+	);
+}
+
+void Amp12::ProcessAMPFixed(const texture<unorm4, 2>& sourceTexture)
+{
+	const auto source = texture_view<const unorm4, 2>(sourceTexture);
+	const auto result = texture_view<unorm4, 2>(*m_result->AMP);
 
-			result.set(idx, unorm4(dst, dst, dst, src.w));
+	// The source and the result are of the same size, so each thread loads its own texel
+	parallel_for_each(result.extent, [=](const index<2>& idx) restrict(amp)
+		{
+			result.set(idx, ToGreyFixed(source[idx]));
 		}
 	);
+}
 
-	if (!m_useNativeDX11)
-		device11On12->ReleaseWrappedResources(pResources11, static_cast<uint32_t>(size(pResources11)));
+void Amp12::ProcessViewFixed(const texture<unorm4, 2>& sourceTexture, const RECT& rect)
+{
+	const auto source = texture_view<const unorm4, 2>(sourceTexture);
+	const auto result = texture_view<unorm4, 2>(*m_view->AMP);
+
+	// The same taps as ProcessView(), each loading the texel it falls in
+	const auto scale = m_viewScale;
+	const float2 offset(m_viewOffset.x, m_viewOffset.y);
+	const float2 imageSize(static_cast<float>(m_imageSize.x), static_cast<float>(m_imageSize.y));
+	const auto maxX = static_cast<int32_t>(m_imageSize.x) - 1;
+	const auto maxY = static_cast<int32_t>(m_imageSize.y) - 1;
+	const auto numTaps = (min)((max)(static_cast<int32_t>(ceil(scale / 2.0f)), 1), MaxViewTaps);
+
+	const index<2> origin(rect.top, rect.left);
+	parallel_for_each(
+		extent<2>(rect.bottom - rect.top, rect.right - rect.left),
+		[=](const index<2>& regionIdx) restrict(amp)
+		{
+			const auto idx = regionIdx + origin;
+			const float2 xy(static_cast<float>(idx[1]), static_cast<float>(idx[0]));
+
+			// Letterbox outside of the image
+			const auto center = (xy + 0.5f - offset) * scale;
+			if (center.x < 0.0f || center.y < 0.0f || center.x >= imageSize.x || center.y >= imageSize.y)
+			{
+				result.set(idx, unorm4(0.0f, 0.0f, 0.0f, 1.0f));
+				return;
+			}
+
+			// Average the fixed-point luma of the taps in integers, rounding to nearest
+			auto luma = 0u, alpha = 0u;
+			for (auto i = 0; i < numTaps; ++i)
+			{
+				for (auto j = 0; j < numTaps; ++j)
+				{
+					const auto tap = (xy - offset + (float2(static_cast<float>(j), static_cast<float>(i)) + 0.5f) /
+						static_cast<float>(numTaps)) * scale;
+					const auto texel = source[index<2>(clamp(static_cast<int32_t>(tap.y), 0, maxY),
+						clamp(static_cast<int32_t>(tap.x), 0, maxX))];
+					luma += ToLumaFixed(ToUnorm8(texel.x), ToUnorm8(texel.y), ToUnorm8(texel.z));
+					alpha += ToUnorm8(texel.w);
+				}
+			}
+			const auto numTexels = static_cast<uint32_t>(numTaps * numTaps);
+			const auto grey = ((luma + numTexels / 2) / numTexels) / 255.0f;
+
+			result.set(idx, unorm4(grey, grey, grey, ((alpha + numTexels / 2) / numTexels) / 255.0f));
+		}
+	);
 }
 
-void Amp12::GetImageSize(uint32_t& width, uint32_t& height) const
+bool Amp12::CreateShaderReadPath(bool toneMap)
 {
-	width = m_imageSize.x;
-	height = m_imageSize.y;
+	m_toneMapInShader = toneMap;
+
+	auto& shader11 = m_shaders11[toneMap ? 1 : 0];
+	if (!shader11)
+	{
+		// The shaders are compiled offline by FXC, and embedded as bytecode
+		const auto pBytecode = toneMap ? g_CSLumaToneMap : g_CSLuma;
+		const auto bytecodeSize = toneMap ? sizeof(g_CSLumaToneMap) : sizeof(g_CSLuma);
+		XUSG_M_RETURN(FAILED(m_device11->CreateComputeShader(pBytecode, bytecodeSize, nullptr, &shader11)),
+			cerr, "Failed to create the DX11 luma shader.", false);
+	}
+
+	// The views are kept with the pooled textures
+	if (!m_source->SRV11)
+		XUSG_M_RETURN(FAILED(m_device11->CreateShaderResourceView(m_source->Texture11.get(), nullptr, &m_source->SRV11)),
+			cerr, "Failed to create the DX11 SRV of Source.", false);
+	if (!m_result->UAV11)
+		XUSG_M_RETURN(FAILED(m_device11->CreateUnorderedAccessView(m_result->Texture11.get(), nullptr, &m_result->UAV11)),
+			cerr, "Failed to create the DX11 UAV of Result.", false);
+
+	if (!m_sampler11)
+	{
+		const CD3D11_SAMPLER_DESC samplerDesc(D3D11_FILTER_MIN_MAG_MIP_LINEAR, D3D11_TEXTURE_ADDRESS_CLAMP,
+			D3D11_TEXTURE_ADDRESS_CLAMP, D3D11_TEXTURE_ADDRESS_CLAMP, 0.0f, 1, D3D11_COMPARISON_NEVER,
+			nullptr, 0.0f, D3D11_FLOAT32_MAX);
+		XUSG_M_RETURN(FAILED(m_device11->CreateSamplerState(&samplerDesc, &m_sampler11)),
+			cerr, "Failed to create the DX11 sampler.", false);
+	}
+
+	return true;
 }
 
-const Texture2D* Amp12::GetResult() const
+void Amp12::ProcessInShader(const TexturePool::Entry& source)
 {
-	return m_result.get();
+	com_ptr<ID3D11DeviceContext> context;
+	m_device11->GetImmediateContext(&context);
+
+	const auto pSRV = source.SRV11.get();
+	const auto pUAV = m_result->UAV11.get();
+	const auto pSampler = m_sampler11.get();
+	context->CSSetShader(m_shaders11[m_toneMapInShader ? 1 : 0].get(), nullptr, 0);
+	context->CSSetShaderResources(0, 1, &pSRV);
+	context->CSSetUnorderedAccessViews(0, 1, &pUAV, nullptr);
+	context->CSSetSamplers(0, 1, &pSampler);
+	context->Dispatch(XUSG_DIV_UP(m_imageSize.x, 8), XUSG_DIV_UP(m_imageSize.y, 8), 1);
+
+	// Unbind, so that the AMP runtime and the DX12 side can access the resources
+	ID3D11ShaderResourceView* const nullSRV = nullptr;
+	ID3D11UnorderedAccessView* const nullUAV = nullptr;
+	context->CSSetShaderResources(0, 1, &nullSRV);
+	context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
 }
@@ -5,36 +5,131 @@
 #pragma once
 
 #include "Core/XUSG.h"
+#include "ImageLoader.h"
+#include "TexturePool.h"
 
+// Runs the luma kernel on a DX12 texture through C++ AMP. Init() may be called once per
+// image; the textures of the previous image, with their DX11 and AMP wrappers, are then
+// recycled through a texture pool for the images of the same size and format.
 class Amp12
 {
 public:
 	Amp12(const Concurrency::accelerator_view& acceleratorView);
 	virtual ~Amp12();
 
-	bool Init(XUSG::CommandList* pCommandList, std::vector<XUSG::Resource::uptr>& uploaders,
-		XUSG::Format rtFormat, const char* fileName, XUSG::Texture::uptr* pSrcForNative11);
+	bool Init(XUSG::CommandList* pCommandList, UploadRing& uploadRing,
+		XUSG::Format rtFormat, ImageLoader& imageLoader, XUSG::Texture::sptr* pSrcForNative11);
+
+	// Many small images are packed into an atlas, which the caller uploads into the source
+	bool InitAtlas(const XUSG::Device* pDevice, uint32_t width, uint32_t height, XUSG::Format rtFormat,
+		bool useNativeDX11);
+
+	// Image sequences are streamed into alternating sources, which are created here
+	bool InitSequence(const XUSG::Device* pDevice, uint32_t width, uint32_t height, XUSG::Format rtFormat,
+		XUSG::Texture::sptr* pFrameSources, uint8_t numFrameSources);
+
+	// Same-size images are stacked into the slices of volume textures, which the caller uploads
+	// into the stack source; C++ AMP cannot wrap texture arrays, and volumes are 11on12 only
+	bool InitStack(const XUSG::Device* pDevice, uint32_t width, uint32_t height, uint16_t depth,
+		XUSG::Format format, XUSG::Format rtFormat);
+
+	// The view is the display-resolution result of the live path: the image is fit into it,
+	// centered, and downsampled by a box of bilinear taps when shrunk. Only some regions of the
+	// view, such as the out-of-date parts of the window, are processed.
+	bool InitView(const XUSG::Device* pDevice, uint32_t width, uint32_t height, XUSG::Format rtFormat);
+
+	// Overwrites a region of the source with texels in the source format, such as an overlay
+	// or a partial readout; the caller submits the command list and the upload ring
+	bool UpdateSource(XUSG::CommandList* pCommandList, UploadRing& uploadRing, const void* pData,
+		uint32_t rowPitch, const RECT& rect);
+
+	// The fixed-point luma loads the texels of unorm sources, and rounds identically on every
+	// device and in the CPU kernels; float sources, and the formats read by the shader, keep
+	// the float luma.
+	void SetFixedPointLuma(bool useFixedPointLuma);
 
 	void Process();
+	void Process(const RECT* pRects, uint32_t numRects);	// In view pixels
+	void ProcessFrame(uint8_t frameSource);
+	void ProcessFrame(uint8_t frameSource, const RECT* pRects, uint32_t numRects);
+	void ProcessStack(uint16_t numSlices);
+
+	// The view pixels that depend on a region of the image, and the image texel under a view pixel
+	RECT GetViewRect(const RECT& imageRect) const;
+	bool GetImagePosition(float x, float y, uint32_t& imageX, uint32_t& imageY) const;
 
 	void GetImageSize(uint32_t& width, uint32_t& height) const;
+	XUSG::Format GetSourceFormat() const;
 
+	XUSG::Texture* GetSource() const;
 	const XUSG::Texture2D* GetResult() const;
+	const XUSG::Texture2D* GetViewResult() const;
+	float GetViewScale() const;	// In image texels per view pixel
+	bool ReadBackResult(XUSG::CommandList* pCommandList, XUSG::Buffer* pReadBuffer, uint32_t* pRowPitch);
+	const TexturePool& GetTexturePool() const;
+
+	// The slices of the stack result are read back in one copy, and lie at the slice pitch apart
+	XUSG::Texture3D* GetStackSource() const;
+	void ReadBackStack(XUSG::CommandList* pCommandList, uint16_t numSlices);
+	const uint8_t* MapStackResult(uint32_t& rowPitch, uint64_t& slicePitch);
+	void UnmapStackResult();
 
 protected:
+	bool CreateResources(const XUSG::Device* pDevice, XUSG::Format sourceFormat, uint8_t numSourceMips,
+		XUSG::Format rtFormat);
+	bool CreateResult(const XUSG::Device* pDevice, TexturePool::Entry& result, XUSG::Format rtFormat,
+		const wchar_t* name);
+	bool CreateShaderReadPath(bool toneMap);
+	void ProcessSource(const TexturePool::Entry& source, const RECT* pViewRects = nullptr, uint32_t numViewRects = 0);
+	void ProcessInShader(const TexturePool::Entry& source);
+
+	template<typename T>
+	void ProcessAMP(const Concurrency::graphics::texture<T, 2>& sourceTexture);
+	template<typename T>
+	void ProcessView(const Concurrency::graphics::texture<T, 2>& sourceTexture, const RECT& rect);
+	void ProcessAMPFixed(const Concurrency::graphics::texture<Concurrency::graphics::unorm_4, 2>& sourceTexture);
+	void ProcessViewFixed(const Concurrency::graphics::texture<Concurrency::graphics::unorm_4, 2>& sourceTexture,
+		const RECT& rect);
+
 	Concurrency::accelerator_view m_acceleratorView;
 
-	XUSG::Texture::uptr				m_source;
-	XUSG::Texture2D::uptr			m_result;
+	// Source and result textures with their DX11 and AMP wrappers
+	TexturePool						m_texturePool;
+	TexturePool::Entry::uptr		m_source;
+	TexturePool::Entry::uptr		m_result;
+	TexturePool::Entry::uptr		m_view;
 
 	XUSG::com_ptr<ID3D11Device1>	m_device11;
-	XUSG::com_ptr<ID3D11Texture2D>	m_source11;
-	XUSG::com_ptr<ID3D11Texture2D>	m_result11;
 
-	std::unique_ptr<Concurrency::graphics::texture<Concurrency::graphics::unorm_4, 2>> m_sourceAMP;
-	std::unique_ptr<Concurrency::graphics::texture<Concurrency::graphics::unorm_4, 2>> m_resultAMP;
+	// DX11 compute path that reads formats AMP cannot wrap, such as BC1-BC7,
+	// and has them decompressed by the texture units on read
+	XUSG::com_ptr<ID3D11ComputeShader>			m_shaders11[2];	// Indexed by tone mapping
+	XUSG::com_ptr<ID3D11SamplerState>			m_sampler11;
+
+	// Alternating sources of an image sequence
+	static const uint8_t MaxFrameSourceCount = 2;
+	TexturePool::Entry::uptr		m_frameSources[MaxFrameSourceCount];
+
+	// Stacked sources and results, kept while the stack shape is unchanged
+	XUSG::Texture3D::uptr			m_stackSource;
+	XUSG::Texture3D::uptr			m_stackResult;
+	XUSG::com_ptr<ID3D11Texture3D>	m_stackSource11;
+	XUSG::com_ptr<ID3D11Texture3D>	m_stackResult11;
+	std::unique_ptr<Concurrency::graphics::texture<Concurrency::graphics::unorm_4, 3>> m_stackSourceAMP;
+	std::unique_ptr<Concurrency::graphics::texture<Concurrency::graphics::unorm_4, 3>> m_stackResultAMP;
+	XUSG::Buffer::uptr				m_stackReadBuffer;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_stackFootprint;
 
 	DirectX::XMUINT2				m_imageSize;
 
+	// Fit of the image into the view
+	float							m_viewScale;
+	DirectX::XMFLOAT2				m_viewOffset;	// Of the image origin, in view pixels
+
+	static const int32_t MaxViewTaps = 4;	// Per axis, of the downsample
+
 	bool							m_useNativeDX11;
+	bool							m_readSourceInShader;
+	bool							m_toneMapInShader;
+	bool							m_useFixedPointLuma;
 };
@@ -0,0 +1,728 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "BCDecoder.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace BCDecoder
+{
+	// Reads the bits of a 128-bit block, least significant first
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* pBlock) : m_pos(0)
+		{
+			memcpy(&m_lo, pBlock, sizeof(m_lo));
+			memcpy(&m_hi, &pBlock[8], sizeof(m_hi));
+		}
+
+		uint32_t Read(uint32_t numBits)
+		{
+			if (numBits == 0) return 0;
+
+			uint64_t bits;
+			if (m_pos >= 64) bits = m_hi >> (m_pos - 64);
+			else if (m_pos + numBits <= 64) bits = m_lo >> m_pos;
+			else bits = (m_lo >> m_pos) | (m_hi << (64 - m_pos));
+			m_pos += numBits;
+
+			return static_cast<uint32_t>(bits & ((1ull << numBits) - 1));
+		}
+
+	protected:
+		uint64_t m_lo;
+		uint64_t m_hi;
+		uint32_t m_pos;
+	};
+
+	// Interpolation weights in 1/64 of the BC6H and BC7 indices of 2, 3 and 4 bits
+	static const uint8_t g_weights2[] = { 0, 21, 43, 64 };
+	static const uint8_t g_weights3[] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	static const uint8_t g_weights4[] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	static uint32_t GetWeight(uint32_t indexBits, uint32_t index)
+	{
+		switch (indexBits)
+		{
+		case 2:
+			return g_weights2[index];
+		case 3:
+			return g_weights3[index];
+		default:
+			return g_weights4[index];
+		}
+	}
+
+	// Texels of the second subset of the 2-subset partitions, one bit per texel
+	static const uint16_t g_partitions2[64] =
+	{
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+		0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+		0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+		0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+		0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+	};
+
+	// Subsets of the texels of the 3-subset partitions, two bits per texel
+	static const uint32_t g_partitions3[64] =
+	{
+		0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+		0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+		0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+		0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+		0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+		0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+		0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+		0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+	};
+
+	// Anchor texels, whose index drops its top bit, of the second subset of the 2-subset
+	// partitions, and of the second and third subsets of the 3-subset partitions
+	static const uint8_t g_anchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+	};
+
+	static const uint8_t g_anchors3_2[64] =
+	{
+		 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+		 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+		 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+		 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+	};
+
+	static const uint8_t g_anchors3_3[64] =
+	{
+		15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+		15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+		15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+		15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+	};
+
+	static uint32_t GetSubset(uint32_t numSubsets, uint32_t partition, uint32_t texel)
+	{
+		switch (numSubsets)
+		{
+		case 2:
+			return (g_partitions2[partition] >> texel) & 1;
+		case 3:
+			return (g_partitions3[partition] >> (2 * texel)) & 3;
+		default:
+			return 0;
+		}
+	}
+
+	static bool IsAnchor(uint32_t numSubsets, uint32_t partition, uint32_t texel)
+	{
+		switch (numSubsets)
+		{
+		case 2:
+			return texel == 0 || texel == g_anchors2[partition];
+		case 3:
+			return texel == 0 || texel == g_anchors3_2[partition] || texel == g_anchors3_3[partition];
+		default:
+			return texel == 0;
+		}
+	}
+
+	static void FillTransparentBlack(uint8_t* pDst, size_t dstRowPitch, uint32_t texelSize)
+	{
+		for (auto i = 0u; i < 4; ++i) memset(&pDst[dstRowPitch * i], 0, texelSize * 4);
+	}
+
+	//--------------------------------------------------------------------------------------
+	// BC1-BC5
+	//--------------------------------------------------------------------------------------
+
+	static void DecodeColorBlock(const uint8_t* pBlock, uint8_t* pDst, size_t dstRowPitch, bool isBC1)
+	{
+		const auto c0 = static_cast<uint32_t>(pBlock[0] | (pBlock[1] << 8));
+		const auto c1 = static_cast<uint32_t>(pBlock[2] | (pBlock[3] << 8));
+		uint32_t indices;
+		memcpy(&indices, &pBlock[4], sizeof(indices));
+
+		uint8_t colors[4][4];
+		for (auto i = 0u; i < 2; ++i)
+		{
+			const auto c = i ? c1 : c0;
+			const auto r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+			colors[i][0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+			colors[i][1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+			colors[i][2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+			colors[i][3] = 0xff;
+		}
+
+		// The 3-color mode with transparent black only exists in BC1
+		if (c0 > c1 || !isBC1)
+		{
+			for (auto j = 0u; j < 3; ++j)
+			{
+				colors[2][j] = static_cast<uint8_t>((2 * colors[0][j] + colors[1][j] + 1) / 3);
+				colors[3][j] = static_cast<uint8_t>((colors[0][j] + 2 * colors[1][j] + 1) / 3);
+			}
+			colors[2][3] = colors[3][3] = 0xff;
+		}
+		else
+		{
+			for (auto j = 0u; j < 3; ++j)
+				colors[2][j] = static_cast<uint8_t>((colors[0][j] + colors[1][j] + 1) / 2);
+			colors[2][3] = 0xff;
+			memset(colors[3], 0, sizeof(colors[3]));
+		}
+
+		for (auto i = 0u; i < 16; ++i)
+			memcpy(&pDst[dstRowPitch * (i / 4) + 4 * (i % 4)], colors[(indices >> (2 * i)) & 3], 4);
+	}
+
+	// Decodes a BC4-style channel into every 4th byte of the texels
+	static void DecodeChannelBlock(const uint8_t* pBlock, uint8_t* pDst, size_t dstRowPitch)
+	{
+		const uint32_t a0 = pBlock[0], a1 = pBlock[1];
+		uint8_t values[8] = { static_cast<uint8_t>(a0), static_cast<uint8_t>(a1) };
+		if (a0 > a1)
+		{
+			for (auto i = 1u; i < 7; ++i)
+				values[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1 + 3) / 7);
+		}
+		else
+		{
+			for (auto i = 1u; i < 5; ++i)
+				values[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1 + 2) / 5);
+			values[6] = 0;
+			values[7] = 0xff;
+		}
+
+		uint64_t indices = 0;
+		memcpy(&indices, &pBlock[2], 6);
+		for (auto i = 0u; i < 16; ++i)
+			pDst[dstRowPitch * (i / 4) + 4 * (i % 4)] = values[(indices >> (3 * i)) & 7];
+	}
+
+	static void DecodeBC2Alpha(const uint8_t* pBlock, uint8_t* pDst, size_t dstRowPitch)
+	{
+		uint64_t alphas;
+		memcpy(&alphas, pBlock, sizeof(alphas));
+		for (auto i = 0u; i < 16; ++i)
+			pDst[dstRowPitch * (i / 4) + 4 * (i % 4)] = static_cast<uint8_t>(((alphas >> (4 * i)) & 0xf) * 17);
+	}
+
+	// Fills a channel of the texels with a constant
+	static void FillChannel(uint8_t* pDst, size_t dstRowPitch, uint8_t value)
+	{
+		for (auto i = 0u; i < 16; ++i) pDst[dstRowPitch * (i / 4) + 4 * (i % 4)] = value;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// BC7
+	//--------------------------------------------------------------------------------------
+
+	struct BC7Mode
+	{
+		uint8_t NumSubsets;
+		uint8_t PartitionBits;
+		uint8_t RotationBits;
+		uint8_t IndexSelectionBits;
+		uint8_t ColorBits;
+		uint8_t AlphaBits;
+		uint8_t EndpointPBits;	// Per endpoint
+		uint8_t SharedPBits;	// Per subset
+		uint8_t IndexBits;
+		uint8_t IndexBits2;		// Secondary indices, for the modes with separate alpha
+	};
+
+	static const BC7Mode g_bc7Modes[] =
+	{
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	static void DecodeBC7(const uint8_t* pBlock, uint8_t* pDst, size_t dstRowPitch)
+	{
+		BitReader bits(pBlock);
+
+		// The mode is the number of zeros before the first set bit
+		auto modeIndex = 0u;
+		while (modeIndex < 8 && !bits.Read(1)) ++modeIndex;
+		if (modeIndex >= 8) return FillTransparentBlack(pDst, dstRowPitch, 4);
+
+		const auto& mode = g_bc7Modes[modeIndex];
+		const auto partition = bits.Read(mode.PartitionBits);
+		const auto rotation = bits.Read(mode.RotationBits);
+		const auto indexSelection = bits.Read(mode.IndexSelectionBits);
+
+		// The endpoints are stored channel by channel, then the P-bits
+		uint32_t endpoints[6][4];
+		const auto numEndpoints = 2u * mode.NumSubsets;
+		for (auto c = 0u; c < 3; ++c)
+			for (auto e = 0u; e < numEndpoints; ++e) endpoints[e][c] = bits.Read(mode.ColorBits);
+		for (auto e = 0u; e < numEndpoints; ++e) endpoints[e][3] = bits.Read(mode.AlphaBits);
+
+		auto colorBits = static_cast<uint32_t>(mode.ColorBits);
+		auto alphaBits = static_cast<uint32_t>(mode.AlphaBits);
+		if (mode.EndpointPBits || mode.SharedPBits)
+		{
+			uint32_t pBits[6];
+			if (mode.EndpointPBits) for (auto e = 0u; e < numEndpoints; ++e) pBits[e] = bits.Read(1);
+			else for (auto s = 0u; s < mode.NumSubsets; ++s) pBits[2 * s] = pBits[2 * s + 1] = bits.Read(1);
+
+			for (auto e = 0u; e < numEndpoints; ++e)
+				for (auto c = 0u; c < 4; ++c) endpoints[e][c] = (endpoints[e][c] << 1) | pBits[e];
+			++colorBits;
+			if (alphaBits) ++alphaBits;
+		}
+
+		// Expand to 8 bits by replicating the top bits
+		for (auto e = 0u; e < numEndpoints; ++e)
+		{
+			for (auto c = 0u; c < 3; ++c)
+			{
+				endpoints[e][c] <<= 8 - colorBits;
+				endpoints[e][c] |= endpoints[e][c] >> colorBits;
+			}
+
+			if (alphaBits)
+			{
+				endpoints[e][3] <<= 8 - alphaBits;
+				endpoints[e][3] |= endpoints[e][3] >> alphaBits;
+			}
+			else endpoints[e][3] = 0xff;
+		}
+
+		uint32_t indices[16], indices2[16] = {};
+		for (auto i = 0u; i < 16; ++i)
+			indices[i] = bits.Read(mode.IndexBits - (IsAnchor(mode.NumSubsets, partition, i) ? 1 : 0));
+		if (mode.IndexBits2)
+			for (auto i = 0u; i < 16; ++i) indices2[i] = bits.Read(mode.IndexBits2 - (i == 0 ? 1 : 0));
+
+		for (auto i = 0u; i < 16; ++i)
+		{
+			const auto subset = GetSubset(mode.NumSubsets, partition, i);
+			const auto& e0 = endpoints[2 * subset];
+			const auto& e1 = endpoints[2 * subset + 1];
+
+			// With separate alpha indices, the index selection swaps the two index sets
+			auto colorWeight = GetWeight(mode.IndexBits, indices[i]);
+			auto alphaWeight = colorWeight;
+			if (mode.IndexBits2)
+			{
+				alphaWeight = GetWeight(mode.IndexBits2, indices2[i]);
+				if (indexSelection) swap(colorWeight, alphaWeight);
+			}
+
+			uint8_t texel[4];
+			for (auto c = 0u; c < 3; ++c)
+				texel[c] = static_cast<uint8_t>(((64 - colorWeight) * e0[c] + colorWeight * e1[c] + 32) >> 6);
+			texel[3] = static_cast<uint8_t>(((64 - alphaWeight) * e0[3] + alphaWeight * e1[3] + 32) >> 6);
+			if (rotation) swap(texel[3], texel[rotation - 1]);
+
+			memcpy(&pDst[dstRowPitch * (i / 4) + 4 * (i % 4)], texel, sizeof(texel));
+		}
+	}
+
+	//--------------------------------------------------------------------------------------
+	// BC6H
+	//--------------------------------------------------------------------------------------
+
+	// Endpoint channels of the BC6H bit layouts: the two endpoints of region 0, then of region 1
+	enum BC6HField : uint8_t
+	{
+		R0, G0, B0,
+		R1, G1, B1,
+		R2, G2, B2,
+		R3, G3, B3
+	};
+
+	// A run of bits of an endpoint channel, stored from bit First to bit Last
+	struct BC6HBits
+	{
+		uint8_t Field;
+		uint8_t First;
+		uint8_t Last;
+	};
+
+	struct BC6HMode
+	{
+		uint8_t ModeBits;
+		uint8_t NumRegions;
+		bool IsTransformed;		// The other endpoints are deltas from the first one
+		uint8_t EndpointBits;
+		uint8_t DeltaBits[3];
+		uint8_t NumRuns;
+		BC6HBits Runs[24];
+	};
+
+	static const BC6HMode g_bc6hModes[] =
+	{
+		{ 0x00, 2, true, 10, { 5, 5, 5 }, 19, { { G2, 4, 4 }, { B2, 4, 4 }, { B3, 4, 4 }, { R0, 0, 9 }, { G0, 0, 9 },
+			{ B0, 0, 9 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 },
+			{ B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 } } },
+		{ 0x01, 2, true, 7, { 6, 6, 6 }, 23, { { G2, 5, 5 }, { G3, 4, 4 }, { G3, 5, 5 }, { R0, 0, 6 }, { B3, 0, 0 },
+			{ B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 6 }, { B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 6 },
+			{ B3, 3, 3 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 },
+			{ B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 } } },
+		{ 0x02, 2, true, 11, { 5, 4, 4 }, 18, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 4 }, { R0, 10, 10 },
+			{ G2, 0, 3 }, { G1, 0, 3 }, { G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 },
+			{ B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 } } },
+		{ 0x06, 2, true, 11, { 4, 5, 4 }, 20, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 },
+			{ G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { G0, 10, 10 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 },
+			{ B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 3 }, { B3, 0, 0 }, { B3, 2, 2 }, { R3, 0, 3 }, { G2, 4, 4 },
+			{ B3, 3, 3 } } },
+		{ 0x0a, 2, true, 11, { 4, 4, 5 }, 20, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 },
+			{ B2, 4, 4 }, { G2, 0, 3 }, { G1, 0, 3 }, { G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 },
+			{ B0, 10, 10 }, { B2, 0, 3 }, { R2, 0, 3 }, { B3, 1, 1 }, { B3, 2, 2 }, { R3, 0, 3 }, { B3, 4, 4 },
+			{ B3, 3, 3 } } },
+		{ 0x0e, 2, true, 9, { 5, 5, 5 }, 19, { { R0, 0, 8 }, { B2, 4, 4 }, { G0, 0, 8 }, { G2, 4, 4 }, { B0, 0, 8 },
+			{ B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 },
+			{ B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 } } },
+		{ 0x12, 2, true, 8, { 6, 5, 5 }, 19, { { R0, 0, 7 }, { G3, 4, 4 }, { B2, 4, 4 }, { G0, 0, 7 }, { B3, 2, 2 },
+			{ G2, 4, 4 }, { B0, 0, 7 }, { B3, 3, 3 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 4 },
+			{ B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 } } },
+		{ 0x16, 2, true, 8, { 5, 6, 5 }, 21, { { R0, 0, 7 }, { B3, 0, 0 }, { B2, 4, 4 }, { G0, 0, 7 }, { G2, 5, 5 },
+			{ G2, 4, 4 }, { B0, 0, 7 }, { G3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 },
+			{ G1, 0, 5 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 },
+			{ R3, 0, 4 }, { B3, 3, 3 } } },
+		{ 0x1a, 2, true, 8, { 5, 5, 6 }, 21, { { R0, 0, 7 }, { B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 7 }, { B2, 5, 5 },
+			{ G2, 4, 4 }, { B0, 0, 7 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 },
+			{ G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 },
+			{ R3, 0, 4 }, { B3, 3, 3 } } },
+		{ 0x1e, 2, false, 6, { 6, 6, 6 }, 23, { { R0, 0, 5 }, { G3, 4, 4 }, { B3, 0, 0 }, { B3, 1, 1 }, { B2, 4, 4 },
+			{ G0, 0, 5 }, { G2, 5, 5 }, { B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 5 }, { G3, 5, 5 },
+			{ B3, 3, 3 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 },
+			{ B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 } } },
+		{ 0x03, 1, false, 10, { 10, 10, 10 }, 6, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 9 }, { G1, 0, 9 },
+			{ B1, 0, 9 } } },
+		{ 0x07, 1, true, 11, { 9, 9, 9 }, 9, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 8 }, { R0, 10, 10 },
+			{ G1, 0, 8 }, { G0, 10, 10 }, { B1, 0, 8 }, { B0, 10, 10 } } },
+		{ 0x0b, 1, true, 12, { 8, 8, 8 }, 9, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 7 }, { R0, 11, 10 },
+			{ G1, 0, 7 }, { G0, 11, 10 }, { B1, 0, 7 }, { B0, 11, 10 } } },
+		{ 0x0f, 1, true, 16, { 4, 4, 4 }, 9, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 15, 10 },
+			{ G1, 0, 3 }, { G0, 15, 10 }, { B1, 0, 3 }, { B0, 15, 10 } } }
+	};
+
+	static int32_t SignExtend(uint32_t value, uint32_t numBits)
+	{
+		const auto shift = 32 - numBits;
+
+		return static_cast<int32_t>(value << shift) >> shift;
+	}
+
+	// Scales a quantized endpoint to the 16-bit range, with the extremes mapped exactly
+	static int32_t Unquantize(int32_t value, uint32_t numBits, bool isSigned)
+	{
+		if (isSigned)
+		{
+			if (numBits >= 16) return value;
+
+			const auto isNegative = value < 0;
+			if (isNegative) value = -value;
+			if (value == 0) return 0;
+			if (value >= (1 << (numBits - 1)) - 1) value = 0x7fff;
+			else value = ((value << 15) + 0x4000) >> (numBits - 1);
+
+			return isNegative ? -value : value;
+		}
+
+		if (numBits >= 15 || value == 0) return value;
+		if (value == (1 << numBits) - 1) return 0xffff;
+
+		return ((value << 16) + 0x8000) >> numBits;
+	}
+
+	static float HalfToFloat(uint32_t half)
+	{
+		const auto sign = (half & 0x8000) << 16;
+		auto exponent = (half >> 10) & 0x1f;
+		auto mantissa = half & 0x3ff;
+
+		uint32_t bits;
+		if (exponent == 0x1f) bits = sign | 0x7f800000 | (mantissa << 13);
+		else if (exponent) bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		else if (mantissa)
+		{
+			// Normalize the denormal
+			exponent = 113;
+			while (!(mantissa & 0x400))
+			{
+				mantissa <<= 1;
+				--exponent;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+		else bits = sign;
+
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+
+		return value;
+	}
+
+	// Turns an interpolated value into a half float; the scaling by 31/64 (or 31/32 signed)
+	// keeps the largest value finite
+	static float FinishUnquantize(int32_t value, bool isSigned)
+	{
+		if (isSigned)
+		{
+			const auto half = value < 0 ? 0x8000 | ((-value * 31) >> 5) : (value * 31) >> 5;
+
+			return HalfToFloat(static_cast<uint32_t>(half));
+		}
+
+		return HalfToFloat(static_cast<uint32_t>((value * 31) >> 6));
+	}
+
+	static void DecodeBC6H(const uint8_t* pBlock, uint8_t* pDst, size_t dstRowPitch, bool isSigned)
+	{
+		BitReader bits(pBlock);
+
+		// 2-bit modes, or 5-bit modes whose low bits are 10 or 11
+		auto modeBits = bits.Read(2);
+		if (modeBits >= 2) modeBits |= bits.Read(3) << 2;
+
+		const BC6HMode* pMode = nullptr;
+		for (const auto& mode : g_bc6hModes) if (mode.ModeBits == modeBits) pMode = &mode;
+		if (!pMode) return FillTransparentBlack(pDst, dstRowPitch, 4 * sizeof(float));	// Reserved modes
+		const auto& mode = *pMode;
+
+		uint32_t fields[12] = {};
+		for (auto i = 0u; i < mode.NumRuns; ++i)
+		{
+			const auto& run = mode.Runs[i];
+			const auto step = run.First <= run.Last ? 1 : -1;
+			for (auto bit = static_cast<int>(run.First); ; bit += step)
+			{
+				fields[run.Field] |= bits.Read(1) << bit;
+				if (bit == run.Last) break;
+			}
+		}
+
+		const auto partition = mode.NumRegions > 1 ? bits.Read(5) : 0;
+
+		// Undo the delta transform, and scale to 16 bits
+		const auto numEndpoints = 2u * mode.NumRegions;
+		int32_t endpoints[4][3];
+		for (auto c = 0u; c < 3; ++c)
+		{
+			const auto endpointMask = (1u << mode.EndpointBits) - 1;
+			const auto base = fields[c];
+			for (auto e = 0u; e < numEndpoints; ++e)
+			{
+				auto value = fields[3 * e + c];
+				if (e > 0 && mode.IsTransformed)
+					value = static_cast<uint32_t>(SignExtend(value, mode.DeltaBits[c]) + static_cast<int32_t>(base)) & endpointMask;
+				const auto endpoint = isSigned ? SignExtend(value, mode.EndpointBits) : static_cast<int32_t>(value);
+				endpoints[e][c] = Unquantize(endpoint, mode.EndpointBits, isSigned);
+			}
+		}
+
+		const auto indexBits = mode.NumRegions > 1 ? 3u : 4u;
+		for (auto i = 0u; i < 16; ++i)
+		{
+			const auto isAnchor = i == 0 || (mode.NumRegions > 1 && i == g_anchors2[partition]);
+			const auto weight = static_cast<int32_t>(GetWeight(indexBits, bits.Read(indexBits - (isAnchor ? 1 : 0))));
+			const auto region = GetSubset(mode.NumRegions, partition, i);
+			const auto& e0 = endpoints[2 * region];
+			const auto& e1 = endpoints[2 * region + 1];
+
+			float texel[4];
+			for (auto c = 0u; c < 3; ++c)
+				texel[c] = FinishUnquantize((e0[c] * (64 - weight) + e1[c] * weight + 32) >> 6, isSigned);
+			texel[3] = 1.0f;
+
+			memcpy(&pDst[dstRowPitch * (i / 4) + sizeof(texel) * (i % 4)], texel, sizeof(texel));
+		}
+	}
+
+	//--------------------------------------------------------------------------------------
+	// DDS and surfaces
+	//--------------------------------------------------------------------------------------
+
+	bool ParseDDS(const uint8_t* pData, size_t size, DDSInfo& info)
+	{
+		static const uint32_t magic = 0x20534444;	// "DDS "
+		static const size_t headerSize = 128;		// With the magic
+		static const size_t dx10HeaderSize = 20;
+		static const uint32_t fourCCFlag = 0x4;
+
+		const auto makeFourCC = [](const char* fourCC)
+		{
+			return static_cast<uint32_t>(fourCC[0]) | (static_cast<uint32_t>(fourCC[1]) << 8) |
+				(static_cast<uint32_t>(fourCC[2]) << 16) | (static_cast<uint32_t>(fourCC[3]) << 24);
+		};
+		const auto readUint32 = [pData](size_t offset)
+		{
+			uint32_t value;
+			memcpy(&value, &pData[offset], sizeof(value));
+
+			return value;
+		};
+
+		info = {};
+		if (size < headerSize || readUint32(0) != magic) return false;
+
+		info.Height = readUint32(12);
+		info.Width = readUint32(16);
+		auto offset = headerSize;
+		if (readUint32(80) & fourCCFlag)
+		{
+			const auto fourCC = readUint32(84);
+			if (fourCC == makeFourCC("DX10"))
+			{
+				if (size < headerSize + dx10HeaderSize) return false;
+				offset += dx10HeaderSize;
+
+				// DXGI_FORMAT_BC1_TYPELESS to DXGI_FORMAT_BC5_UNORM, and DXGI_FORMAT_BC6H_TYPELESS to
+				// DXGI_FORMAT_BC7_UNORM_SRGB; the signed BC4 and BC5 formats are not supported
+				switch (readUint32(headerSize))
+				{
+				case 70: case 71: case 72:
+					info.BlockFormat = FORMAT_BC1;
+					break;
+				case 73: case 74: case 75:
+					info.BlockFormat = FORMAT_BC2;
+					break;
+				case 76: case 77: case 78:
+					info.BlockFormat = FORMAT_BC3;
+					break;
+				case 79: case 80:
+					info.BlockFormat = FORMAT_BC4;
+					break;
+				case 82: case 83:
+					info.BlockFormat = FORMAT_BC5;
+					break;
+				case 94: case 95:
+					info.BlockFormat = FORMAT_BC6H_UF16;
+					break;
+				case 96:
+					info.BlockFormat = FORMAT_BC6H_SF16;
+					break;
+				case 97: case 98: case 99:
+					info.BlockFormat = FORMAT_BC7;
+					break;
+				default:
+					break;
+				}
+			}
+			else if (fourCC == makeFourCC("DXT1")) info.BlockFormat = FORMAT_BC1;
+			else if (fourCC == makeFourCC("DXT2") || fourCC == makeFourCC("DXT3")) info.BlockFormat = FORMAT_BC2;
+			else if (fourCC == makeFourCC("DXT4") || fourCC == makeFourCC("DXT5")) info.BlockFormat = FORMAT_BC3;
+			else if (fourCC == makeFourCC("ATI1") || fourCC == makeFourCC("BC4U")) info.BlockFormat = FORMAT_BC4;
+			else if (fourCC == makeFourCC("ATI2") || fourCC == makeFourCC("BC5U")) info.BlockFormat = FORMAT_BC5;
+		}
+
+		// The top mip must be complete
+		if (info.BlockFormat != FORMAT_UNKNOWN)
+		{
+			const auto numBlocks = static_cast<uint64_t>((info.Width + 3) / 4) * ((info.Height + 3) / 4);
+			if (info.Width == 0 || info.Height == 0 || numBlocks * GetBlockSize(info.BlockFormat) > size - offset)
+				info.BlockFormat = FORMAT_UNKNOWN;
+			else info.pBlocks = &pData[offset];
+		}
+
+		return true;
+	}
+
+	uint32_t GetBlockSize(Format format)
+	{
+		switch (format)
+		{
+		case FORMAT_BC1:
+		case FORMAT_BC4:
+			return 8;
+		case FORMAT_UNKNOWN:
+			return 0;
+		default:
+			return 16;
+		}
+	}
+
+	bool IsHDR(Format format)
+	{
+		return format == FORMAT_BC6H_UF16 || format == FORMAT_BC6H_SF16;
+	}
+
+	void DecodeBlock(Format format, const uint8_t* pBlock, uint8_t* pDst, size_t dstRowPitch)
+	{
+		switch (format)
+		{
+		case FORMAT_BC1:
+			DecodeColorBlock(pBlock, pDst, dstRowPitch, true);
+			break;
+		case FORMAT_BC2:
+			DecodeColorBlock(&pBlock[8], pDst, dstRowPitch, false);
+			DecodeBC2Alpha(pBlock, &pDst[3], dstRowPitch);
+			break;
+		case FORMAT_BC3:
+			DecodeColorBlock(&pBlock[8], pDst, dstRowPitch, false);
+			DecodeChannelBlock(pBlock, &pDst[3], dstRowPitch);
+			break;
+		case FORMAT_BC4:
+			DecodeChannelBlock(pBlock, pDst, dstRowPitch);
+			FillChannel(&pDst[1], dstRowPitch, 0);
+			FillChannel(&pDst[2], dstRowPitch, 0);
+			FillChannel(&pDst[3], dstRowPitch, 0xff);
+			break;
+		case FORMAT_BC5:
+			DecodeChannelBlock(pBlock, pDst, dstRowPitch);
+			DecodeChannelBlock(&pBlock[8], &pDst[1], dstRowPitch);
+			FillChannel(&pDst[2], dstRowPitch, 0);
+			FillChannel(&pDst[3], dstRowPitch, 0xff);
+			break;
+		case FORMAT_BC6H_UF16:
+		case FORMAT_BC6H_SF16:
+			DecodeBC6H(pBlock, pDst, dstRowPitch, format == FORMAT_BC6H_SF16);
+			break;
+		case FORMAT_BC7:
+			DecodeBC7(pBlock, pDst, dstRowPitch);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void DecodeRegion(Format format, const uint8_t* pBlocks, uint32_t width, uint32_t height,
+		uint32_t x, uint32_t y, uint32_t regionWidth, uint32_t regionHeight, uint8_t* pDst, size_t dstRowPitch)
+	{
+		const auto blockSize = GetBlockSize(format);
+		const size_t texelSize = IsHDR(format) ? 4 * sizeof(float) : 4;
+		const auto numBlocksX = (width + 3) / 4;
+		const auto right = (min)(x + regionWidth, width);
+		const auto bottom = (min)(y + regionHeight, height);
+
+		// Decode each block of the region, and copy the texels inside the region
+		uint8_t texels[4 * 4 * 4 * sizeof(float)];
+		const auto blockRowPitch = 4 * texelSize;
+		for (auto blockY = y / 4; blockY * 4 < bottom; ++blockY)
+		{
+			const auto rowBegin = (max)(blockY * 4, y);
+			const auto rowEnd = (min)(blockY * 4 + 4, bottom);
+			for (auto blockX = x / 4; blockX * 4 < right; ++blockX)
+			{
+				DecodeBlock(format, &pBlocks[(static_cast<size_t>(numBlocksX) * blockY + blockX) * blockSize],
+					texels, blockRowPitch);
+
+				const auto colBegin = (max)(blockX * 4, x);
+				const auto colEnd = (min)(blockX * 4 + 4, right);
+				for (auto row = rowBegin; row < rowEnd; ++row)
+					memcpy(&pDst[dstRowPitch * (row - y) + texelSize * (colBegin - x)],
+						&texels[blockRowPitch * (row - blockY * 4) + texelSize * (colBegin - blockX * 4)],
+						texelSize * (colEnd - colBegin));
+			}
+		}
+	}
+}
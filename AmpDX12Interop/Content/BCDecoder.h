@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Portable CPU decoder of the BC1-BC7 block-compressed formats of DDS files, for the CPU
+// workers, which cannot sample them through the texture units. BC1-BC5 and BC7 decode to
+// RGBA8 as the GPU reads them (BC4 and BC5 with zero green/blue and opaque alpha), and BC6H
+// decodes to RGBA32F. The DDS parsing only covers the top mip of the first surface.
+namespace BCDecoder
+{
+	enum Format : uint8_t
+	{
+		FORMAT_UNKNOWN,
+		FORMAT_BC1,
+		FORMAT_BC2,
+		FORMAT_BC3,
+		FORMAT_BC4,
+		FORMAT_BC5,
+		FORMAT_BC6H_UF16,
+		FORMAT_BC6H_SF16,
+		FORMAT_BC7
+	};
+
+	struct DDSInfo
+	{
+		uint32_t Width;
+		uint32_t Height;
+		Format BlockFormat;
+		const uint8_t* pBlocks;
+	};
+
+	// Parses the header of a DDS file; the format is unknown if it is not block-compressed.
+	bool ParseDDS(const uint8_t* pData, size_t size, DDSInfo& info);
+
+	uint32_t GetBlockSize(Format format);	// In bytes
+	bool IsHDR(Format format);				// BC6H decodes to RGBA32F
+
+	// Decodes a 4x4 block into RGBA8 texels, or RGBA32F texels for BC6H, at the given row pitch.
+	void DecodeBlock(Format format, const uint8_t* pBlock, uint8_t* pDst, size_t dstRowPitch);
+
+	// Decodes a region of a surface of the given size, at the given destination row pitch.
+	void DecodeRegion(Format format, const uint8_t* pBlocks, uint32_t width, uint32_t height,
+		uint32_t x, uint32_t y, uint32_t regionWidth, uint32_t regionHeight, uint8_t* pDst, size_t dstRowPitch);
+}
@@ -0,0 +1,389 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "BandReader.h"
+#include "PixelKernels.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+#ifdef _WIN32
+using namespace Microsoft::WRL;
+#endif
+
+// Parses the next whitespace-separated token of a PNM or PFM header, skipping comments.
+static bool ParseHeaderToken(const uint8_t* pData, size_t size, size_t& offset, string& token)
+{
+	const auto isSpace = [](uint8_t c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+
+	while (offset < size && (isSpace(pData[offset]) || pData[offset] == '#'))
+	{
+		if (pData[offset] == '#') while (offset < size && pData[offset] != '\n') ++offset;
+		else ++offset;
+	}
+
+	token.clear();
+	while (offset < size && !isSpace(pData[offset])) token.push_back(static_cast<char>(pData[offset++]));
+
+	// A single whitespace ends the header
+	if (offset >= size || token.empty()) return false;
+	++offset;
+
+	return true;
+}
+
+static bool ParseHeaderValue(const uint8_t* pData, size_t size, size_t& offset, uint32_t& value)
+{
+	string token;
+	if (!ParseHeaderToken(pData, size, offset, token)) return false;
+
+	char* pEnd;
+	const auto parsed = strtoul(token.c_str(), &pEnd, 10);
+	value = static_cast<uint32_t>(parsed);
+
+	return *pEnd == '\0' && parsed > 0 && parsed <= UINT32_MAX;
+}
+
+BandReader::BandReader() :
+	m_sourceType(SOURCE_PNM),
+	m_pPixels(nullptr),
+	m_pDecoded(nullptr),
+	m_width(0),
+	m_height(0),
+	m_maxValue(0),
+	m_srcChannels(0),
+	m_bytesPerChannel(1),
+	m_isLittleEndian(true),
+	m_bcFormat(BCDecoder::FORMAT_UNKNOWN)
+#ifdef _WIN32
+	, m_isCOMInitialized(false)
+#endif
+{
+}
+
+BandReader::~BandReader()
+{
+	Close();
+}
+
+bool BandReader::Open(const char* fileName)
+{
+	Close();
+
+	if (!m_file.Open(fileName)) return false;
+	const auto pData = m_file.GetData();
+	const auto dataSize = m_file.GetSize();
+
+	// BC blocks are decoded region by region
+	BCDecoder::DDSInfo ddsInfo;
+	if (BCDecoder::ParseDDS(pData, dataSize, ddsInfo) && ddsInfo.BlockFormat != BCDecoder::FORMAT_UNKNOWN)
+	{
+		m_sourceType = SOURCE_DDS;
+		m_pPixels = ddsInfo.pBlocks;
+		m_width = ddsInfo.Width;
+		m_height = ddsInfo.Height;
+		m_bytesPerChannel = BCDecoder::IsHDR(ddsInfo.BlockFormat) ? sizeof(float) : sizeof(uint8_t);
+		m_bcFormat = ddsInfo.BlockFormat;
+
+		return true;
+	}
+
+	if (dataSize > 2 && pData[0] == 'P' && (pData[1] == '5' || pData[1] == '6')) return OpenPNM();
+	if (dataSize > 2 && pData[0] == 'P' && (pData[1] == 'F' || pData[1] == 'f')) return OpenPFM();
+
+#ifdef _WIN32
+	if (OpenWIC(fileName)) return true;
+#endif
+
+	return OpenDecoded();
+}
+
+void BandReader::Close()
+{
+#ifdef _WIN32
+	m_wicSource = nullptr;
+	m_wicFactory = nullptr;
+	if (m_isCOMInitialized) CoUninitialize();
+	m_isCOMInitialized = false;
+#endif
+
+	if (m_pDecoded) stbi_image_free(m_pDecoded);
+	m_pDecoded = nullptr;
+	m_pPixels = nullptr;
+	m_file.Close();
+	m_width = 0;
+	m_height = 0;
+}
+
+bool BandReader::ReadRows(uint8_t* pDst, size_t dstRowPitch, uint32_t y, uint32_t numRows)
+{
+	if (y > m_height || numRows > m_height - y) return false;
+	if (numRows == 0) return true;
+
+	switch (m_sourceType)
+	{
+	case SOURCE_PNM:
+		for (auto i = 0u; i < numRows; ++i) ReadPNMRow(&pDst[dstRowPitch * i], y + i);
+		return true;
+	case SOURCE_PFM:
+		for (auto i = 0u; i < numRows; ++i) ReadPFMRow(&pDst[dstRowPitch * i], y + i);
+		return true;
+	case SOURCE_DDS:
+		BCDecoder::DecodeRegion(m_bcFormat, m_pPixels, m_width, m_height, 0, y, m_width, numRows, pDst, dstRowPitch);
+		return true;
+#ifdef _WIN32
+	case SOURCE_WIC:
+	{
+		const WICRect rect = { 0, static_cast<INT>(y), static_cast<INT>(m_width), static_cast<INT>(numRows) };
+		const auto rowSize = 4 * m_bytesPerChannel * m_width;
+
+		return SUCCEEDED(m_wicSource->CopyPixels(&rect, static_cast<UINT>(dstRowPitch),
+			static_cast<UINT>(dstRowPitch * (numRows - 1) + rowSize), pDst));
+	}
+#endif
+	default:
+	{
+		if (!m_pPixels && !Decode()) return false;
+
+		const size_t rowSize = 4 * m_bytesPerChannel * m_width;
+		for (auto i = 0u; i < numRows; ++i) memcpy(&pDst[dstRowPitch * i], &m_pPixels[rowSize * (y + i)], rowSize);
+
+		return true;
+	}
+	}
+}
+
+void BandReader::GetImageSize(uint32_t& width, uint32_t& height) const
+{
+	width = m_width;
+	height = m_height;
+}
+
+uint8_t BandReader::GetBytesPerChannel() const
+{
+	return m_bytesPerChannel;
+}
+
+bool BandReader::IsStreamed() const
+{
+	return m_sourceType != SOURCE_DECODED;
+}
+
+bool BandReader::OpenPNM()
+{
+	const auto pData = m_file.GetData();
+	const auto dataSize = m_file.GetSize();
+
+	size_t offset = 2;
+	if (!ParseHeaderValue(pData, dataSize, offset, m_width) || !ParseHeaderValue(pData, dataSize, offset, m_height) ||
+		!ParseHeaderValue(pData, dataSize, offset, m_maxValue) || m_maxValue > UINT16_MAX)
+		return false;
+
+	m_sourceType = SOURCE_PNM;
+	m_srcChannels = pData[1] == '6' ? 3 : 1;
+	m_bytesPerChannel = m_maxValue > UINT8_MAX ? sizeof(uint16_t) : sizeof(uint8_t);
+	m_pPixels = &pData[offset];
+
+	return static_cast<uint64_t>(m_width) * m_height * m_srcChannels * m_bytesPerChannel <= dataSize - offset;
+}
+
+bool BandReader::OpenPFM()
+{
+	const auto pData = m_file.GetData();
+	const auto dataSize = m_file.GetSize();
+
+	// The sign of the scale tells the byte order
+	size_t offset = 2;
+	string scale;
+	if (!ParseHeaderValue(pData, dataSize, offset, m_width) || !ParseHeaderValue(pData, dataSize, offset, m_height) ||
+		!ParseHeaderToken(pData, dataSize, offset, scale))
+		return false;
+
+	m_sourceType = SOURCE_PFM;
+	m_srcChannels = pData[1] == 'F' ? 3 : 1;
+	m_bytesPerChannel = sizeof(float);
+	m_isLittleEndian = strtof(scale.c_str(), nullptr) < 0.0f;
+	m_pPixels = &pData[offset];
+
+	return static_cast<uint64_t>(m_width) * m_height * m_srcChannels * sizeof(float) <= dataSize - offset;
+}
+
+#ifdef _WIN32
+bool BandReader::OpenWIC(const char* fileName)
+{
+	// COM may already be initialized on this thread in another mode, which WIC also works with
+	m_isCOMInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_wicFactory))))
+		return false;
+
+	const wstring fileNameW(fileName, fileName + strlen(fileName));
+	ComPtr<IWICBitmapDecoder> decoder;
+	ComPtr<IWICBitmapFrameDecode> frame;
+	if (FAILED(m_wicFactory->CreateDecoderFromFilename(fileNameW.c_str(), nullptr, GENERIC_READ,
+		WICDecodeMetadataCacheOnDemand, &decoder)) || FAILED(decoder->GetFrame(0, &frame)))
+		return false;
+
+	UINT width, height;
+	WICPixelFormatGUID srcFormat;
+	if (FAILED(frame->GetSize(&width, &height)) || FAILED(frame->GetPixelFormat(&srcFormat))) return false;
+
+	// Read RGBA of the precision of the source
+	ComPtr<IWICComponentInfo> componentInfo;
+	ComPtr<IWICPixelFormatInfo2> formatInfo;
+	UINT bitsPerPixel, numChannels;
+	WICPixelFormatNumericRepresentation numericRepresentation;
+	if (FAILED(m_wicFactory->CreateComponentInfo(srcFormat, &componentInfo)) || FAILED(componentInfo.As(&formatInfo)) ||
+		FAILED(formatInfo->GetBitsPerPixel(&bitsPerPixel)) || FAILED(formatInfo->GetChannelCount(&numChannels)) ||
+		FAILED(formatInfo->GetNumericRepresentation(&numericRepresentation)))
+		return false;
+
+	WICPixelFormatGUID dstFormat;
+	if (numericRepresentation == WICPixelFormatNumericRepresentationFloat ||
+		numericRepresentation == WICPixelFormatNumericRepresentationFixed)
+	{
+		dstFormat = GUID_WICPixelFormat128bppRGBAFloat;
+		m_bytesPerChannel = sizeof(float);
+	}
+	else if (bitsPerPixel > 8 * (numChannels ? numChannels : 1))
+	{
+		dstFormat = GUID_WICPixelFormat64bppRGBA;
+		m_bytesPerChannel = sizeof(uint16_t);
+	}
+	else
+	{
+		dstFormat = GUID_WICPixelFormat32bppRGBA;
+		m_bytesPerChannel = sizeof(uint8_t);
+	}
+
+	if (srcFormat == dstFormat) m_wicSource = frame;
+	else
+	{
+		ComPtr<IWICFormatConverter> converter;
+		if (FAILED(m_wicFactory->CreateFormatConverter(&converter)) || FAILED(converter->Initialize(frame.Get(),
+			dstFormat, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+			return false;
+		m_wicSource = converter;
+	}
+
+	// WIC reads the file on its own
+	m_sourceType = SOURCE_WIC;
+	m_width = width;
+	m_height = height;
+	m_file.Close();
+
+	return true;
+}
+#endif
+
+bool BandReader::OpenDecoded()
+{
+	// stb_image takes the encoded size as an int
+	const auto pData = m_file.GetData();
+	if (m_file.GetSize() > INT_MAX) return false;
+	const auto dataSize = static_cast<int>(m_file.GetSize());
+
+	int width, height, channels;
+	if (!stbi_info_from_memory(pData, dataSize, &width, &height, &channels)) return false;
+
+	m_sourceType = SOURCE_DECODED;
+	m_width = static_cast<uint32_t>(width);
+	m_height = static_cast<uint32_t>(height);
+	if (stbi_is_hdr_from_memory(pData, dataSize)) m_bytesPerChannel = sizeof(float);
+	else if (stbi_is_16_bit_from_memory(pData, dataSize)) m_bytesPerChannel = sizeof(uint16_t);
+	else m_bytesPerChannel = sizeof(uint8_t);
+
+	return true;
+}
+
+void BandReader::ReadPNMRow(uint8_t* pDst, uint32_t y) const
+{
+	const size_t srcRowSize = static_cast<size_t>(m_srcChannels) * m_bytesPerChannel * m_width;
+	const auto pSrc = &m_pPixels[srcRowSize * y];
+
+	// The common RGB8 rows are expanded by the vectorized kernel
+	if (m_bytesPerChannel == sizeof(uint8_t) && m_srcChannels == 3 && m_maxValue == UINT8_MAX)
+	{
+		PixelKernels::ExpandRGBToRGBA(pDst, pSrc, m_width);
+		return;
+	}
+
+	// 16-bit channels are big-endian, and channels of other max values are rescaled
+	const uint32_t fullValue = m_bytesPerChannel == sizeof(uint16_t) ? UINT16_MAX : UINT8_MAX;
+	const auto loadChannel = [&](size_t i)
+	{
+		uint32_t value = m_bytesPerChannel == sizeof(uint16_t) ? (pSrc[2 * i] << 8) | pSrc[2 * i + 1] : pSrc[i];
+		if (m_maxValue != fullValue) value = ((min)(value, m_maxValue) * fullValue + m_maxValue / 2) / m_maxValue;
+
+		return value;
+	};
+	const auto storeChannel = [&](size_t i, uint32_t value)
+	{
+		if (m_bytesPerChannel == sizeof(uint16_t))
+		{
+			const auto value16 = static_cast<uint16_t>(value);
+			memcpy(&pDst[2 * i], &value16, sizeof(value16));
+		}
+		else pDst[i] = static_cast<uint8_t>(value);
+	};
+
+	for (size_t i = 0; i < m_width; ++i)
+	{
+		for (uint8_t j = 0; j < 3; ++j)
+			storeChannel(4 * i + j, loadChannel(m_srcChannels * i + (m_srcChannels > 1 ? j : 0)));
+		storeChannel(4 * i + 3, fullValue);
+	}
+}
+
+void BandReader::ReadPFMRow(uint8_t* pDst, uint32_t y) const
+{
+	// Rows are stored bottom up
+	const size_t srcRowSize = sizeof(float) * m_srcChannels * m_width;
+	const auto pSrc = &m_pPixels[srcRowSize * (m_height - 1 - y)];
+	const auto pDstF = reinterpret_cast<float*>(pDst);
+
+	const auto loadChannel = [&](size_t i)
+	{
+		uint8_t bytes[sizeof(float)];
+		memcpy(bytes, &pSrc[sizeof(float) * i], sizeof(bytes));
+		if (!m_isLittleEndian) reverse(bytes, bytes + sizeof(bytes));
+
+		float value;
+		memcpy(&value, bytes, sizeof(value));
+
+		return value;
+	};
+
+	for (size_t i = 0; i < m_width; ++i)
+	{
+		for (uint8_t j = 0; j < 3; ++j) pDstF[4 * i + j] = loadChannel(m_srcChannels * i + (m_srcChannels > 1 ? j : 0));
+		pDstF[4 * i + 3] = 1.0f;
+	}
+}
+
+bool BandReader::Decode()
+{
+	const auto pData = m_file.GetData();
+	const auto dataSize = static_cast<int>(m_file.GetSize());
+	const auto reqChannels = 4;
+
+	int width, height, channels;
+	switch (m_bytesPerChannel)
+	{
+	case sizeof(float):
+		m_pDecoded = reinterpret_cast<uint8_t*>(stbi_loadf_from_memory(pData, dataSize, &width, &height, &channels, reqChannels));
+		break;
+	case sizeof(uint16_t):
+		m_pDecoded = reinterpret_cast<uint8_t*>(stbi_load_16_from_memory(pData, dataSize, &width, &height, &channels, reqChannels));
+		break;
+	default:
+		m_pDecoded = stbi_load_from_memory(pData, dataSize, &width, &height, &channels, reqChannels);
+	}
+	m_pPixels = m_pDecoded;
+
+	return m_pPixels && static_cast<uint32_t>(width) == m_width && static_cast<uint32_t>(height) == m_height;
+}
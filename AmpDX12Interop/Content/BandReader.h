@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "MappedFile.h"
+#include "BCDecoder.h"
+
+#ifdef _WIN32
+#include <wincodec.h>
+#endif
+
+// Reads an image band by band as RGBA pixels of 8- or 16-bit unorm, or 32-bit float,
+// channels, so that only the rows of a band are decoded in memory at any time. Binary
+// PNM (PGM and PPM), PFM and BC1-BC7 DDS files are read in place from the mapped file,
+// and on Windows, the other formats are decoded region by region by WIC. Any other
+// format stb_image reads is decoded as a whole on the first read, as the only fallback
+// that is not streamed.
+class BandReader
+{
+public:
+	BandReader();
+	virtual ~BandReader();
+
+	// Only reads the header; no pixel is decoded until ReadRows().
+	bool Open(const char* fileName);
+	void Close();
+
+	// Reads the rows [y, y + numRows) of the full width, at the given destination row pitch.
+	bool ReadRows(uint8_t* pDst, size_t dstRowPitch, uint32_t y, uint32_t numRows);
+
+	void GetImageSize(uint32_t& width, uint32_t& height) const;
+	uint8_t GetBytesPerChannel() const;		// Of the RGBA pixels read: 1, 2 or 4 (float)
+	bool IsStreamed() const;				// False for the fallback, which decodes the whole image
+
+protected:
+	enum SourceType : uint8_t
+	{
+		SOURCE_PNM,
+		SOURCE_PFM,
+		SOURCE_DDS,
+		SOURCE_WIC,
+		SOURCE_DECODED
+	};
+
+	bool OpenPNM();
+	bool OpenPFM();
+	bool OpenWIC(const char* fileName);
+	bool OpenDecoded();
+	void ReadPNMRow(uint8_t* pDst, uint32_t y) const;
+	void ReadPFMRow(uint8_t* pDst, uint32_t y) const;
+	bool Decode();
+
+	SourceType		m_sourceType;
+	MappedFile		m_file;
+	const uint8_t*	m_pPixels;			// In place in the mapped file, or decoded by the fallback
+	uint8_t*		m_pDecoded;
+	uint32_t		m_width;
+	uint32_t		m_height;
+	uint32_t		m_maxValue;			// Of PNM channels
+	uint8_t			m_srcChannels;
+	uint8_t			m_bytesPerChannel;
+	bool			m_isLittleEndian;	// Of PFM floats; PNM is always big-endian
+	BCDecoder::Format m_bcFormat;
+
+#ifdef _WIN32
+	Microsoft::WRL::ComPtr<IWICImagingFactory> m_wicFactory;
+	Microsoft::WRL::ComPtr<IWICBitmapSource> m_wicSource;
+	bool m_isCOMInitialized;
+#endif
+};
@@ -0,0 +1,119 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "BandScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <future>
+
+using namespace std;
+
+BandScheduler::BandScheduler(uint32_t rowGranularity, double smoothing) :
+	m_rowGranularity((max)(rowGranularity, 1u)),
+	m_smoothing(smoothing)
+{
+}
+
+BandScheduler::~BandScheduler()
+{
+}
+
+uint32_t BandScheduler::AddDevice(double initialThroughput)
+{
+	if (initialThroughput <= 0.0)
+	{
+		initialThroughput = 1.0;
+		if (!m_devices.empty())
+		{
+			auto sum = 0.0;
+			for (const auto& device : m_devices) sum += device.Throughput;
+			initialThroughput = sum / m_devices.size();
+		}
+	}
+
+	m_devices.push_back({ initialThroughput, false });
+
+	return static_cast<uint32_t>(m_devices.size() - 1);
+}
+
+void BandScheduler::Split(uint32_t y, uint32_t height, vector<Band>& bands) const
+{
+	bands.clear();
+	if (m_devices.empty() || height == 0) return;
+
+	auto sum = 0.0;
+	for (const auto& device : m_devices) sum += device.Throughput;
+
+	// Place the band boundaries at the cumulative shares, snapped to the row granularity,
+	// so that the rounding never accumulates; the last band ends at the last row
+	auto cumulative = 0.0;
+	auto bandY = 0u;
+	const auto numDevices = static_cast<uint32_t>(m_devices.size());
+	for (auto i = 0u; i < numDevices; ++i)
+	{
+		cumulative += m_devices[i].Throughput;
+		auto bandEnd = height;
+		if (i + 1 < numDevices)
+		{
+			const auto rows = static_cast<uint32_t>(height * (cumulative / sum) / m_rowGranularity + 0.5);
+			bandEnd = (min)(rows * m_rowGranularity, height);
+		}
+
+		if (bandEnd > bandY) bands.push_back({ i, y + bandY, bandEnd - bandY });
+		bandY = (max)(bandY, bandEnd);
+	}
+}
+
+void BandScheduler::Report(uint32_t device, uint64_t numPixels, double time)
+{
+	assert(device < m_devices.size());
+	if (numPixels == 0 || time <= 0.0) return;
+
+	// The first measurement replaces the guess; later ones are smoothed
+	auto& info = m_devices[device];
+	const auto throughput = numPixels / time;
+	info.Throughput = info.IsMeasured ? info.Throughput + (throughput - info.Throughput) * m_smoothing : throughput;
+	info.IsMeasured = true;
+}
+
+void BandScheduler::Run(uint32_t width, uint32_t height, uint32_t numRounds,
+	const function<double(const Band&)>& processBand)
+{
+	numRounds = (min)((max)(numRounds, 1u), height);
+
+	vector<Band> bands;
+	vector<future<double>> tasks;
+	for (auto i = 0u; i < numRounds; ++i)
+	{
+		const auto y = static_cast<uint32_t>(static_cast<uint64_t>(height) * i / numRounds);
+		const auto roundHeight = static_cast<uint32_t>(static_cast<uint64_t>(height) * (i + 1) / numRounds) - y;
+		Split(y, roundHeight, bands);
+
+		// Run the bands on all the devices at once
+		tasks.clear();
+		for (const auto& band : bands) tasks.emplace_back(async(launch::async, cref(processBand), band));
+
+		// Feed the measured times back into the split of the next round
+		for (size_t j = 0; j < bands.size(); ++j)
+			Report(bands[j].Device, static_cast<uint64_t>(width) * bands[j].Height, tasks[j].get());
+	}
+}
+
+uint32_t BandScheduler::GetNumDevices() const
+{
+	return static_cast<uint32_t>(m_devices.size());
+}
+
+double BandScheduler::GetThroughput(uint32_t device) const
+{
+	return m_devices[device].Throughput;
+}
+
+double BandScheduler::GetShare(uint32_t device) const
+{
+	auto sum = 0.0;
+	for (const auto& info : m_devices) sum += info.Throughput;
+
+	return sum > 0.0 ? m_devices[device].Throughput / sum : 0.0;
+}
@@ -0,0 +1,61 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Splits the rows of an image into one band per device, sized in proportion to the measured
+// throughput of each device, so that all devices finish at about the same time. Throughputs
+// are smoothed over the reported runs. The scheduler knows nothing about the devices; they
+// are driven through a callback, so simulated devices of any speed can stand in for them.
+class BandScheduler
+{
+public:
+	struct Band
+	{
+		uint32_t Device;
+		uint32_t Y;
+		uint32_t Height;
+	};
+
+	BandScheduler(uint32_t rowGranularity = DefaultRowGranularity, double smoothing = DefaultSmoothing);
+	virtual ~BandScheduler();
+
+	// Registers a device with an initial throughput guess in pixels per ms, or with the
+	// average of the other devices if 0; returns the device index.
+	uint32_t AddDevice(double initialThroughput = 0.0);
+
+	// Splits the rows [y, y + height) into bands; devices whose share rounds to no rows are skipped.
+	void Split(uint32_t y, uint32_t height, std::vector<Band>& bands) const;
+
+	// Reports the time in ms that a device took for its band.
+	void Report(uint32_t device, uint64_t numPixels, double time);
+
+	// Processes the rows [0, height) in rounds. Each round is split among the devices, whose
+	// bands run concurrently through processBand, which returns the time of the band in ms;
+	// the times are reported, so that the next round is split by the updated throughputs.
+	void Run(uint32_t width, uint32_t height, uint32_t numRounds,
+		const std::function<double(const Band&)>& processBand);
+
+	uint32_t GetNumDevices() const;
+	double GetThroughput(uint32_t device) const;	// In pixels per ms
+	double GetShare(uint32_t device) const;
+
+	static const uint32_t DefaultRowGranularity = 16;
+	static constexpr double DefaultSmoothing = 0.5;	// Weight of the latest measurement
+
+protected:
+	struct DeviceInfo
+	{
+		double Throughput;
+		bool IsMeasured;
+	};
+
+	std::vector<DeviceInfo> m_devices;
+	uint32_t m_rowGranularity;
+	double m_smoothing;
+};
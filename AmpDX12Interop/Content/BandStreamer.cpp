@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "BandStreamer.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+BandStreamer::BandStreamer()
+{
+}
+
+BandStreamer::~BandStreamer()
+{
+}
+
+bool BandStreamer::Run(BandReader& reader, BandWriter& writer, uint32_t bandHeight, uint32_t haloSize,
+	const function<bool(const Band&)>& processBand)
+{
+	uint32_t width, height;
+	reader.GetImageSize(width, height);
+	if (width == 0 || height == 0) return false;
+
+	bandHeight = (max)((min)(bandHeight, height), 1u);
+	haloSize = (min)(haloSize, height);
+
+	// The source band holds the band with its halo, and the result band the band only
+	Band band = {};
+	band.SourceRowPitch = static_cast<size_t>(4 * reader.GetBytesPerChannel()) * width;
+	band.ResultRowPitch = sizeof(uint32_t) * static_cast<size_t>(width);
+	const auto maxSrcHeight = (min)(bandHeight + 2 * haloSize, height);
+	const auto pSource = m_source.Reserve(band.SourceRowPitch * maxSrcHeight);
+	band.pResult = m_result.Reserve(band.ResultRowPitch * bandHeight);
+	if (!pSource || !band.pResult) return false;
+	band.pSource = pSource;
+
+	// Source rows [loadedY, loadedEnd) are in the source band
+	auto loadedY = 0u, loadedEnd = 0u;
+	for (auto y = 0u; y < height; y += bandHeight)
+	{
+		band.Y = y;
+		band.Height = (min)(bandHeight, height - y);
+		band.SrcY = y > haloSize ? y - haloSize : 0;
+		const auto srcEnd = (min)(y + band.Height + haloSize, height);
+		band.SrcHeight = srcEnd - band.SrcY;
+
+		// Carry over the rows shared with the previous band, and read the rest
+		if (loadedEnd > band.SrcY)
+			memmove(pSource, &pSource[band.SourceRowPitch * (band.SrcY - loadedY)],
+				band.SourceRowPitch * (loadedEnd - band.SrcY));
+		else loadedEnd = band.SrcY;
+		if (!reader.ReadRows(&pSource[band.SourceRowPitch * (loadedEnd - band.SrcY)], band.SourceRowPitch,
+			loadedEnd, srcEnd - loadedEnd))
+			return false;
+		loadedY = band.SrcY;
+		loadedEnd = srcEnd;
+
+		if (!processBand(band)) return false;
+		if (!writer.WriteRows(band.pResult, band.ResultRowPitch, band.Height)) return false;
+	}
+
+	return true;
+}
+
+size_t BandStreamer::GetBufferSize() const
+{
+	return m_source.GetCapacity() + m_result.GetCapacity();
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "AlignedBuffer.h"
+#include "BandReader.h"
+#include "BandWriter.h"
+#include <functional>
+
+// Streams an image from a band reader to a band writer, one band of rows at a time, with
+// a halo of rows above and below each band (clamped to the image) for neighborhood ops.
+// The halo rows shared by consecutive bands are carried over, so that every row is read
+// once and in order, and only one band of the source and of the result is in memory.
+class BandStreamer
+{
+public:
+	struct Band
+	{
+		uint32_t Y;					// Rows of the result
+		uint32_t Height;
+		uint32_t SrcY;				// Rows of the source, including the halo
+		uint32_t SrcHeight;
+
+		const uint8_t* pSource;		// Row SrcY, of RGBA pixels in the format of the reader
+		size_t SourceRowPitch;
+		uint8_t* pResult;			// Row Y, of RGBA8 pixels
+		size_t ResultRowPitch;
+	};
+
+	BandStreamer();
+	virtual ~BandStreamer();
+
+	// Runs processBand on every band of the given height, which fills the result of the band.
+	bool Run(BandReader& reader, BandWriter& writer, uint32_t bandHeight, uint32_t haloSize,
+		const std::function<bool(const Band&)>& processBand);
+
+	size_t GetBufferSize() const;	// Of the source and result bands, in bytes
+
+protected:
+	AlignedBuffer m_source;
+	AlignedBuffer m_result;
+};
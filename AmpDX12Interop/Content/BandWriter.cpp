@@ -0,0 +1,279 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "BandWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace std;
+#ifdef _WIN32
+using namespace Microsoft::WRL;
+#else
+static void StoreBigEndian(uint8_t* pDst, uint32_t value)
+{
+	pDst[0] = static_cast<uint8_t>(value >> 24);
+	pDst[1] = static_cast<uint8_t>(value >> 16);
+	pDst[2] = static_cast<uint8_t>(value >> 8);
+	pDst[3] = static_cast<uint8_t>(value);
+}
+
+static uint32_t UpdateCRC32(uint32_t crc, const uint8_t* pData, size_t size)
+{
+	static uint32_t table[256] = {};
+	static const bool isTableReady = []()
+	{
+		for (auto i = 0u; i < 256; ++i)
+		{
+			auto c = i;
+			for (auto k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+
+		return true;
+	}();
+	(void)isTableReady;
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i) crc = table[(crc ^ pData[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static uint32_t UpdateAdler32(uint32_t adler, const uint8_t* pData, size_t size)
+{
+	// The sums stay in 32 bits over runs of 5552 bytes
+	static const size_t maxRun = 5552;
+	static const uint32_t modulus = 65521;
+
+	uint32_t a = adler & 0xffff, b = adler >> 16;
+	while (size > 0)
+	{
+		const auto run = (min)(size, maxRun);
+		for (size_t i = 0; i < run; ++i)
+		{
+			a += pData[i];
+			b += a;
+		}
+		a %= modulus;
+		b %= modulus;
+		pData += run;
+		size -= run;
+	}
+
+	return (b << 16) | a;
+}
+#endif
+
+BandWriter::BandWriter() :
+	m_width(0),
+	m_height(0),
+	m_numRowsWritten(0),
+#ifdef _WIN32
+	m_isBGRA(false),
+	m_isCOMInitialized(false)
+#else
+	m_pFile(nullptr),
+	m_adler(1)
+#endif
+{
+}
+
+BandWriter::~BandWriter()
+{
+	Close();
+}
+
+bool BandWriter::Open(const char* fileName, uint32_t width, uint32_t height)
+{
+	Close();
+	if (width == 0 || height == 0) return false;
+
+	m_width = width;
+	m_height = height;
+	m_numRowsWritten = 0;
+
+#ifdef _WIN32
+	m_isCOMInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+	const wstring fileNameW(fileName, fileName + strlen(fileName));
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_wicFactory))) ||
+		FAILED(m_wicFactory->CreateStream(&m_wicStream)) ||
+		FAILED(m_wicStream->InitializeFromFilename(fileNameW.c_str(), GENERIC_WRITE)) ||
+		FAILED(m_wicFactory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &m_wicEncoder)) ||
+		FAILED(m_wicEncoder->Initialize(m_wicStream.Get(), WICBitmapEncoderNoCache)) ||
+		FAILED(m_wicEncoder->CreateNewFrame(&m_wicFrame, nullptr)) ||
+		FAILED(m_wicFrame->Initialize(nullptr)) ||
+		FAILED(m_wicFrame->SetSize(width, height)))
+		return false;
+
+	// The encoder may pick the closest format it supports
+	auto pixelFormat = GUID_WICPixelFormat32bppRGBA;
+	if (FAILED(m_wicFrame->SetPixelFormat(&pixelFormat))) return false;
+	m_isBGRA = pixelFormat == GUID_WICPixelFormat32bppBGRA;
+
+	return m_isBGRA || pixelFormat == GUID_WICPixelFormat32bppRGBA;
+#else
+	m_pFile = fopen(fileName, "wb");
+	if (!m_pFile) return false;
+
+	// Signature, and the header of 8-bit RGBA without interlacing
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	uint8_t header[13] = {};
+	StoreBigEndian(&header[0], width);
+	StoreBigEndian(&header[4], height);
+	header[8] = 8;
+	header[9] = 6;
+	m_adler = 1;
+
+	return fwrite(signature, sizeof(signature), 1, m_pFile) == 1 && WriteChunk("IHDR", header, sizeof(header));
+#endif
+}
+
+bool BandWriter::WriteRows(const uint8_t* pSrc, size_t srcRowPitch, uint32_t numRows)
+{
+	if (numRows == 0) return true;
+	if (m_numRowsWritten + numRows > m_height) return false;
+
+	const size_t rowSize = 4 * m_width;
+#ifdef _WIN32
+	if (!m_wicFrame) return false;
+
+	if (m_isBGRA)
+	{
+		m_swizzled.resize(rowSize * numRows);
+		for (auto i = 0u; i < numRows; ++i)
+			for (size_t j = 0; j < rowSize; j += 4)
+			{
+				const auto pPixel = &pSrc[srcRowPitch * i + j];
+				const auto pDst = &m_swizzled[rowSize * i + j];
+				pDst[0] = pPixel[2];
+				pDst[1] = pPixel[1];
+				pDst[2] = pPixel[0];
+				pDst[3] = pPixel[3];
+			}
+		pSrc = m_swizzled.data();
+		srcRowPitch = rowSize;
+	}
+
+	if (FAILED(m_wicFrame->WritePixels(numRows, static_cast<UINT>(srcRowPitch),
+		static_cast<UINT>(srcRowPitch * (numRows - 1) + rowSize), const_cast<uint8_t*>(pSrc))))
+		return false;
+#else
+	if (!m_pFile) return false;
+
+	// The bands continue a single zlib stream of stored blocks of the filtered rows (filter type 0),
+	// which the first band opens and the last one closes, in IDAT chunks of a bounded size
+	static const size_t maxBlockSize = 0xffff;
+	static const size_t maxBlocksPerChunk = 256;
+	const auto isLast = m_numRowsWritten + numRows == m_height;
+	const auto rawSize = (rowSize + 1) * numRows;
+	const auto numBlocks = (rawSize + maxBlockSize - 1) / maxBlockSize;
+	m_chunk.reserve(2 + (5 + maxBlockSize) * maxBlocksPerChunk + 4);
+	m_chunk.clear();
+	if (m_numRowsWritten == 0)
+	{
+		// Deflate with a 32K window, and no preset dictionary
+		m_chunk.push_back(0x78);
+		m_chunk.push_back(0x01);
+	}
+
+	size_t rawOffset = 0;
+	for (size_t i = 0; i < numBlocks; ++i)
+	{
+		const auto blockSize = static_cast<uint16_t>((min)(rawSize - rawOffset, maxBlockSize));
+		const auto complement = static_cast<uint16_t>(~blockSize);
+		const uint8_t blockHeader[] =
+		{
+			static_cast<uint8_t>(isLast && i + 1 == numBlocks ? 1 : 0),
+			static_cast<uint8_t>(blockSize), static_cast<uint8_t>(blockSize >> 8),
+			static_cast<uint8_t>(complement), static_cast<uint8_t>(complement >> 8)
+		};
+		m_chunk.insert(m_chunk.end(), blockHeader, blockHeader + sizeof(blockHeader));
+
+		// Copy the block out of the rows, each led by its filter type
+		const auto blockOffset = m_chunk.size();
+		m_chunk.resize(blockOffset + blockSize);
+		auto pDst = &m_chunk[blockOffset];
+		for (const auto end = rawOffset + blockSize; rawOffset < end;)
+		{
+			const auto row = rawOffset / (rowSize + 1);
+			const auto column = rawOffset % (rowSize + 1);
+			if (column == 0)
+			{
+				*pDst++ = 0;
+				++rawOffset;
+				continue;
+			}
+
+			const auto size = (min)(rowSize + 1 - column, end - rawOffset);
+			memcpy(pDst, &pSrc[srcRowPitch * row + column - 1], size);
+			pDst += size;
+			rawOffset += size;
+		}
+		m_adler = UpdateAdler32(m_adler, &m_chunk[blockOffset], blockSize);
+
+		if (isLast && i + 1 == numBlocks)
+		{
+			uint8_t adler[4];
+			StoreBigEndian(adler, m_adler);
+			m_chunk.insert(m_chunk.end(), adler, adler + sizeof(adler));
+		}
+
+		if ((i + 1) % maxBlocksPerChunk == 0 || i + 1 == numBlocks)
+		{
+			if (!WriteChunk("IDAT", m_chunk.data(), m_chunk.size())) return false;
+			m_chunk.clear();
+		}
+	}
+#endif
+
+	m_numRowsWritten += numRows;
+
+	return true;
+}
+
+bool BandWriter::Close()
+{
+	const auto isComplete = m_height > 0 && m_numRowsWritten == m_height;
+	auto isWritten = true;
+
+#ifdef _WIN32
+	if (m_wicFrame) isWritten = isComplete && SUCCEEDED(m_wicFrame->Commit()) && SUCCEEDED(m_wicEncoder->Commit());
+	m_wicFrame = nullptr;
+	m_wicEncoder = nullptr;
+	m_wicStream = nullptr;
+	m_wicFactory = nullptr;
+	m_swizzled.clear();
+	if (m_isCOMInitialized) CoUninitialize();
+	m_isCOMInitialized = false;
+#else
+	if (m_pFile)
+	{
+		isWritten = isComplete && WriteChunk("IEND", nullptr, 0);
+		isWritten = fclose(m_pFile) == 0 && isWritten;
+	}
+	m_pFile = nullptr;
+	m_chunk.clear();
+#endif
+
+	const auto wasOpen = m_height > 0;
+	m_width = 0;
+	m_height = 0;
+	m_numRowsWritten = 0;
+
+	return wasOpen && isComplete && isWritten;
+}
+
+#ifndef _WIN32
+bool BandWriter::WriteChunk(const char* type, const uint8_t* pData, size_t size)
+{
+	uint8_t length[4], crc[4];
+	StoreBigEndian(length, static_cast<uint32_t>(size));
+	const auto pType = reinterpret_cast<const uint8_t*>(type);
+	StoreBigEndian(crc, UpdateCRC32(UpdateCRC32(0, pType, 4), pData, size));
+
+	return fwrite(length, sizeof(length), 1, m_pFile) == 1 && fwrite(type, 4, 1, m_pFile) == 1 &&
+		(size == 0 || fwrite(pData, size, 1, m_pFile) == 1) && fwrite(crc, sizeof(crc), 1, m_pFile) == 1;
+}
+#endif
@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#ifdef _WIN32
+#include <wincodec.h>
+#endif
+
+// Writes an RGBA8 PNG band by band, top down, as the bands are produced, so that the
+// whole image is never held in memory. On Windows, the WIC PNG encoder compresses the
+// bands; elsewhere, they are written as stored (uncompressed) deflate blocks, since
+// stb_image_write only compresses whole images.
+class BandWriter
+{
+public:
+	BandWriter();
+	virtual ~BandWriter();
+
+	bool Open(const char* fileName, uint32_t width, uint32_t height);
+
+	// Appends the next rows of the full width, at the given source row pitch.
+	bool WriteRows(const uint8_t* pSrc, size_t srcRowPitch, uint32_t numRows);
+
+	// Finishes the file; fails if any row is missing.
+	bool Close();
+
+protected:
+#ifndef _WIN32
+	bool WriteChunk(const char* type, const uint8_t* pData, size_t size);
+#endif
+
+	uint32_t	m_width;
+	uint32_t	m_height;
+	uint32_t	m_numRowsWritten;
+
+#ifdef _WIN32
+	Microsoft::WRL::ComPtr<IWICImagingFactory> m_wicFactory;
+	Microsoft::WRL::ComPtr<IWICStream> m_wicStream;
+	Microsoft::WRL::ComPtr<IWICBitmapEncoder> m_wicEncoder;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameEncode> m_wicFrame;
+	std::vector<uint8_t> m_swizzled;	// For an encoder that only takes BGRA
+	bool m_isBGRA;
+	bool m_isCOMInitialized;
+#else
+	FILE*		m_pFile;
+	uint32_t	m_adler;	// Of the zlib stream
+	std::vector<uint8_t> m_chunk;
+#endif
+};
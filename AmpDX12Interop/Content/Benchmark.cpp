@@ -0,0 +1,113 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+using namespace std;
+
+Benchmark::Benchmark(uint32_t numIterations) :
+	m_numIterations((max)(numIterations, 1u))
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+bool Benchmark::Run(const string& name, const function<bool()>& func, double amount,
+	const char* unit, const function<void(bool)>& prepare)
+{
+	return RunMeasured(name, [&func](double& time)
+	{
+		const auto startTime = chrono::steady_clock::now();
+		const auto isDone = func();
+		time = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+		return isDone;
+	}, amount, unit, prepare);
+}
+
+bool Benchmark::RunMeasured(const string& name, const function<bool(double&)>& func, double amount,
+	const char* unit, const function<void(bool)>& prepare)
+{
+	Result result = { name, 0.0, {}, amount, unit ? unit : "" };
+	result.WarmTimes.reserve(m_numIterations);
+
+	for (auto i = 0u; i <= m_numIterations; ++i)
+	{
+		if (prepare) prepare(i == 0);
+
+		auto time = 0.0;
+		if (!func(time)) return false;
+
+		if (i == 0) result.ColdTime = time;
+		else result.WarmTimes.push_back(time);
+	}
+
+	m_results.emplace_back(move(result));
+
+	return true;
+}
+
+void Benchmark::Print(ostream& os, const char* title) const
+{
+	os << title << " (cold run, then " << m_numIterations << " warm iterations; ms)" << endl;
+	for (const auto& result : m_results)
+	{
+		const auto median = GetMedianTime(result);
+		os << "    " << result.Name << ": cold " << result.ColdTime << ", warm min " << GetMinTime(result)
+			<< ", median " << median << ", mean " << GetMeanTime(result);
+		if (result.Amount > 0.0)
+		{
+			os << "; " << result.Amount * 1000.0 / result.ColdTime << " " << result.Unit << "/s cold, ";
+			os << result.Amount * 1000.0 / median << " " << result.Unit << "/s warm";
+		}
+		os << endl;
+	}
+}
+
+void Benchmark::Clear()
+{
+	m_results.clear();
+}
+
+uint32_t Benchmark::GetNumIterations() const
+{
+	return m_numIterations;
+}
+
+const vector<Benchmark::Result>& Benchmark::GetResults() const
+{
+	return m_results;
+}
+
+double Benchmark::GetMinTime(const Result& result)
+{
+	return result.WarmTimes.empty() ? 0.0 : *min_element(result.WarmTimes.cbegin(), result.WarmTimes.cend());
+}
+
+double Benchmark::GetMedianTime(const Result& result)
+{
+	if (result.WarmTimes.empty()) return 0.0;
+
+	auto times = result.WarmTimes;
+	const auto mid = times.size() / 2;
+	nth_element(times.begin(), times.begin() + mid, times.end());
+	if (times.size() % 2) return times[mid];
+
+	// The mean of the middle two
+	const auto lower = *max_element(times.cbegin(), times.cbegin() + mid);
+
+	return (lower + times[mid]) / 2.0;
+}
+
+double Benchmark::GetMeanTime(const Result& result)
+{
+	if (result.WarmTimes.empty()) return 0.0;
+
+	return accumulate(result.WarmTimes.cbegin(), result.WarmTimes.cend(), 0.0) / result.WarmTimes.size();
+}
@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Times repeatable measurements: a cold run first, then a number of warm iterations. The cold
+// run pays the one-off costs (first touch of the files and allocations, cache misses), so it is
+// reported apart from the warm runs, of which the median is the steady state. Each measurement
+// may name the amount of work of a run, such as pixels or images, to report its throughput.
+class Benchmark
+{
+public:
+	struct Result
+	{
+		std::string Name;
+		double ColdTime;			// In ms
+		std::vector<double> WarmTimes;
+		double Amount;				// Of work per run, or 0
+		std::string Unit;
+	};
+
+	Benchmark(uint32_t numIterations = DefaultNumIterations);
+	virtual ~Benchmark();
+
+	// Runs the function cold once and warm numIterations times, timing each run; prepare, if any,
+	// runs untimed before each run, told whether it is the cold one. Fails if any run fails.
+	bool Run(const std::string& name, const std::function<bool()>& func, double amount = 0.0,
+		const char* unit = nullptr, const std::function<void(bool)>& prepare = nullptr);
+
+	// As Run(), but the function measures its runs itself, returning the time in ms of the part
+	// it measures, such as a stage of a pipeline whose other stages are not to be timed.
+	bool RunMeasured(const std::string& name, const std::function<bool(double&)>& func, double amount = 0.0,
+		const char* unit = nullptr, const std::function<void(bool)>& prepare = nullptr);
+
+	// Prints the results under the title, one line per measurement.
+	void Print(std::ostream& os, const char* title) const;
+	void Clear();
+
+	uint32_t GetNumIterations() const;
+	const std::vector<Result>& GetResults() const;
+
+	static double GetMinTime(const Result& result);
+	static double GetMedianTime(const Result& result);
+	static double GetMeanTime(const Result& result);
+
+	static const uint32_t DefaultNumIterations = 5;
+
+protected:
+	std::vector<Result> m_results;
+	uint32_t m_numIterations;
+};
@@ -0,0 +1,131 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "CPUTiledProcessor.h"
+#include "PixelKernels.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace std;
+
+CPUTiledProcessor::CPUTiledProcessor(uint32_t numWorkers) :
+	m_numWorkers(numWorkers > 0 ? numWorkers : (max)(thread::hardware_concurrency(), 1u)),
+	m_numTiles(0),
+	m_processTime(0.0)
+{
+	m_workBuffers.resize(m_numWorkers);
+}
+
+CPUTiledProcessor::~CPUTiledProcessor()
+{
+}
+
+bool CPUTiledProcessor::Process(BandReader& reader, BandWriter& writer, uint32_t tileSize, uint32_t haloSize)
+{
+	const auto startTime = chrono::steady_clock::now();
+
+	uint32_t width, height;
+	reader.GetImageSize(width, height);
+	tileSize = (max)(tileSize, 1u);
+	const auto numTilesX = (width + tileSize - 1) / tileSize;
+	const auto bytesPerChannel = reader.GetBytesPerChannel();
+	m_numTiles = 0;
+
+	// The workers take the tiles of a band in turn
+	const auto processBand = [&](const BandStreamer::Band& band)
+	{
+		atomic<uint32_t> nextTile(0);
+		const auto work = [&](AlignedBuffer& workBuffer)
+		{
+			for (auto i = nextTile++; i < numTilesX; i = nextTile++)
+			{
+				const auto x = tileSize * i;
+				ProcessTile(band, x, (min)(tileSize, width - x), bytesPerChannel, workBuffer);
+			}
+		};
+
+		const auto numWorkers = (min)(m_numWorkers, numTilesX);
+		vector<future<void>> workers;
+		for (auto i = 1u; i < numWorkers; ++i) workers.emplace_back(async(launch::async, work, ref(m_workBuffers[i])));
+		work(m_workBuffers[0]);
+		for (auto& worker : workers) worker.get();
+		m_numTiles += numTilesX;
+
+		return true;
+	};
+
+	const auto isProcessed = m_streamer.Run(reader, writer, tileSize, haloSize, processBand);
+	m_processTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	return isProcessed;
+}
+
+uint32_t CPUTiledProcessor::GetNumTiles() const
+{
+	return m_numTiles;
+}
+
+double CPUTiledProcessor::GetProcessTime() const
+{
+	return m_processTime;
+}
+
+size_t CPUTiledProcessor::GetBufferSize() const
+{
+	auto size = m_streamer.GetBufferSize();
+	for (const auto& workBuffer : m_workBuffers) size += workBuffer.GetCapacity();
+
+	return size;
+}
+
+void CPUTiledProcessor::ProcessTile(const BandStreamer::Band& band, uint32_t x, uint32_t width,
+	uint8_t bytesPerChannel, AlignedBuffer& workBuffer) const
+{
+	const size_t texelSize = 4 * bytesPerChannel;
+	const auto haloY = band.Y - band.SrcY;
+
+	// Texels of more than 8 bits are rounded to 8 bits first, as the fixed-point AMP kernel does
+	const auto pRow8 = bytesPerChannel == sizeof(uint16_t) ? workBuffer.Reserve(sizeof(uint32_t) * width) : nullptr;
+	if (bytesPerChannel == sizeof(uint16_t) && !pRow8) throw bad_alloc();
+
+	for (auto i = 0u; i < band.Height; ++i)
+	{
+		const auto pSrc = &band.pSource[band.SourceRowPitch * (haloY + i) + texelSize * x];
+		const auto pDst = &band.pResult[band.ResultRowPitch * i + sizeof(uint32_t) * x];
+
+		switch (bytesPerChannel)
+		{
+		case sizeof(uint8_t):
+			PixelKernels::ConvertRGBAToLuma(pDst, pSrc, width);
+			break;
+		case sizeof(uint16_t):
+		{
+			const auto pSrc16 = reinterpret_cast<const uint16_t*>(pSrc);
+			for (size_t j = 0; j < 4 * width; ++j) pRow8[j] = static_cast<uint8_t>((pSrc16[j] + 128) / 257);
+			PixelKernels::ConvertRGBAToLuma(pDst, pRow8, width);
+			break;
+		}
+		default:
+		{
+			// Reinhard tone mapping of the luma, as the AMP kernel maps HDR sources
+			const auto pSrcF = reinterpret_cast<const float*>(pSrc);
+			const auto toUnorm8 = [](float value)
+			{
+				return static_cast<uint8_t>((min)((max)(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+			};
+			for (size_t j = 0; j < width; ++j)
+			{
+				const auto pTexel = &pSrcF[4 * j];
+				const auto luma = (max)(0.299f * pTexel[0] + 0.587f * pTexel[1] + 0.114f * pTexel[2], 0.0f);
+				const auto grey = toUnorm8(luma / (1.0f + luma));
+				pDst[4 * j] = pDst[4 * j + 1] = pDst[4 * j + 2] = grey;
+				pDst[4 * j + 3] = toUnorm8(pTexel[3]);
+			}
+		}
+		}
+	}
+}
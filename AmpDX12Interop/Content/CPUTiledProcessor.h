@@ -0,0 +1,41 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "BandStreamer.h"
+
+// Processes images tile by tile on CPU worker threads, with no accelerator, so that it
+// runs on any platform. Bands of tile rows are streamed from the file to the output with
+// their halos, as in the AMP tiled path, and the tiles of a band are shared among the
+// workers; the halo columns of a tile are read from the band. The grey is the fixed-point
+// luma of the pixel kernels, as the fixed-point AMP kernel computes it, except for HDR
+// sources, which are tone-mapped from the float luma.
+class CPUTiledProcessor
+{
+public:
+	CPUTiledProcessor(uint32_t numWorkers = 0);	// 0 for the hardware concurrency
+	virtual ~CPUTiledProcessor();
+
+	bool Process(BandReader& reader, BandWriter& writer,
+		uint32_t tileSize = DefaultTileSize, uint32_t haloSize = DefaultHaloSize);
+
+	uint32_t GetNumTiles() const;
+	double GetProcessTime() const;
+	size_t GetBufferSize() const;	// Of the bands and the working buffers, in bytes
+
+	static const uint32_t DefaultTileSize = 256;
+	static const uint32_t DefaultHaloSize = 16;
+
+protected:
+	void ProcessTile(const BandStreamer::Band& band, uint32_t x, uint32_t width,
+		uint8_t bytesPerChannel, AlignedBuffer& workBuffer) const;
+
+	BandStreamer				m_streamer;
+	std::vector<AlignedBuffer>	m_workBuffers;
+
+	uint32_t	m_numWorkers;
+	uint32_t	m_numTiles;
+	double		m_processTime;
+};
@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "DirtyRegion.h"
+
+using namespace std;
+
+DirtyRegion::DirtyRegion(uint32_t tileSize, float minCoverage) :
+	m_bounds(),
+	m_tileSize((max)(tileSize, 1u)),
+	m_minCoverage(minCoverage)
+{
+}
+
+DirtyRegion::~DirtyRegion()
+{
+}
+
+void DirtyRegion::SetBounds(uint32_t width, uint32_t height)
+{
+	m_bounds = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+	m_rects.clear();
+}
+
+void DirtyRegion::Add(const RECT& rect)
+{
+	// An empty rect would otherwise be snapped out to a whole tile
+	if (IsRectEmpty(&rect)) return;
+
+	// Snap out to the tiles
+	const auto tileSize = static_cast<LONG>(m_tileSize);
+	RECT tileRect;
+	tileRect.left = (max)(rect.left, 0L) / tileSize * tileSize;
+	tileRect.top = (max)(rect.top, 0L) / tileSize * tileSize;
+	tileRect.right = ((max)(rect.right, 0L) + tileSize - 1) / tileSize * tileSize;
+	tileRect.bottom = ((max)(rect.bottom, 0L) + tileSize - 1) / tileSize * tileSize;
+
+	RECT clippedRect;
+	if (!IntersectRect(&clippedRect, &tileRect, &m_bounds)) return;
+
+	// Skip the rects that are covered already
+	for (const auto& dirtyRect : m_rects)
+	{
+		RECT unionRect;
+		UnionRect(&unionRect, &dirtyRect, &clippedRect);
+		if (EqualRect(&unionRect, &dirtyRect)) return;
+	}
+
+	m_rects.emplace_back(clippedRect);
+	Merge();
+}
+
+void DirtyRegion::AddAll()
+{
+	m_rects.assign(1, m_bounds);
+	if (IsRectEmpty(&m_bounds)) m_rects.clear();
+}
+
+void DirtyRegion::Clear()
+{
+	m_rects.clear();
+}
+
+bool DirtyRegion::IsEmpty() const
+{
+	return m_rects.empty();
+}
+
+const vector<RECT>& DirtyRegion::GetRects() const
+{
+	return m_rects;
+}
+
+uint64_t DirtyRegion::GetArea() const
+{
+	uint64_t area = 0;
+	for (const auto& rect : m_rects) area += GetArea(rect);
+
+	return area;
+}
+
+uint64_t DirtyRegion::GetArea(const RECT& rect)
+{
+	return static_cast<uint64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+void DirtyRegion::Merge()
+{
+	// Merge the pairs whose bounding rects are covered well enough, until none is left
+	for (auto isMerged = true; isMerged;)
+	{
+		isMerged = false;
+		for (size_t i = 0; i < m_rects.size() && !isMerged; ++i)
+		{
+			for (auto j = i + 1; j < m_rects.size() && !isMerged; ++j)
+			{
+				RECT unionRect, intersectRect;
+				UnionRect(&unionRect, &m_rects[i], &m_rects[j]);
+				const auto overlap = IntersectRect(&intersectRect, &m_rects[i], &m_rects[j]) ? GetArea(intersectRect) : 0;
+				const auto coveredArea = GetArea(m_rects[i]) + GetArea(m_rects[j]) - overlap;
+				if (coveredArea >= m_minCoverage * GetArea(unionRect))
+				{
+					m_rects[i] = unionRect;
+					m_rects.erase(m_rects.begin() + j);
+					isMerged = true;
+				}
+			}
+		}
+	}
+
+	// Keep the list short, by merging the pairs that waste the least
+	while (m_rects.size() > MaxRects)
+	{
+		auto minWaste = UINT64_MAX;
+		size_t mergeI = 0, mergeJ = 1;
+		for (size_t i = 0; i < m_rects.size(); ++i)
+		{
+			for (auto j = i + 1; j < m_rects.size(); ++j)
+			{
+				RECT unionRect;
+				UnionRect(&unionRect, &m_rects[i], &m_rects[j]);
+				const auto unionArea = GetArea(unionRect);
+				const auto area = GetArea(m_rects[i]) + GetArea(m_rects[j]);
+				const auto waste = unionArea > area ? unionArea - area : 0;
+				if (waste < minWaste)
+				{
+					minWaste = waste;
+					mergeI = i;
+					mergeJ = j;
+				}
+			}
+		}
+
+		UnionRect(&m_rects[mergeI], &m_rects[mergeI], &m_rects[mergeJ]);
+		m_rects.erase(m_rects.begin() + mergeJ);
+	}
+}
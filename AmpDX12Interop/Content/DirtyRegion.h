@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Out-of-date region of a 2D resource, kept as a short list of rects. The added rects are
+// snapped out to a tile grid and clipped to the bounds; two rects are merged whenever their
+// bounding rect is mostly covered by them, so that a few tile-aligned dispatches cover the
+// changes with little waste. Beyond MaxRects, the pair that wastes the least is merged.
+class DirtyRegion
+{
+public:
+	DirtyRegion(uint32_t tileSize = DefaultTileSize, float minCoverage = DefaultMinCoverage);
+	virtual ~DirtyRegion();
+
+	void SetBounds(uint32_t width, uint32_t height);
+
+	void Add(const RECT& rect);
+	void AddAll();
+	void Clear();
+
+	bool IsEmpty() const;
+	const std::vector<RECT>& GetRects() const;
+	uint64_t GetArea() const;	// Counting the overlaps of the rects
+
+	static const uint32_t DefaultTileSize = 16;
+	static constexpr float DefaultMinCoverage = 0.75f;
+	static const uint32_t MaxRects = 8;
+
+protected:
+	static uint64_t GetArea(const RECT& rect);
+
+	void Merge();
+
+	std::vector<RECT>	m_rects;
+	RECT				m_bounds;
+	uint32_t			m_tileSize;
+	float				m_minCoverage;
+};
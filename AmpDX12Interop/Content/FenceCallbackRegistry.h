@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Registry of CPU-side completions for async GPU->CPU transfers. Each callback is
+// tagged with the fence value signaled after its submission, and fires as soon as
+// the fence has passed that value.
+class FenceCallbackRegistry
+{
+public:
+	using Callback = std::function<void()>;
+
+	void Register(uint64_t fenceValue, const Callback& callback)
+	{
+		// Keep the callbacks sorted by fence value, FIFO for equal values
+		const auto it = std::upper_bound(m_callbacks.begin(), m_callbacks.end(), fenceValue,
+			[](uint64_t value, const Entry& entry) { return value < entry.first; });
+		m_callbacks.emplace(it, fenceValue, callback);
+	}
+
+	// Fires all the callbacks whose fence values have been completed.
+	uint32_t Poll(uint64_t completedValue)
+	{
+		const auto it = std::upper_bound(m_callbacks.begin(), m_callbacks.end(), completedValue,
+			[](uint64_t value, const Entry& entry) { return value < entry.first; });
+
+		// Move the ready callbacks out first, since a callback may register new ones.
+		std::vector<Entry> readyCallbacks(std::make_move_iterator(m_callbacks.begin()),
+			std::make_move_iterator(it));
+		m_callbacks.erase(m_callbacks.begin(), it);
+
+		for (auto& callback : readyCallbacks) callback.second();
+
+		return static_cast<uint32_t>(readyCallbacks.size());
+	}
+
+	bool IsEmpty() const { return m_callbacks.empty(); }
+
+	// The smallest fence value with a pending callback; the registry must not be empty.
+	uint64_t GetNextFenceValue() const { return m_callbacks.front().first; }
+
+protected:
+	using Entry = std::pair<uint64_t, Callback>;
+
+	std::vector<Entry> m_callbacks;
+};
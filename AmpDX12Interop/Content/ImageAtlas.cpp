@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ImageAtlas.h"
+
+using namespace std;
+using namespace XUSG;
+
+ImageAtlas::ImageAtlas() :
+	m_pData(nullptr),
+	m_footprint(),
+	m_width(0),
+	m_height(0),
+	m_shelfX(0),
+	m_shelfY(0),
+	m_shelfHeight(0),
+	m_numImages(0),
+	m_numPackedPixels(0)
+{
+}
+
+ImageAtlas::~ImageAtlas()
+{
+	if (m_pData && m_uploader) m_uploader->Unmap();
+}
+
+bool ImageAtlas::Init(const Device* pDevice, uint32_t width, uint32_t height)
+{
+	m_width = width;
+	m_height = height;
+
+	// Get the placed footprint of the whole atlas
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Width = width;
+	desc.Height = height;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	const auto pDevice12 = static_cast<ID3D12Device*>(pDevice->GetHandle());
+	uint64_t uploaderSize;
+	pDevice12->GetCopyableFootprints(&desc, 0, 1, 0, &m_footprint, nullptr, nullptr, &uploaderSize);
+
+	m_uploader = Buffer::MakeUnique();
+	XUSG_N_RETURN(m_uploader->Create(pDevice, static_cast<size_t>(uploaderSize), ResourceFlag::NONE,
+		MemoryType::UPLOAD, 0, nullptr, 0, nullptr, MemoryFlag::NONE, L"AtlasUploader"), false);
+	m_pData = static_cast<uint8_t*>(m_uploader->Map(nullptr));
+	XUSG_N_RETURN(m_pData, false);
+
+	Reset();
+
+	return true;
+}
+
+bool ImageAtlas::Init(uint32_t width, uint32_t height)
+{
+	if (m_pData && m_uploader) m_uploader->Unmap();
+	m_uploader.reset();
+	m_width = width;
+	m_height = height;
+
+	// Tightly packed rows
+	m_footprint = {};
+	m_footprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	m_footprint.Footprint.Width = width;
+	m_footprint.Footprint.Height = height;
+	m_footprint.Footprint.Depth = 1;
+	m_footprint.Footprint.RowPitch = sizeof(uint32_t) * width;
+	m_pData = m_pixels.Reserve(static_cast<size_t>(m_footprint.Footprint.RowPitch) * height);
+	XUSG_N_RETURN(m_pData, false);
+
+	Reset();
+
+	return true;
+}
+
+void ImageAtlas::Reset()
+{
+	m_shelfX = 0;
+	m_shelfY = 0;
+	m_shelfHeight = 0;
+	m_numImages = 0;
+	m_numPackedPixels = 0;
+}
+
+bool ImageAtlas::Insert(const ImageLoader& imageLoader, Region& region)
+{
+	uint32_t width, height;
+	imageLoader.GetImageSize(width, height);
+	assert(width <= m_width);
+
+	// Open a new shelf below the current one, if the image does not fit in its remaining width
+	if (m_shelfX + width > m_width)
+	{
+		m_shelfY += m_shelfHeight;
+		m_shelfX = 0;
+		m_shelfHeight = 0;
+	}
+	if (m_shelfY + height > m_height) return false;
+
+	region.X = m_shelfX;
+	region.Y = m_shelfY;
+	region.Width = width;
+	region.Height = height;
+
+	const auto rowPitch = m_footprint.Footprint.RowPitch;
+	imageLoader.WriteRegion(&m_pData[m_footprint.Offset + rowPitch * region.Y + sizeof(uint32_t) * region.X],
+		rowPitch, 0, 0, width, height);
+
+	m_shelfX += width;
+	m_shelfHeight = (max)(m_shelfHeight, height);
+	m_numPackedPixels += static_cast<uint64_t>(width) * height;
+	++m_numImages;
+
+	return true;
+}
+
+void ImageAtlas::Upload(CommandList* pCommandList, Texture* pTexture) const
+{
+	ResourceBarrier barrier;
+	auto numBarriers = pTexture->SetBarrier(&barrier, ResourceState::COPY_DEST);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	D3D12_TEXTURE_COPY_LOCATION dst = {};
+	dst.pResource = static_cast<ID3D12Resource*>(pTexture->GetHandle());
+	dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	dst.SubresourceIndex = 0;
+
+	D3D12_TEXTURE_COPY_LOCATION src = {};
+	src.pResource = static_cast<ID3D12Resource*>(m_uploader->GetHandle());
+	src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	src.PlacedFootprint = m_footprint;
+
+	// Only the rows of the packed shelves are copied
+	const D3D12_BOX srcBox = { 0, 0, 0, m_width, GetPackedHeight(), 1 };
+	const auto pCommandList12 = static_cast<ID3D12GraphicsCommandList*>(pCommandList->GetHandle());
+	pCommandList12->CopyTextureRegion(&dst, 0, 0, 0, &src, &srcBox);
+
+	numBarriers = pTexture->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, &barrier);
+}
+
+const uint8_t* ImageAtlas::GetPixels() const
+{
+	assert(!m_uploader);
+
+	return m_pData;
+}
+
+uint32_t ImageAtlas::GetWidth() const
+{
+	return m_width;
+}
+
+uint32_t ImageAtlas::GetUsedHeight() const
+{
+	const auto usedHeight = XUSG_DIV_UP(m_shelfY + m_shelfHeight, HeightGranularity) * HeightGranularity;
+
+	return (min)(usedHeight, m_height);
+}
+
+uint32_t ImageAtlas::GetPackedHeight() const
+{
+	return m_shelfY + m_shelfHeight;
+}
+
+uint32_t ImageAtlas::GetNumImages() const
+{
+	return m_numImages;
+}
+
+double ImageAtlas::GetOccupancy() const
+{
+	const auto usedArea = static_cast<double>(m_width) * (m_shelfY + m_shelfHeight);
+
+	return usedArea > 0.0 ? m_numPackedPixels / usedArea : 0.0;
+}
+
+bool ImageAtlas::IsPackable(const ImageLoader& imageLoader)
+{
+	uint32_t width, height;
+	imageLoader.GetImageSize(width, height);
+
+	return !imageLoader.IsDDS() && imageLoader.GetFormat() == Format::R8G8B8A8_UNORM &&
+		width <= MaxImageSize && height <= MaxImageSize;
+}
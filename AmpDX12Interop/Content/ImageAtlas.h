@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+#include "ImageLoader.h"
+#include "AlignedBuffer.h"
+
+// Packs many small images into one atlas, so that they share a single upload, dispatch and
+// read-back instead of paying the per-image overhead each. Images are placed with a shelf
+// packer in arrival order, and written straight into a persistently mapped upload buffer at
+// the atlas row pitch. The kernel samples at texel centers, so no gutters are needed. An
+// atlas initialized without a device is packed in CPU memory instead, for the CPU workers.
+class ImageAtlas
+{
+public:
+	struct Region
+	{
+		uint32_t X;
+		uint32_t Y;
+		uint32_t Width;
+		uint32_t Height;
+	};
+
+	ImageAtlas();
+	virtual ~ImageAtlas();
+
+	bool Init(const XUSG::Device* pDevice, uint32_t width = DefaultSize, uint32_t height = DefaultSize);
+	bool Init(uint32_t width = DefaultSize, uint32_t height = DefaultSize);
+
+	// Starts a new atlas; the upload of the previous one must have completed.
+	void Reset();
+
+	// Packs the image and writes its pixels at its region; fails if the atlas is full.
+	bool Insert(const ImageLoader& imageLoader, Region& region);
+
+	// Records the copy of the used rows into the texture, leaving it as a shader resource.
+	void Upload(XUSG::CommandList* pCommandList, XUSG::Texture* pTexture) const;
+
+	// RGBA8 pixels of an atlas in CPU memory, at the row pitch of the atlas width
+	const uint8_t* GetPixels() const;
+
+	uint32_t GetWidth() const;
+	uint32_t GetUsedHeight() const;	// Rounded up to the height granularity
+	uint32_t GetPackedHeight() const;	// Of the packed shelves
+	uint32_t GetNumImages() const;
+	double GetOccupancy() const;	// Ratio of the packed pixels in the used area
+
+	static bool IsPackable(const ImageLoader& imageLoader);
+
+	static const uint32_t DefaultSize = 2048;
+	static const uint32_t MaxImageSize = 256;
+
+	// Atlases are sized in steps of the granularity, so that their textures are pooled
+	static const uint32_t HeightGranularity = 256;
+
+protected:
+	XUSG::Buffer::uptr	m_uploader;
+	AlignedBuffer		m_pixels;	// Instead of the uploader, without a device
+	uint8_t*			m_pData;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_footprint;
+
+	uint32_t			m_width;
+	uint32_t			m_height;
+
+	// Current shelf
+	uint32_t			m_shelfX;
+	uint32_t			m_shelfY;
+	uint32_t			m_shelfHeight;
+
+	uint32_t			m_numImages;
+	uint64_t			m_numPackedPixels;
+};
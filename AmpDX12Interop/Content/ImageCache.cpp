@@ -0,0 +1,205 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ImageCache.h"
+
+using namespace std;
+
+static const uint32_t g_cacheMagic = 0x31434941; // "AIC1"
+static const uint32_t g_cacheVersion = 2;
+
+ImageCache::ImageCache() :
+	m_maxSize(0)
+{
+}
+
+ImageCache::~ImageCache()
+{
+}
+
+bool ImageCache::Init(const char* cacheDir, uint64_t maxSize)
+{
+	m_cacheDir = cacheDir;
+	if (!m_cacheDir.empty() && m_cacheDir.back() != '/' && m_cacheDir.back() != '\\')
+		m_cacheDir += '/';
+	m_maxSize = maxSize;
+
+	if (!CreateDirectoryA(m_cacheDir.c_str(), nullptr))
+		XUSG_M_RETURN(GetLastError() != ERROR_ALREADY_EXISTS, cerr, "Failed to create the image cache directory.", false);
+
+	return true;
+}
+
+bool ImageCache::Find(uint64_t key, Entry& entry, MappedFile& file) const
+{
+	const auto fileName = GetFileName(key);
+	XUSG_N_RETURN(file.Open(fileName.c_str()), false);
+
+	// Validate the entry
+	if (file.GetSize() < PageSize)
+	{
+		file.Close();
+		return false;
+	}
+
+	const auto& header = *reinterpret_cast<const Header*>(file.GetData());
+	if (header.Magic != g_cacheMagic || header.Version != g_cacheVersion ||
+		file.GetSize() < PageSize + header.DataSize ||
+		header.DataSize != static_cast<uint64_t>(header.Width) * header.Height * header.Channels * header.BytesPerChannel)
+	{
+		file.Close();
+		return false;
+	}
+
+	entry.Width = header.Width;
+	entry.Height = header.Height;
+	entry.Channels = static_cast<uint8_t>(header.Channels);
+	entry.BytesPerChannel = static_cast<uint8_t>(header.BytesPerChannel);
+	entry.pPixels = file.GetData() + PageSize;
+
+	// Refresh the LRU timestamp of the entry
+	const auto hFile = CreateFileA(fileName.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		SetFileTime(hFile, nullptr, nullptr, &now);
+		CloseHandle(hFile);
+	}
+
+	return true;
+}
+
+bool ImageCache::Store(uint64_t key, const Entry& entry)
+{
+	Header header = {};
+	header.Magic = g_cacheMagic;
+	header.Version = g_cacheVersion;
+	header.Width = entry.Width;
+	header.Height = entry.Height;
+	header.Channels = entry.Channels;
+	header.BytesPerChannel = entry.BytesPerChannel;
+	header.DataSize = static_cast<uint64_t>(entry.Width) * entry.Height * entry.Channels * entry.BytesPerChannel;
+
+	// Never let a single entry flush the whole cache
+	XUSG_C_RETURN(PageSize + header.DataSize > m_maxSize, false);
+
+	// Write to a temporary file first, so that a partial entry is never visible
+	const auto fileName = GetFileName(key);
+	const auto tempFileName = fileName + ".tmp";
+	{
+		ofstream stream(tempFileName, ios::binary | ios::trunc);
+		XUSG_N_RETURN(stream, false);
+
+		// Page-align the pixel data
+		vector<char> headerPage(PageSize);
+		memcpy(headerPage.data(), &header, sizeof(Header));
+		stream.write(headerPage.data(), headerPage.size());
+		stream.write(reinterpret_cast<const char*>(entry.pPixels), static_cast<streamsize>(header.DataSize));
+		XUSG_N_RETURN(stream, false);
+	}
+
+	XUSG_N_RETURN(MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING), false);
+
+	Evict();
+
+	return true;
+}
+
+void ImageCache::Clear()
+{
+	WIN32_FIND_DATAA findData;
+	const auto hFind = FindFirstFileA((m_cacheDir + "*.bin").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE) return;
+	do
+	{
+		DeleteFileA((m_cacheDir + findData.cFileName).c_str());
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+}
+
+uint64_t ImageCache::CalculateKey(const uint8_t* pData, size_t size, uint8_t reqChannels)
+{
+	// xxHash64-style 4-lane hash over 8-byte words
+	static const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+	static const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+	static const uint64_t prime3 = 0x165667B19E3779F9ull;
+	const auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+	const auto round = [&rotl](uint64_t acc, uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; };
+
+	uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		uint64_t words[4];
+		memcpy(words, &pData[i], sizeof(words));
+		for (uint8_t j = 0; j < 4; ++j) lanes[j] = round(lanes[j], words[j]);
+	}
+
+	auto hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, &pData[i], sizeof(word));
+		hash = rotl(hash ^ round(0, word), 27) * prime1 + prime3;
+	}
+
+	for (; i < size; ++i) hash = rotl(hash ^ (pData[i] * prime3), 11) * prime1;
+
+	// Mix in the size and the requested channel count
+	hash ^= static_cast<uint64_t>(size) * prime2 + reqChannels;
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+string ImageCache::GetFileName(uint64_t key) const
+{
+	char keyStr[17];
+	snprintf(keyStr, sizeof(keyStr), "%016llx", static_cast<unsigned long long>(key));
+
+	return m_cacheDir + keyStr + ".bin";
+}
+
+void ImageCache::Evict()
+{
+	struct FileInfo
+	{
+		string Name;
+		uint64_t Size;
+		uint64_t LastWriteTime;
+	};
+
+	// Enumerate the entries
+	vector<FileInfo> files;
+	uint64_t totalSize = 0;
+	WIN32_FIND_DATAA findData;
+	const auto hFind = FindFirstFileA((m_cacheDir + "*.bin").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE) return;
+	do
+	{
+		FileInfo file;
+		file.Name = m_cacheDir + findData.cFileName;
+		file.Size = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+		file.LastWriteTime = (static_cast<uint64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) |
+			findData.ftLastWriteTime.dwLowDateTime;
+		totalSize += file.Size;
+		files.emplace_back(file);
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+
+	// Remove the least recently used entries until the cache fits in its budget
+	sort(files.begin(), files.end(), [](const FileInfo& a, const FileInfo& b)
+		{ return a.LastWriteTime < b.LastWriteTime; });
+	for (const auto& file : files)
+	{
+		if (totalSize <= m_maxSize) break;
+		if (DeleteFileA(file.Name.c_str())) totalSize -= file.Size;
+	}
+}
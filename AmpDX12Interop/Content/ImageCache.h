@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "MappedFile.h"
+
+// On-disk cache of decoded pixel blobs, keyed by a content hash of the source file and
+// the requested channel count. The pixels of each entry start on a page boundary, so a
+// mapped entry can be written straight into an upload resource. Entries are evicted in
+// LRU order when the cache grows beyond its size budget.
+class ImageCache
+{
+public:
+	struct Entry
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint8_t Channels;
+		uint8_t BytesPerChannel;
+		const uint8_t* pPixels;
+	};
+
+	ImageCache();
+	virtual ~ImageCache();
+
+	bool Init(const char* cacheDir, uint64_t maxSize);
+
+	bool Find(uint64_t key, Entry& entry, MappedFile& file) const;
+	bool Store(uint64_t key, const Entry& entry);
+	void Clear();	// Removes every entry
+
+	static uint64_t CalculateKey(const uint8_t* pData, size_t size, uint8_t reqChannels);
+
+	using uptr = std::unique_ptr<ImageCache>;
+
+	static const uint32_t PageSize = 4096;
+
+protected:
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Channels;
+		uint32_t BytesPerChannel;
+		uint64_t DataSize;
+	};
+
+	std::string GetFileName(uint64_t key) const;
+	void Evict();
+
+	std::string m_cacheDir;
+	uint64_t m_maxSize;
+};
@@ -0,0 +1,398 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ImageLoader.h"
+#include "PixelKernels.h"
+#include "MappedFile.h"
+#include "stb_image.h"
+#include "Advanced/XUSGTextureLoader.h"
+
+using namespace std;
+using namespace XUSG;
+
+ImageLoader::ImageLoader() :
+	m_pPixels(nullptr),
+	m_pDecoded(nullptr),
+	m_width(0),
+	m_height(0),
+	m_channels(0),
+	m_bytesPerChannel(1),
+	m_reqChannels(0),
+	m_bcFormat(BCDecoder::FORMAT_UNKNOWN),
+	m_loadTime(0.0),
+	m_writeTime(0.0),
+	m_writePrecisionName(""),
+	m_isCacheHit(false),
+	m_isDDS(false),
+	m_useHalfFloat(true)
+{
+}
+
+ImageLoader::~ImageLoader()
+{
+	Wait();
+	Release();
+}
+
+bool ImageLoader::Load(const char* fileName, ImageCache* pCache)
+{
+	Release();
+	const auto startTime = chrono::steady_clock::now();
+	m_loadTime = 0.0;
+	m_isCacheHit = false;
+
+	XUSG_M_RETURN(!m_sourceFile.Open(fileName), cerr, "Failed to open the image file.", false);
+	const auto pData = m_sourceFile.GetData();
+	const auto dataSize = m_sourceFile.GetSize();
+
+	// DDS files are uploaded as they are from the mapping, keeping their block-compressed formats;
+	// the blocks are only decoded for the regions read on the CPU.
+	BCDecoder::DDSInfo ddsInfo;
+	m_isDDS = BCDecoder::ParseDDS(pData, dataSize, ddsInfo);
+	if (m_isDDS)
+	{
+		m_pPixels = ddsInfo.pBlocks;
+		m_width = ddsInfo.Width;
+		m_height = ddsInfo.Height;
+		m_channels = 4;
+		m_bytesPerChannel = BCDecoder::IsHDR(ddsInfo.BlockFormat) ? sizeof(float) : sizeof(uint8_t);
+		m_bcFormat = ddsInfo.BlockFormat;
+		m_isCacheHit = false;
+		m_loadTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+		return true;
+	}
+
+	// Look up the decoded pixels in the cache, keyed by the file content and the requested channel count
+	const auto cacheKey = pCache ? ImageCache::CalculateKey(pData, dataSize, m_reqChannels) : 0;
+	ImageCache::Entry entry;
+	m_isCacheHit = pCache && pCache->Find(cacheKey, entry, m_cachedFile);
+
+	if (m_isCacheHit)
+	{
+		m_pPixels = entry.pPixels;
+		m_width = entry.Width;
+		m_height = entry.Height;
+		m_channels = entry.Channels;
+		m_bytesPerChannel = entry.BytesPerChannel;
+	}
+	else
+	{
+		// stb_image takes the encoded size as an int
+		XUSG_M_RETURN(dataSize > INT_MAX, cerr, "Image files of 2 GB or more cannot be decoded.", false);
+
+		// Decode with the native channel count, unless requested otherwise, and precision; 3-channel images
+		// are expanded while uploading.
+		const auto reqChannels = static_cast<int>(m_reqChannels);
+		const auto srcSize = static_cast<int>(dataSize);
+		int width, height, channels;
+		if (stbi_is_hdr_from_memory(pData, srcSize))
+		{
+			m_pDecoded = reinterpret_cast<uint8_t*>(stbi_loadf_from_memory(pData, srcSize, &width, &height, &channels, reqChannels));
+			m_bytesPerChannel = sizeof(float);
+		}
+		else if (stbi_is_16_bit_from_memory(pData, srcSize))
+		{
+			m_pDecoded = reinterpret_cast<uint8_t*>(stbi_load_16_from_memory(pData, srcSize, &width, &height, &channels, reqChannels));
+			m_bytesPerChannel = sizeof(uint16_t);
+		}
+		else
+		{
+			m_pDecoded = stbi_load_from_memory(pData, srcSize, &width, &height, &channels, reqChannels);
+			m_bytesPerChannel = sizeof(uint8_t);
+		}
+		XUSG_M_RETURN(!m_pDecoded, cerr, stbi_failure_reason(), false);
+
+		m_pPixels = m_pDecoded;
+		m_width = static_cast<uint32_t>(width);
+		m_height = static_cast<uint32_t>(height);
+		m_channels = m_reqChannels ? m_reqChannels : static_cast<uint8_t>(channels);
+
+		if (pCache)
+		{
+			entry.Width = m_width;
+			entry.Height = m_height;
+			entry.Channels = m_channels;
+			entry.BytesPerChannel = m_bytesPerChannel;
+			entry.pPixels = m_pPixels;
+			pCache->Store(cacheKey, entry);
+		}
+	}
+
+	m_sourceFile.Close();
+	m_loadTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	return true;
+}
+
+void ImageLoader::LoadAsync(const char* fileName, ImageCache* pCache)
+{
+	Wait();
+
+	const string fileNameStr(fileName);
+	m_loadTask = async(launch::async, [this, fileNameStr, pCache]() { return Load(fileNameStr.c_str(), pCache); });
+}
+
+bool ImageLoader::Wait()
+{
+	// The result of the pending load, or whether an image is loaded if none is pending
+	if (m_loadTask.valid()) return m_loadTask.get();
+
+	return m_pPixels || m_isDDS;
+}
+
+bool ImageLoader::CreateTexture(CommandList* pCommandList, Texture::sptr& texture, UploadRing& uploadRing,
+	ResourceState state, MemoryFlag memoryFlags, const wchar_t* name)
+{
+	// Join the decoding if it is still running
+	XUSG_N_RETURN(Wait(), false);
+
+	if (m_isDDS) return CreateTextureFromDDS(pCommandList, texture, uploadRing, state, memoryFlags, name);
+
+	// Reuse the given texture if it matches the image, such as a pooled one
+	const auto pDevice = pCommandList->GetDevice();
+	if (!texture || texture->GetWidth() != m_width || texture->GetHeight() != m_height ||
+		texture->GetFormat() != GetFormat() || texture->GetNumMips() != 1)
+	{
+		texture = Texture::MakeShared();
+		XUSG_N_RETURN(texture->Create(pDevice, m_width, m_height, GetFormat(), 1, ResourceFlag::NONE,
+			1, 1, false, memoryFlags, name), false);
+	}
+	const auto pTexture = texture.get();
+
+	// Get the footprint of the texture, and place it in the upload ring
+	const auto pDevice12 = static_cast<ID3D12Device*>(pDevice->GetHandle());
+	const auto desc = static_cast<ID3D12Resource*>(pTexture->GetHandle())->GetDesc();
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	uint64_t uploadSize;
+	pDevice12->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, nullptr, nullptr, &uploadSize);
+
+	UploadRing::Allocation allocation;
+	XUSG_M_RETURN(!uploadRing.Allocate(uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation),
+		cerr, "Failed to allocate upload memory.", false);
+	footprint.Offset += allocation.Offset;
+	const auto pUploader = allocation.pResource;
+
+	// Write the pixels directly into the mapped upload memory
+	const auto startTime = chrono::steady_clock::now();
+	WriteRegion(allocation.pData, footprint.Footprint.RowPitch, 0, 0, m_width, m_height);
+	m_writeTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+	m_writePrecisionName = GetPrecisionName();
+
+	// Copy to the texture
+	ResourceBarrier barrier;
+	auto numBarriers = pTexture->SetBarrier(&barrier, ResourceState::COPY_DEST);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	D3D12_TEXTURE_COPY_LOCATION dst = {};
+	dst.pResource = static_cast<ID3D12Resource*>(pTexture->GetHandle());
+	dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	dst.SubresourceIndex = 0;
+
+	D3D12_TEXTURE_COPY_LOCATION src = {};
+	src.pResource = static_cast<ID3D12Resource*>(pUploader->GetHandle());
+	src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	src.PlacedFootprint = footprint;
+
+	const auto pCommandList12 = static_cast<ID3D12GraphicsCommandList*>(pCommandList->GetHandle());
+	pCommandList12->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+	numBarriers = pTexture->SetBarrier(&barrier, state);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	return true;
+}
+
+void ImageLoader::Release()
+{
+	// Nothing of the image is left, so that no later failed load can be taken for it
+	if (m_pDecoded) stbi_image_free(m_pDecoded);
+	m_cachedFile.Close();
+	m_sourceFile.Close();
+	m_pDecoded = nullptr;
+	m_pPixels = nullptr;
+	m_width = 0;
+	m_height = 0;
+	m_channels = 0;
+	m_bytesPerChannel = 1;
+	m_bcFormat = BCDecoder::FORMAT_UNKNOWN;
+	m_isDDS = false;
+}
+
+void ImageLoader::SetHalfFloat(bool useHalfFloat)
+{
+	m_useHalfFloat = useHalfFloat;
+}
+
+void ImageLoader::SetRequestedChannels(uint8_t reqChannels)
+{
+	m_reqChannels = reqChannels;
+}
+
+void ImageLoader::GetImageSize(uint32_t& width, uint32_t& height) const
+{
+	width = m_width;
+	height = m_height;
+}
+
+Format ImageLoader::GetFormat() const
+{
+	static const Format formats[][4] =
+	{
+		{ Format::R8_UNORM, Format::R8G8_UNORM, Format::R8G8B8A8_UNORM, Format::R8G8B8A8_UNORM },
+		{ Format::R16_UNORM, Format::R16G16_UNORM, Format::R16G16B16A16_UNORM, Format::R16G16B16A16_UNORM },
+		{ Format::R16_FLOAT, Format::R16G16_FLOAT, Format::R16G16B16A16_FLOAT, Format::R16G16B16A16_FLOAT },
+		{ Format::R32_FLOAT, Format::R32G32_FLOAT, Format::R32G32B32A32_FLOAT, Format::R32G32B32A32_FLOAT }
+	};
+
+	// DDS files that are not block-compressed cannot be read on the CPU
+	if (m_isDDS && m_bcFormat == BCDecoder::FORMAT_UNKNOWN) return Format::UNKNOWN;
+
+	if (m_channels < 1 || m_channels > 4)
+	{
+		assert(!"Wrong channels, unknown format!");
+		return Format::UNKNOWN;
+	}
+
+	switch (m_bytesPerChannel)
+	{
+	case sizeof(uint8_t):
+		return formats[0][m_channels - 1];
+	case sizeof(uint16_t):
+		return formats[1][m_channels - 1];
+	case sizeof(float):
+		return formats[m_useHalfFloat ? 2 : 3][m_channels - 1];
+	default:
+		assert(!"Wrong bytes per channel, unknown format!");
+		return Format::UNKNOWN;
+	}
+}
+
+const char* ImageLoader::GetPrecisionName() const
+{
+	if (m_isDDS) return "DDS";
+
+	switch (m_bytesPerChannel)
+	{
+	case sizeof(uint8_t):
+		return "8-bit unorm";
+	case sizeof(uint16_t):
+		return "16-bit unorm";
+	default:
+		return m_useHalfFloat ? "16-bit float" : "32-bit float";
+	}
+}
+
+bool ImageLoader::CreateTextureFromDDS(CommandList* pCommandList, Texture::sptr& texture,
+	UploadRing& uploadRing, ResourceState state, MemoryFlag memoryFlags, const wchar_t* name)
+{
+	// The DDS loader creates its own upload resource, which is kept alive by the ring
+	DDS::Loader loader;
+	XUSG_M_RETURN(!loader.CreateTextureFromMemory(pCommandList, m_sourceFile.GetData(), m_sourceFile.GetSize(),
+		0, false, texture, uploadRing.CreateDedicated(), nullptr, state, memoryFlags),
+		cerr, "Failed to load the DDS file.", false);
+	if (name) texture->SetName(name);
+
+	m_width = static_cast<uint32_t>(texture->GetWidth());
+	m_height = texture->GetHeight();
+	m_writePrecisionName = GetPrecisionName();
+
+	return true;
+}
+
+double ImageLoader::GetLoadTime() const
+{
+	return m_loadTime;
+}
+
+double ImageLoader::GetWriteTime() const
+{
+	return m_writeTime;
+}
+
+const char* ImageLoader::GetWritePrecisionName() const
+{
+	return m_writePrecisionName;
+}
+
+bool ImageLoader::IsCacheHit() const
+{
+	return m_isCacheHit;
+}
+
+bool ImageLoader::IsDDS() const
+{
+	return m_isDDS;
+}
+
+const uint8_t* ImageLoader::GetUploadPixels() const
+{
+	const auto isHalfFloat = m_bytesPerChannel == sizeof(float) && m_useHalfFloat;
+
+	return m_channels == 4 && !isHalfFloat && !m_isDDS ? m_pPixels : nullptr;
+}
+
+void ImageLoader::WriteRegion(uint8_t* pDst, size_t dstRowPitch, uint32_t x, uint32_t y,
+	uint32_t width, uint32_t height) const
+{
+	const size_t srcPixelSize = m_channels * m_bytesPerChannel;
+	const auto srcRowPitch = srcPixelSize * m_width;
+	const auto isHalfFloat = m_bytesPerChannel == sizeof(float) && m_useHalfFloat;
+
+	if (m_isDDS)
+	{
+		assert(m_bcFormat != BCDecoder::FORMAT_UNKNOWN);
+		if (!isHalfFloat)
+		{
+			BCDecoder::DecodeRegion(m_bcFormat, m_pPixels, m_width, m_height, x, y, width, height, pDst, dstRowPitch);
+			return;
+		}
+
+		// BC6H decodes to 32-bit floats, so convert a block row at a time
+		vector<float> blockRow(4 * width * 4);
+		for (auto i = 0u; i < height;)
+		{
+			const auto numRows = (min)(4 - (y + i) % 4, height - i);
+			BCDecoder::DecodeRegion(m_bcFormat, m_pPixels, m_width, m_height, x, y + i, width, numRows,
+				reinterpret_cast<uint8_t*>(blockRow.data()), sizeof(float) * 4 * width);
+			for (auto j = 0u; j < numRows; ++j)
+				PixelKernels::ConvertFloatToHalf(reinterpret_cast<uint16_t*>(&pDst[dstRowPitch * (i + j)]),
+					&blockRow[4 * width * j], 4 * width);
+			i += numRows;
+		}
+
+		return;
+	}
+
+	for (auto i = 0u; i < height; ++i)
+	{
+		const auto pSrcRow = &m_pPixels[srcRowPitch * (y + i) + srcPixelSize * x];
+		const auto pDstRow = &pDst[dstRowPitch * i];
+
+		if (isHalfFloat)
+		{
+			const auto pSrc = reinterpret_cast<const float*>(pSrcRow);
+			const auto pDst16 = reinterpret_cast<uint16_t*>(pDstRow);
+			if (m_channels == 3) PixelKernels::ConvertRGBToRGBAHalf(pDst16, pSrc, width);
+			else PixelKernels::ConvertFloatToHalf(pDst16, pSrc, width * m_channels);
+		}
+		else if (m_channels == 3)
+		{
+			switch (m_bytesPerChannel)
+			{
+			case sizeof(uint16_t):
+				PixelKernels::ExpandRGBToRGBA16(reinterpret_cast<uint16_t*>(pDstRow),
+					reinterpret_cast<const uint16_t*>(pSrcRow), width);
+				break;
+			case sizeof(float):
+				PixelKernels::ExpandRGBToRGBA32F(reinterpret_cast<float*>(pDstRow),
+					reinterpret_cast<const float*>(pSrcRow), width);
+				break;
+			default:
+				PixelKernels::ExpandRGBToRGBA(pDstRow, pSrcRow, width);
+			}
+		}
+		else memcpy(pDstRow, pSrcRow, srcPixelSize * width);
+	}
+}
@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+#include "BCDecoder.h"
+#include "ImageCache.h"
+#include "UploadRing.h"
+
+// Decodes an image file into CPU memory with its native channel count, and writes
+// it straight into a mapped upload resource at the texture's row pitch, expanding
+// RGB to RGBA on the fly, so no intermediate RGBA copy is ever made. With an image
+// cache, decoded pixels are reused across launches straight from the mapped entry.
+// LoadAsync() decodes on a worker thread; the pixels are joined only at upload.
+// DDS files (including BC1-BC7) are uploaded as-is from the mapped file through the
+// XUSG DDS loader; only regions read on the CPU, through WriteRegion(), are decoded from
+// the BC blocks, to RGBA8, or to RGBA floats for BC6H. 16-bit images keep their precision
+// as 16-bit unorm, and HDR images are uploaded as half floats (or 32-bit floats).
+// Upload memory is suballocated from an upload ring, and recycled once the GPU is done.
+class ImageLoader
+{
+public:
+	ImageLoader();
+	virtual ~ImageLoader();
+
+	bool Load(const char* fileName, ImageCache* pCache = nullptr);
+	void LoadAsync(const char* fileName, ImageCache* pCache = nullptr);
+	bool Wait();
+
+	// Uploads into the given texture if it matches the image, or into a new one otherwise.
+	bool CreateTexture(XUSG::CommandList* pCommandList, XUSG::Texture::sptr& texture,
+		UploadRing& uploadRing, XUSG::ResourceState state = XUSG::ResourceState::COMMON,
+		XUSG::MemoryFlag memoryFlags = XUSG::MemoryFlag::NONE, const wchar_t* name = nullptr);
+	void Release();
+
+	// Writes a region of the pixels in the upload format, at the given destination row pitch.
+	void WriteRegion(uint8_t* pDst, size_t dstRowPitch, uint32_t x, uint32_t y,
+		uint32_t width, uint32_t height) const;
+
+	// Returns the tightly packed pixels if they are already in the upload format, so that they
+	// can be read in place, or null if they need WriteRegion() to be converted.
+	const uint8_t* GetUploadPixels() const;
+
+	void SetHalfFloat(bool useHalfFloat);
+	void SetRequestedChannels(uint8_t reqChannels);	// 0 for the native channel count
+
+	void GetImageSize(uint32_t& width, uint32_t& height) const;
+	XUSG::Format GetFormat() const;
+	const char* GetPrecisionName() const;
+	bool IsDDS() const;
+
+	// Statistics of the last load and upload, which are kept after Release()
+	double GetLoadTime() const;
+	double GetWriteTime() const;
+	const char* GetWritePrecisionName() const;
+	bool IsCacheHit() const;
+
+protected:
+	bool CreateTextureFromDDS(XUSG::CommandList* pCommandList, XUSG::Texture::sptr& texture,
+		UploadRing& uploadRing, XUSG::ResourceState state, XUSG::MemoryFlag memoryFlags,
+		const wchar_t* name);
+
+	const uint8_t*	m_pPixels;
+	uint8_t*		m_pDecoded;
+	MappedFile		m_cachedFile;
+	MappedFile		m_sourceFile;
+	uint32_t		m_width;
+	uint32_t		m_height;
+	uint8_t			m_channels;
+	uint8_t			m_bytesPerChannel;
+	uint8_t			m_reqChannels;
+	BCDecoder::Format m_bcFormat;
+
+	double			m_loadTime;
+	double			m_writeTime;
+	const char*		m_writePrecisionName;
+	bool			m_isCacheHit;
+	bool			m_isDDS;
+	bool			m_useHalfFloat;
+
+	std::future<bool> m_loadTask;
+};
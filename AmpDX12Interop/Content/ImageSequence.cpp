@@ -0,0 +1,349 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ImageSequence.h"
+#include "stb_image.h"
+
+using namespace std;
+
+static bool HasExtension(const string& fileName, const char* ext)
+{
+	const auto extLen = strlen(ext);
+
+	return fileName.size() > extLen && _stricmp(fileName.c_str() + fileName.size() - extLen, ext) == 0;
+}
+
+static uint64_t HashBytes(uint64_t hash, const uint8_t* pData, size_t size)
+{
+	// Multiply-xorshift over 64-bit words; 64 bits make a collision between two frames negligible
+	const auto mix = [](uint64_t hash, uint64_t word)
+		{
+			hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+
+			return hash ^ (hash >> 29);
+		};
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, &pData[i], sizeof(uint64_t));
+		hash = mix(hash, word);
+	}
+
+	if (i < size)
+	{
+		uint64_t word = 0;
+		memcpy(&word, &pData[i], size - i);
+		hash = mix(hash, word);
+	}
+
+	return hash;
+}
+
+ImageSequence::ImageSequence() :
+	m_sourceType(SOURCE_FILES),
+	m_width(0),
+	m_height(0),
+	m_numFrames(0),
+	m_nextFrame(0),
+	m_hashTileSize(DefaultHashTileSize),
+	m_prefetchDepth(DefaultPrefetchDepth)
+{
+}
+
+ImageSequence::~ImageSequence()
+{
+	Close();
+}
+
+bool ImageSequence::Open(const char* path, uint32_t rawWidth, uint32_t rawHeight, uint8_t prefetchDepth)
+{
+	Close();
+
+	const string pathStr(path);
+	if (pathStr.find_first_of("*?") != string::npos) XUSG_N_RETURN(OpenFiles(path), false);
+	else if (HasExtension(pathStr, ".y4m")) XUSG_N_RETURN(OpenY4M(path), false);
+	else XUSG_N_RETURN(OpenRaw(path, rawWidth, rawHeight), false);
+
+	XUSG_M_RETURN(m_numFrames == 0, cerr, "The image sequence has no frames.", false);
+
+	m_prefetchDepth = (max)(prefetchDepth, static_cast<uint8_t>(1));
+	Prefetch();
+
+	return true;
+}
+
+void ImageSequence::Close()
+{
+	m_prefetchedFrames.clear();
+	m_fileNames.clear();
+	m_frameOffsets.clear();
+	m_stream.Close();
+	m_numFrames = 0;
+	m_nextFrame = 0;
+}
+
+bool ImageSequence::GetNextFrame(Frame& frame, bool wait)
+{
+	XUSG_C_RETURN(m_prefetchedFrames.empty(), false);
+
+	auto& nextFrame = m_prefetchedFrames.front();
+	XUSG_C_RETURN(!wait && nextFrame.wait_for(chrono::seconds(0)) != future_status::ready, false);
+
+	frame = nextFrame.get();
+	m_prefetchedFrames.pop_front();
+	Prefetch();
+
+	XUSG_M_RETURN(frame.Pixels.empty(), cerr, "Failed to decode a frame of the image sequence.", false);
+
+	return true;
+}
+
+void ImageSequence::GetFrameSize(uint32_t& width, uint32_t& height) const
+{
+	width = m_width;
+	height = m_height;
+}
+
+uint32_t ImageSequence::GetNumFrames() const
+{
+	return m_numFrames;
+}
+
+void ImageSequence::SetHashTileSize(uint32_t tileSize)
+{
+	m_hashTileSize = tileSize;
+}
+
+uint32_t ImageSequence::GetHashTileSize() const
+{
+	return m_hashTileSize;
+}
+
+bool ImageSequence::IsSequencePath(const char* path)
+{
+	const string pathStr(path);
+
+	return pathStr.find_first_of("*?") != string::npos || HasExtension(pathStr, ".y4m");
+}
+
+bool ImageSequence::OpenFiles(const char* pattern)
+{
+	m_sourceType = SOURCE_FILES;
+
+	// Frames are ordered by their file names
+	XUSG_N_RETURN(FindFiles(pattern, m_fileNames), false);
+	m_numFrames = static_cast<uint32_t>(m_fileNames.size());
+
+	// The first frame determines the frame size
+	MappedFile file;
+	XUSG_M_RETURN(!file.Open(m_fileNames[0].c_str()), cerr, "Failed to open the first frame.", false);
+	int width, height, channels;
+	XUSG_M_RETURN(!stbi_info_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &width, &height, &channels),
+		cerr, stbi_failure_reason(), false);
+	m_width = static_cast<uint32_t>(width);
+	m_height = static_cast<uint32_t>(height);
+
+	return true;
+}
+
+bool ImageSequence::FindFiles(const char* pattern, vector<string>& fileNames)
+{
+	const string patternStr(pattern);
+	const auto dirPos = patternStr.find_last_of("/\\");
+	const auto dir = dirPos != string::npos ? patternStr.substr(0, dirPos + 1) : string();
+
+	WIN32_FIND_DATAA findData;
+	const auto hFind = FindFirstFileA(pattern, &findData);
+	XUSG_M_RETURN(hFind == INVALID_HANDLE_VALUE, cerr, "No files match the pattern.", false);
+	do
+	{
+		if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			fileNames.emplace_back(dir + findData.cFileName);
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+
+	sort(fileNames.begin(), fileNames.end());
+	XUSG_C_RETURN(fileNames.empty(), false);
+
+	return true;
+}
+
+bool ImageSequence::OpenY4M(const char* fileName)
+{
+	m_sourceType = SOURCE_Y4M;
+	XUSG_M_RETURN(!m_stream.Open(fileName), cerr, "Failed to open the Y4M stream.", false);
+
+	const auto pData = reinterpret_cast<const char*>(m_stream.GetData());
+	const auto dataSize = m_stream.GetSize();
+	const auto pHeaderEnd = static_cast<const char*>(memchr(pData, '\n', dataSize));
+	XUSG_M_RETURN(!pHeaderEnd || strncmp(pData, "YUV4MPEG2 ", 10) != 0, cerr, "Invalid Y4M header.", false);
+
+	// Parse the stream header, e.g. "YUV4MPEG2 W640 H480 F30:1 Ip A1:1 C420jpeg"
+	istringstream header(string(pData + 10, pHeaderEnd));
+	string token;
+	while (header >> token)
+	{
+		switch (token[0])
+		{
+		case 'W':
+			m_width = static_cast<uint32_t>(stoul(token.substr(1)));
+			break;
+		case 'H':
+			m_height = static_cast<uint32_t>(stoul(token.substr(1)));
+			break;
+		case 'C':
+			XUSG_M_RETURN(token.compare(0, 4, "C420") != 0 || token == "C420p10" || token == "C420p12",
+				cerr, "Only 8-bit 4:2:0 Y4M streams are supported.", false);
+			break;
+		}
+	}
+	XUSG_M_RETURN(m_width == 0 || m_height == 0, cerr, "Invalid Y4M frame size.", false);
+
+	// Index the frames, each of which has its own header line
+	const auto chromaSize = static_cast<size_t>((m_width + 1) / 2) * ((m_height + 1) / 2);
+	const auto frameSize = static_cast<size_t>(m_width) * m_height + 2 * chromaSize;
+	auto offset = static_cast<size_t>(pHeaderEnd - pData) + 1;
+	while (offset + 5 < dataSize && strncmp(pData + offset, "FRAME", 5) == 0)
+	{
+		const auto pFrameHeaderEnd = static_cast<const char*>(memchr(pData + offset, '\n', dataSize - offset));
+		XUSG_C_RETURN(!pFrameHeaderEnd, false);
+
+		offset = static_cast<size_t>(pFrameHeaderEnd - pData) + 1;
+		if (offset + frameSize > dataSize) break;
+		m_frameOffsets.emplace_back(offset);
+		offset += frameSize;
+	}
+	m_numFrames = static_cast<uint32_t>(m_frameOffsets.size());
+
+	return true;
+}
+
+bool ImageSequence::OpenRaw(const char* fileName, uint32_t width, uint32_t height)
+{
+	m_sourceType = SOURCE_RAW;
+	XUSG_M_RETURN(width == 0 || height == 0, cerr, "Raw image sequences require a frame size.", false);
+	XUSG_M_RETURN(!m_stream.Open(fileName), cerr, "Failed to open the raw image sequence.", false);
+
+	m_width = width;
+	m_height = height;
+	const auto frameSize = sizeof(uint32_t) * m_width * m_height;
+	m_numFrames = static_cast<uint32_t>(m_stream.GetSize() / frameSize);
+	for (auto i = 0u; i < m_numFrames; ++i) m_frameOffsets.emplace_back(frameSize * i);
+
+	return true;
+}
+
+bool ImageSequence::DecodeFrame(uint32_t index, Frame& frame) const
+{
+	const auto startTime = chrono::steady_clock::now();
+	frame.Index = index;
+	frame.Pixels.resize(sizeof(uint32_t) * m_width * m_height);
+
+	switch (m_sourceType)
+	{
+	case SOURCE_FILES:
+	{
+		MappedFile file;
+		XUSG_N_RETURN(file.Open(m_fileNames[index].c_str()), false);
+
+		int width, height, channels;
+		const auto pPixels = stbi_load_from_memory(file.GetData(), static_cast<int>(file.GetSize()),
+			&width, &height, &channels, 4);
+		XUSG_N_RETURN(pPixels, false);
+
+		const auto isSizeMatched = static_cast<uint32_t>(width) == m_width && static_cast<uint32_t>(height) == m_height;
+		if (isSizeMatched) memcpy(frame.Pixels.data(), pPixels, frame.Pixels.size());
+		stbi_image_free(pPixels);
+		XUSG_N_RETURN(isSizeMatched, false);
+		break;
+	}
+	case SOURCE_Y4M:
+		ConvertYUV420ToRGBA(frame.Pixels.data(), m_stream.GetData() + m_frameOffsets[index]);
+		break;
+	default:
+		memcpy(frame.Pixels.data(), m_stream.GetData() + m_frameOffsets[index], frame.Pixels.size());
+	}
+
+	frame.DecodeTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+	HashTiles(frame);
+
+	return true;
+}
+
+void ImageSequence::HashTiles(Frame& frame) const
+{
+	frame.TileHashes.clear();
+	frame.HashTime = 0.0;
+	if (m_hashTileSize == 0) return;
+
+	// The rows are walked in order, each one adding its segments to the hashes of its tiles
+	const auto startTime = chrono::steady_clock::now();
+	const auto numTilesX = (m_width + m_hashTileSize - 1) / m_hashTileSize;
+	const auto numTilesY = (m_height + m_hashTileSize - 1) / m_hashTileSize;
+	frame.TileHashes.assign(static_cast<size_t>(numTilesX) * numTilesY, 0xcbf29ce484222325ull);
+
+	const auto rowSize = sizeof(uint32_t) * m_width;
+	const auto segmentSize = sizeof(uint32_t) * m_hashTileSize;
+	for (auto i = 0u; i < m_height; ++i)
+	{
+		const auto pRow = &frame.Pixels[rowSize * i];
+		const auto pHashes = &frame.TileHashes[static_cast<size_t>(numTilesX) * (i / m_hashTileSize)];
+		for (auto j = 0u; j < numTilesX; ++j)
+		{
+			const auto offset = segmentSize * j;
+			pHashes[j] = HashBytes(pHashes[j], &pRow[offset], (min)(segmentSize, rowSize - offset));
+		}
+	}
+
+	frame.HashTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+}
+
+void ImageSequence::ConvertYUV420ToRGBA(uint8_t* pDst, const uint8_t* pSrc) const
+{
+	// BT.601 limited range, in 8-bit fixed point
+	const auto clamp8 = [](int32_t v) { return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v)); };
+
+	const auto chromaWidth = (m_width + 1) / 2;
+	const auto pY = pSrc;
+	const auto pU = pY + static_cast<size_t>(m_width) * m_height;
+	const auto pV = pU + static_cast<size_t>(chromaWidth) * ((m_height + 1) / 2);
+
+	for (auto i = 0u; i < m_height; ++i)
+	{
+		const auto pYRow = &pY[static_cast<size_t>(m_width) * i];
+		const auto pURow = &pU[static_cast<size_t>(chromaWidth) * (i / 2)];
+		const auto pVRow = &pV[static_cast<size_t>(chromaWidth) * (i / 2)];
+		const auto pDstRow = &pDst[sizeof(uint32_t) * m_width * i];
+
+		for (auto j = 0u; j < m_width; ++j)
+		{
+			const auto c = 298 * (static_cast<int32_t>(pYRow[j]) - 16) + 128;
+			const auto d = static_cast<int32_t>(pURow[j / 2]) - 128;
+			const auto e = static_cast<int32_t>(pVRow[j / 2]) - 128;
+
+			pDstRow[4 * j] = clamp8((c + 409 * e) >> 8);
+			pDstRow[4 * j + 1] = clamp8((c - 100 * d - 208 * e) >> 8);
+			pDstRow[4 * j + 2] = clamp8((c + 516 * d) >> 8);
+			pDstRow[4 * j + 3] = 0xff;
+		}
+	}
+}
+
+void ImageSequence::Prefetch()
+{
+	while (m_prefetchedFrames.size() < m_prefetchDepth)
+	{
+		const auto index = m_nextFrame;
+		m_nextFrame = (m_nextFrame + 1) % m_numFrames;
+		m_prefetchedFrames.emplace_back(async(launch::async, [this, index]()
+			{
+				Frame frame;
+				if (!DecodeFrame(index, frame)) frame.Pixels.clear();
+
+				return frame;
+			}));
+	}
+}
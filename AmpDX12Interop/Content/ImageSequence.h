@@ -0,0 +1,81 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "MappedFile.h"
+
+// Source of an image sequence: a directory glob of image files (e.g. "Frames/*.png"),
+// a Y4M stream (8-bit 4:2:0), or a raw stream of RGBA8 frames of a given size. Frames
+// are decoded to RGBA8 on worker threads and prefetched ahead of their use; the
+// sequence loops at its end. Each decoded frame is also hashed per tile on its worker,
+// so that the tiles that are unchanged from the previous frame can be told cheaply.
+class ImageSequence
+{
+public:
+	struct Frame
+	{
+		std::vector<uint8_t> Pixels;
+		std::vector<uint64_t> TileHashes;	// Row-major; empty without hashing
+		uint32_t Index;
+		double DecodeTime;
+		double HashTime;
+	};
+
+	ImageSequence();
+	virtual ~ImageSequence();
+
+	bool Open(const char* path, uint32_t rawWidth = 0, uint32_t rawHeight = 0,
+		uint8_t prefetchDepth = DefaultPrefetchDepth);
+	void Close();
+
+	// Takes the next frame in order; without waiting, returns false if it is still being decoded.
+	bool GetNextFrame(Frame& frame, bool wait = false);
+
+	void GetFrameSize(uint32_t& width, uint32_t& height) const;
+	uint32_t GetNumFrames() const;
+
+	// The tile size applies to the frames decoded after Open; 0 disables the hashing.
+	void SetHashTileSize(uint32_t tileSize);
+	uint32_t GetHashTileSize() const;
+
+	static bool IsSequencePath(const char* path);
+
+	// Lists the files matching a glob, ordered by their names.
+	static bool FindFiles(const char* pattern, std::vector<std::string>& fileNames);
+
+	static const uint8_t DefaultPrefetchDepth = 4;
+	static const uint32_t DefaultHashTileSize = 32;
+
+protected:
+	enum SourceType : uint8_t
+	{
+		SOURCE_FILES,
+		SOURCE_Y4M,
+		SOURCE_RAW
+	};
+
+	bool OpenFiles(const char* pattern);
+	bool OpenY4M(const char* fileName);
+	bool OpenRaw(const char* fileName, uint32_t width, uint32_t height);
+	bool DecodeFrame(uint32_t index, Frame& frame) const;
+	void ConvertYUV420ToRGBA(uint8_t* pDst, const uint8_t* pSrc) const;
+	void HashTiles(Frame& frame) const;
+	void Prefetch();
+
+	SourceType	m_sourceType;
+	uint32_t	m_width;
+	uint32_t	m_height;
+	uint32_t	m_numFrames;
+	uint32_t	m_nextFrame;
+	uint32_t	m_hashTileSize;
+	uint8_t		m_prefetchDepth;
+
+	std::vector<std::string>	m_fileNames;
+	MappedFile					m_stream;
+	std::vector<size_t>			m_frameOffsets;
+
+	// Declared last, so that the pending decodes are joined before the sources are released
+	std::deque<std::future<Frame>> m_prefetchedFrames;
+};
@@ -0,0 +1,155 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ImageStack.h"
+
+using namespace std;
+using namespace XUSG;
+
+ImageStack::ImageStack() :
+	m_pData(nullptr),
+	m_uploaderSize(0),
+	m_footprint(),
+	m_width(0),
+	m_height(0),
+	m_format(Format::UNKNOWN),
+	m_maxDepth(0),
+	m_numImages(0)
+{
+}
+
+ImageStack::~ImageStack()
+{
+	if (m_pData) m_uploader->Unmap();
+}
+
+bool ImageStack::Begin(const Device* pDevice, const ImageLoader& imageLoader, uint16_t maxDepth)
+{
+	imageLoader.GetImageSize(m_width, m_height);
+	m_format = imageLoader.GetFormat();
+	m_maxDepth = maxDepth;
+	m_numImages = 0;
+
+	// Get the placed footprint of the whole stack; its slices are laid out one after
+	// another at the row pitch times the height
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+	desc.Width = m_width;
+	desc.Height = m_height;
+	desc.DepthOrArraySize = maxDepth;
+	desc.MipLevels = 1;
+	desc.Format = static_cast<DXGI_FORMAT>(m_format);
+	desc.SampleDesc.Count = 1;
+	const auto pDevice12 = static_cast<ID3D12Device*>(pDevice->GetHandle());
+	uint64_t uploaderSize;
+	pDevice12->GetCopyableFootprints(&desc, 0, 1, 0, &m_footprint, nullptr, nullptr, &uploaderSize);
+
+	// The upload buffer only grows, so that stacks of smaller images reuse it
+	if (uploaderSize > m_uploaderSize)
+	{
+		if (m_pData) m_uploader->Unmap();
+		m_pData = nullptr;
+
+		m_uploader = Buffer::MakeUnique();
+		XUSG_N_RETURN(m_uploader->Create(pDevice, static_cast<size_t>(uploaderSize), ResourceFlag::NONE,
+			MemoryType::UPLOAD, 0, nullptr, 0, nullptr, MemoryFlag::NONE, L"StackUploader"), false);
+		m_pData = static_cast<uint8_t*>(m_uploader->Map(nullptr));
+		XUSG_N_RETURN(m_pData, false);
+		m_uploaderSize = uploaderSize;
+	}
+
+	return true;
+}
+
+void ImageStack::Reset()
+{
+	m_numImages = 0;
+}
+
+bool ImageStack::Insert(const ImageLoader& imageLoader)
+{
+	if (IsFull() || !IsCompatible(imageLoader)) return false;
+
+	const auto rowPitch = m_footprint.Footprint.RowPitch;
+	const auto slicePitch = static_cast<uint64_t>(rowPitch) * m_footprint.Footprint.Height;
+	imageLoader.WriteRegion(&m_pData[m_footprint.Offset + slicePitch * m_numImages], rowPitch, 0, 0, m_width, m_height);
+	++m_numImages;
+
+	return true;
+}
+
+void ImageStack::Upload(CommandList* pCommandList, Texture3D* pTexture) const
+{
+	ResourceBarrier barrier;
+	auto numBarriers = pTexture->SetBarrier(&barrier, ResourceState::COPY_DEST);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	D3D12_TEXTURE_COPY_LOCATION dst = {};
+	dst.pResource = static_cast<ID3D12Resource*>(pTexture->GetHandle());
+	dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	dst.SubresourceIndex = 0;
+
+	D3D12_TEXTURE_COPY_LOCATION src = {};
+	src.pResource = static_cast<ID3D12Resource*>(m_uploader->GetHandle());
+	src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	src.PlacedFootprint = m_footprint;
+
+	// Only the written slices are copied
+	const D3D12_BOX srcBox = { 0, 0, 0, m_width, m_height, m_numImages };
+	const auto pCommandList12 = static_cast<ID3D12GraphicsCommandList*>(pCommandList->GetHandle());
+	pCommandList12->CopyTextureRegion(&dst, 0, 0, 0, &src, &srcBox);
+
+	numBarriers = pTexture->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, &barrier);
+}
+
+bool ImageStack::IsCompatible(const ImageLoader& imageLoader) const
+{
+	uint32_t width, height;
+	imageLoader.GetImageSize(width, height);
+
+	return width == m_width && height == m_height && imageLoader.GetFormat() == m_format;
+}
+
+bool ImageStack::IsFull() const
+{
+	return m_numImages >= m_maxDepth;
+}
+
+bool ImageStack::IsEmpty() const
+{
+	return m_numImages == 0;
+}
+
+void ImageStack::GetImageSize(uint32_t& width, uint32_t& height) const
+{
+	width = m_width;
+	height = m_height;
+}
+
+Format ImageStack::GetFormat() const
+{
+	return m_format;
+}
+
+uint16_t ImageStack::GetMaxDepth() const
+{
+	return m_maxDepth;
+}
+
+uint16_t ImageStack::GetNumImages() const
+{
+	return m_numImages;
+}
+
+bool ImageStack::IsStackable(const ImageLoader& imageLoader)
+{
+	// Only the unorm formats that AMP wraps as volume textures, within the volume texture size
+	uint32_t width, height;
+	imageLoader.GetImageSize(width, height);
+	const auto format = imageLoader.GetFormat();
+
+	return !imageLoader.IsDDS() && (format == Format::R8G8B8A8_UNORM || format == Format::R16G16B16A16_UNORM) &&
+		width <= D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION && height <= D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION;
+}
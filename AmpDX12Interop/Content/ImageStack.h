@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+#include "ImageLoader.h"
+
+// Stacks images of the same size and format into the depth slices of a volume texture, so
+// that a homogeneous batch is uploaded, processed and read back as a whole. The pixels are
+// written straight into a persistently mapped upload buffer at the slice pitch. C++ AMP
+// cannot wrap texture arrays, so the slices of a 3D texture serve as the array.
+class ImageStack
+{
+public:
+	ImageStack();
+	virtual ~ImageStack();
+
+	// Starts a stack for the image size and format; the upload of the previous stack must
+	// have completed.
+	bool Begin(const XUSG::Device* pDevice, const ImageLoader& imageLoader, uint16_t maxDepth = DefaultMaxDepth);
+
+	// Empties the stack, keeping its size and format; the upload must have completed.
+	void Reset();
+
+	// Writes the image into the next slice; fails if it does not match the stack.
+	bool Insert(const ImageLoader& imageLoader);
+
+	// Records the copy of the written slices into the texture, leaving it as a shader resource.
+	void Upload(XUSG::CommandList* pCommandList, XUSG::Texture3D* pTexture) const;
+
+	bool IsCompatible(const ImageLoader& imageLoader) const;
+	bool IsFull() const;
+	bool IsEmpty() const;
+
+	void GetImageSize(uint32_t& width, uint32_t& height) const;
+	XUSG::Format GetFormat() const;
+	uint16_t GetMaxDepth() const;
+	uint16_t GetNumImages() const;
+
+	static bool IsStackable(const ImageLoader& imageLoader);
+
+	static const uint16_t DefaultMaxDepth = 8;
+
+protected:
+	XUSG::Buffer::uptr	m_uploader;
+	uint8_t*			m_pData;
+	uint64_t			m_uploaderSize;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_footprint;
+
+	uint32_t			m_width;
+	uint32_t			m_height;
+	XUSG::Format		m_format;
+	uint16_t			m_maxDepth;
+	uint16_t			m_numImages;
+};
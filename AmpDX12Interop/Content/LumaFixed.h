@@ -0,0 +1,20 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "PixelKernels.h"
+
+// Outside C++ AMP, as in the portable tests, the fixed-point luma is a plain CPU function
+#ifndef __GPU
+#define __GPU
+#endif
+
+// Fixed-point luma of 8-bit channels, rounded in integers as the CPU kernels do
+// (PixelKernels::ConvertRGBAToLuma), so that its results are identical on every device
+inline uint32_t ToLumaFixed(uint32_t r, uint32_t g, uint32_t b) __GPU
+{
+	return (PixelKernels::LumaWeightR * r + PixelKernels::LumaWeightG * g + PixelKernels::LumaWeightB * b +
+		PixelKernels::LumaRounding) >> PixelKernels::LumaShift;
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "AmpVecMath.h"
+#include "LumaFixed.h"
+
+// Format-specialized display mapping of the luma: unorm sources are already in [0, 1],
+// while float (HDR) sources are tone-mapped (Reinhard).
+inline float ToDisplay(float luma, const Concurrency::graphics::unorm_4&) __GPU
+{
+	return luma;
+}
+
+inline float ToDisplay(float luma, const Concurrency::graphics::float_4&) __GPU
+{
+	return luma / (1.0f + luma);
+}
+
+// Color to grey, shared by the full-image and the tiled paths, and by the CPU workers
+template<typename T>
+inline Concurrency::graphics::unorm_4 ToGrey(const T& src) __GPU
+{
+	const Concurrency::graphics::float_3 rgb(src.x, src.y, src.z);
+	const auto dst = ToDisplay(dot(rgb, Concurrency::graphics::float_3(0.299f, 0.587f, 0.114f)), src);
+
+	return Concurrency::graphics::unorm_4(dst, dst, dst, src.w);
+}
+
+// Rounds a unorm channel to 8 bits, for the fixed-point luma (LumaFixed.h)
+inline uint32_t ToUnorm8(float value) __GPU
+{
+	return static_cast<uint32_t>(value * 255.0f + 0.5f);
+}
+
+// Texels of more than 8 bits are rounded to 8 bits first; an 8-bit result converts back exactly.
+inline Concurrency::graphics::unorm_4 ToGreyFixed(const Concurrency::graphics::unorm_4& src) __GPU
+{
+	const auto dst = ToLumaFixed(ToUnorm8(src.x), ToUnorm8(src.y), ToUnorm8(src.z)) / 255.0f;
+
+	return Concurrency::graphics::unorm_4(dst, dst, dst, ToUnorm8(src.w) / 255.0f);
+}
@@ -0,0 +1,256 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "MultiAdapterProcessor.h"
+#include "TiledProcessor.h"
+#include "LumaKernel.h"
+
+using namespace std;
+using namespace Concurrency;
+using namespace Concurrency::graphics;
+using namespace XUSG;
+
+// Texel loads of the CPU workers, in the upload formats of the image loader
+template<typename T>
+static T LoadTexel(const uint8_t* pTexel, uint32_t bitsPerScalar);
+
+template<>
+unorm4 LoadTexel<unorm4>(const uint8_t* pTexel, uint32_t bitsPerScalar)
+{
+	if (bitsPerScalar == 16)
+	{
+		const auto pScalars = reinterpret_cast<const uint16_t*>(pTexel);
+
+		return unorm4(pScalars[0] / 65535.0f, pScalars[1] / 65535.0f, pScalars[2] / 65535.0f, pScalars[3] / 65535.0f);
+	}
+
+	return unorm4(pTexel[0] / 255.0f, pTexel[1] / 255.0f, pTexel[2] / 255.0f, pTexel[3] / 255.0f);
+}
+
+template<>
+float4 LoadTexel<float4>(const uint8_t* pTexel, uint32_t)
+{
+	const auto pScalars = reinterpret_cast<const float*>(pTexel);
+
+	return float4(pScalars[0], pScalars[1], pScalars[2], pScalars[3]);
+}
+
+// Rounds to nearest, as the texture units do on unorm stores
+static uint32_t PackUnorm4(const unorm4& texel)
+{
+	const auto x = static_cast<uint32_t>(static_cast<float>(texel.x) * 255.0f + 0.5f);
+	const auto y = static_cast<uint32_t>(static_cast<float>(texel.y) * 255.0f + 0.5f);
+	const auto z = static_cast<uint32_t>(static_cast<float>(texel.z) * 255.0f + 0.5f);
+	const auto w = static_cast<uint32_t>(static_cast<float>(texel.w) * 255.0f + 0.5f);
+
+	return x | (y << 8) | (z << 16) | (w << 24);
+}
+
+MultiAdapterProcessor::MultiAdapterProcessor() :
+	m_numCPUWorkers(0),
+	m_processTime(0.0)
+{
+}
+
+MultiAdapterProcessor::~MultiAdapterProcessor()
+{
+}
+
+bool MultiAdapterProcessor::Init(uint32_t numCPUWorkers)
+{
+	m_devices.clear();
+	m_scheduler = BandScheduler();
+
+	for (const auto& acc : accelerator::get_all())
+	{
+		if (acc.is_emulated || acc.device_path == accelerator::direct3d_warp) continue;
+
+		Device device = { acc.description, make_unique<accelerator_view>(acc.create_view()), 0 };
+		m_devices.emplace_back(move(device));
+		m_scheduler.AddDevice();
+	}
+
+	m_numCPUWorkers = numCPUWorkers;
+	m_workBuffers.resize(m_numCPUWorkers);
+	if (m_numCPUWorkers > 0)
+	{
+		Device device = { L"CPU (" + to_wstring(m_numCPUWorkers) + L" workers)", nullptr, 0 };
+		m_devices.emplace_back(move(device));
+		m_scheduler.AddDevice();
+	}
+
+	XUSG_M_RETURN(m_devices.empty(), cerr, "No device for multi-adapter processing.", false);
+
+	return true;
+}
+
+bool MultiAdapterProcessor::Process(const ImageLoader& imageLoader, vector<uint8_t>& result, uint32_t numRounds)
+{
+	Source source = { &imageLoader, imageLoader.GetUploadPixels() };
+	imageLoader.GetImageSize(source.Width, source.Height);
+
+	switch (imageLoader.GetFormat())
+	{
+	case Format::R8G8B8A8_UNORM:
+		return ProcessRounds<unorm4>(source, result, 8, numRounds);
+	case Format::R16G16B16A16_UNORM:
+		return ProcessRounds<unorm4>(source, result, 16, numRounds);
+	case Format::R32G32B32A32_FLOAT:
+		return ProcessRounds<float4>(source, result, 32, numRounds);
+	default:
+		cerr << "Multi-adapter processing only supports 3- and 4-channel images, with 32-bit float HDR, "
+			"and BC1-BC7 DDS files." << endl;
+		return false;
+	}
+}
+
+bool MultiAdapterProcessor::Process(const uint8_t* pPixels, uint32_t width, uint32_t height,
+	vector<uint8_t>& result, uint32_t numRounds)
+{
+	XUSG_N_RETURN(pPixels, false);
+	const Source source = { nullptr, pPixels, width, height };
+
+	return ProcessRounds<unorm4>(source, result, 8, numRounds);
+}
+
+uint32_t MultiAdapterProcessor::GetNumDevices() const
+{
+	return static_cast<uint32_t>(m_devices.size());
+}
+
+const wstring& MultiAdapterProcessor::GetDeviceName(uint32_t device) const
+{
+	return m_devices[device].Name;
+}
+
+uint64_t MultiAdapterProcessor::GetNumPixels(uint32_t device) const
+{
+	return m_devices[device].NumPixels;
+}
+
+const BandScheduler& MultiAdapterProcessor::GetScheduler() const
+{
+	return m_scheduler;
+}
+
+double MultiAdapterProcessor::GetProcessTime() const
+{
+	return m_processTime;
+}
+
+template<typename T>
+bool MultiAdapterProcessor::ProcessRounds(const Source& source, vector<uint8_t>& result,
+	uint32_t bitsPerScalar, uint32_t numRounds)
+{
+	const auto startTime = chrono::steady_clock::now();
+
+	const auto width = source.Width;
+	const auto height = source.Height;
+	XUSG_N_RETURN(width > 0 && height > 0, false);
+	XUSG_M_RETURN(width > TiledProcessor::MaxTextureSize, cerr,
+		"The image is too wide for multi-adapter processing; use tiled processing instead.", false);
+
+	// Every band must fit in a texture
+	numRounds = (max)(numRounds, XUSG_DIV_UP(height, TiledProcessor::MaxTextureSize));
+
+	result.resize(sizeof(uint32_t) * static_cast<size_t>(width) * height);
+
+	// Run the bands on all the devices at once; each writes into its own rows of the output
+	m_scheduler.Run(width, height, numRounds, [&](const BandScheduler::Band& band)
+	{
+		const auto bandStartTime = chrono::steady_clock::now();
+		const auto pResult = &result[sizeof(uint32_t) * static_cast<size_t>(width) * band.Y];
+		const auto& pAcceleratorView = m_devices[band.Device].AcceleratorView;
+		if (pAcceleratorView) ProcessBandAMP<T>(*pAcceleratorView, source, band, bitsPerScalar, pResult);
+		else ProcessBandCPU<T>(source, band, bitsPerScalar, pResult);
+		m_devices[band.Device].NumPixels += static_cast<uint64_t>(width) * band.Height;
+
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - bandStartTime).count();
+	});
+
+	m_processTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	return true;
+}
+
+template<typename T>
+void MultiAdapterProcessor::ProcessBandAMP(const accelerator_view& acceleratorView, const Source& source,
+	const BandScheduler::Band& band, uint32_t bitsPerScalar, uint8_t* pResult) const
+{
+	// Pixels already in the upload format are copied in place; others are converted first
+	const auto width = source.Width;
+	const auto texelSize = 4 * bitsPerScalar / 8;
+	const auto rowPitch = static_cast<size_t>(texelSize) * width;
+	const auto bandSize = rowPitch * band.Height;
+	vector<uint8_t> staging;
+	auto pSource = source.pPixels;
+	if (pSource) pSource += rowPitch * band.Y;
+	else
+	{
+		staging.resize(bandSize);
+		source.pImageLoader->WriteRegion(staging.data(), rowPitch, 0, band.Y, width, band.Height);
+		pSource = staging.data();
+	}
+
+	texture<T, 2> sourceTexture(band.Height, width, bitsPerScalar, acceleratorView);
+	texture<unorm4, 2> resultTexture(band.Height, width, 8u, acceleratorView);
+	copy(pSource, static_cast<uint32_t>(bandSize), sourceTexture);
+
+	const auto sourceView = texture_view<const T, 2>(sourceTexture);
+	const auto result = texture_view<unorm4, 2>(resultTexture);
+
+	parallel_for_each(
+		// Define the compute domain, which is the set of threads that are created.
+		result.extent,
+		// Define the code to run on each thread on the accelerator.
+		[=](const index<2>& idx) restrict(amp)
+		{
+			const uint2 xy(idx[1], idx[0]);
+			const uint2 bandSize(result.extent[1], result.extent[0]);
+			const auto uv = (float2(xy) + 0.5f) / float2(bandSize);
+
+			result.set(idx, ToGrey(sourceView.sample(uv, 0.0f)));
+		}
+	);
+
+	copy(resultTexture, pResult, static_cast<uint32_t>(sizeof(uint32_t) * width * band.Height));
+}
+
+template<typename T>
+void MultiAdapterProcessor::ProcessBandCPU(const Source& source, const BandScheduler::Band& band,
+	uint32_t bitsPerScalar, uint8_t* pResult)
+{
+	// Split the band among the workers. Each reads its rows in place if they are already in the
+	// upload format, or otherwise has them converted straight into its own aligned working buffer,
+	// the CPU counterpart of the mapped upload resource.
+	const auto width = source.Width;
+	const auto texelSize = 4 * bitsPerScalar / 8;
+	const auto rowPitch = static_cast<size_t>(texelSize) * width;
+	const auto pPixels = source.pPixels;
+	const auto numWorkers = (min)(m_numCPUWorkers, band.Height);
+	vector<future<void>> workers;
+	for (auto i = 0u; i < numWorkers; ++i)
+	{
+		const auto y = band.Height * i / numWorkers;
+		const auto height = band.Height * (i + 1) / numWorkers - y;
+		workers.emplace_back(async(launch::async, [&, i, y, height]()
+		{
+			auto pSource = pPixels ? &pPixels[rowPitch * (band.Y + y)] : nullptr;
+			if (!pSource)
+			{
+				const auto pBuffer = m_workBuffers[i].Reserve(rowPitch * height);
+				if (!pBuffer) throw bad_alloc();
+				source.pImageLoader->WriteRegion(pBuffer, rowPitch, 0, band.Y + y, width, height);
+				pSource = pBuffer;
+			}
+
+			const auto pDst = reinterpret_cast<uint32_t*>(&pResult[sizeof(uint32_t) * width * y]);
+			const auto numPixels = static_cast<size_t>(width) * height;
+			for (size_t j = 0; j < numPixels; ++j)
+				pDst[j] = PackUnorm4(ToGrey(LoadTexel<T>(&pSource[texelSize * j], bitsPerScalar)));
+		}));
+	}
+
+	for (auto& worker : workers) worker.get();
+}
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ImageLoader.h"
+#include "BandScheduler.h"
+#include "AlignedBuffer.h"
+
+// Processes an image on all the hardware AMP accelerators at once, together with CPU worker
+// threads running the same luma kernel. The image is processed in rounds of horizontal
+// bands; each round is split among the devices by a band scheduler in proportion to their
+// throughput measured in the previous rounds. Every device writes its band straight into
+// its rows of the output, so stitching the bands needs no extra copy.
+class MultiAdapterProcessor
+{
+public:
+	MultiAdapterProcessor();
+	virtual ~MultiAdapterProcessor();
+
+	// Adds every hardware AMP accelerator, and the CPU as one more device if numCPUWorkers > 0.
+	// WARP is skipped, since the CPU workers already run on the same cores.
+	bool Init(uint32_t numCPUWorkers);
+
+	// Outputs the processed image as tightly packed RGBA8 pixels.
+	bool Process(const ImageLoader& imageLoader, std::vector<uint8_t>& result,
+		uint32_t numRounds = DefaultNumRounds);
+
+	// Processes tightly packed RGBA8 pixels already in memory, such as an atlas of small images
+	// packed on the CPU, so that the devices are woken once for all of them.
+	bool Process(const uint8_t* pPixels, uint32_t width, uint32_t height, std::vector<uint8_t>& result,
+		uint32_t numRounds = DefaultNumRounds);
+
+	uint32_t GetNumDevices() const;
+	const std::wstring& GetDeviceName(uint32_t device) const;
+	uint64_t GetNumPixels(uint32_t device) const;	// Processed by the device in total
+	const BandScheduler& GetScheduler() const;
+	double GetProcessTime() const;
+
+	static const uint32_t DefaultNumRounds = 4;
+
+protected:
+	struct Device
+	{
+		std::wstring Name;
+		std::unique_ptr<Concurrency::accelerator_view> AcceleratorView;	// Null for the CPU
+		uint64_t NumPixels;
+	};
+
+	// Pixels in the upload format, read in place, or otherwise converted by the image loader
+	struct Source
+	{
+		const ImageLoader* pImageLoader;
+		const uint8_t* pPixels;
+		uint32_t Width;
+		uint32_t Height;
+	};
+
+	template<typename T>
+	bool ProcessRounds(const Source& source, std::vector<uint8_t>& result,
+		uint32_t bitsPerScalar, uint32_t numRounds);
+
+	template<typename T>
+	void ProcessBandAMP(const Concurrency::accelerator_view& acceleratorView, const Source& source,
+		const BandScheduler::Band& band, uint32_t bitsPerScalar, uint8_t* pResult) const;
+
+	template<typename T>
+	void ProcessBandCPU(const Source& source, const BandScheduler::Band& band,
+		uint32_t bitsPerScalar, uint8_t* pResult);
+
+	std::vector<Device> m_devices;
+	BandScheduler		m_scheduler;
+	uint32_t			m_numCPUWorkers;
+
+	// One working buffer per CPU worker, kept across the bands, rounds and images
+	std::vector<AlignedBuffer> m_workBuffers;
+
+	double				m_processTime;
+};
@@ -0,0 +1,657 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PixelKernels.h"
+
+#if defined(_M_ARM64) || defined(__ARM_NEON)
+#define _PIXEL_KERNELS_NEON_
+#include <arm_neon.h>
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define _PIXEL_KERNELS_X86_
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#define TARGET_F16C
+#else
+#include <cpuid.h>
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#endif
+#endif
+
+using namespace std;
+
+namespace PixelKernels
+{
+	static void ExpandRGBToRGBA_Scalar(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		for (size_t i = 0; i < numPixels; ++i)
+		{
+			pDst[4 * i] = pSrc[3 * i];
+			pDst[4 * i + 1] = pSrc[3 * i + 1];
+			pDst[4 * i + 2] = pSrc[3 * i + 2];
+			pDst[4 * i + 3] = 0xff;
+		}
+	}
+
+	static void ExpandRGBToRGBA16_Scalar(uint16_t* pDst, const uint16_t* pSrc, size_t numPixels)
+	{
+		for (size_t i = 0; i < numPixels; ++i)
+		{
+			pDst[4 * i] = pSrc[3 * i];
+			pDst[4 * i + 1] = pSrc[3 * i + 1];
+			pDst[4 * i + 2] = pSrc[3 * i + 2];
+			pDst[4 * i + 3] = 0xffff;
+		}
+	}
+
+	static void ExpandRGBToRGBA32F_Scalar(float* pDst, const float* pSrc, size_t numPixels)
+	{
+		for (size_t i = 0; i < numPixels; ++i)
+		{
+			pDst[4 * i] = pSrc[3 * i];
+			pDst[4 * i + 1] = pSrc[3 * i + 1];
+			pDst[4 * i + 2] = pSrc[3 * i + 2];
+			pDst[4 * i + 3] = 1.0f;
+		}
+	}
+
+	static uint16_t FloatToHalf(float value)
+	{
+		static const uint32_t f32Infinity = 255 << 23;
+		static const uint32_t f16Max = (127 + 16) << 23;
+		static const uint32_t denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const auto sign = bits & 0x80000000;
+		bits ^= sign;
+
+		uint16_t half;
+		// Quieted NaN with the top payload bits, or infinity
+		if (bits >= f16Max) half = bits > f32Infinity ? 0x7e00 | ((bits >> 13) & 0x3ff) : 0x7c00;
+		else if (bits < (113 << 23))
+		{
+			// Subnormal or zero: align the 10 mantissa bits at the bottom with a magic
+			// addition, which rounds to nearest even as the FPU does
+			float magic, aligned;
+			memcpy(&magic, &denormMagic, sizeof(magic));
+			memcpy(&aligned, &bits, sizeof(aligned));
+			aligned += magic;
+			memcpy(&bits, &aligned, sizeof(bits));
+			half = static_cast<uint16_t>(bits - denormMagic);
+		}
+		else
+		{
+			// Rebias the exponent and round the mantissa to nearest even
+			const auto mantissaOdd = (bits >> 13) & 1;
+			bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + mantissaOdd;
+			half = static_cast<uint16_t>(bits >> 13);
+		}
+
+		return half | static_cast<uint16_t>(sign >> 16);
+	}
+
+	static void ConvertFloatToHalf_Scalar(uint16_t* pDst, const float* pSrc, size_t numValues)
+	{
+		for (size_t i = 0; i < numValues; ++i) pDst[i] = FloatToHalf(pSrc[i]);
+	}
+
+	static void ConvertRGBToRGBAHalf_Scalar(uint16_t* pDst, const float* pSrc, size_t numPixels)
+	{
+		for (size_t i = 0; i < numPixels; ++i)
+		{
+			pDst[4 * i] = FloatToHalf(pSrc[3 * i]);
+			pDst[4 * i + 1] = FloatToHalf(pSrc[3 * i + 1]);
+			pDst[4 * i + 2] = FloatToHalf(pSrc[3 * i + 2]);
+			pDst[4 * i + 3] = 0x3c00;
+		}
+	}
+
+	static void ConvertRGBAToLuma_Scalar(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		for (size_t i = 0; i < numPixels; ++i)
+		{
+			const auto luma = static_cast<uint8_t>((LumaWeightR * pSrc[4 * i] + LumaWeightG * pSrc[4 * i + 1] +
+				LumaWeightB * pSrc[4 * i + 2] + LumaRounding) >> LumaShift);
+			pDst[4 * i] = luma;
+			pDst[4 * i + 1] = luma;
+			pDst[4 * i + 2] = luma;
+			pDst[4 * i + 3] = pSrc[4 * i + 3];
+		}
+	}
+
+#ifdef _PIXEL_KERNELS_X86_
+	enum SIMDLevel : uint8_t
+	{
+		SIMD_NONE,
+		SIMD_SSSE3,
+		SIMD_AVX2
+	};
+
+	static SIMDLevel DetectSIMDLevel()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		const auto maxLeaf = info[0];
+		__cpuid(info, 1);
+		const auto ssse3 = (info[2] & (1 << 9)) != 0;
+		const auto osxsave = (info[2] & (1 << 27)) != 0;
+		const auto avx = (info[2] & (1 << 28)) != 0;
+		auto avx2 = false;
+		if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		const auto ssse3 = __builtin_cpu_supports("ssse3") != 0;
+		const auto avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+
+		return avx2 ? SIMD_AVX2 : (ssse3 ? SIMD_SSSE3 : SIMD_NONE);
+	}
+
+	static SIMDLevel GetSIMDLevel()
+	{
+		static const auto simdLevel = DetectSIMDLevel();
+
+		return simdLevel;
+	}
+
+	static bool DetectF16C()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const auto osxsave = (info[2] & (1 << 27)) != 0;
+		const auto avx = (info[2] & (1 << 28)) != 0;
+		const auto f16c = (info[2] & (1 << 29)) != 0;
+
+		return osxsave && avx && f16c && (_xgetbv(0) & 0x6) == 0x6;
+#else
+		__builtin_cpu_init();
+
+		return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#endif
+	}
+
+	static bool HasF16C()
+	{
+		static const auto hasF16C = DetectF16C();
+
+		return hasF16C;
+	}
+
+	TARGET_SSSE3
+	static size_t ExpandRGBToRGBA_SSSE3(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		const auto shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const auto alpha = _mm_set1_epi32(0xff000000);
+
+		// Each 16-byte load covers 4 pixels, so keep enough pixels behind to never read past the end
+		size_t i = 0;
+		for (; i + 6 <= numPixels; i += 4)
+		{
+			const auto rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[3 * i]));
+			const auto rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[4 * i]), rgba);
+		}
+
+		return i;
+	}
+
+	TARGET_AVX2
+	static size_t ExpandRGBToRGBA_AVX2(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		const auto shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+			0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const auto alpha = _mm256_set1_epi32(0xff000000);
+
+		// 8 pixels per iteration: 4 pixels per 128-bit lane, the upper lane loaded from byte 12
+		size_t i = 0;
+		for (; i + 10 <= numPixels; i += 8)
+		{
+			const auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[3 * i]));
+			const auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[3 * i + 12]));
+			const auto rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			const auto rgba = _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pDst[4 * i]), rgba);
+		}
+
+		return i;
+	}
+	TARGET_SSSE3
+	static size_t ExpandRGBToRGBA16_SSSE3(uint16_t* pDst, const uint16_t* pSrc, size_t numPixels)
+	{
+		const auto shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+		const auto alpha = _mm_set1_epi64x(static_cast<int64_t>(0xffff000000000000ull));
+
+		// Each 16-byte load covers 2 pixels and a third of the next one
+		size_t i = 0;
+		for (; i + 3 <= numPixels; i += 2)
+		{
+			const auto rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[3 * i]));
+			const auto rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[4 * i]), rgba);
+		}
+
+		return i;
+	}
+
+	TARGET_AVX2
+	static size_t ExpandRGBToRGBA16_AVX2(uint16_t* pDst, const uint16_t* pSrc, size_t numPixels)
+	{
+		const auto shuffle = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1,
+			0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+		const auto alpha = _mm256_set1_epi64x(static_cast<int64_t>(0xffff000000000000ull));
+
+		// 4 pixels per iteration: 2 pixels per 128-bit lane, the upper lane loaded from pixel 2
+		size_t i = 0;
+		for (; i + 5 <= numPixels; i += 4)
+		{
+			const auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[3 * i]));
+			const auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[3 * i + 6]));
+			const auto rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			const auto rgba = _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pDst[4 * i]), rgba);
+		}
+
+		return i;
+	}
+
+	TARGET_SSSE3
+	static size_t ExpandRGBToRGBA32F_SSSE3(float* pDst, const float* pSrc, size_t numPixels)
+	{
+		const auto rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+		const auto alpha = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		// Each 4-float load reads into the next pixel, so stop one pixel early
+		size_t i = 0;
+		for (; i + 2 <= numPixels; ++i)
+		{
+			const auto rgb = _mm_loadu_ps(&pSrc[3 * i]);
+			_mm_storeu_ps(&pDst[4 * i], _mm_or_ps(_mm_and_ps(rgb, rgbMask), alpha));
+		}
+
+		return i;
+	}
+
+	TARGET_F16C
+	static size_t ConvertFloatToHalf_F16C(uint16_t* pDst, const float* pSrc, size_t numValues)
+	{
+		size_t i = 0;
+		for (; i + 8 <= numValues; i += 8)
+		{
+			const auto half = _mm256_cvtps_ph(_mm256_loadu_ps(&pSrc[i]), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[i]), half);
+		}
+
+		return i;
+	}
+
+	TARGET_F16C
+	static size_t ConvertRGBToRGBAHalf_F16C(uint16_t* pDst, const float* pSrc, size_t numPixels)
+	{
+		const auto rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+		const auto alpha = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		// 2 pixels per iteration; the 4-float load of the second one reads into the third
+		size_t i = 0;
+		for (; i + 3 <= numPixels; i += 2)
+		{
+			const auto lo = _mm_or_ps(_mm_and_ps(_mm_loadu_ps(&pSrc[3 * i]), rgbMask), alpha);
+			const auto hi = _mm_or_ps(_mm_and_ps(_mm_loadu_ps(&pSrc[3 * i + 3]), rgbMask), alpha);
+			const auto rgba = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+			const auto half = _mm256_cvtps_ph(rgba, _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[4 * i]), half);
+		}
+
+		return i;
+	}
+
+	TARGET_SSSE3
+	static size_t ConvertRGBAToLuma_SSSE3(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		// R and B, then G and A, are split into the 16-bit halves of each pixel, so that one
+		// multiply-add per pair sums the weighted channels of each pixel in 32 bits
+		const auto mask = _mm_set1_epi32(0x00ff00ff);
+		const auto weightsRB = _mm_set1_epi32((LumaWeightB << 16) | LumaWeightR);
+		const auto weightsGA = _mm_set1_epi32(LumaWeightG);
+		const auto rounding = _mm_set1_epi32(LumaRounding);
+		const auto alphaMask = _mm_set1_epi32(0xff000000);
+		const auto broadcast = _mm_setr_epi8(0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1);
+
+		size_t i = 0;
+		for (; i + 4 <= numPixels; i += 4)
+		{
+			const auto rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[4 * i]));
+			const auto rb = _mm_and_si128(rgba, mask);
+			const auto ga = _mm_and_si128(_mm_srli_epi32(rgba, 8), mask);
+			auto luma = _mm_add_epi32(_mm_madd_epi16(rb, weightsRB), _mm_madd_epi16(ga, weightsGA));
+			luma = _mm_srli_epi32(_mm_add_epi32(luma, rounding), LumaShift);
+			const auto grey = _mm_or_si128(_mm_shuffle_epi8(luma, broadcast), _mm_and_si128(rgba, alphaMask));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[4 * i]), grey);
+		}
+
+		return i;
+	}
+
+	TARGET_AVX2
+	static size_t ConvertRGBAToLuma_AVX2(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		const auto mask = _mm256_set1_epi32(0x00ff00ff);
+		const auto weightsRB = _mm256_set1_epi32((LumaWeightB << 16) | LumaWeightR);
+		const auto weightsGA = _mm256_set1_epi32(LumaWeightG);
+		const auto rounding = _mm256_set1_epi32(LumaRounding);
+		const auto alphaMask = _mm256_set1_epi32(0xff000000);
+		const auto broadcast = _mm256_setr_epi8(0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1,
+			0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1);
+
+		// 8 pixels per iteration, twice the 4 pixels of the SSSE3 kernel
+		size_t i = 0;
+		for (; i + 8 <= numPixels; i += 8)
+		{
+			const auto rgba = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&pSrc[4 * i]));
+			const auto rb = _mm256_and_si256(rgba, mask);
+			const auto ga = _mm256_and_si256(_mm256_srli_epi32(rgba, 8), mask);
+			auto luma = _mm256_add_epi32(_mm256_madd_epi16(rb, weightsRB), _mm256_madd_epi16(ga, weightsGA));
+			luma = _mm256_srli_epi32(_mm256_add_epi32(luma, rounding), LumaShift);
+			const auto grey = _mm256_or_si256(_mm256_shuffle_epi8(luma, broadcast), _mm256_and_si256(rgba, alphaMask));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pDst[4 * i]), grey);
+		}
+
+		return i;
+	}
+#endif
+
+#ifdef _PIXEL_KERNELS_NEON_
+	static size_t ExpandRGBToRGBA_NEON(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		size_t i = 0;
+		for (; i + 16 <= numPixels; i += 16)
+		{
+			const auto rgb = vld3q_u8(&pSrc[3 * i]);
+			uint8x16x4_t rgba;
+			rgba.val[0] = rgb.val[0];
+			rgba.val[1] = rgb.val[1];
+			rgba.val[2] = rgb.val[2];
+			rgba.val[3] = vdupq_n_u8(0xff);
+			vst4q_u8(&pDst[4 * i], rgba);
+		}
+
+		return i;
+	}
+	static size_t ExpandRGBToRGBA16_NEON(uint16_t* pDst, const uint16_t* pSrc, size_t numPixels)
+	{
+		size_t i = 0;
+		for (; i + 8 <= numPixels; i += 8)
+		{
+			const auto rgb = vld3q_u16(&pSrc[3 * i]);
+			uint16x8x4_t rgba;
+			rgba.val[0] = rgb.val[0];
+			rgba.val[1] = rgb.val[1];
+			rgba.val[2] = rgb.val[2];
+			rgba.val[3] = vdupq_n_u16(0xffff);
+			vst4q_u16(&pDst[4 * i], rgba);
+		}
+
+		return i;
+	}
+
+	static size_t ExpandRGBToRGBA32F_NEON(float* pDst, const float* pSrc, size_t numPixels)
+	{
+		size_t i = 0;
+		for (; i + 4 <= numPixels; i += 4)
+		{
+			const auto rgb = vld3q_f32(&pSrc[3 * i]);
+			float32x4x4_t rgba;
+			rgba.val[0] = rgb.val[0];
+			rgba.val[1] = rgb.val[1];
+			rgba.val[2] = rgb.val[2];
+			rgba.val[3] = vdupq_n_f32(1.0f);
+			vst4q_f32(&pDst[4 * i], rgba);
+		}
+
+		return i;
+	}
+
+	static size_t ConvertFloatToHalf_NEON(uint16_t* pDst, const float* pSrc, size_t numValues)
+	{
+		size_t i = 0;
+		for (; i + 4 <= numValues; i += 4)
+			vst1_u16(&pDst[i], vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(&pSrc[i]))));
+
+		return i;
+	}
+
+	static size_t ConvertRGBToRGBAHalf_NEON(uint16_t* pDst, const float* pSrc, size_t numPixels)
+	{
+		size_t i = 0;
+		for (; i + 4 <= numPixels; i += 4)
+		{
+			const auto rgb = vld3q_f32(&pSrc[3 * i]);
+			uint16x4x4_t rgba;
+			rgba.val[0] = vreinterpret_u16_f16(vcvt_f16_f32(rgb.val[0]));
+			rgba.val[1] = vreinterpret_u16_f16(vcvt_f16_f32(rgb.val[1]));
+			rgba.val[2] = vreinterpret_u16_f16(vcvt_f16_f32(rgb.val[2]));
+			rgba.val[3] = vdup_n_u16(0x3c00);
+			vst4_u16(&pDst[4 * i], rgba);
+		}
+
+		return i;
+	}
+
+	static size_t ConvertRGBAToLuma_NEON(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels)
+	{
+		const auto weightR = vdup_n_u8(LumaWeightR);
+		const auto weightG = vdup_n_u8(LumaWeightG);
+		const auto weightB = vdup_n_u8(LumaWeightB);
+
+		// The rounding narrowing shift adds the rounding of the fixed-point luma
+		static_assert(LumaRounding == 1 << (LumaShift - 1), "The luma rounding must be half of its divisor.");
+
+		size_t i = 0;
+		for (; i + 16 <= numPixels; i += 16)
+		{
+			const auto rgba = vld4q_u8(&pSrc[4 * i]);
+			auto lo = vmull_u8(vget_low_u8(rgba.val[0]), weightR);
+			lo = vmlal_u8(lo, vget_low_u8(rgba.val[1]), weightG);
+			lo = vmlal_u8(lo, vget_low_u8(rgba.val[2]), weightB);
+			auto hi = vmull_u8(vget_high_u8(rgba.val[0]), weightR);
+			hi = vmlal_u8(hi, vget_high_u8(rgba.val[1]), weightG);
+			hi = vmlal_u8(hi, vget_high_u8(rgba.val[2]), weightB);
+
+			const auto luma = vcombine_u8(vrshrn_n_u16(lo, LumaShift), vrshrn_n_u16(hi, LumaShift));
+			uint8x16x4_t grey;
+			grey.val[0] = luma;
+			grey.val[1] = luma;
+			grey.val[2] = luma;
+			grey.val[3] = rgba.val[3];
+			vst4q_u8(&pDst[4 * i], grey);
+		}
+
+		return i;
+	}
+#endif
+
+	bool IsBackendSupported(Backend backend)
+	{
+		switch (backend)
+		{
+		case BACKEND_SCALAR:
+		case BACKEND_AUTO:
+			return true;
+#if defined(_PIXEL_KERNELS_X86_)
+		case BACKEND_SSSE3:
+			return GetSIMDLevel() != SIMD_NONE;
+		case BACKEND_AVX2:
+			return GetSIMDLevel() == SIMD_AVX2;
+#elif defined(_PIXEL_KERNELS_NEON_)
+		case BACKEND_NEON:
+			return true;
+#endif
+		default:
+			return false;
+		}
+	}
+
+	const char* GetBackendName(Backend backend)
+	{
+		static const char* const names[] = { "Scalar", "SSSE3", "AVX2", "NEON", "Auto" };
+
+		return backend <= BACKEND_AUTO ? names[backend] : "Unknown";
+	}
+
+	static Backend GetBestBackend()
+	{
+#if defined(_PIXEL_KERNELS_X86_)
+		switch (GetSIMDLevel())
+		{
+		case SIMD_AVX2:
+			return BACKEND_AVX2;
+		case SIMD_SSSE3:
+			return BACKEND_SSSE3;
+		default:
+			return BACKEND_SCALAR;
+		}
+#elif defined(_PIXEL_KERNELS_NEON_)
+		return BACKEND_NEON;
+#else
+		return BACKEND_SCALAR;
+#endif
+	}
+
+	void ExpandRGBToRGBA(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels, Backend backend)
+	{
+		assert(IsBackendSupported(backend));
+		if (backend == BACKEND_AUTO) backend = GetBestBackend();
+		size_t i = 0;
+
+#if defined(_PIXEL_KERNELS_X86_)
+		switch (backend)
+		{
+		case BACKEND_AVX2:
+			i = ExpandRGBToRGBA_AVX2(pDst, pSrc, numPixels);
+			break;
+		case BACKEND_SSSE3:
+			i = ExpandRGBToRGBA_SSSE3(pDst, pSrc, numPixels);
+			break;
+		default:
+			break;
+		}
+#elif defined(_PIXEL_KERNELS_NEON_)
+		if (backend == BACKEND_NEON) i = ExpandRGBToRGBA_NEON(pDst, pSrc, numPixels);
+#endif
+
+		// Tail
+		ExpandRGBToRGBA_Scalar(&pDst[4 * i], &pSrc[3 * i], numPixels - i);
+	}
+
+	void ExpandRGBToRGBA16(uint16_t* pDst, const uint16_t* pSrc, size_t numPixels, Backend backend)
+	{
+		assert(IsBackendSupported(backend));
+		if (backend == BACKEND_AUTO) backend = GetBestBackend();
+		size_t i = 0;
+
+#if defined(_PIXEL_KERNELS_X86_)
+		switch (backend)
+		{
+		case BACKEND_AVX2:
+			i = ExpandRGBToRGBA16_AVX2(pDst, pSrc, numPixels);
+			break;
+		case BACKEND_SSSE3:
+			i = ExpandRGBToRGBA16_SSSE3(pDst, pSrc, numPixels);
+			break;
+		default:
+			break;
+		}
+#elif defined(_PIXEL_KERNELS_NEON_)
+		if (backend == BACKEND_NEON) i = ExpandRGBToRGBA16_NEON(pDst, pSrc, numPixels);
+#endif
+
+		// Tail
+		ExpandRGBToRGBA16_Scalar(&pDst[4 * i], &pSrc[3 * i], numPixels - i);
+	}
+
+	void ExpandRGBToRGBA32F(float* pDst, const float* pSrc, size_t numPixels, Backend backend)
+	{
+		assert(IsBackendSupported(backend));
+		if (backend == BACKEND_AUTO) backend = GetBestBackend();
+		size_t i = 0;
+
+		// The SSSE3 kernel serves the AVX2 backend too
+#if defined(_PIXEL_KERNELS_X86_)
+		if (backend == BACKEND_SSSE3 || backend == BACKEND_AVX2) i = ExpandRGBToRGBA32F_SSSE3(pDst, pSrc, numPixels);
+#elif defined(_PIXEL_KERNELS_NEON_)
+		if (backend == BACKEND_NEON) i = ExpandRGBToRGBA32F_NEON(pDst, pSrc, numPixels);
+#endif
+
+		// Tail
+		ExpandRGBToRGBA32F_Scalar(&pDst[4 * i], &pSrc[3 * i], numPixels - i);
+	}
+
+	void ConvertFloatToHalf(uint16_t* pDst, const float* pSrc, size_t numValues, Backend backend)
+	{
+		assert(IsBackendSupported(backend));
+		if (backend == BACKEND_AUTO) backend = GetBestBackend();
+		size_t i = 0;
+
+#if defined(_PIXEL_KERNELS_X86_)
+		if (backend != BACKEND_SCALAR && HasF16C()) i = ConvertFloatToHalf_F16C(pDst, pSrc, numValues);
+#elif defined(_PIXEL_KERNELS_NEON_)
+		if (backend == BACKEND_NEON) i = ConvertFloatToHalf_NEON(pDst, pSrc, numValues);
+#endif
+
+		// Tail
+		ConvertFloatToHalf_Scalar(&pDst[i], &pSrc[i], numValues - i);
+	}
+
+	void ConvertRGBToRGBAHalf(uint16_t* pDst, const float* pSrc, size_t numPixels, Backend backend)
+	{
+		assert(IsBackendSupported(backend));
+		if (backend == BACKEND_AUTO) backend = GetBestBackend();
+		size_t i = 0;
+
+#if defined(_PIXEL_KERNELS_X86_)
+		if (backend != BACKEND_SCALAR && HasF16C()) i = ConvertRGBToRGBAHalf_F16C(pDst, pSrc, numPixels);
+#elif defined(_PIXEL_KERNELS_NEON_)
+		if (backend == BACKEND_NEON) i = ConvertRGBToRGBAHalf_NEON(pDst, pSrc, numPixels);
+#endif
+
+		// Tail
+		ConvertRGBToRGBAHalf_Scalar(&pDst[4 * i], &pSrc[3 * i], numPixels - i);
+	}
+
+	void ConvertRGBAToLuma(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels, Backend backend)
+	{
+		assert(IsBackendSupported(backend));
+		if (backend == BACKEND_AUTO) backend = GetBestBackend();
+		size_t i = 0;
+
+#if defined(_PIXEL_KERNELS_X86_)
+		switch (backend)
+		{
+		case BACKEND_AVX2:
+			i = ConvertRGBAToLuma_AVX2(pDst, pSrc, numPixels);
+			break;
+		case BACKEND_SSSE3:
+			i = ConvertRGBAToLuma_SSSE3(pDst, pSrc, numPixels);
+			break;
+		default:
+			break;
+		}
+#elif defined(_PIXEL_KERNELS_NEON_)
+		if (backend == BACKEND_NEON) i = ConvertRGBAToLuma_NEON(pDst, pSrc, numPixels);
+#endif
+
+		// Tail
+		ConvertRGBAToLuma_Scalar(&pDst[4 * i], &pSrc[4 * i], numPixels - i);
+	}
+}
@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// CPU pixel kernels, vectorized with SSSE3/AVX2/F16C on x86/x64 (selected at run time)
+// and NEON on ARM, with scalar fallbacks.
+namespace PixelKernels
+{
+	// Instruction sets of the kernels, which may be forced for cross-checking them
+	enum Backend : uint8_t
+	{
+		BACKEND_SCALAR,
+		BACKEND_SSSE3,
+		BACKEND_AVX2,
+		BACKEND_NEON,
+		BACKEND_AUTO	// The best one available
+	};
+
+	bool IsBackendSupported(Backend backend);
+	const char* GetBackendName(Backend backend);
+
+	// Fixed-point luma weights of 8-bit channels, in 1/256, shared with the AMP kernel:
+	// luma = (77 R + 150 G + 29 B + 128) >> 8, which never exceeds 255
+	static const uint32_t LumaWeightR = 77;
+	static const uint32_t LumaWeightG = 150;
+	static const uint32_t LumaWeightB = 29;
+	static const uint32_t LumaRounding = 128;
+	static const uint32_t LumaShift = 8;
+
+	// Expands packed RGB8 pixels to RGBA8 with opaque alpha.
+	void ExpandRGBToRGBA(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels, Backend backend = BACKEND_AUTO);
+
+	// Expands packed RGB16 pixels to RGBA16 with opaque alpha.
+	void ExpandRGBToRGBA16(uint16_t* pDst, const uint16_t* pSrc, size_t numPixels, Backend backend = BACKEND_AUTO);
+
+	// Expands packed RGB32F pixels to RGBA32F with an alpha of 1.0.
+	void ExpandRGBToRGBA32F(float* pDst, const float* pSrc, size_t numPixels, Backend backend = BACKEND_AUTO);
+
+	// Converts 32-bit floats to half floats, rounding to nearest even. A NaN stays a quiet NaN
+	// of the same sign with the top bits of its payload, as F16C and NEON convert it; on x86,
+	// both vector backends take the F16C kernel where the CPU has it.
+	void ConvertFloatToHalf(uint16_t* pDst, const float* pSrc, size_t numValues, Backend backend = BACKEND_AUTO);
+
+	// Converts packed RGB32F pixels to RGBA16F with an alpha of 1.0.
+	void ConvertRGBToRGBAHalf(uint16_t* pDst, const float* pSrc, size_t numPixels, Backend backend = BACKEND_AUTO);
+
+	// Converts RGBA8 pixels to grey by the fixed-point luma, keeping the alpha. All the
+	// backends round identically, and match the fixed-point AMP kernel bit for bit.
+	void ConvertRGBAToLuma(uint8_t* pDst, const uint8_t* pSrc, size_t numPixels, Backend backend = BACKEND_AUTO);
+}
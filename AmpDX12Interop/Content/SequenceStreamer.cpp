@@ -0,0 +1,255 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "SequenceStreamer.h"
+
+using namespace std;
+using namespace XUSG;
+
+SequenceStreamer::SequenceStreamer() :
+	m_pSequence(nullptr),
+	m_fenceValue(0),
+	m_fenceEvent(nullptr),
+	m_uploadSize(0),
+	m_footprint(),
+	m_lastUseFenceValues(),
+	m_numSources(0),
+	m_current(0),
+	m_target(0),
+	m_isUploading(false),
+	m_decodeTimeSum(0.0),
+	m_uploadTimeSum(0.0),
+	m_hashTimeSum(0.0),
+	m_numTiles(0),
+	m_numSkippedTiles(0),
+	m_numUploads(0),
+	m_numProcessed(0),
+	m_numOverlapped(0)
+{
+}
+
+SequenceStreamer::~SequenceStreamer()
+{
+	if (m_fenceEvent)
+	{
+		WaitForUpload();
+		CloseHandle(m_fenceEvent);
+	}
+}
+
+bool SequenceStreamer::Init(const Device* pDevice, ImageSequence* pSequence,
+	const Texture::sptr* pSources, uint8_t numSources)
+{
+	assert(numSources > 0 && numSources <= MaxSourceCount);
+	m_pSequence = pSequence;
+	m_numSources = numSources;
+	for (uint8_t i = 0; i < numSources; ++i) m_sources[i] = pSources[i];
+
+	// Create the copy queue and its command list
+	m_copyQueue = CommandQueue::MakeUnique();
+	XUSG_N_RETURN(m_copyQueue->Create(pDevice, CommandListType::COPY, CommandQueueFlag::NONE,
+		0, 0, L"CopyQueue"), false);
+
+	m_commandAllocator = CommandAllocator::MakeUnique();
+	XUSG_N_RETURN(m_commandAllocator->Create(pDevice, CommandListType::COPY, L"CopyAllocator"), false);
+
+	m_commandList = CommandList::MakeUnique();
+	XUSG_N_RETURN(m_commandList->Create(pDevice, 0, CommandListType::COPY,
+		m_commandAllocator.get(), nullptr), false);
+	XUSG_N_RETURN(m_commandList->Close(), false);
+
+	m_fence = Fence::MakeUnique();
+	XUSG_N_RETURN(m_fence->Create(pDevice, m_fenceValue, FenceFlag::NONE, L"CopyFence"), false);
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	XUSG_N_RETURN(m_fenceEvent, false);
+
+	// Create the upload ring; a single upload is in flight at a time, so a frame fits all
+	const auto pDevice12 = static_cast<ID3D12Device*>(pDevice->GetHandle());
+	const auto desc = static_cast<ID3D12Resource*>(m_sources[0]->GetHandle())->GetDesc();
+	pDevice12->GetCopyableFootprints(&desc, 0, 1, 0, &m_footprint, nullptr, nullptr, &m_uploadSize);
+	m_uploadSize = XUSG_DIV_UP(m_uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT) *
+		D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+	XUSG_N_RETURN(m_uploadRing.Init(pDevice, m_uploadSize, L"SequenceUploadRing"), false);
+
+	// Upload the first frame before the first processing
+	ImageSequence::Frame frame;
+	XUSG_N_RETURN(m_pSequence->GetNextFrame(frame, true), false);
+	XUSG_N_RETURN(Upload(frame, 0), false);
+	WaitForUpload();
+	m_isUploading = false;
+	m_current = 0;
+	m_changedRects.clear();
+	m_statsTime = chrono::steady_clock::now();
+
+	return true;
+}
+
+uint8_t SequenceStreamer::Update(const Fence* pDirectFence, uint64_t directFenceValue)
+{
+	// Switch to the uploaded source once its copy has completed
+	const auto completedValue = m_fence->GetCompletedValue();
+	m_uploadRing.Reclaim(completedValue);
+	m_changedRects.clear();
+	if (m_isUploading && completedValue >= m_fenceValue)
+	{
+		m_uploadTimeSum += chrono::duration<double, milli>(chrono::steady_clock::now() - m_uploadTime).count();
+		++m_numUploads;
+		m_current = m_target;
+		m_changedRects.swap(m_uploadChangedRects);
+		m_isUploading = false;
+	}
+
+	// The current source is read by the frame that signals this fence value
+	m_lastUseFenceValues[m_current] = directFenceValue;
+
+	// Start uploading the next frame into another source, once it has been decoded
+	ImageSequence::Frame frame;
+	if (!m_isUploading && m_numSources > 1 && m_pSequence->GetNextFrame(frame))
+	{
+		const auto target = static_cast<uint8_t>((m_current + 1) % m_numSources);
+
+		// Do not overwrite the source while a previous frame may still be reading it
+		m_copyQueue->Wait(pDirectFence, m_lastUseFenceValues[target]);
+		Upload(frame, target);
+	}
+
+	++m_numProcessed;
+	if (m_isUploading) ++m_numOverlapped;
+
+	return m_current;
+}
+
+void SequenceStreamer::WaitForUpload()
+{
+	if (m_fence->GetCompletedValue() < m_fenceValue)
+	{
+		m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent);
+		WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+	}
+}
+
+const vector<RECT>& SequenceStreamer::GetChangedRects() const
+{
+	return m_changedRects;
+}
+
+const UploadRing::Stats& SequenceStreamer::GetUploadStats() const
+{
+	return m_uploadRing.GetStats();
+}
+
+SequenceStreamer::Stats SequenceStreamer::GetStats()
+{
+	const auto now = chrono::steady_clock::now();
+	const auto elapsed = chrono::duration<double>(now - m_statsTime).count();
+
+	Stats stats;
+	stats.FramesPerSecond = elapsed > 0.0 ? m_numUploads / elapsed : 0.0;
+	stats.DecodeTime = m_numUploads > 0 ? m_decodeTimeSum / m_numUploads : 0.0;
+	stats.UploadTime = m_numUploads > 0 ? m_uploadTimeSum / m_numUploads : 0.0;
+	stats.HashTime = m_numUploads > 0 ? m_hashTimeSum / m_numUploads : 0.0;
+	stats.Overlap = m_numProcessed > 0 ? static_cast<double>(m_numOverlapped) / m_numProcessed : 0.0;
+	stats.SkipRate = m_numTiles > 0 ? static_cast<double>(m_numSkippedTiles) / m_numTiles : 0.0;
+
+	m_statsTime = now;
+	m_decodeTimeSum = 0.0;
+	m_uploadTimeSum = 0.0;
+	m_hashTimeSum = 0.0;
+	m_numTiles = 0;
+	m_numSkippedTiles = 0;
+	m_numUploads = 0;
+	m_numProcessed = 0;
+	m_numOverlapped = 0;
+
+	return stats;
+}
+
+bool SequenceStreamer::Upload(const ImageSequence::Frame& frame, uint8_t target)
+{
+	// The previous copy has completed, so the allocator is free
+	UploadRing::Allocation allocation;
+	XUSG_M_RETURN(!m_uploadRing.Allocate(m_uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation),
+		cerr, "Failed to allocate upload memory.", false);
+
+	uint32_t width, height;
+	m_pSequence->GetFrameSize(width, height);
+	const auto rowSize = sizeof(uint32_t) * width;
+	for (auto i = 0u; i < height; ++i)
+		memcpy(&allocation.pData[m_footprint.Footprint.RowPitch * i], &frame.Pixels[rowSize * i], rowSize);
+
+	XUSG_N_RETURN(m_commandAllocator->Reset(), false);
+	XUSG_N_RETURN(m_commandList->Reset(m_commandAllocator.get(), nullptr), false);
+
+	// The source is promoted from COMMON to COPY_DEST, and decays back after the copy
+	D3D12_TEXTURE_COPY_LOCATION dst = {};
+	dst.pResource = static_cast<ID3D12Resource*>(m_sources[target]->GetHandle());
+	dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	dst.SubresourceIndex = 0;
+
+	D3D12_TEXTURE_COPY_LOCATION src = {};
+	src.pResource = static_cast<ID3D12Resource*>(allocation.pResource->GetHandle());
+	src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	src.PlacedFootprint = m_footprint;
+	src.PlacedFootprint.Offset += allocation.Offset;
+
+	const auto pCommandList12 = static_cast<ID3D12GraphicsCommandList*>(m_commandList->GetHandle());
+	pCommandList12->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	XUSG_N_RETURN(m_commandList->Close(), false);
+
+	m_copyQueue->ExecuteCommandList(m_commandList.get());
+	XUSG_N_RETURN(m_copyQueue->Signal(m_fence.get(), ++m_fenceValue), false);
+	m_uploadRing.Submit(m_fenceValue);
+
+	UpdateChangedRects(frame, m_uploadChangedRects);
+	m_decodeTimeSum += frame.DecodeTime;
+	m_hashTimeSum += frame.HashTime;
+	m_uploadTime = chrono::steady_clock::now();
+	m_target = target;
+	m_isUploading = true;
+
+	return true;
+}
+
+void SequenceStreamer::UpdateChangedRects(const ImageSequence::Frame& frame, vector<RECT>& rects)
+{
+	uint32_t width, height;
+	m_pSequence->GetFrameSize(width, height);
+	rects.clear();
+
+	// Without the hashes of both frames, the whole frame has changed
+	const auto tileSize = m_pSequence->GetHashTileSize();
+	if (frame.TileHashes.empty() || frame.TileHashes.size() != m_tileHashes.size())
+	{
+		rects.push_back({ 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) });
+		m_tileHashes = frame.TileHashes;
+
+		return;
+	}
+
+	// Each run of changed tiles in a tile row makes a rect
+	const auto numTilesX = (width + tileSize - 1) / tileSize;
+	const auto numTilesY = static_cast<uint32_t>(frame.TileHashes.size() / numTilesX);
+	for (auto i = 0u; i < numTilesY; ++i)
+	{
+		const auto pHashes = &frame.TileHashes[static_cast<size_t>(numTilesX) * i];
+		const auto pPrevHashes = &m_tileHashes[static_cast<size_t>(numTilesX) * i];
+		for (auto j = 0u; j < numTilesX;)
+		{
+			if (pHashes[j] == pPrevHashes[j])
+			{
+				++m_numSkippedTiles;
+				++j;
+				continue;
+			}
+
+			const auto start = j;
+			while (j < numTilesX && pHashes[j] != pPrevHashes[j]) ++j;
+			rects.push_back({ static_cast<LONG>(tileSize * start), static_cast<LONG>(tileSize * i),
+				static_cast<LONG>((min)(tileSize * j, width)), static_cast<LONG>((min)(tileSize * (i + 1), height)) });
+		}
+	}
+
+	m_numTiles += frame.TileHashes.size();
+	m_tileHashes = frame.TileHashes;
+}
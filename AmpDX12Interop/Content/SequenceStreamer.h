@@ -0,0 +1,92 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+#include "ImageSequence.h"
+#include "UploadRing.h"
+
+// Streams an image sequence into alternating source textures. The next frame is uploaded
+// on a copy queue while the current one is being processed, and the processed source only
+// switches once its upload has completed, so the direct queue never waits on the copy
+// queue. The copy queue in turn waits on the direct queue before overwriting a source.
+// With the tile hashes of the sequence, the tiles whose hashes match the previous frame
+// are left out of the changed rects, so their results can be kept.
+class SequenceStreamer
+{
+public:
+	struct Stats
+	{
+		double FramesPerSecond;	// Sustained sequence frames per second
+		double DecodeTime;		// Average per frame on the worker threads, in ms
+		double UploadTime;		// Average from submission to completion, in ms
+		double HashTime;		// Average per frame on the worker threads, in ms
+		double Overlap;			// Ratio of processed frames with an upload in flight
+		double SkipRate;		// Ratio of the tiles unchanged from the previous frame
+	};
+
+	SequenceStreamer();
+	virtual ~SequenceStreamer();
+
+	bool Init(const XUSG::Device* pDevice, ImageSequence* pSequence,
+		const XUSG::Texture::sptr* pSources, uint8_t numSources);
+
+	// Called once per processed frame, before processing. Returns the source to process;
+	// the direct fence value is the one signaled after the frame.
+	uint8_t Update(const XUSG::Fence* pDirectFence, uint64_t directFenceValue);
+	void WaitForUpload();
+
+	// Gets the rects of the source, in texels, that have changed with the last update; they
+	// are empty unless the update has switched to a new frame.
+	const std::vector<RECT>& GetChangedRects() const;
+
+	// Gets the stats since the last call.
+	Stats GetStats();
+	const UploadRing::Stats& GetUploadStats() const;
+
+	static const uint8_t MaxSourceCount = 2;
+
+protected:
+	bool Upload(const ImageSequence::Frame& frame, uint8_t target);
+	void UpdateChangedRects(const ImageSequence::Frame& frame, std::vector<RECT>& rects);
+
+	ImageSequence*					m_pSequence;
+
+	XUSG::CommandQueue::uptr		m_copyQueue;
+	XUSG::CommandAllocator::uptr	m_commandAllocator;
+	XUSG::CommandList::uptr			m_commandList;
+	XUSG::Fence::uptr				m_fence;
+	uint64_t						m_fenceValue;
+	HANDLE							m_fenceEvent;
+
+	// Upload memory recycled on the copy fence
+	UploadRing						m_uploadRing;
+	uint64_t						m_uploadSize;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_footprint;
+
+	XUSG::Texture::sptr				m_sources[MaxSourceCount];
+	uint64_t						m_lastUseFenceValues[MaxSourceCount];
+	uint8_t							m_numSources;
+	uint8_t							m_current;
+	uint8_t							m_target;
+	bool							m_isUploading;
+
+	// Tile hashes of the last uploaded frame, and the changes of the frames in flight and current
+	std::vector<uint64_t>			m_tileHashes;
+	std::vector<RECT>				m_uploadChangedRects;
+	std::vector<RECT>				m_changedRects;
+
+	// Stats
+	std::chrono::steady_clock::time_point m_statsTime;
+	std::chrono::steady_clock::time_point m_uploadTime;
+	double							m_decodeTimeSum;
+	double							m_uploadTimeSum;
+	double							m_hashTimeSum;
+	uint64_t						m_numTiles;
+	uint64_t						m_numSkippedTiles;
+	uint32_t						m_numUploads;
+	uint32_t						m_numProcessed;
+	uint32_t						m_numOverlapped;
+};
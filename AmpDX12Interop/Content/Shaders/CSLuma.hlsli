@@ -0,0 +1,26 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// The same luma kernel as the AMP path, sampling the source through the texture units
+
+Texture2D<float4> g_source : register(t0);
+RWTexture2D<unorm float4> g_result : register(u0);
+SamplerState g_sampler : register(s0);
+
+[numthreads(8, 8, 1)]
+void main(uint2 DTid : SV_DispatchThreadID)
+{
+	uint2 imageSize;
+	g_result.GetDimensions(imageSize.x, imageSize.y);
+	if (any(DTid >= imageSize)) return;
+
+	const float2 uv = (DTid + 0.5) / imageSize;
+	const float4 src = g_source.SampleLevel(g_sampler, uv, 0.0);
+	float dst = dot(src.xyz, float3(0.299, 0.587, 0.114));
+#ifdef TONE_MAP
+	dst /= 1.0 + dst;
+#endif
+
+	g_result[DTid] = float4(dst.xxx, src.w);
+}
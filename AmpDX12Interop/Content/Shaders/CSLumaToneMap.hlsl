@@ -0,0 +1,7 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// For HDR sources, which the display would otherwise clip
+#define TONE_MAP
+#include "CSLuma.hlsli"
@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TexturePool.h"
+
+using namespace std;
+using namespace XUSG;
+
+bool TexturePool::Key::operator<(const Key& key) const
+{
+	if (Width != key.Width) return Width < key.Width;
+	if (Height != key.Height) return Height < key.Height;
+	if (Format != key.Format) return Format < key.Format;
+
+	return Flags < key.Flags;
+}
+
+TexturePool::TexturePool(uint32_t maxFreeEntries) :
+	m_maxFreeEntries(maxFreeEntries),
+	m_numAcquires(0),
+	m_numHits(0)
+{
+}
+
+TexturePool::~TexturePool()
+{
+}
+
+TexturePool::Entry::uptr TexturePool::Acquire(const Key& key)
+{
+	++m_numAcquires;
+
+	const auto it = m_freeEntries.find(key);
+	if (it != m_freeEntries.end())
+	{
+		auto entry = move(it->second);
+		m_freeEntries.erase(it);
+		++m_numHits;
+
+		return entry;
+	}
+
+	auto entry = make_unique<Entry>();
+	entry->Id = key;
+
+	return entry;
+}
+
+void TexturePool::Release(Entry::uptr& entry)
+{
+	if (entry && entry->Id.Width > 0 && m_freeEntries.size() < m_maxFreeEntries)
+		m_freeEntries.emplace(entry->Id, move(entry));
+	entry.reset();
+}
+
+void TexturePool::Clear()
+{
+	m_freeEntries.clear();
+}
+
+uint32_t TexturePool::GetNumAcquires() const
+{
+	return m_numAcquires;
+}
+
+uint32_t TexturePool::GetNumHits() const
+{
+	return m_numHits;
+}
+
+double TexturePool::GetHitRate() const
+{
+	return m_numAcquires > 0 ? static_cast<double>(m_numHits) / m_numAcquires : 0.0;
+}
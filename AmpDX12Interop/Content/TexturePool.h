@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+
+// Pool of textures keyed by their size, format and resource flags. Each entry keeps the
+// DX11 resource, views and AMP wrappers made for its texture, so an entry recycled for
+// another image of the same key skips all the creation, sharing and wrapping; its user
+// only creates the parts that the entry is still missing.
+class TexturePool
+{
+public:
+	struct Key
+	{
+		uint32_t Width;
+		uint32_t Height;
+		XUSG::Format Format;
+		XUSG::ResourceFlag Flags;
+
+		bool operator<(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		Key Id;
+		XUSG::Texture::sptr Texture12;
+		XUSG::com_ptr<ID3D11Texture2D> Texture11;
+		XUSG::com_ptr<ID3D11ShaderResourceView> SRV11;
+		XUSG::com_ptr<ID3D11UnorderedAccessView> UAV11;
+		std::unique_ptr<Concurrency::graphics::texture<Concurrency::graphics::unorm_4, 2>> AMP;
+		std::unique_ptr<Concurrency::graphics::texture<Concurrency::graphics::float_4, 2>> AMPF;
+
+		using uptr = std::unique_ptr<Entry>;
+	};
+
+	TexturePool(uint32_t maxFreeEntries = DefaultMaxFreeEntries);
+	virtual ~TexturePool();
+
+	// Takes a free entry of the key, or a new empty entry on a miss.
+	Entry::uptr Acquire(const Key& key);
+
+	// Returns the entry to the pool; entries beyond the free capacity, and the ones
+	// with an empty key, are destroyed instead.
+	void Release(Entry::uptr& entry);
+
+	void Clear();
+
+	uint32_t GetNumAcquires() const;
+	uint32_t GetNumHits() const;
+	double GetHitRate() const;
+
+	static const uint32_t DefaultMaxFreeEntries = 8;
+
+protected:
+	std::multimap<Key, Entry::uptr> m_freeEntries;
+	uint32_t m_maxFreeEntries;
+
+	uint32_t m_numAcquires;
+	uint32_t m_numHits;
+};
@@ -0,0 +1,202 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TiledProcessor.h"
+#include "LumaKernel.h"
+
+using namespace std;
+using namespace Concurrency;
+using namespace Concurrency::graphics;
+using namespace XUSG;
+
+TiledProcessor::TiledProcessor(const accelerator_view& acceleratorView) :
+	m_acceleratorView(acceleratorView),
+	m_numTiles(0),
+	m_processTime(0.0),
+	m_stagingSize(0)
+{
+}
+
+TiledProcessor::~TiledProcessor()
+{
+}
+
+bool TiledProcessor::Process(BandReader& reader, BandWriter& writer,
+	uint32_t tileSize, uint32_t haloSize, uint8_t maxTilesInFlight)
+{
+	// A tile and its halo must fit in a texture, and 2 tiles in flight are needed
+	// to overlap the upload of a tile with the processing of the previous one.
+	haloSize = (min)(haloSize, MaxTextureSize / 4);
+	tileSize = (max)((min)(tileSize, MaxTextureSize - 2 * haloSize), 1u);
+	maxTilesInFlight = (max)(maxTilesInFlight, static_cast<uint8_t>(2));
+
+	switch (reader.GetBytesPerChannel())
+	{
+	case sizeof(uint8_t):
+		return ProcessTiles<unorm4>(reader, writer, 8, tileSize, haloSize, maxTilesInFlight);
+	case sizeof(uint16_t):
+		return ProcessTiles<unorm4>(reader, writer, 16, tileSize, haloSize, maxTilesInFlight);
+	case sizeof(float):
+		return ProcessTiles<float4>(reader, writer, 32, tileSize, haloSize, maxTilesInFlight);
+	default:
+		cerr << "Tiled processing does not support the format of the image." << endl;
+		return false;
+	}
+}
+
+uint32_t TiledProcessor::GetNumTiles() const
+{
+	return m_numTiles;
+}
+
+double TiledProcessor::GetProcessTime() const
+{
+	return m_processTime;
+}
+
+size_t TiledProcessor::GetBufferSize() const
+{
+	return m_streamer.GetBufferSize() + m_stagingSize;
+}
+
+bool TiledProcessor::IsTilingRequired(uint32_t width, uint32_t height)
+{
+	return width > MaxTextureSize || height > MaxTextureSize;
+}
+
+template<typename T>
+bool TiledProcessor::ProcessTiles(BandReader& reader, BandWriter& writer, uint32_t bitsPerScalar,
+	uint32_t tileSize, uint32_t haloSize, uint8_t maxTilesInFlight)
+{
+	const auto startTime = chrono::steady_clock::now();
+
+	uint32_t width, height;
+	reader.GetImageSize(width, height);
+	XUSG_N_RETURN(width > 0 && height > 0, false);
+
+	// Each slot holds the resources of a tile in flight
+	struct Slot
+	{
+		Slot(uint32_t sourceSize, uint32_t resultSize, uint32_t bitsPerScalar, const accelerator_view& acceleratorView) :
+			Source(sourceSize, sourceSize, bitsPerScalar, acceleratorView),
+			Result(resultSize, resultSize, 8u, acceleratorView) {}
+
+		texture<T, 2>		Source;
+		texture<unorm4, 2>	Result;
+		vector<uint8_t>		Staging;
+		vector<uint8_t>		Readback;
+		completion_future	Upload;
+		completion_future	Download;
+		Tile				Region;
+	};
+
+	const auto texelSize = 4 * bitsPerScalar / 8;
+	const auto sourceSize = tileSize + 2 * haloSize;
+	const auto numTilesX = (width + tileSize - 1) / tileSize;
+	const auto numTilesY = (height + tileSize - 1) / tileSize;
+	vector<unique_ptr<Slot>> slots((min)(static_cast<uint32_t>(maxTilesInFlight), numTilesX * numTilesY));
+	m_stagingSize = 0;
+	for (auto& slot : slots)
+	{
+		slot = make_unique<Slot>(sourceSize, tileSize, bitsPerScalar, m_acceleratorView);
+		slot->Staging.resize(static_cast<size_t>(texelSize) * sourceSize * sourceSize);
+		slot->Readback.resize(sizeof(uint32_t) * tileSize * tileSize);
+		m_stagingSize += slot->Staging.size() + slot->Readback.size();
+	}
+	m_numTiles = 0;
+
+	// Stage 1: upload the tile with its halo out of the source band
+	const auto upload = [&](Slot& slot, const Tile& tile, const BandStreamer::Band& band)
+	{
+		slot.Region = tile;
+		const auto rowPitch = static_cast<size_t>(texelSize) * tile.SrcWidth;
+		for (auto i = 0u; i < tile.SrcHeight; ++i)
+			memcpy(&slot.Staging[rowPitch * i], &band.pSource[band.SourceRowPitch * i + texelSize * tile.SrcX], rowPitch);
+		slot.Upload = copy_async(slot.Staging.data(), static_cast<uint32_t>(rowPitch * tile.SrcHeight),
+			slot.Source, index<2>(0, 0), extent<2>(tile.SrcHeight, tile.SrcWidth));
+	};
+
+	// Stage 2: process the interior of the tile, and read it back
+	const auto process = [](Slot& slot)
+	{
+		slot.Upload.get();
+
+		const auto& tile = slot.Region;
+		const auto source = texture_view<const T, 2>(slot.Source);
+		const auto result = texture_view<unorm4, 2>(slot.Result);
+		const index<2> haloOffset(tile.Y - tile.SrcY, tile.X - tile.SrcX);
+		const extent<2> tileExtent(tile.Height, tile.Width);
+
+		parallel_for_each(
+			// Define the compute domain, which is the set of threads that are created.
+			tileExtent,
+			// Define the code to run on each thread on the accelerator.
+			[=](const index<2>& idx) restrict(amp)
+			{
+				const auto srcIdx = idx + haloOffset;
+				const uint2 xy(srcIdx[1], srcIdx[0]);
+				const uint2 sourceSize(source.extent[1], source.extent[0]);
+				const auto uv = (float2(xy) + 0.5f) / float2(sourceSize);
+
+				result.set(idx, ToGrey(source.sample(uv, 0.0f)));
+			}
+		);
+
+		slot.Download = copy_async(slot.Result, index<2>(0, 0), tileExtent, slot.Readback.data(),
+			static_cast<uint32_t>(sizeof(uint32_t) * tile.Width * tile.Height));
+	};
+
+	// Stage 3: stitch the interior into the result band
+	const auto stitch = [](Slot& slot, const BandStreamer::Band& band)
+	{
+		slot.Download.get();
+		slot.Download = completion_future();
+
+		const auto& tile = slot.Region;
+		const auto rowSize = sizeof(uint32_t) * tile.Width;
+		for (auto i = 0u; i < tile.Height; ++i)
+			memcpy(&band.pResult[band.ResultRowPitch * i + sizeof(uint32_t) * tile.X],
+				&slot.Readback[rowSize * i], rowSize);
+	};
+
+	// Software pipeline over the tiles of a band: the upload of a tile on the CPU overlaps the
+	// processing of the previous one, and a slot is only reused once its previous tile has been
+	// stitched. The band is drained before it is written.
+	const auto processBand = [&](const BandStreamer::Band& band)
+	{
+		Slot* pPending = nullptr;
+		for (auto i = 0u; i < numTilesX; ++i)
+		{
+			// Split the band into tiles, each with its halo clamped to the image
+			Tile tile;
+			tile.X = tileSize * i;
+			tile.Y = band.Y;
+			tile.Width = (min)(tileSize, width - tile.X);
+			tile.Height = band.Height;
+			tile.SrcX = tile.X > haloSize ? tile.X - haloSize : 0;
+			tile.SrcY = band.SrcY;
+			tile.SrcWidth = (min)(tile.X + tile.Width + haloSize, width) - tile.SrcX;
+			tile.SrcHeight = band.SrcHeight;
+
+			auto& slot = *slots[i % slots.size()];
+			if (slot.Download.valid()) stitch(slot, band);
+
+			upload(slot, tile, band);
+			if (pPending) process(*pPending);
+			pPending = &slot;
+		}
+
+		if (pPending) process(*pPending);
+		for (auto& slot : slots)
+			if (slot->Download.valid()) stitch(*slot, band);
+		m_numTiles += numTilesX;
+
+		return true;
+	};
+
+	const auto isProcessed = m_streamer.Run(reader, writer, tileSize, haloSize, processBand);
+	m_processTime = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	return isProcessed;
+}
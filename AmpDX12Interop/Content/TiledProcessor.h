@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "BandStreamer.h"
+
+// Processes images beyond the max texture dimension tile by tile with C++ AMP. The image
+// is streamed from the file to the output in bands of a tile row, so neither the source
+// nor the result is ever held in memory as a whole. Each tile is uploaded with a halo of
+// its neighboring pixels (for neighborhood ops), and only its interior is read back into
+// the band. Tiles stream through upload, process and read-back with a bounded number in
+// flight, so no allocation scales with the image size beyond a band.
+class TiledProcessor
+{
+public:
+	TiledProcessor(const Concurrency::accelerator_view& acceleratorView);
+	virtual ~TiledProcessor();
+
+	// Writes the processed image as RGBA8 pixels, band by band.
+	bool Process(BandReader& reader, BandWriter& writer,
+		uint32_t tileSize = DefaultTileSize, uint32_t haloSize = DefaultHaloSize,
+		uint8_t maxTilesInFlight = DefaultMaxTilesInFlight);
+
+	uint32_t GetNumTiles() const;
+	double GetProcessTime() const;
+	size_t GetBufferSize() const;	// Of the bands and the staging of the tiles in flight, in bytes
+
+	static bool IsTilingRequired(uint32_t width, uint32_t height);
+
+	static const uint32_t MaxTextureSize = D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+	static const uint32_t DefaultTileSize = 4096;
+	static const uint32_t DefaultHaloSize = 16;
+	static const uint8_t DefaultMaxTilesInFlight = 3;
+
+protected:
+	struct Tile
+	{
+		uint32_t X;
+		uint32_t Y;
+		uint32_t Width;
+		uint32_t Height;
+
+		// Source region, including the halo
+		uint32_t SrcX;
+		uint32_t SrcY;
+		uint32_t SrcWidth;
+		uint32_t SrcHeight;
+	};
+
+	template<typename T>
+	bool ProcessTiles(BandReader& reader, BandWriter& writer, uint32_t bitsPerScalar,
+		uint32_t tileSize, uint32_t haloSize, uint8_t maxTilesInFlight);
+
+	Concurrency::accelerator_view m_acceleratorView;
+	BandStreamer m_streamer;
+
+	uint32_t	m_numTiles;
+	double		m_processTime;
+	size_t		m_stagingSize;
+};
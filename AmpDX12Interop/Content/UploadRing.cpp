@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "UploadRing.h"
+
+using namespace std;
+using namespace XUSG;
+
+UploadRing::UploadRing() :
+	m_pDevice(nullptr),
+	m_pData(nullptr),
+	m_capacity(0),
+	m_head(0),
+	m_usedSize(0),
+	m_openSize(0),
+	m_stats()
+{
+}
+
+UploadRing::~UploadRing()
+{
+	if (m_pData) m_buffer->Unmap();
+}
+
+bool UploadRing::Init(const Device* pDevice, uint64_t capacity, const wchar_t* name)
+{
+	m_pDevice = pDevice;
+	m_name = name ? name : L"UploadRing";
+
+	return Create(capacity);
+}
+
+bool UploadRing::Allocate(uint64_t size, uint64_t alignment, Allocation& allocation)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	if (m_usedSize == 0)
+	{
+		// Grow the ring for an oversized upload while nothing is in flight
+		if (size > m_capacity)
+			XUSG_N_RETURN(Create((max)(size, m_capacity * 2)), false);
+
+		// Restart from the beginning to avoid a needless wrap
+		m_head = 0;
+	}
+
+	auto offset = (m_head + alignment - 1) & ~(alignment - 1);
+	auto padding = offset - m_head;
+	if (offset + size > m_capacity)
+	{
+		// Skip the tail end of the ring, which is recycled with this allocation
+		padding = m_capacity - m_head;
+		offset = 0;
+		++m_stats.NumWraps;
+	}
+
+	if (m_usedSize + padding + size > m_capacity)
+	{
+		++m_stats.NumFailures;
+		return false;
+	}
+
+	m_head = offset + size;
+	m_usedSize += padding + size;
+	m_openSize += padding + size;
+
+	allocation.pResource = m_buffer.get();
+	allocation.Offset = offset;
+	allocation.pData = &m_pData[offset];
+
+	++m_stats.NumAllocations;
+	m_stats.HighWaterMark = (max)(m_stats.HighWaterMark, m_usedSize);
+
+	return true;
+}
+
+Resource* UploadRing::CreateDedicated()
+{
+	m_openDedicated.emplace_back(Resource::MakeUnique());
+	++m_stats.NumDedicated;
+
+	return m_openDedicated.back().get();
+}
+
+void UploadRing::Submit(uint64_t fenceValue)
+{
+	if (m_openSize == 0 && m_openDedicated.empty()) return;
+
+	m_submissions.emplace_back();
+	auto& submission = m_submissions.back();
+	submission.FenceValue = fenceValue;
+	submission.Size = m_openSize;
+	submission.Dedicated = move(m_openDedicated);
+
+	m_openSize = 0;
+	m_openDedicated.clear();
+}
+
+void UploadRing::Reclaim(uint64_t completedValue)
+{
+	while (!m_submissions.empty() && m_submissions.front().FenceValue <= completedValue)
+	{
+		m_usedSize -= m_submissions.front().Size;
+		m_submissions.pop_front();
+	}
+}
+
+uint64_t UploadRing::GetUsedSize() const
+{
+	return m_usedSize;
+}
+
+const UploadRing::Stats& UploadRing::GetStats() const
+{
+	return m_stats;
+}
+
+bool UploadRing::Create(uint64_t capacity)
+{
+	assert(m_usedSize == 0);
+
+	// Keep the capacity at the granularity of the heap
+	capacity = XUSG_DIV_UP(capacity, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT) *
+		D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+	if (m_pData) m_buffer->Unmap();
+	m_pData = nullptr;
+
+	m_buffer = Buffer::MakeUnique();
+	XUSG_N_RETURN(m_buffer->Create(m_pDevice, static_cast<size_t>(capacity), ResourceFlag::NONE,
+		MemoryType::UPLOAD, 0, nullptr, 0, nullptr, MemoryFlag::NONE, m_name.c_str()), false);
+	m_pData = static_cast<uint8_t*>(m_buffer->Map(nullptr));
+	XUSG_N_RETURN(m_pData, false);
+
+	m_capacity = capacity;
+	m_head = 0;
+	m_stats.Capacity = capacity;
+
+	return true;
+}
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+
+// Persistently mapped ring of upload memory. Uploads are suballocated at the required
+// alignment, tagged with the fence value signaled after their submission, and recycled
+// in FIFO order once the fence has passed that value. Uploads written by third-party
+// loaders, which insist on their own upload resources, are kept alive the same way.
+class UploadRing
+{
+public:
+	struct Allocation
+	{
+		XUSG::Resource* pResource;
+		uint64_t Offset;
+		uint8_t* pData;
+	};
+
+	struct Stats
+	{
+		uint64_t Capacity;
+		uint64_t HighWaterMark;		// Peak of the bytes in flight, including padding
+		uint32_t NumAllocations;
+		uint32_t NumDedicated;		// Uploads into standalone upload resources
+		uint32_t NumWraps;
+		uint32_t NumFailures;		// Allocations not fitting into the free space
+	};
+
+	UploadRing();
+	virtual ~UploadRing();
+
+	bool Init(const XUSG::Device* pDevice, uint64_t capacity, const wchar_t* name = nullptr);
+
+	// Suballocates a region; fails if the ring has no room until the GPU catches up. The
+	// ring grows while no allocations are in flight, if the region is larger than the ring.
+	bool Allocate(uint64_t size, uint64_t alignment, Allocation& allocation);
+
+	// Creates a standalone upload resource, which is released like a suballocation.
+	XUSG::Resource* CreateDedicated();
+
+	// Tags all the allocations since the last submission with the fence value.
+	void Submit(uint64_t fenceValue);
+
+	// Recycles the allocations whose fence values have been completed.
+	void Reclaim(uint64_t completedValue);
+
+	uint64_t GetUsedSize() const;
+	const Stats& GetStats() const;
+
+protected:
+	struct Submission
+	{
+		uint64_t FenceValue;
+		uint64_t Size;
+		std::vector<XUSG::Resource::uptr> Dedicated;
+	};
+
+	bool Create(uint64_t capacity);
+
+	const XUSG::Device*	m_pDevice;
+	std::wstring		m_name;
+
+	XUSG::Buffer::uptr	m_buffer;
+	uint8_t*			m_pData;
+	uint64_t			m_capacity;
+	uint64_t			m_head;
+	uint64_t			m_usedSize;
+
+	// Allocations since the last submission
+	uint64_t			m_openSize;
+	std::vector<XUSG::Resource::uptr> m_openDedicated;
+
+	std::deque<Submission> m_submissions;
+
+	Stats				m_stats;
+};
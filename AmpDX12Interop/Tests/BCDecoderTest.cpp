@@ -0,0 +1,383 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Checks the BC decoder against blocks decoded by an independent decoder (Pillow), and the
+// region and DDS header handling around it.
+
+#include "BCDecoder.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace BCDecoder;
+
+struct GoldenBlock
+{
+	Format BlockFormat;
+	uint8_t Block[16];
+	uint8_t Expected[64];	// RGBA8; BC6H as its values in [0, 1] scaled to 255 and truncated
+};
+
+static const GoldenBlock g_goldenBlocks[] =
+{
+	// BC1, 4-color
+	{
+		FORMAT_BC1,
+		{ 0x1f, 0xf8, 0xe0, 0x07, 0xf3, 0x1e, 0x36, 0x78 },
+		{
+			85, 170, 85, 255, 255, 0, 255, 255, 85, 170, 85, 255, 85, 170, 85, 255,
+			170, 85, 170, 255, 85, 170, 85, 255, 0, 255, 0, 255, 255, 0, 255, 255,
+			170, 85, 170, 255, 0, 255, 0, 255, 85, 170, 85, 255, 255, 0, 255, 255,
+			255, 0, 255, 255, 170, 85, 170, 255, 85, 170, 85, 255, 0, 255, 0, 255
+		}
+	},
+	// BC1, 3-color with transparent black
+	{
+		FORMAT_BC1,
+		{ 0xe0, 0x07, 0x1f, 0xf8, 0x07, 0x59, 0x23, 0x01 },
+		{
+			0, 0, 0, 0, 255, 0, 255, 255, 0, 255, 0, 255, 0, 255, 0, 255,
+			255, 0, 255, 255, 127, 127, 127, 255, 255, 0, 255, 255, 255, 0, 255, 255,
+			0, 0, 0, 0, 0, 255, 0, 255, 127, 127, 127, 255, 0, 255, 0, 255,
+			255, 0, 255, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255
+		}
+	},
+	// BC2
+	{
+		FORMAT_BC2,
+		{ 0xb9, 0x8b, 0x4b, 0x70, 0xa4, 0xf4, 0x45, 0x8e, 0x50, 0x13, 0x14, 0x62, 0xa4, 0x40, 0x3a, 0x73 },
+		{
+			16, 105, 132, 153, 99, 65, 165, 187, 43, 91, 143, 187, 43, 91, 143, 136,
+			16, 105, 132, 187, 16, 105, 132, 68, 16, 105, 132, 0, 99, 65, 165, 119,
+			43, 91, 143, 68, 43, 91, 143, 170, 71, 78, 154, 68, 16, 105, 132, 255,
+			71, 78, 154, 85, 16, 105, 132, 68, 71, 78, 154, 238, 99, 65, 165, 136
+		}
+	},
+	// BC3, 8-value alpha
+	{
+		FORMAT_BC3,
+		{ 0xc8, 0x1e, 0x67, 0xea, 0xd8, 0x56, 0x05, 0xd9, 0x8d, 0xdd, 0xaa, 0xe9, 0x55, 0x44, 0xd0, 0x2f },
+		{
+			239, 52, 82, 54, 239, 52, 82, 127, 239, 52, 82, 30, 239, 52, 82, 102,
+			222, 178, 107, 78, 239, 52, 82, 30, 222, 178, 107, 78, 239, 52, 82, 78,
+			222, 178, 107, 78, 222, 178, 107, 175, 239, 52, 82, 102, 233, 94, 90, 175,
+			233, 94, 90, 200, 233, 94, 90, 175, 227, 136, 98, 78, 222, 178, 107, 78
+		}
+	},
+	// BC4, 6-value ramp with 0 and 255
+	{
+		FORMAT_BC4,
+		{ 0x28, 0xdc, 0xe8, 0xc4, 0x5e, 0x9e, 0x09, 0xef },
+		{
+			40, 0, 0, 255, 184, 0, 0, 255, 112, 0, 0, 255, 76, 0, 0, 255,
+			148, 0, 0, 255, 184, 0, 0, 255, 255, 0, 0, 255, 76, 0, 0, 255,
+			0, 0, 0, 255, 112, 0, 0, 255, 0, 0, 0, 255, 148, 0, 0, 255,
+			40, 0, 0, 255, 0, 0, 0, 255, 112, 0, 0, 255, 255, 0, 0, 255
+		}
+	},
+	// BC5
+	{
+		FORMAT_BC5,
+		{ 0xfa, 0x0a, 0x00, 0xc4, 0xb7, 0x5a, 0xdd, 0xee, 0x05, 0xb4, 0x94, 0xb3, 0x44, 0x8b, 0x4d, 0x53 },
+		{
+			250, 110, 0, 255, 250, 40, 0, 255, 250, 0, 0, 255, 215, 180, 0, 255,
+			147, 75, 0, 255, 44, 180, 0, 255, 112, 180, 0, 255, 112, 40, 0, 255,
+			215, 75, 0, 255, 181, 180, 0, 255, 112, 0, 0, 255, 78, 0, 0, 255,
+			112, 110, 0, 255, 112, 0, 0, 255, 181, 110, 0, 255, 44, 40, 0, 255
+		}
+	},
+	// BC7, mode 0
+	{
+		FORMAT_BC7,
+		{ 0x41, 0x9b, 0x1b, 0xa8, 0xb3, 0x22, 0x7e, 0xf6, 0x78, 0x11, 0x3c, 0xbe, 0x36, 0x60, 0x0c, 0xdd },
+		{
+			186, 186, 105, 255, 172, 205, 68, 255, 212, 25, 186, 255, 205, 54, 150, 255,
+			200, 167, 144, 255, 207, 157, 162, 255, 212, 25, 186, 255, 198, 82, 115, 255,
+			165, 214, 49, 255, 64, 221, 146, 255, 0, 16, 181, 255, 205, 54, 150, 255,
+			0, 16, 181, 255, 53, 188, 152, 255, 31, 117, 164, 255, 31, 117, 164, 255
+		}
+	},
+	// BC7, mode 1
+	{
+		FORMAT_BC7,
+		{ 0x5a, 0x4f, 0xfe, 0xfe, 0x97, 0xef, 0x3e, 0x0a, 0x97, 0xc4, 0xb6, 0xe0, 0xf2, 0x3d, 0x63, 0xdb },
+		{
+			84, 114, 50, 255, 131, 158, 70, 255, 84, 114, 50, 255, 60, 92, 40, 255,
+			229, 249, 112, 255, 108, 136, 60, 255, 205, 227, 102, 255, 229, 249, 112, 255,
+			209, 152, 83, 255, 229, 249, 112, 255, 158, 183, 82, 255, 84, 114, 50, 255,
+			246, 80, 176, 255, 246, 80, 176, 255, 205, 227, 102, 255, 205, 227, 102, 255
+		}
+	},
+	// BC7, mode 2
+	{
+		FORMAT_BC7,
+		{ 0xbc, 0xb2, 0x41, 0x1b, 0x51, 0x05, 0x86, 0x67, 0xa9, 0x2a, 0xce, 0xd0, 0x97, 0x92, 0xf2, 0xe2 },
+		{
+			206, 82, 173, 255, 154, 55, 143, 255, 101, 27, 112, 255, 101, 27, 112, 255,
+			66, 24, 231, 255, 117, 97, 188, 255, 101, 27, 112, 255, 101, 27, 112, 255,
+			66, 99, 66, 255, 133, 82, 193, 255, 117, 97, 188, 255, 49, 0, 82, 255,
+			133, 82, 193, 255, 66, 99, 66, 255, 171, 174, 142, 255, 49, 0, 82, 255
+		}
+	},
+	// BC7, mode 3
+	{
+		FORMAT_BC7,
+		{ 0x48, 0x85, 0xe2, 0x10, 0xef, 0x80, 0x4c, 0x30, 0xf2, 0x56, 0x7d, 0xe2, 0x19, 0x51, 0xa1, 0x29 },
+		{
+			67, 7, 121, 255, 227, 201, 87, 255, 33, 9, 251, 255, 33, 9, 251, 255,
+			120, 71, 110, 255, 67, 7, 121, 255, 120, 71, 110, 255, 84, 52, 213, 255,
+			120, 71, 110, 255, 67, 7, 121, 255, 175, 137, 98, 255, 175, 137, 98, 255,
+			120, 71, 110, 255, 175, 137, 98, 255, 175, 137, 98, 255, 67, 7, 121, 255
+		}
+	},
+	// BC7, mode 4
+	{
+		FORMAT_BC7,
+		{ 0x50, 0xff, 0xb5, 0xd7, 0xd0, 0x93, 0x54, 0x32, 0x43, 0xbc, 0x9c, 0x61, 0x40, 0xdb, 0xbf, 0x0c },
+		{
+			212, 53, 94, 112, 166, 50, 79, 118, 166, 39, 79, 118, 255, 60, 107, 107,
+			212, 39, 94, 112, 166, 60, 79, 118, 212, 60, 94, 112, 166, 53, 79, 118,
+			212, 50, 94, 112, 255, 50, 107, 107, 166, 36, 79, 118, 255, 36, 107, 107,
+			166, 50, 79, 118, 123, 57, 66, 123, 212, 50, 94, 112, 212, 60, 94, 112
+		}
+	},
+	// BC7, mode 5
+	{
+		FORMAT_BC7,
+		{ 0x60, 0x0a, 0x8f, 0xa1, 0xda, 0x51, 0xf6, 0x8f, 0xb3, 0x72, 0x26, 0xb4, 0xf2, 0xbb, 0x85, 0x17 },
+		{
+			244, 12, 58, 20, 253, 119, 119, 47, 227, 64, 88, 33, 227, 64, 88, 33,
+			227, 64, 88, 33, 236, 119, 119, 47, 227, 171, 149, 60, 236, 12, 58, 20,
+			244, 171, 149, 60, 244, 12, 58, 20, 253, 64, 88, 33, 236, 12, 58, 20,
+			227, 119, 119, 47, 244, 119, 119, 47, 244, 64, 88, 33, 253, 64, 88, 33
+		}
+	},
+	// BC7, mode 6
+	{
+		FORMAT_BC7,
+		{ 0x40, 0x7e, 0x4d, 0x74, 0xf0, 0x34, 0x93, 0xea, 0x43, 0x3f, 0x5a, 0x36, 0x11, 0x05, 0x5b, 0x26 },
+		{
+			240, 66, 67, 151, 211, 55, 86, 165, 107, 15, 155, 213, 220, 58, 80, 160,
+			154, 33, 124, 191, 202, 51, 92, 169, 191, 47, 99, 174, 220, 58, 80, 160,
+			240, 66, 67, 151, 240, 66, 67, 151, 202, 51, 92, 169, 249, 69, 61, 147,
+			145, 29, 130, 195, 202, 51, 92, 169, 191, 47, 99, 174, 229, 61, 74, 156
+		}
+	},
+	// BC7, mode 7
+	{
+		FORMAT_BC7,
+		{ 0x80, 0x44, 0xd0, 0x4e, 0xff, 0xca, 0xf4, 0x40, 0x38, 0x27, 0xda, 0xf8, 0x35, 0xf6, 0xd3, 0x9f },
+		{
+			79, 228, 41, 106, 148, 201, 56, 137, 79, 228, 41, 106, 12, 255, 28, 77,
+			215, 174, 69, 166, 148, 201, 56, 137, 215, 174, 69, 166, 211, 211, 203, 227,
+			79, 228, 41, 106, 148, 201, 56, 137, 148, 201, 56, 137, 211, 211, 203, 227,
+			215, 174, 69, 166, 215, 174, 69, 166, 117, 101, 199, 109, 148, 137, 200, 148
+		}
+	},
+	// BC6H_UF16, mode 0x00, two regions, transformed
+	{
+		FORMAT_BC6H_UF16,
+		{ 0xd8, 0x57, 0xb7, 0x8c, 0xfd, 0x2d, 0x30, 0x2b, 0x75, 0xcd, 0x82, 0xd7, 0x04, 0xd0, 0x79, 0x19 },
+		{
+			255, 17, 255, 255, 255, 17, 255, 255, 255, 17, 255, 255, 255, 17, 255, 255,
+			255, 17, 255, 255, 255, 17, 255, 255, 255, 17, 255, 255, 255, 17, 255, 255,
+			255, 20, 255, 255, 255, 17, 255, 255, 255, 17, 255, 255, 255, 17, 255, 255,
+			255, 14, 255, 255, 255, 18, 255, 255, 255, 17, 255, 255, 255, 17, 255, 255
+		}
+	},
+	// BC6H_UF16, mode 0x1e, two regions, untransformed
+	{
+		FORMAT_BC6H_UF16,
+		{ 0xbe, 0xce, 0x2d, 0x9d, 0xa5, 0xce, 0x5c, 0x48, 0xc0, 0x0d, 0x05, 0x59, 0x13, 0x9c, 0x1f, 0x11 },
+		{
+			255, 136, 1, 255, 255, 84, 1, 255, 255, 231, 1, 255, 37, 255, 1, 255,
+			255, 231, 1, 255, 255, 255, 1, 255, 255, 231, 1, 255, 255, 84, 1, 255,
+			37, 255, 1, 255, 255, 136, 1, 255, 7, 255, 1, 255, 84, 255, 29, 255,
+			255, 84, 1, 255, 255, 136, 1, 255, 255, 255, 7, 255, 255, 255, 3, 255
+		}
+	},
+	// BC6H_UF16, mode 0x03, one region, untransformed
+	{
+		FORMAT_BC6H_UF16,
+		{ 0xe3, 0xdb, 0xe6, 0xa8, 0x07, 0x1c, 0x6e, 0x7b, 0xaa, 0xb6, 0xc5, 0xdc, 0xa8, 0x26, 0x0f, 0x8f },
+		{
+			255, 255, 255, 255, 255, 255, 223, 255, 255, 255, 255, 255, 255, 255, 86, 255,
+			255, 255, 255, 255, 255, 255, 31, 255, 255, 255, 31, 255, 255, 255, 12, 255,
+			255, 255, 255, 255, 255, 255, 223, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+			255, 255, 1, 255, 255, 125, 255, 255, 255, 255, 1, 255, 255, 255, 255, 255
+		}
+	},
+	// BC6H_UF16, mode 0x0b, one region, transformed
+	{
+		FORMAT_BC6H_UF16,
+		{ 0xeb, 0x7b, 0x8b, 0x6b, 0x9a, 0xc3, 0x54, 0xdb, 0x87, 0x8d, 0xf4, 0x72, 0x45, 0xe8, 0xd5, 0x2a },
+		{
+			1, 101, 255, 255, 1, 87, 255, 255, 2, 73, 255, 255, 1, 87, 255, 255,
+			1, 98, 255, 255, 2, 66, 255, 255, 1, 104, 255, 255, 1, 90, 255, 255,
+			1, 96, 255, 255, 1, 98, 255, 255, 1, 87, 255, 255, 2, 69, 255, 255,
+			1, 96, 255, 255, 2, 73, 255, 255, 2, 81, 255, 255, 1, 104, 255, 255
+		}
+	}
+};
+
+// The reference rounds some interpolations differently, by at most 1
+static bool IsClose(int value, int expected)
+{
+	return abs(value - expected) <= 1;
+}
+
+static void TestGoldenBlocks()
+{
+	for (const auto& golden : g_goldenBlocks)
+	{
+		auto numMismatches = 0;
+		if (IsHDR(golden.BlockFormat))
+		{
+			float texels[16][4];
+			DecodeBlock(golden.BlockFormat, golden.Block, reinterpret_cast<uint8_t*>(texels), 4 * sizeof(texels[0]));
+			for (auto i = 0u; i < 64; ++i)
+			{
+				const auto value = static_cast<int>((min)((max)(texels[i / 4][i % 4], 0.0f), 1.0f) * 255.0f);
+				if (!IsClose(value, golden.Expected[i])) ++numMismatches;
+			}
+		}
+		else
+		{
+			uint8_t texels[64];
+			DecodeBlock(golden.BlockFormat, golden.Block, texels, 16);
+			for (auto i = 0u; i < 64; ++i) if (!IsClose(texels[i], golden.Expected[i])) ++numMismatches;
+		}
+
+		if (numMismatches) cerr << "Format " << static_cast<int>(golden.BlockFormat) << ": ";
+		CHECK(numMismatches == 0);
+	}
+}
+
+static void TestReservedModes()
+{
+	// A BC7 block without a mode bit in its first byte decodes to transparent black
+	uint8_t block[16];
+	memset(block, 0xff, sizeof(block));
+	block[0] = 0;
+	uint8_t texels[64];
+	memset(texels, 0x55, sizeof(texels));
+	DecodeBlock(FORMAT_BC7, block, texels, 16);
+	CHECK(all_of(texels, texels + 64, [](uint8_t v) { return v == 0; }));
+
+	// So does a BC6H block of a reserved mode
+	block[0] = 0x13;
+	float hdrTexels[64];
+	fill(hdrTexels, hdrTexels + 64, 0.5f);
+	DecodeBlock(FORMAT_BC6H_UF16, block, reinterpret_cast<uint8_t*>(hdrTexels), 16 * sizeof(float));
+	CHECK(all_of(hdrTexels, hdrTexels + 64, [](float v) { return v == 0.0f; }));
+}
+
+static void TestDecodeRegion()
+{
+	// A 7x6 BC7 surface of 2x2 blocks, with partial blocks at the right and bottom edges
+	const uint32_t width = 7, height = 6;
+	vector<uint8_t> blocks;
+	for (const auto& golden : g_goldenBlocks)
+		if (golden.BlockFormat == FORMAT_BC7 && blocks.size() < 64)
+			blocks.insert(blocks.end(), golden.Block, golden.Block + 16);
+	CHECK(blocks.size() == 64);
+
+	// Reference from whole blocks
+	vector<uint8_t> reference(8 * 8 * 4);
+	for (auto i = 0u; i < 4; ++i)
+		DecodeBlock(FORMAT_BC7, &blocks[16 * i], &reference[(8 * 4 * (i / 2) + 4 * (i % 2)) * 4], 8 * 4);
+
+	const struct { uint32_t X, Y, Width, Height; } regions[] =
+	{
+		{ 0, 0, width, height },
+		{ 3, 1, 3, 4 },		// Straddles all 4 blocks
+		{ 5, 4, 8, 8 },		// Clipped to the surface
+		{ 4, 0, 1, 1 }
+	};
+
+	for (const auto& region : regions)
+	{
+		const auto regionWidth = (min)(region.Width, width - region.X);
+		const auto regionHeight = (min)(region.Height, height - region.Y);
+		const auto rowPitch = 4 * regionWidth + 12;	// Padded
+		vector<uint8_t> pixels(rowPitch * regionHeight + 4, 0xcd);
+		DecodeRegion(FORMAT_BC7, blocks.data(), width, height, region.X, region.Y,
+			region.Width, region.Height, pixels.data(), rowPitch);
+
+		auto isMatched = true;
+		for (auto y = 0u; y < regionHeight; ++y)
+		{
+			isMatched = isMatched && memcmp(&pixels[rowPitch * y],
+				&reference[(8 * (region.Y + y) + region.X) * 4], 4 * regionWidth) == 0;
+			isMatched = isMatched && all_of(&pixels[rowPitch * y + 4 * regionWidth],
+				&pixels[rowPitch * (y + 1)], [](uint8_t v) { return v == 0xcd; });
+		}
+		CHECK(isMatched);
+	}
+}
+
+static vector<uint8_t> MakeDDS(uint32_t width, uint32_t height, const char* fourCC, uint32_t dxgiFormat, size_t dataSize)
+{
+	vector<uint8_t> file(128 + (dxgiFormat ? 20 : 0) + dataSize);
+	const auto writeUint32 = [&file](size_t offset, uint32_t value) { memcpy(&file[offset], &value, sizeof(value)); };
+	memcpy(file.data(), "DDS ", 4);
+	writeUint32(4, 124);
+	writeUint32(12, height);
+	writeUint32(16, width);
+	writeUint32(76, 32);
+	if (fourCC)
+	{
+		writeUint32(80, 0x4);
+		memcpy(&file[84], fourCC, 4);
+	}
+	if (dxgiFormat) writeUint32(128, dxgiFormat);
+
+	return file;
+}
+
+static void TestParseDDS()
+{
+	DDSInfo info;
+
+	auto file = MakeDDS(10, 6, "DXT1", 0, 3 * 2 * 8);
+	CHECK(ParseDDS(file.data(), file.size(), info));
+	CHECK(info.Width == 10 && info.Height == 6);
+	CHECK(info.BlockFormat == FORMAT_BC1);
+	CHECK(info.pBlocks == &file[128]);
+
+	file = MakeDDS(4, 4, "DX10", 98, 16);
+	CHECK(ParseDDS(file.data(), file.size(), info));
+	CHECK(info.BlockFormat == FORMAT_BC7);
+	CHECK(info.pBlocks == &file[148]);
+
+	file = MakeDDS(4, 8, "DX10", 95, 32);
+	CHECK(ParseDDS(file.data(), file.size(), info));
+	CHECK(info.BlockFormat == FORMAT_BC6H_UF16 && IsHDR(info.BlockFormat));
+
+	// Truncated, and not block-compressed
+	file = MakeDDS(8, 8, "DXT5", 0, 3 * 16);
+	CHECK(ParseDDS(file.data(), file.size(), info));
+	CHECK(info.BlockFormat == FORMAT_UNKNOWN);
+	file = MakeDDS(8, 8, nullptr, 0, 8 * 8 * 4);
+	CHECK(ParseDDS(file.data(), file.size(), info));
+	CHECK(info.BlockFormat == FORMAT_UNKNOWN);
+
+	// Not a DDS file
+	file[0] = 'X';
+	CHECK(!ParseDDS(file.data(), file.size(), info));
+	CHECK(!ParseDDS(file.data(), 64, info));
+}
+
+int main()
+{
+	TestGoldenBlocks();
+	TestReservedModes();
+	TestDecodeRegion();
+	TestParseDDS();
+
+	return ReportChecks();
+}
@@ -0,0 +1,159 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Drives the band scheduler with simulated devices, each processing a band in a time
+// proportional to its number of pixels over its speed, and checks the splits.
+
+#include "BandScheduler.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+struct SimulatedDevices
+{
+	vector<double> Speeds;		// In pixels per ms
+	vector<double> LastTimes;	// Time of the last band of each device in ms
+	vector<uint32_t> RowCounts;	// Number of times each row has been processed
+	atomic<uint32_t> NumBands;
+
+	SimulatedDevices(const vector<double>& speeds, uint32_t height) :
+		Speeds(speeds),
+		LastTimes(speeds.size(), 0.0),
+		RowCounts(height, 0),
+		NumBands(0)
+	{
+	}
+
+	double Process(const BandScheduler::Band& band, uint32_t width)
+	{
+		// Bands of a round never overlap, so each row and device is only written by one task
+		for (auto y = band.Y; y < band.Y + band.Height; ++y) ++RowCounts[y];
+		LastTimes[band.Device] = static_cast<double>(width) * band.Height / Speeds[band.Device];
+		++NumBands;
+
+		return LastTimes[band.Device];
+	}
+};
+
+static void TestSplitCoverage()
+{
+	const uint32_t granularity = 16;
+	BandScheduler scheduler(granularity);
+	scheduler.AddDevice(1.0);
+	scheduler.AddDevice(3.0);
+	scheduler.AddDevice(0.0);	// Takes the average guess
+	CHECK(scheduler.GetNumDevices() == 3);
+	CHECK(scheduler.GetThroughput(2) == 2.0);
+
+	for (const auto height : { 1u, 15u, 16u, 100u, 1000u, 4097u })
+	{
+		vector<BandScheduler::Band> bands;
+		scheduler.Split(7, height, bands);
+		CHECK(!bands.empty());
+
+		// The bands are contiguous, in device order, and cover the rows exactly
+		auto y = 7u;
+		for (size_t i = 0; i < bands.size(); ++i)
+		{
+			CHECK(bands[i].Y == y);
+			CHECK(bands[i].Height > 0);
+			CHECK(i == 0 || bands[i].Device > bands[i - 1].Device);
+			y += bands[i].Height;
+
+			// Only the end of the last band may be off the row granularity
+			if (i + 1 < bands.size()) CHECK((y - 7) % granularity == 0);
+		}
+		CHECK(y == 7 + height);
+	}
+
+	// Nothing to split
+	vector<BandScheduler::Band> bands;
+	scheduler.Split(0, 0, bands);
+	CHECK(bands.empty());
+	BandScheduler().Split(0, 100, bands);
+	CHECK(bands.empty());
+}
+
+static void TestConvergence()
+{
+	const uint32_t width = 1024, height = 8192, numRounds = 8;
+	const vector<double> speeds = { 100.0, 400.0, 1000.0 };
+
+	BandScheduler scheduler(16);
+	for (size_t i = 0; i < speeds.size(); ++i) scheduler.AddDevice(0.0);
+
+	SimulatedDevices devices(speeds, height);
+	scheduler.Run(width, height, numRounds,
+		[&](const BandScheduler::Band& band) { return devices.Process(band, width); });
+
+	// Every row is processed exactly once
+	CHECK(all_of(devices.RowCounts.cbegin(), devices.RowCounts.cend(), [](uint32_t n) { return n == 1; }));
+	CHECK(devices.NumBands <= numRounds * speeds.size());
+
+	// The measured throughputs and shares match the simulated speeds
+	auto sum = 0.0;
+	for (const auto speed : speeds) sum += speed;
+	for (auto i = 0u; i < speeds.size(); ++i)
+	{
+		CHECK(fabs(scheduler.GetThroughput(i) - speeds[i]) < 1e-6 * speeds[i]);
+		CHECK(fabs(scheduler.GetShare(i) - speeds[i] / sum) < 1e-6);
+	}
+
+	// After the first round, the devices finish at about the same time
+	const auto minMax = minmax_element(devices.LastTimes.cbegin(), devices.LastTimes.cend());
+	CHECK(*minMax.second / *minMax.first < 1.1);
+}
+
+static void TestAdaptation()
+{
+	const uint32_t width = 256, height = 4096, numRounds = 16;
+
+	BandScheduler scheduler(8, 0.5);
+	scheduler.AddDevice(1.0);
+	scheduler.AddDevice(1.0);
+
+	// The second device slows down to a quarter of the first halfway through the image
+	SimulatedDevices devices({ 200.0, 200.0 }, height);
+	scheduler.Run(width, height, numRounds, [&](const BandScheduler::Band& band)
+	{
+		if (band.Device == 1 && band.Y >= height / 2) devices.Speeds[1] = 50.0;
+		return devices.Process(band, width);
+	});
+
+	CHECK(all_of(devices.RowCounts.cbegin(), devices.RowCounts.cend(), [](uint32_t n) { return n == 1; }));
+	CHECK(scheduler.GetShare(0) > 0.75);
+	CHECK(scheduler.GetShare(1) > 0.15);
+}
+
+static void TestTinyImages()
+{
+	// Fewer rows than rounds and devices; some devices get no band at all
+	BandScheduler scheduler(16);
+	scheduler.AddDevice(1.0);
+	scheduler.AddDevice(1000.0);
+	scheduler.AddDevice(1.0);
+
+	for (const auto height : { 0u, 1u, 3u, 17u })
+	{
+		SimulatedDevices devices({ 1.0, 1000.0, 1.0 }, height);
+		scheduler.Run(64, height, 8,
+			[&](const BandScheduler::Band& band) { return devices.Process(band, 64); });
+		CHECK(all_of(devices.RowCounts.cbegin(), devices.RowCounts.cend(), [](uint32_t n) { return n == 1; }));
+		CHECK(devices.NumBands <= (max)(height, 1u) * 3);
+	}
+}
+
+int main()
+{
+	TestSplitCoverage();
+	TestConvergence();
+	TestAdaptation();
+	TestTinyImages();
+
+	return ReportChecks();
+}
@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Checks that the benchmark harness separates the cold run from the warm iterations, and
+// the statistics it reports over the warm ones.
+
+#include "Benchmark.h"
+#include "TestCheck.h"
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static void TestRun()
+{
+	Benchmark benchmark(4);
+	auto numRuns = 0u, numColdPrepares = 0u, numWarmPrepares = 0u;
+	CHECK(benchmark.Run("Count", [&numRuns]() { ++numRuns; return true; }, 10.0, "items",
+		[&](bool isCold) { ++(isCold ? numColdPrepares : numWarmPrepares); }));
+	CHECK(numRuns == 5);
+	CHECK(numColdPrepares == 1 && numWarmPrepares == 4);
+
+	const auto& results = benchmark.GetResults();
+	CHECK(results.size() == 1);
+	CHECK(results[0].Name == "Count" && results[0].Unit == "items" && results[0].Amount == 10.0);
+	CHECK(results[0].WarmTimes.size() == 4);
+
+	// A failed run stops the measurement, which is not recorded
+	numRuns = 0;
+	CHECK(!benchmark.Run("Fail", [&numRuns]() { return ++numRuns < 3; }));
+	CHECK(numRuns == 3);
+	CHECK(benchmark.GetResults().size() == 1);
+
+	ostringstream os;
+	benchmark.Print(os, "Test");
+	CHECK(os.str().find("Count: cold") != string::npos);
+	CHECK(os.str().find("items/s warm") != string::npos);
+
+	// Times measured by the function are taken as they are
+	auto time = 0.0;
+	CHECK(benchmark.RunMeasured("Measured", [&time](double& runTime) { runTime = time += 1.0; return true; }));
+	CHECK(benchmark.GetResults().size() == 2);
+	const auto& measured = benchmark.GetResults()[1];
+	CHECK(measured.ColdTime == 1.0);
+	CHECK(measured.WarmTimes == vector<double>({ 2.0, 3.0, 4.0, 5.0 }));
+
+	benchmark.Clear();
+	CHECK(benchmark.GetResults().empty());
+	CHECK(Benchmark(0).GetNumIterations() == 1);
+}
+
+static void TestStatistics()
+{
+	Benchmark::Result result = { "Times", 100.0, { 4.0, 1.0, 3.0, 2.0 }, 0.0, "" };
+	CHECK(Benchmark::GetMinTime(result) == 1.0);
+	CHECK(Benchmark::GetMedianTime(result) == 2.5);
+	CHECK(Benchmark::GetMeanTime(result) == 2.5);
+
+	// The cold run is not in the warm statistics
+	result.WarmTimes = { 5.0, 9.0, 1.0 };
+	CHECK(Benchmark::GetMinTime(result) == 1.0);
+	CHECK(Benchmark::GetMedianTime(result) == 5.0);
+	CHECK(Benchmark::GetMeanTime(result) == 5.0);
+
+	result.WarmTimes.clear();
+	CHECK(Benchmark::GetMedianTime(result) == 0.0);
+}
+
+int main()
+{
+	TestRun();
+	TestStatistics();
+
+	return ReportChecks();
+}
@@ -0,0 +1,168 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Checks the dirty-region tracker as the view drives it: rects of source updates and of
+// newly visible parts are added, and the tracked rects are dispatched and cleared per frame.
+
+#include "DirtyRegion.h"
+#include "TestCheck.h"
+#include <random>
+
+using namespace std;
+
+static bool IsEqual(const RECT& rect, LONG left, LONG top, LONG right, LONG bottom)
+{
+	const RECT expected = { left, top, right, bottom };
+
+	return EqualRect(&rect, &expected) != 0;
+}
+
+// Every texel of the rect is in one of the dirty rects
+static bool IsCovered(const DirtyRegion& region, const RECT& rect)
+{
+	for (auto y = rect.top; y < rect.bottom; ++y)
+		for (auto x = rect.left; x < rect.right; ++x)
+		{
+			const auto& rects = region.GetRects();
+			const auto isInRect = [x, y](const RECT& r) { return x >= r.left && x < r.right && y >= r.top && y < r.bottom; };
+			if (none_of(rects.cbegin(), rects.cend(), isInRect)) return false;
+		}
+
+	return true;
+}
+
+static void TestSnapAndClip()
+{
+	DirtyRegion region(16);
+	region.SetBounds(100, 50);
+	CHECK(region.IsEmpty());
+
+	region.Add({ 5, 5, 10, 10 });
+	CHECK(region.GetRects().size() == 1 && IsEqual(region.GetRects()[0], 0, 0, 16, 16));
+	CHECK(region.GetArea() == 256);
+
+	// Snapped out, then clipped to the bounds
+	region.Clear();
+	region.Add({ 90, 40, 200, 200 });
+	CHECK(region.GetRects().size() == 1 && IsEqual(region.GetRects()[0], 80, 32, 100, 50));
+
+	region.Clear();
+	region.Add({ -20, -20, 3, 3 });
+	CHECK(region.GetRects().size() == 1 && IsEqual(region.GetRects()[0], 0, 0, 16, 16));
+
+	// In tiles outside of the bounds, or empty
+	region.Clear();
+	region.Add({ 112, 0, 130, 10 });
+	region.Add({ 10, 10, 10, 20 });
+	CHECK(region.IsEmpty());
+
+	region.AddAll();
+	CHECK(region.GetRects().size() == 1 && IsEqual(region.GetRects()[0], 0, 0, 100, 50));
+	region.SetBounds(0, 0);
+	region.AddAll();
+	CHECK(region.IsEmpty());
+}
+
+static void TestMerge()
+{
+	DirtyRegion region(16, 0.75f);
+	region.SetBounds(256, 256);
+
+	// A rect that is covered already adds nothing
+	region.Add({ 0, 0, 64, 64 });
+	region.Add({ 16, 16, 32, 32 });
+	CHECK(region.GetRects().size() == 1 && IsEqual(region.GetRects()[0], 0, 0, 64, 64));
+
+	// Neighbours cover their bounding rect, so they are merged
+	region.Clear();
+	region.Add({ 0, 0, 16, 16 });
+	region.Add({ 16, 0, 32, 16 });
+	CHECK(region.GetRects().size() == 1 && IsEqual(region.GetRects()[0], 0, 0, 32, 16));
+
+	// Far apart, their bounding rect would be mostly waste
+	region.Clear();
+	region.Add({ 0, 0, 16, 16 });
+	region.Add({ 128, 128, 144, 144 });
+	CHECK(region.GetRects().size() == 2);
+	CHECK(region.GetArea() == 512);
+
+	// Three tiles of an L cover 3/4 of their bounding rect, which is just enough
+	region.Clear();
+	region.Add({ 0, 0, 16, 16 });
+	region.Add({ 0, 16, 16, 32 });
+	region.Add({ 16, 16, 32, 32 });
+	CHECK(region.GetRects().size() == 1 && IsEqual(region.GetRects()[0], 0, 0, 32, 32));
+}
+
+static void TestMaxRects()
+{
+	// Scattered tiles, beyond the max number of rects, are merged by the least waste
+	DirtyRegion region(16);
+	region.SetBounds(1024, 1024);
+	vector<RECT> added;
+	for (auto i = 0; i < 20; ++i)
+	{
+		const LONG x = (i * 7 % 20) * 48, y = (i * 13 % 20) * 48;
+		added.push_back({ x, y, x + 16, y + 16 });
+		region.Add(added.back());
+		CHECK(region.GetRects().size() <= DirtyRegion::MaxRects);
+	}
+	for (const auto& rect : added) CHECK(IsCovered(region, rect));
+}
+
+static void TestMovingOverlay()
+{
+	// A small overlay moving over the image, as the annotations or a partially read-out sensor
+	// update the source: only the tiles it touches are dirty in each frame, and always all of them
+	const auto width = 640u, height = 480u, tileSize = 16u, overlaySize = 10u;
+	DirtyRegion region(tileSize);
+	region.SetBounds(width, height);
+
+	mt19937 rng(1);
+	auto numDirtyTexels = 0ull, numFrames = 0ull;
+	for (auto frame = 0; frame < 200; ++frame)
+	{
+		vector<RECT> stamps;
+		for (auto i = rng() % 4; i > 0; --i)
+		{
+			const auto x = static_cast<LONG>(rng() % (width + 20)) - 10, y = static_cast<LONG>(rng() % (height + 20)) - 10;
+			stamps.push_back({ x, y, x + static_cast<LONG>(overlaySize), y + static_cast<LONG>(overlaySize) });
+			region.Add(stamps.back());
+		}
+
+		CHECK(region.GetRects().size() <= DirtyRegion::MaxRects);
+		for (const auto& rect : region.GetRects())
+		{
+			CHECK(rect.left >= 0 && rect.top >= 0 && rect.right <= static_cast<LONG>(width) &&
+				rect.bottom <= static_cast<LONG>(height) && !IsRectEmpty(&rect));
+			CHECK(rect.left % tileSize == 0 && rect.top % tileSize == 0);
+		}
+		for (const auto& stamp : stamps)
+		{
+			RECT visible;
+			const RECT bounds = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+			if (IntersectRect(&visible, &stamp, &bounds)) CHECK(IsCovered(region, visible));
+		}
+		CHECK(stamps.empty() == region.IsEmpty());
+
+		numDirtyTexels += region.GetArea();
+		++numFrames;
+		region.Clear();
+	}
+
+	// At most 3 stamps of at most 2x2 tiles each per frame, which are only merged into rects they
+	// cover mostly, so a small part of the image
+	CHECK(numDirtyTexels <= numFrames * 3 * 4 * tileSize * tileSize / DirtyRegion::DefaultMinCoverage);
+	CHECK(numDirtyTexels > 0);
+}
+
+int main()
+{
+	TestSnapAndClip();
+	TestMerge();
+	TestMaxRects();
+	TestMovingOverlay();
+
+	return ReportChecks();
+}
@@ -0,0 +1,224 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Checks every CPU backend available of the pixel kernels, over all the lengths up to a few
+// vector widths, so that the vector bodies and the scalar tails are both covered.
+
+#include "LumaFixed.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <random>
+
+using namespace std;
+using namespace PixelKernels;
+
+static const size_t g_maxNumPixels = 100;	// Beyond 3 iterations of the widest kernel
+static const uint8_t g_guard = 0xcd;		// Past the last pixel, which no kernel may write
+
+// Random RGBA8 pixels, with the extremes of the channels in a quarter of them
+static vector<uint8_t> MakeRandomRGBA(size_t numPixels, uint32_t seed)
+{
+	vector<uint8_t> pixels(4 * numPixels);
+	mt19937 rng(seed);
+	for (auto& value : pixels)
+	{
+		const auto r = rng();
+		value = r % 8 == 0 ? 0 : r % 8 == 1 ? 255 : static_cast<uint8_t>(r >> 8);
+	}
+
+	return pixels;
+}
+
+static void CheckLuma(const uint8_t* pSrc, size_t numPixels, Backend backend, size_t offset)
+{
+	// The destination is unaligned by the same offset as the source
+	vector<uint8_t> dst(offset + 4 * numPixels + 4, g_guard);
+	ConvertRGBAToLuma(&dst[offset], pSrc, numPixels, backend);
+
+	auto numMismatches = 0u;
+	for (size_t i = 0; i < numPixels; ++i)
+	{
+		const auto pPixel = &pSrc[4 * i];
+		const auto pResult = &dst[offset + 4 * i];
+		const auto luma = ToLumaFixed(pPixel[0], pPixel[1], pPixel[2]);
+		if (pResult[0] != luma || pResult[1] != luma || pResult[2] != luma || pResult[3] != pPixel[3]) ++numMismatches;
+	}
+	CHECK(numMismatches == 0);
+	CHECK(dst[offset + 4 * numPixels] == g_guard);
+	if (numMismatches > 0) cerr << GetBackendName(backend) << ", " << numPixels << " pixels" << endl;
+}
+
+static void TestLuma()
+{
+	// Random pixels, at every length and source alignment
+	for (uint8_t b = 0; b < BACKEND_AUTO; ++b)
+	{
+		const auto backend = static_cast<Backend>(b);
+		if (!IsBackendSupported(backend)) continue;
+
+		for (auto offset = 0u; offset < 4; ++offset)
+		{
+			auto src = MakeRandomRGBA(g_maxNumPixels + 1, offset);
+			for (size_t n = 0; n <= g_maxNumPixels; ++n) CheckLuma(&src[offset], n, backend, offset);
+		}
+	}
+
+	// Every grey, and every single channel, from 0 to 255
+	vector<uint8_t> src;
+	for (auto i = 0u; i < 256; ++i)
+	{
+		const auto v = static_cast<uint8_t>(i);
+		src.insert(src.end(), { v, v, v, v, v, 0, 0, 255, 0, v, 0, 0, 0, 0, v, 255 });
+	}
+	for (uint8_t b = 0; b < BACKEND_AUTO; ++b)
+		if (IsBackendSupported(static_cast<Backend>(b))) CheckLuma(src.data(), src.size() / 4, static_cast<Backend>(b), 0);
+
+	// The luma never exceeds 255, so it never wraps around in 8 bits
+	CHECK(ToLumaFixed(255, 255, 255) == 255);
+	CHECK(ToLumaFixed(0, 0, 0) == 0);
+}
+
+// Random float bits: NaNs, infinities and subnormals among them, and values around the
+// range of half floats, with the ties and the extremes of the half conversion ahead
+static vector<float> MakeRandomFloats(size_t numValues, uint32_t seed)
+{
+	static const uint32_t specialBits[] =
+	{
+		0x7fc00000, 0xffc00000, 0x7f800001, 0x7fc02000, 0xffbfffff,	// NaNs, quiet and signaling
+		0x7f800000, 0xff800000, 0x00000000, 0x80000000,				// Infinities and zeros
+		0x477fe000, 0x477fefff, 0x477ff000, 0x47800000,				// Around the max half, 65504
+		0x33800000, 0x33000000, 0x33000001, 0x387fc000,				// Around the half subnormals
+		0x3f801000, 0x3f803000, 0x00000001							// Ties to even, and a float subnormal
+	};
+
+	vector<float> values(numValues);
+	mt19937 rng(seed);
+	for (size_t i = 0; i < numValues; ++i)
+	{
+		const auto r = rng();
+		uint32_t bits;
+		if (i < sizeof(specialBits) / sizeof(uint32_t)) bits = specialBits[i];
+		else if (r % 4 == 0) bits = rng();
+		else
+		{
+			const auto value = ldexp(static_cast<float>(rng() & 0xffffff) / 0x1000000, static_cast<int>(r % 48) - 30);
+			memcpy(&bits, &value, sizeof(bits));
+			bits |= r & 0x80000000;
+		}
+		memcpy(&values[i], &bits, sizeof(bits));
+	}
+
+	return values;
+}
+
+// Runs the kernel of every vector backend at every length, and at source and destination
+// element offsets that leave them unaligned, and compares its result with the result of
+// the scalar backend bit for bit, including the guard past the last pixel. The source ends
+// right after the last pixel, so that a sanitized build catches any kernel reading past it.
+template<typename TDst, typename TSrc, typename Kernel>
+static void CheckBackends(const char* kernelName, const vector<TSrc>& src, size_t srcStride, size_t dstStride,
+	const Kernel& kernel)
+{
+	assert(src.size() >= 3 + srcStride * g_maxNumPixels);
+
+	for (uint8_t b = BACKEND_SCALAR + 1; b < BACKEND_AUTO; ++b)
+	{
+		const auto backend = static_cast<Backend>(b);
+		if (!IsBackendSupported(backend)) continue;
+
+		auto numMismatches = 0u;
+		for (auto offset = 0u; offset < 4; ++offset)
+			for (size_t n = 0; n <= g_maxNumPixels; ++n)
+			{
+				TDst guard;
+				memset(&guard, g_guard, sizeof(guard));
+				const vector<TSrc> pixels(src.cbegin(), src.cbegin() + offset + srcStride * n);
+				vector<TDst> expected(offset + dstStride * (n + 1), guard), result(expected);
+				kernel(&expected[offset], pixels.data() + offset, n, BACKEND_SCALAR);
+				kernel(&result[offset], pixels.data() + offset, n, backend);
+				if (memcmp(expected.data(), result.data(), sizeof(TDst) * expected.size()) != 0)
+				{
+					if (numMismatches++ == 0) cerr << kernelName << ", " << GetBackendName(backend) << ", "
+						<< n << " pixels at offset " << offset << endl;
+				}
+			}
+		CHECK(numMismatches == 0);
+	}
+}
+
+static void TestExpand()
+{
+	const auto src8 = MakeRandomRGBA(g_maxNumPixels + 1, 10);
+	CheckBackends<uint8_t>("ExpandRGBToRGBA", src8, 3, 4,
+		[](uint8_t* pDst, const uint8_t* pSrc, size_t n, Backend backend) { ExpandRGBToRGBA(pDst, pSrc, n, backend); });
+
+	vector<uint16_t> src16(4 * (g_maxNumPixels + 1));
+	mt19937 rng(11);
+	for (auto& value : src16) value = static_cast<uint16_t>(rng());
+	CheckBackends<uint16_t>("ExpandRGBToRGBA16", src16, 3, 4,
+		[](uint16_t* pDst, const uint16_t* pSrc, size_t n, Backend backend) { ExpandRGBToRGBA16(pDst, pSrc, n, backend); });
+
+	const auto src32F = MakeRandomFloats(4 * (g_maxNumPixels + 1), 12);
+	CheckBackends<float>("ExpandRGBToRGBA32F", src32F, 3, 4,
+		[](float* pDst, const float* pSrc, size_t n, Backend backend) { ExpandRGBToRGBA32F(pDst, pSrc, n, backend); });
+
+	// The scalar reference itself
+	const uint8_t rgb[] = { 1, 2, 3, 4, 5, 6 };
+	uint8_t rgba[8];
+	ExpandRGBToRGBA(rgba, rgb, 2, BACKEND_SCALAR);
+	CHECK(memcmp(rgba, "\1\2\3\377\4\5\6\377", sizeof(rgba)) == 0);
+}
+
+static void TestHalf()
+{
+	// The scalar reference, on the values F16C converts as below
+	const struct
+	{
+		uint32_t Bits;
+		uint16_t Half;
+	} cases[] =
+	{
+		{ 0x3f800000, 0x3c00 },	// 1.0
+		{ 0xc0000000, 0xc000 },	// -2.0
+		{ 0x477fe000, 0x7bff },	// 65504, the max half
+		{ 0x477ff000, 0x7c00 },	// 65520 rounds to infinity
+		{ 0x7f800000, 0x7c00 },	// Infinity
+		{ 0x33800000, 0x0001 },	// The min half subnormal
+		{ 0x33000000, 0x0000 },	// Half of it ties to even zero
+		{ 0x80000000, 0x8000 },	// -0.0
+		{ 0x3f801000, 0x3c00 },	// Ties to even, down
+		{ 0x3f803000, 0x3c02 },	// Ties to even, up
+		{ 0x7fc00000, 0x7e00 },	// Quiet NaN
+		{ 0x7f800001, 0x7e00 },	// Signaling NaN, quieted; its payload is below the half mantissa
+		{ 0xffc02000, 0xfe01 },	// Negative NaN with the top payload bits kept
+		{ 0x7fbfe000, 0x7fff }	// Signaling NaN, quieted, with all the payload bits of a half
+	};
+	for (const auto& c : cases)
+	{
+		float value;
+		uint16_t half;
+		memcpy(&value, &c.Bits, sizeof(value));
+		ConvertFloatToHalf(&half, &value, 1, BACKEND_SCALAR);
+		CHECK(half == c.Half);
+		if (half != c.Half) cerr << hex << c.Bits << " -> " << half << ", not " << c.Half << dec << endl;
+	}
+
+	const auto src = MakeRandomFloats(4 * (g_maxNumPixels + 1), 13);
+	CheckBackends<uint16_t>("ConvertFloatToHalf", src, 1, 1,
+		[](uint16_t* pDst, const float* pSrc, size_t n, Backend backend) { ConvertFloatToHalf(pDst, pSrc, n, backend); });
+	CheckBackends<uint16_t>("ConvertRGBToRGBAHalf", src, 3, 4,
+		[](uint16_t* pDst, const float* pSrc, size_t n, Backend backend) { ConvertRGBToRGBAHalf(pDst, pSrc, n, backend); });
+}
+
+int main()
+{
+	for (uint8_t b = 0; b < BACKEND_AUTO; ++b)
+		if (IsBackendSupported(static_cast<Backend>(b))) cout << "Backend: " << GetBackendName(static_cast<Backend>(b)) << endl;
+
+	TestLuma();
+	TestExpand();
+	TestHalf();
+
+	return ReportChecks();
+}
@@ -0,0 +1,31 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// The checks shared by the portable tests, each of which is a single translation unit:
+// a failed check is reported with its location, and the test goes on to the next one.
+
+#pragma once
+
+#include <iostream>
+
+static int g_numFailures = 0;
+
+#define CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			std::cerr << __FILE__ << "(" << __LINE__ << "): check failed: " #cond << std::endl; \
+			++g_numFailures; \
+		} \
+	} while (0)
+
+// Reports the result of all the checks, as the exit code of the test
+static int ReportChecks()
+{
+	if (g_numFailures > 0) std::cerr << g_numFailures << " check(s) failed." << std::endl;
+	else std::cout << "All checks passed." << std::endl;
+
+	return g_numFailures > 0 ? 1 : 0;
+}
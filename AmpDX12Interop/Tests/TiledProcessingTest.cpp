@@ -0,0 +1,293 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Checks the band streaming and the CPU tiled processing end to end: images are written in
+// each streamed format, processed in tiles smaller than the image, and the PNG written band
+// by band is read back and compared with the luma of every pixel computed directly.
+
+#include "CPUTiledProcessor.h"
+#include "stb_image.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+
+static const char* const g_inFileName = "TiledProcessingTest_in";
+static const char* const g_outFileName = "TiledProcessingTest_out.png";
+
+static bool WriteFile(const string& fileName, const vector<uint8_t>& data)
+{
+	const auto pFile = fopen(fileName.c_str(), "wb");
+	if (!pFile) return false;
+	const auto isWritten = fwrite(data.data(), data.size(), 1, pFile) == 1;
+
+	return fclose(pFile) == 0 && isWritten;
+}
+
+static vector<uint8_t> MakeHeader(const char* header)
+{
+	return vector<uint8_t>(header, header + strlen(header));
+}
+
+static uint8_t ToLuma(uint32_t r, uint32_t g, uint32_t b)
+{
+	return static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+// Processes the file in tiles, and compares the output with the expected RGBA8 pixels
+static void CheckTiled(const string& fileName, uint32_t width, uint32_t height, const vector<uint8_t>& expected,
+	bool isStreamed, uint32_t tolerance = 0)
+{
+	BandReader reader;
+	BandWriter writer;
+	CHECK(reader.Open(fileName.c_str()));
+	CHECK(reader.IsStreamed() == isStreamed);
+	CHECK(writer.Open(g_outFileName, width, height));
+
+	CPUTiledProcessor tiledProcessor(3);
+	CHECK(tiledProcessor.Process(reader, writer, 7, 3));
+	CHECK(tiledProcessor.GetNumTiles() == ((width + 6) / 7) * ((height + 6) / 7));
+	reader.Close();
+	CHECK(writer.Close());
+
+	int w, h, comp;
+	const auto pResult = stbi_load(g_outFileName, &w, &h, &comp, 4);
+	CHECK(pResult && w == static_cast<int>(width) && h == static_cast<int>(height) && comp == 4);
+	if (!pResult) return;
+
+	auto numMismatches = 0u;
+	for (size_t i = 0; i < expected.size(); ++i)
+		if (static_cast<uint32_t>(abs(pResult[i] - expected[i])) > tolerance) ++numMismatches;
+	CHECK(numMismatches == 0);
+	stbi_image_free(pResult);
+}
+
+static void TestPPM8()
+{
+	const auto width = 37u, height = 29u;
+	auto file = MakeHeader("P6\n# comment\n37 29\n255\n");
+	vector<uint8_t> expected;
+	mt19937 rng(1);
+	for (auto i = 0u; i < width * height; ++i)
+	{
+		uint8_t rgb[3];
+		for (auto& c : rgb) c = static_cast<uint8_t>(rng());
+		file.insert(file.end(), rgb, rgb + 3);
+		const auto luma = ToLuma(rgb[0], rgb[1], rgb[2]);
+		expected.insert(expected.end(), { luma, luma, luma, 255 });
+	}
+
+	const auto fileName = string(g_inFileName) + ".ppm";
+	CHECK(WriteFile(fileName, file));
+	CheckTiled(fileName, width, height, expected, true);
+	remove(fileName.c_str());
+}
+
+static void TestPPM16()
+{
+	// Rounded to 8 bits before the luma, as the fixed-point AMP kernel does
+	const auto width = 20u, height = 15u;
+	auto file = MakeHeader("P6 20 15 65535\n");
+	vector<uint8_t> expected;
+	mt19937 rng(2);
+	for (auto i = 0u; i < width * height; ++i)
+	{
+		uint32_t rgb[3];
+		for (auto& c : rgb)
+		{
+			c = rng() & 0xffff;
+			file.insert(file.end(), { static_cast<uint8_t>(c >> 8), static_cast<uint8_t>(c) });
+			c = static_cast<uint32_t>(lround(c / 65535.0 * 255.0));
+		}
+		const auto luma = ToLuma(rgb[0], rgb[1], rgb[2]);
+		expected.insert(expected.end(), { luma, luma, luma, 255 });
+	}
+
+	const auto fileName = string(g_inFileName) + ".ppm";
+	CHECK(WriteFile(fileName, file));
+	CheckTiled(fileName, width, height, expected, true);
+	remove(fileName.c_str());
+}
+
+static void TestPGM()
+{
+	const auto width = 9u, height = 23u;
+	auto file = MakeHeader("P5\n9 23\n255\n");
+	vector<uint8_t> expected;
+	for (auto i = 0u; i < width * height; ++i)
+	{
+		const auto grey = static_cast<uint8_t>(i * 7);
+		file.push_back(grey);
+		expected.insert(expected.end(), { grey, grey, grey, 255 });
+	}
+
+	const auto fileName = string(g_inFileName) + ".pgm";
+	CHECK(WriteFile(fileName, file));
+	CheckTiled(fileName, width, height, expected, true);
+	remove(fileName.c_str());
+}
+
+static void TestPFM()
+{
+	// Little-endian RGB floats, stored bottom up, tone-mapped from the luma
+	const auto width = 11u, height = 8u;
+	auto file = MakeHeader("PF\n11 8\n-1.0\n");
+	vector<float> pixels(3 * width * height);
+	mt19937 rng(3);
+	for (auto& value : pixels) value = (rng() % 4000) / 1000.0f;
+	for (auto y = height; y-- > 0;)
+	{
+		const auto pRow = reinterpret_cast<const uint8_t*>(&pixels[3 * width * y]);
+		file.insert(file.end(), pRow, pRow + sizeof(float) * 3 * width);
+	}
+
+	vector<uint8_t> expected;
+	for (auto i = 0u; i < width * height; ++i)
+	{
+		const auto pRGB = &pixels[3 * i];
+		const auto luma = 0.299f * pRGB[0] + 0.587f * pRGB[1] + 0.114f * pRGB[2];
+		const auto grey = static_cast<uint8_t>(luma / (1.0f + luma) * 255.0f + 0.5f);
+		expected.insert(expected.end(), { grey, grey, grey, 255 });
+	}
+
+	const auto fileName = string(g_inFileName) + ".pfm";
+	CHECK(WriteFile(fileName, file));
+	CheckTiled(fileName, width, height, expected, true, 1);
+	remove(fileName.c_str());
+}
+
+static void TestDDS()
+{
+	// BC1 blocks of a 13x10 image, decoded block row by block row
+	const auto width = 13u, height = 10u;
+	const auto numBlocks = ((width + 3) / 4) * ((height + 3) / 4);
+	vector<uint8_t> file(128 + 8 * numBlocks);
+	const auto writeUint32 = [&file](size_t offset, uint32_t value) { memcpy(&file[offset], &value, sizeof(value)); };
+	memcpy(file.data(), "DDS ", 4);
+	writeUint32(4, 124);
+	writeUint32(12, height);
+	writeUint32(16, width);
+	writeUint32(76, 32);
+	writeUint32(80, 0x4);
+	memcpy(&file[84], "DXT1", 4);
+	mt19937 rng(4);
+	for (auto i = 128u; i < file.size(); ++i) file[i] = static_cast<uint8_t>(rng());
+
+	vector<uint8_t> expected(4 * width * height);
+	BCDecoder::DecodeRegion(BCDecoder::FORMAT_BC1, &file[128], width, height, 0, 0, width, height,
+		expected.data(), 4 * width);
+	for (auto i = 0u; i < width * height; ++i)
+	{
+		const auto pPixel = &expected[4 * i];
+		pPixel[0] = pPixel[1] = pPixel[2] = ToLuma(pPixel[0], pPixel[1], pPixel[2]);
+	}
+
+	const auto fileName = string(g_inFileName) + ".dds";
+	CHECK(WriteFile(fileName, file));
+	CheckTiled(fileName, width, height, expected, true);
+	remove(fileName.c_str());
+}
+
+static void TestDecodedFallback()
+{
+	// A PNG, as the band writer writes it, is decoded as a whole off Windows
+	const auto width = 16u, height = 12u;
+	vector<uint8_t> pixels(4 * width * height), expected(pixels.size());
+	mt19937 rng(5);
+	for (auto& value : pixels) value = static_cast<uint8_t>(rng());
+	for (auto i = 0u; i < width * height; ++i)
+	{
+		const auto pPixel = &pixels[4 * i];
+		const auto luma = ToLuma(pPixel[0], pPixel[1], pPixel[2]);
+		expected[4 * i] = expected[4 * i + 1] = expected[4 * i + 2] = luma;
+		expected[4 * i + 3] = pPixel[3];
+	}
+
+	const auto fileName = string(g_inFileName) + ".png";
+	BandWriter writer;
+	CHECK(writer.Open(fileName.c_str(), width, height));
+	CHECK(writer.WriteRows(pixels.data(), 4 * width, 5));
+	CHECK(!BandWriter().Close());
+	CHECK(writer.WriteRows(&pixels[4 * width * 5], 4 * width, height - 5));
+	CHECK(!writer.WriteRows(pixels.data(), 4 * width, 1));
+	CHECK(writer.Close());
+
+#ifdef _WIN32
+	CheckTiled(fileName, width, height, expected, true);
+#else
+	CheckTiled(fileName, width, height, expected, false);
+#endif
+	remove(fileName.c_str());
+}
+
+static void TestBandStreamer()
+{
+	// Every source row in a band, halo included, is the row of the image it claims to be
+	const auto width = 600u, height = 411u, bandHeight = 16u, haloSize = 5u;
+	auto file = MakeHeader("P5\n600 411\n255\n");
+	for (auto y = 0u; y < height; ++y)
+		for (auto x = 0u; x < width; ++x) file.push_back(static_cast<uint8_t>(x ^ (y * 3)));
+
+	const auto fileName = string(g_inFileName) + ".pgm";
+	CHECK(WriteFile(fileName, file));
+
+	BandReader reader;
+	BandWriter writer;
+	CHECK(reader.Open(fileName.c_str()));
+	CHECK(writer.Open(g_outFileName, width, height));
+
+	auto nextY = 0u, numBadRows = 0u;
+	BandStreamer streamer;
+	const auto processBand = [&](const BandStreamer::Band& band)
+	{
+		CHECK(band.Y == nextY);
+		CHECK(band.SrcY == (band.Y > haloSize ? band.Y - haloSize : 0));
+		CHECK(band.SrcY + band.SrcHeight == (min)(band.Y + band.Height + haloSize, height));
+		nextY += band.Height;
+
+		for (auto i = 0u; i < band.SrcHeight; ++i)
+			for (auto x = 0u; x < width; ++x)
+				if (band.pSource[band.SourceRowPitch * i + 4 * x] != static_cast<uint8_t>(x ^ ((band.SrcY + i) * 3)))
+				{
+					++numBadRows;
+					break;
+				}
+
+		for (auto i = 0u; i < band.Height; ++i)
+			memcpy(&band.pResult[band.ResultRowPitch * i], &band.pSource[band.SourceRowPitch * (band.Y - band.SrcY + i)],
+				band.ResultRowPitch);
+
+		return true;
+	};
+	CHECK(streamer.Run(reader, writer, bandHeight, haloSize, processBand));
+	CHECK(nextY == height);
+	CHECK(numBadRows == 0);
+	CHECK(writer.Close());
+
+	// Only the bands are held, never the whole image
+	const size_t bandSize = 4 * width * (2 * bandHeight + 2 * haloSize);
+	CHECK(streamer.GetBufferSize() <= bandSize + 2 * 4096);
+	CHECK(streamer.GetBufferSize() < 4 * width * height / 8);
+
+	reader.Close();
+	remove(fileName.c_str());
+}
+
+int main()
+{
+	TestPPM8();
+	TestPPM16();
+	TestPGM();
+	TestPFM();
+	TestDDS();
+	TestDecodedFallback();
+	TestBandStreamer();
+	remove(g_outFileName);
+
+	return ReportChecks();
+}
@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Stands in for the precompiled header of the sample, which the portable sources rely on
+// for the standard headers, without D3D12 or C++ AMP. Off Windows, the rect functions of
+// Win32 that they use are defined with the same results.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+typedef long LONG;
+typedef int BOOL;
+
+struct RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+
+inline BOOL IsRectEmpty(const RECT* pRect)
+{
+	return pRect->right <= pRect->left || pRect->bottom <= pRect->top;
+}
+
+inline BOOL EqualRect(const RECT* pRect1, const RECT* pRect2)
+{
+	return pRect1->left == pRect2->left && pRect1->top == pRect2->top &&
+		pRect1->right == pRect2->right && pRect1->bottom == pRect2->bottom;
+}
+
+inline BOOL IntersectRect(RECT* pDst, const RECT* pSrc1, const RECT* pSrc2)
+{
+	const RECT rect =
+	{
+		(std::max)(pSrc1->left, pSrc2->left), (std::max)(pSrc1->top, pSrc2->top),
+		(std::min)(pSrc1->right, pSrc2->right), (std::min)(pSrc1->bottom, pSrc2->bottom)
+	};
+	*pDst = IsRectEmpty(&rect) ? RECT() : rect;
+
+	return !IsRectEmpty(&rect);
+}
+
+inline BOOL UnionRect(RECT* pDst, const RECT* pSrc1, const RECT* pSrc2)
+{
+	// An empty rect adds nothing
+	if (IsRectEmpty(pSrc1) && IsRectEmpty(pSrc2)) *pDst = RECT();
+	else if (IsRectEmpty(pSrc1)) *pDst = *pSrc2;
+	else if (IsRectEmpty(pSrc2)) *pDst = *pSrc1;
+	else *pDst =
+	{
+		(std::min)(pSrc1->left, pSrc2->left), (std::min)(pSrc1->top, pSrc2->top),
+		(std::max)(pSrc1->right, pSrc2->right), (std::max)(pSrc1->bottom, pSrc2->bottom)
+	};
+
+	return !IsRectEmpty(pDst);
+}
+#endif
@@ -40,6 +40,11 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <deque>
 
 #if _HAS_CXX17
 #include <winrt/base.h>